@@ -0,0 +1,106 @@
+#pragma once
+
+#include "bvh.h"
+#include "sphere_kernels.h"
+#include "vector3.h"
+#include <memory>
+
+class Scene;
+struct MeshInstance;
+struct Sphere;
+
+// Precision of the intersection kernels, chosen when building
+#ifdef RAY_TRACER_DOUBLE_PRECISION
+using intersect_real = double;
+#else
+using intersect_real = float;
+#endif
+
+/**
+ * SceneAccelerator - Ray queries against a scene through a BVH
+ *
+ * Mesh instances get a second, top-level BVH over their world bounds; rays
+ * reaching an instance are moved into its object space and traced through
+ * the shared mesh's own BVH.
+ *
+ * Built once per render from the scene's spheres; the scene must outlive it
+ * and must not change while it is in use. Sphere geometry is copied into
+ * structure-of-arrays form in BVH leaf order, so each leaf is one contiguous
+ * batch for the SIMD kernels.
+ *
+ * The tree and geometry may instead come prebuilt (see SceneCache), in which
+ * case they are used where they lie without copying.
+ */
+class SceneAccelerator {
+public:
+    struct Hit {
+        bool hit = false;
+        double t = 0.0;
+        const Sphere* sphere = nullptr;         // Null for mesh hits
+        const MeshInstance* instance = nullptr;  // Null for sphere hits
+        uint32_t material = 0;  // Index into the scene's material table
+        Vector3 normal;  // Unit length; facing the ray for triangles
+    };
+
+    // BVH and leaf-ordered geometry built earlier; `owner` keeps the memory
+    // they point into alive
+    struct Prebuilt {
+        const BVHNode* nodes = nullptr;
+        size_t node_count = 0;
+        const uint32_t* indices = nullptr;
+        size_t primitive_count = 0;
+        int depth = 0;
+        SphereView<intersect_real> geometry{};  // Padded like SphereArrays
+        std::shared_ptr<const void> owner;
+    };
+
+    SceneAccelerator(const Scene& scene, int num_threads = 1,
+                     SimdLevel simd_level = detect_simd_level());
+    SceneAccelerator(const Scene& scene, Prebuilt prebuilt,
+                     SimdLevel simd_level = detect_simd_level());
+
+    // Nearest sphere whose entry point lies in (t_min, t_max)
+    Hit closest_hit(const Vector3& origin, const Vector3& direction,
+                    double t_min, double t_max) const;
+
+    // Whether any sphere's entry point lies in (t_min, t_max); stops at the
+    // first one found and builds no hit record
+    bool occluded(const Vector3& origin, const Vector3& direction,
+                  double t_min, double t_max) const;
+
+    // Follow spheres that moved or resized since the build, keeping the
+    // tree's shape. False if the scene's sphere count changed (nothing is
+    // touched) or if the refit tree has grown so loose that rebuilding
+    // would pay off; it is still correct then, only slower to traverse.
+    bool refit();
+
+    const BVH& bvh() const { return bvh_; }
+    const BVH& instance_bvh() const { return instance_bvh_; }
+    const SphereView<intersect_real>& geometry() const { return view_; }
+    double build_ms() const { return build_ms_; }  // Of the last build or refit
+    SimdLevel simd_level() const { return kernels_.level; }
+
+private:
+    const Scene& scene_;
+    BVH bvh_;
+    SphereArrays<intersect_real> geometry_;
+    SphereView<intersect_real> view_;
+    SphereKernels<intersect_real> kernels_;
+    std::shared_ptr<const void> prebuilt_owner_;
+    BVH instance_bvh_;
+    double build_ms_ = 0.0;
+    double built_area_ = 0.0;  // bvh_.interior_area() when built
+
+    // Refits may loosen the tree up to this factor of its built area
+    static constexpr double max_refit_growth = 2.0;
+
+    // Copy sphere geometry into leaf order for the kernels
+    void fill_geometry();
+
+    // Kernel ray along the unit direction; returns the direction's length
+    // (0 for a degenerate ray) to convert distances back
+    double prepare_ray(const Vector3& origin, const Vector3& direction,
+                       KernelRay<intersect_real>& kernel_ray) const;
+
+    void build_instance_bvh(int num_threads);
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "vector3.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Scene;
+struct Camera;
+
+/**
+ * Animation - Keyframed motion of a scene's spheres, lights and camera
+ *
+ * Each track moves one property through its keys, interpolated linearly
+ * between them and held before the first and after the last. Objects only
+ * move and are never added or removed, so from one frame to the next a
+ * renderer can refit its BVH instead of rebuilding it.
+ */
+class Animation {
+public:
+    enum class Target {
+        SPHERE_CENTER,    // Sphere `index`, in the order added
+        LIGHT_POSITION,   // Light `index`, in the order added
+        CAMERA_POSITION,
+        CAMERA_LOOK_AT,
+        CAMERA_ORBIT      // value.x degrees around the target, about the up vector
+    };
+
+    // Key a property at frame (from 0); a second key at the same frame replaces the first
+    void add_key(Target target, uint32_t index, int frame, const Vector3& value);
+
+    // Whole camera turn over frames frames, ending one step short of the start so it loops
+    static Animation turntable(int frames);
+
+    // Frames in the sequence: set_frame_count, or one past the last key if that is later
+    int frame_count() const;
+    void set_frame_count(int frames) { frame_count_ = frames; }
+
+    bool empty() const { return tracks_.empty(); }
+
+    // Whether any track moves spheres; if not, a BVH stays valid for every frame
+    bool moves_spheres() const;
+
+    // Pose scene at frame: keyed spheres and lights move to their place and
+    // the camera becomes base_camera with its keyed changes applied. Throws
+    // std::out_of_range for keys of objects the scene does not have.
+    void apply(int frame, const Camera& base_camera, Scene& scene) const;
+
+private:
+    struct Key {
+        int frame;
+        Vector3 value;
+    };
+
+    struct Track {
+        Target target;
+        uint32_t index;
+        std::vector<Key> keys;  // Sorted by frame
+    };
+
+    std::vector<Track> tracks_;
+    int frame_count_ = 0;
+
+    static Vector3 value_at(const Track& track, int frame);
+};
+
+// File name of a frame: the first run of '#' in pattern becomes the frame
+// number zero-padded to its length ("frame_####.png" -> "frame_0007.png");
+// without one, "_NNNN" goes before the extension
+std::string frame_filename(const std::string& pattern, int frame);
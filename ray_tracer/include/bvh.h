@@ -0,0 +1,188 @@
+#pragma once
+
+#include "instrumentation.h"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * AABB - Axis-aligned bounding box in single precision
+ */
+struct AABB {
+    float min[3] = {std::numeric_limits<float>::infinity(),
+                    std::numeric_limits<float>::infinity(),
+                    std::numeric_limits<float>::infinity()};
+    float max[3] = {-std::numeric_limits<float>::infinity(),
+                    -std::numeric_limits<float>::infinity(),
+                    -std::numeric_limits<float>::infinity()};
+
+    void expand(const AABB& other) {
+        for (int i = 0; i < 3; ++i) {
+            min[i] = std::fmin(min[i], other.min[i]);
+            max[i] = std::fmax(max[i], other.max[i]);
+        }
+    }
+
+    void expand(const float point[3]) {
+        for (int i = 0; i < 3; ++i) {
+            min[i] = std::fmin(min[i], point[i]);
+            max[i] = std::fmax(max[i], point[i]);
+        }
+    }
+
+    float surface_area() const {
+        float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+        if (dx < 0 || dy < 0 || dz < 0) return 0.0f;
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+
+    float centroid(int axis) const { return 0.5f * (min[axis] + max[axis]); }
+
+    // Conservative float box around a double-precision sphere
+    static AABB around_sphere(double cx, double cy, double cz, double radius);
+};
+
+/**
+ * BVHNode - Flattened 32-byte BVH node
+ *
+ * Interior nodes (count == 0) store their left child immediately after
+ * themselves and the right child at `offset`; `axis` is the split axis used to
+ * pick the near child. Leaves cover primitives [offset, offset + count) of
+ * BVH::primitive_indices().
+ */
+struct BVHNode {
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t offset;
+    uint16_t count;
+    uint8_t axis;
+    uint8_t pad;
+
+    bool is_leaf() const { return count > 0; }
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode must stay 32 bytes");
+
+/**
+ * BVHRay - Ray prepared once for repeated slab tests
+ */
+struct BVHRay {
+    float origin[3];
+    float inv_dir[3];
+    uint8_t dir_negative[3];
+
+    BVHRay(double ox, double oy, double oz, double dx, double dy, double dz);
+};
+
+/**
+ * BVH - Bounding volume hierarchy built with the binned surface area heuristic
+ *
+ * Primitives are only seen through their bounds, so the same structure serves
+ * any primitive type; callers intersect the primitives of each visited leaf.
+ */
+class BVH {
+public:
+    // Most levels a tree may have: traversal keeps a fixed stack this deep
+    static constexpr int max_depth = 64;
+
+    struct BuildOptions {
+        int max_leaf_size = 4;
+        int bins = 16;
+        int num_threads = 1;  // Subtrees are built in parallel above a size threshold
+    };
+
+    // Build over the given primitive bounds (replaces any previous tree)
+    void build(const std::vector<AABB>& primitive_bounds, const BuildOptions& options);
+
+    // Use a tree built earlier, e.g. mapped from a cache file, in place. The
+    // arrays are not copied and must outlive this BVH.
+    void adopt(const BVHNode* nodes, size_t node_count, const uint32_t* indices,
+               size_t primitive_count, int depth);
+
+    // Recompute node bounds bottom-up after primitives moved, keeping the
+    // tree's shape: O(nodes) instead of a rebuild. Bounds are indexed like
+    // those built over, which must have the same count. Adopted nodes are
+    // copied first, since they may be read-only.
+    void refit(const std::vector<AABB>& primitive_bounds);
+
+    // Summed surface area of interior nodes, proportional to the expected
+    // traversal cost; grows as refits stretch the tree
+    double interior_area() const;
+
+    bool empty() const { return node_count_ == 0; }
+    const BVHNode* nodes() const { return nodes_; }
+    size_t node_count() const { return node_count_; }
+    const uint32_t* primitive_indices() const { return indices_; }
+    size_t primitive_count() const { return primitive_count_; }
+    int depth() const { return depth_; }
+
+    // Visit leaves the ray may hit, near child first. leaf(first, count, t_max)
+    // may shrink t_max to prune farther nodes and returns true to stop early.
+    template <typename LeafFn>
+    void traverse(const BVHRay& ray, double& t_max, LeafFn&& leaf) const;
+
+private:
+    std::vector<BVHNode> node_storage_;
+    std::vector<uint32_t> index_storage_;
+    const BVHNode* nodes_ = nullptr;  // node_storage_ or adopted memory
+    size_t node_count_ = 0;
+    const uint32_t* indices_ = nullptr;
+    size_t primitive_count_ = 0;
+    int depth_ = 0;
+};
+
+inline bool intersect_node(const BVHNode& node, const BVHRay& ray, float t_max) {
+    float t0 = 0.0f;
+    float t1 = t_max;
+    for (int i = 0; i < 3; ++i) {
+        float near_t = (node.bounds_min[i] - ray.origin[i]) * ray.inv_dir[i];
+        float far_t = (node.bounds_max[i] - ray.origin[i]) * ray.inv_dir[i];
+        if (ray.dir_negative[i]) {
+            float tmp = near_t;
+            near_t = far_t;
+            far_t = tmp;
+        }
+        t0 = near_t > t0 ? near_t : t0;
+        t1 = far_t < t1 ? far_t : t1;
+    }
+    return t0 <= t1;
+}
+
+template <typename LeafFn>
+void BVH::traverse(const BVHRay& ray, double& t_max, LeafFn&& leaf) const {
+    if (node_count_ == 0) {
+        return;
+    }
+
+    uint32_t stack[max_depth];
+    int stack_size = 0;
+    uint32_t current = 0;
+
+    while (true) {
+        const BVHNode& node = nodes_[current];
+        RT_COUNT(node_visits, 1);
+        if (intersect_node(node, ray, static_cast<float>(t_max))) {
+            if (node.is_leaf()) {
+                if (leaf(node.offset, node.count, t_max)) {
+                    return;
+                }
+            } else {
+                // Descend into the child on the ray's side of the split first
+                uint32_t left = current + 1;
+                uint32_t right = node.offset;
+                if (ray.dir_negative[node.axis]) {
+                    stack[stack_size++] = left;
+                    current = right;
+                } else {
+                    stack[stack_size++] = right;
+                    current = left;
+                }
+                continue;
+            }
+        }
+        if (stack_size == 0) {
+            return;
+        }
+        current = stack[--stack_size];
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "mapped_buffer.h"
+#include "pixel_estimate.h"
+#include <cstdint>
+#include <string>
+
+/**
+ * RenderCheckpoint - Everything needed to continue an interrupted render
+ *
+ * Sampler points depend only on the render seed, the pixel and its sample
+ * count, so a resumed render continues each pixel's sequence where it
+ * stopped instead of repeating earlier samples.
+ */
+struct RenderCheckpoint {
+    int width = 0;
+    int height = 0;
+    uint64_t seed = 0;
+    uint32_t passes = 0;          // Passes completed so far
+    uint32_t target_samples = 0;  // Samples per pixel the last pass aimed for
+    MappedBuffer<PixelEstimate> pixels;
+};
+
+// Write atomically (temporary file + rename) so a kill mid-write keeps the
+// previous checkpoint intact
+void save_checkpoint(const std::string& filename, const RenderCheckpoint& checkpoint);
+
+// False if the file does not exist; throws if it exists but is unusable.
+// Pixels are loaded into a mapping of scratch_file when one is given.
+bool load_checkpoint(const std::string& filename, RenderCheckpoint& checkpoint,
+                     const std::string& scratch_file = "");
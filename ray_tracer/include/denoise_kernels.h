@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+
+// Planes are padded on every side by this many pixels, which covers the
+// widest footprint (two taps of the largest step) plus a vector's overhang
+// past the last column, so rows need no edge cases
+constexpr int denoise_padding = 40;
+constexpr int denoise_max_step = 16;
+
+/**
+ * DenoisePlanes - One à-trous pass: inputs and outputs as padded planes
+ *
+ * Pixel (x, y) lies at (y + denoise_padding) * stride + x + denoise_padding.
+ * Padding has valid = 0 and never contributes to a pixel.
+ */
+struct DenoisePlanes {
+    ptrdiff_t stride;
+    const float* red;  // Albedo-demodulated color
+    const float* green;
+    const float* blue;
+    const float* variance;  // Of the demodulated luminance
+    const float* normal_x;
+    const float* normal_y;
+    const float* normal_z;
+    const float* depth;
+    const float* valid;            // 1 inside the image
+    const float* luminance_scale;  // 1 / (sigma_luminance * blurred standard deviation)
+    const float* depth_scale;      // 1 / (sigma_depth * depth gradient * step)
+    float* out_red;
+    float* out_green;
+    float* out_blue;
+    float* out_variance;
+};
+
+// Shared body of the filter. Only include this from a translation unit
+// compiled for the target instruction set, with V defined in an anonymous
+// namespace so each instantiation stays local to that unit; nothing here
+// may call into the standard library (see sphere_kernels_simd.h).
+//
+// V provides: reg, lanes, set1, loadu, storeu, add, sub, mul, div, max, abs.
+
+template <typename V>
+typename V::reg denoise_luminance(const DenoisePlanes& p, ptrdiff_t i) {
+    return V::add(V::add(V::mul(V::set1(0.2126f), V::loadu(p.red + i)),
+                         V::mul(V::set1(0.7152f), V::loadu(p.green + i))),
+                  V::mul(V::set1(0.0722f), V::loadu(p.blue + i)));
+}
+
+// Filter image row y of width pixels with taps step pixels apart. Writes up
+// to V::lanes - 1 pixels past the row end, into the padding.
+template <typename V>
+void atrous_row(const DenoisePlanes& p, int y, int width, int step) {
+    using reg = typename V::reg;
+    const float spline[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+    const reg zero = V::set1(0.0f);
+    const reg one = V::set1(1.0f);
+    const reg tiny = V::set1(1e-20f);
+
+    ptrdiff_t row = (y + denoise_padding) * p.stride + denoise_padding;
+    for (int x = 0; x < width; x += V::lanes) {
+        ptrdiff_t i = row + x;
+        reg nx = V::loadu(p.normal_x + i);
+        reg ny = V::loadu(p.normal_y + i);
+        reg nz = V::loadu(p.normal_z + i);
+        reg depth = V::loadu(p.depth + i);
+        reg luminance = denoise_luminance<V>(p, i);
+        reg luminance_scale = V::loadu(p.luminance_scale + i);
+        reg depth_scale = V::loadu(p.depth_scale + i);
+
+        // The center tap always counts fully, so every weight sum is positive
+        reg center = V::mul(V::set1(spline[2] * spline[2]), V::loadu(p.valid + i));
+        reg sum_weight = center;
+        reg sum_red = V::mul(center, V::loadu(p.red + i));
+        reg sum_green = V::mul(center, V::loadu(p.green + i));
+        reg sum_blue = V::mul(center, V::loadu(p.blue + i));
+        reg sum_variance = V::mul(V::mul(center, center), V::loadu(p.variance + i));
+
+        for (int dy = -2; dy <= 2; ++dy) {
+            for (int dx = -2; dx <= 2; ++dx) {
+                if (dx == 0 && dy == 0) {
+                    continue;
+                }
+                ptrdiff_t q = i + (dy * p.stride + dx) * step;
+                int across = dx < 0 ? -dx : dx;
+                int down = dy < 0 ? -dy : dy;
+                float distance = static_cast<float>(across > down ? across : down);
+
+                // cos^128 of the angle between normals by repeated squaring
+                reg cosine = V::max(zero, V::add(V::add(V::mul(nx, V::loadu(p.normal_x + q)),
+                                                        V::mul(ny, V::loadu(p.normal_y + q))),
+                                                 V::mul(nz, V::loadu(p.normal_z + q))));
+                for (int k = 0; k < 7; ++k) {
+                    cosine = V::mul(cosine, cosine);
+                }
+
+                // exp(-e) as (1 + e/16)^-16: no transcendental, same falloff
+                reg e = V::add(
+                    V::mul(V::abs(V::sub(luminance, denoise_luminance<V>(p, q))), luminance_scale),
+                    V::mul(V::abs(V::sub(depth, V::loadu(p.depth + q))),
+                           V::mul(depth_scale, V::set1(1.0f / distance))));
+                reg falloff = V::add(one, V::mul(e, V::set1(1.0f / 16)));
+                falloff = V::mul(falloff, falloff);
+                falloff = V::mul(falloff, falloff);
+                falloff = V::mul(falloff, falloff);
+                falloff = V::mul(falloff, falloff);
+
+                reg weight = V::div(
+                    V::mul(V::mul(V::set1(spline[dx + 2] * spline[dy + 2]), V::loadu(p.valid + q)),
+                           cosine),
+                    falloff);
+                sum_weight = V::add(sum_weight, weight);
+                sum_red = V::add(sum_red, V::mul(weight, V::loadu(p.red + q)));
+                sum_green = V::add(sum_green, V::mul(weight, V::loadu(p.green + q)));
+                sum_blue = V::add(sum_blue, V::mul(weight, V::loadu(p.blue + q)));
+                sum_variance =
+                    V::add(sum_variance, V::mul(V::mul(weight, weight), V::loadu(p.variance + q)));
+            }
+        }
+
+        // Padding beyond the row end may have no weight at all; it stays finite
+        reg norm = V::max(sum_weight, tiny);
+        V::storeu(p.out_red + i, V::div(sum_red, norm));
+        V::storeu(p.out_green + i, V::div(sum_green, norm));
+        V::storeu(p.out_blue + i, V::div(sum_blue, norm));
+        V::storeu(p.out_variance + i,
+                  V::div(sum_variance, V::max(V::mul(sum_weight, sum_weight), tiny)));
+    }
+}
+
+using AtrousRowFn = void (*)(const DenoisePlanes& planes, int y, int width, int step);
+
+// Entry point of the AVX2 unit (see denoiser.cpp)
+AtrousRowFn avx2_atrous_row();
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "pixel_estimate.h"
+#include "vector3.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class WorkerPool;
+
+/**
+ * FeatureBuffers - First-hit surface data of every pixel (AOVs)
+ *
+ * Summed over a pixel's camera samples while rendering, then resolved into
+ * averages, so edges get the same antialiasing as the color. Misses count
+ * as white albedo with no normal at depth 0.
+ */
+struct FeatureBuffers {
+    int width = 0;
+    int height = 0;
+    std::vector<float> albedo;    // RGB: texture color the shaded result is multiplied by
+    std::vector<float> normal;    // XYZ, unit length, zero where every sample missed
+    std::vector<float> depth;     // Distance along the camera ray
+    std::vector<float> variance;  // Of the pixel's mean luminance, filled by resolve
+
+    // Zeroed buffers for a width x height image
+    void allocate(int w, int h);
+
+    // Add one camera sample of pixel (row-major index)
+    void add(size_t pixel, const Vector3& sample_albedo, const Vector3& sample_normal,
+             double sample_depth) {
+        float* a = &albedo[3 * pixel];
+        float* n = &normal[3 * pixel];
+        a[0] += static_cast<float>(sample_albedo.x);
+        a[1] += static_cast<float>(sample_albedo.y);
+        a[2] += static_cast<float>(sample_albedo.z);
+        n[0] += static_cast<float>(sample_normal.x);
+        n[1] += static_cast<float>(sample_normal.y);
+        n[2] += static_cast<float>(sample_normal.z);
+        depth[pixel] += static_cast<float>(sample_depth);
+    }
+
+    // Turn the sums into averages over each pixel's sample count and fill in
+    // variance. Pixels with fewer than two samples have no variance of their
+    // own and take that of the mean luminances around them.
+    void resolve(const PixelEstimate* estimates);
+
+    // Write albedo, normal, depth and variance images named
+    // <prefix>_albedo.pfm and so on
+    void write(const std::string& prefix) const;
+};
+
+/**
+ * DenoiseOptions - Edge-stopping strengths of the à-trous filter
+ */
+struct DenoiseOptions {
+    // The footprint doubles with each pass: 2 passes span 13 pixels. More
+    // passes blur shading detail at the noise levels of 4-8 samples/pixel.
+    int iterations = 2;
+    float sigma_luminance = 4.0f;  // In standard deviations of the pixel's noise
+    float sigma_depth = 1.0f;      // In multiples of the local depth gradient
+};
+
+// Edge-avoiding à-trous wavelet filter (as in SVGF). The color is divided
+// by albedo so texture detail is kept out of the blur, and each pass blends
+// a 5x5 B3-spline footprint, spaced 1, 2, 4, ... pixels apart. Neighbours
+// are weighted down by normal difference (cosine to the 128th power),
+// depth difference against the local gradient, and luminance difference
+// against the filtered noise level, which is propagated through every pass.
+// Rows run on the pool's threads and are vectorized for the CPU's widest
+// supported instruction set. color and the result are RGB per pixel.
+std::vector<float> denoise(const std::vector<float>& color, const FeatureBuffers& features,
+                           const DenoiseOptions& options, WorkerPool& pool);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "sampler.h"
+#include "tile_scheduler.h"
+#include <cstdint>
+#include <string>
+
+class Scene;
+
+/**
+ * DistributedSettings - Everything besides the scene that decides a pixel
+ *
+ * Shipped to every worker with the scene, so all of them render any given
+ * tile to the same bits.
+ */
+struct DistributedSettings {
+    int width = 800;
+    int height = 600;
+    int samples_per_pixel = 10;
+    int max_depth = 3;
+    SamplerType sampler = SamplerType::SOBOL;
+    uint64_t seed = 0;
+    double noise_threshold = 0.0;  // Adaptive sampling, as RayTracer::set_adaptive_sampling
+    int min_samples = 4;
+    int pass_samples = 0;          // Progressive passes, as RayTracer::set_progressive
+    int shadow_probe_samples = 4;
+    int shadow_max_samples = 16;
+    int light_samples = 0;         // Lights picked per hit, as RayTracer::set_light_samples
+};
+
+/**
+ * TileCoordinator - Renders one image on worker processes over TCP
+ *
+ * Workers connect at any time, even mid-render, and are sent the serialized
+ * scene once. Image textures are sent by the path of their tiled file, which
+ * workers must be able to open (e.g. on a shared file system). The image is
+ * cut into tiles handed out a few at a time per worker, so a worker always
+ * has its next tile queued and faster workers take more tiles. Once no
+ * unassigned tiles are left, idle workers are also given copies of tiles
+ * still out elsewhere; whichever copy returns first is kept, so a slow or
+ * stuck machine cannot hold up the end of the render.
+ * A worker that disconnects or keeps a tile past the timeout is dropped and
+ * its tiles go back to the front of the queue. Rendering is deterministic,
+ * so a tile rendered again anywhere matches the lost one exactly.
+ */
+class TileCoordinator {
+public:
+    struct Options {
+        int port = 7070;                 // 0 = any free port, see port()
+        int tile_size = 64;              // Edge of the tiles workers render
+        TileOrder order = TileOrder::MORTON;
+        int tiles_in_flight = 2;         // Per worker: the one rendering plus those queued
+        double timeout_seconds = 120.0;  // Longest a worker may keep a tile without answering
+        bool progress = true;            // Report tiles done and workers on stderr
+    };
+
+    // Starts listening at once, so workers may connect before render()
+    explicit TileCoordinator(const Options& options);
+    ~TileCoordinator();
+
+    TileCoordinator(const TileCoordinator&) = delete;
+    TileCoordinator& operator=(const TileCoordinator&) = delete;
+
+    int port() const { return port_; }
+
+    // Render scene on the workers that connect, waiting for one if there is
+    // none, and write the image (.ppm, .png or .pfm). Workers are told to
+    // exit once every tile is in. Throws if a worker reports an error, as
+    // the same tile would fail on every machine.
+    void render(const Scene& scene, const DistributedSettings& settings,
+                const std::string& output_file);
+
+private:
+    Options options_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+};
+
+// Connect to a coordinator at host:port, retrying for up to retry_seconds,
+// then render the tiles it sends on num_threads threads until it is done
+void run_tile_worker(const std::string& host, int port, int num_threads,
+                     double retry_seconds = 30.0);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "mapped_buffer.h"
+#include "vector3.h"
+#include <string>
+
+/**
+ * Framebuffer - Linear RGB image, 12 bytes per pixel of float
+ *
+ * Storage can be backed by an mmap'd scratch file for images larger than RAM.
+ */
+class Framebuffer {
+public:
+    Framebuffer(int width, int height, const std::string& scratch_file = "");
+
+    // Set pixel color at (x, y); out-of-range coordinates are ignored
+    void set_pixel(int x, int y, const Vector3& color);
+    Vector3 get_pixel(int x, int y) const;
+
+    // Row y as width * 3 floats
+    void read_row(int y, float* rgb) const;
+
+    // Write image to file, format chosen by extension (.ppm, .png, .pfm)
+    void write(const std::string& filename) const;
+
+    int get_width() const { return width_; }
+    int get_height() const { return height_; }
+    size_t bytes() const;
+
+private:
+    int width_;
+    int height_;
+    MappedBuffer<float> pixels_;
+};
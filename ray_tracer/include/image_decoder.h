@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * DecodedImage - 8-bit RGB pixels, row by row from the top
+ */
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgb;  // width * height * 3, as stored (gamma-encoded)
+};
+
+// Read a binary PPM (P6) or a non-interlaced PNG of any color type; alpha
+// is dropped and 16-bit channels keep their high byte. Throws
+// std::runtime_error for other formats and damaged files.
+DecodedImage decode_image(const std::string& filename);
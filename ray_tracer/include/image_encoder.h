@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class ImageFormat {
+    PPM,  // Binary P6, 8 bits per channel
+    PNG,  // 8-bit RGB, deflated
+    PFM   // 32-bit float RGB, linear (HDR)
+};
+
+// Format from the file extension (.ppm, .png, .pfm); throws for others
+ImageFormat image_format_for(const std::string& filename);
+
+// Clamp linear values to [0, 1], apply gamma 2.0 and quantize to bytes
+void convert_to_srgb8(const float* linear, uint8_t* out, size_t count);
+
+/**
+ * ImageEncoder - Encodes an image in horizontal strips, in any order
+ *
+ * Strips are independent (PNG strips are separate deflate runs stitched into
+ * one zlib stream), so different threads may encode different strips at the
+ * same time, e.g. as soon as the tiles covering them finish rendering. write()
+ * then only concatenates the encoded strips.
+ *
+ * In streaming mode the header is written up front and every strip goes to
+ * the file, and is freed, as soon as all strips before it in file order are
+ * done, so only strips still waiting on earlier ones are held in memory.
+ * PFM stores rows bottom to top: stream its strips last to first.
+ */
+class ImageEncoder {
+public:
+    // Fill `row` with width * 3 linear RGB floats of image row y
+    using RowSource = std::function<void(int y, float* row)>;
+
+    ImageEncoder(int width, int height, ImageFormat format, int strip_height = 32);
+    ~ImageEncoder();
+
+    int strip_count() const { return static_cast<int>(strips_.size()); }
+    int strip_height() const { return strip_height_; }
+
+    // Encode one strip; thread-safe for distinct strips
+    void encode_strip(int strip, const RowSource& source);
+    bool strip_encoded(int strip) const;
+
+    // Encode every strip not encoded yet, spread over num_threads threads
+    void encode_remaining(const RowSource& source, int num_threads);
+
+    // Write the header and all strips (all must be encoded)
+    void write(const std::string& filename) const;
+
+    // Streaming: open the file and write the header now, strips as they
+    // become writable, and the trailer in finish_stream()
+    void begin_stream(const std::string& filename);
+    void finish_stream();
+
+    // Strip order in the file (bottom-up for PFM)
+    int strip_in_file_order(int position) const;
+
+private:
+    struct Strip;
+
+    int width_;
+    int height_;
+    ImageFormat format_;
+    int strip_height_;
+    std::vector<std::unique_ptr<Strip>> strips_;
+
+    std::mutex stream_mutex_;
+    std::unique_ptr<std::ofstream> stream_;
+    std::string stream_filename_;
+    int stream_position_ = 0;
+    unsigned long stream_adler_ = 1;
+
+    void encode_png_strip(int strip, const RowSource& source, Strip& out) const;
+    void write_header(std::ostream& out) const;
+    void write_strip(std::ostream& out, const Strip& strip, unsigned long& adler) const;
+    void write_trailer(std::ostream& out, unsigned long adler) const;
+    void flush_stream();
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "texture_cache.h"
+#include "vector3.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct DecodedImage;
+
+/**
+ * ImageTexture - Mip-mapped image read tile by tile from a tiled file
+ *
+ * The tiled file (.rtx) holds the image's whole mip pyramid, each level
+ * half the size of the one before, box-filtered down to 1x1 in linear
+ * color. Every level is cut into tile_size x tile_size tiles of 8-bit RGB,
+ * gamma-encoded like the renderer's output, stored one after another at
+ * fixed offsets. Only the header stays in memory: texels come through a
+ * TextureCache, which reads the tiles they fall in on demand.
+ *
+ * A tiled file records the size and modification time of the image it was
+ * made from, like SceneCache, so load() remakes it once the image changes.
+ */
+class ImageTexture {
+public:
+    static constexpr int tile_size = 64;
+
+    ~ImageTexture();
+
+    // Open a tiled file; throws std::runtime_error if it is missing or damaged
+    static std::shared_ptr<const ImageTexture> open(
+        const std::string& filename, std::shared_ptr<TextureCache> cache = default_texture_cache());
+
+    // A .rtx file as open(), or a PPM or PNG image through its tiled file
+    // <image>.rtx, which is (re)made first if missing or stale
+    static std::shared_ptr<const ImageTexture> load(
+        const std::string& filename, std::shared_ptr<TextureCache> cache = default_texture_cache());
+
+    // Build image's mip pyramid and save it as a tiled file, atomically
+    // (temporary file + rename); source_file is the image it came from
+    static void write_tiled(const DecodedImage& image, const std::string& filename,
+                            const std::string& source_file = "");
+
+    // Trilinearly filtered linear color at (u, v), both in [0, 1] across the
+    // image (v down from the top row). u wraps around, v is clamped. du and
+    // dv are the footprint's extent in the same units: its larger side in
+    // texels picks the pair of mip levels blended.
+    Vector3 sample(double u, double v, double du, double dv) const;
+
+    const std::string& path() const { return path_; }
+    int width() const { return levels_[0].width; }
+    int height() const { return levels_[0].height; }
+    int level_count() const { return static_cast<int>(levels_.size()); }
+    uint64_t file_bytes() const { return file_bytes_; }
+
+    // For TextureCache: tile key prefix, tile size, and reading a tile
+    uint32_t cache_id() const { return cache_id_; }
+    size_t tile_bytes() const { return static_cast<size_t>(tile_size) * tile_size * 3; }
+    void read_tile(uint32_t tile, uint8_t* out) const;
+
+private:
+    struct Level {
+        int width;
+        int height;
+        int tiles_x;
+        uint32_t first_tile;  // Tile number of the level's top-left tile
+    };
+
+    std::string path_;
+    int fd_ = -1;
+    uint64_t data_offset_ = 0;
+    uint64_t file_bytes_ = 0;
+    uint32_t tile_count_ = 0;
+    std::vector<Level> levels_;
+    std::shared_ptr<TextureCache> cache_;
+    uint32_t cache_id_ = 0;
+
+    ImageTexture() = default;
+
+    // Gamma-decoded texel (x, y) of a level, both in range
+    Vector3 texel(int level, int x, int y) const;
+
+    // Bilinear lookup in one level
+    Vector3 bilinear(int level, double u, double v) const;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#ifdef RAY_TRACER_INSTRUMENT
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+/**
+ * TraceCounters - Work done by one thread, for render instrumentation
+ *
+ * Only built with RAY_TRACER_INSTRUMENT defined (CMake option
+ * RAY_TRACER_INSTRUMENTATION). Otherwise the RT_COUNT macros expand to
+ * nothing and the counters are never touched, so normal builds pay nothing.
+ * Counting goes through a thread-local record with no atomics; RayTracer
+ * collects it after every tile.
+ */
+struct TraceCounters {
+    uint64_t node_visits = 0;         // BVH nodes tested against a ray, all levels
+    uint64_t intersection_tests = 0;  // Spheres and triangles tested
+    uint32_t max_depth = 0;           // Deepest cast_ray recursion reached
+};
+
+#ifdef RAY_TRACER_INSTRUMENT
+
+inline thread_local TraceCounters thread_counters;
+
+#define RT_COUNT(field, n) (thread_counters.field += (n))
+#define RT_COUNT_MAX(field, value) \
+    (thread_counters.field = thread_counters.field < (value) ? (value) : thread_counters.field)
+
+// Timestamp for per-pixel cost: TSC cycles on x86, nanoseconds elsewhere
+inline uint64_t cost_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+inline const char* cost_clock_unit() {
+#if defined(__x86_64__) || defined(__i386__)
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
+
+#else
+
+#define RT_COUNT(field, n) ((void)0)
+#define RT_COUNT_MAX(field, value) ((void)0)
+
+#endif
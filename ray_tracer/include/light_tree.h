@@ -0,0 +1,56 @@
+#pragma once
+
+#include "bvh.h"
+#include "vector3.h"
+#include <cstdint>
+#include <vector>
+
+struct Light;
+
+/**
+ * LightTree - Hierarchy over a scene's lights for picking one by importance
+ *
+ * The lights are clustered by a BVH over their spheres, and every node also
+ * keeps the summed power of the lights below it. A pick walks down from the
+ * root, choosing each child with probability proportional to an upper bound
+ * on what it can add at the shading point: its power times how far the
+ * point's normal can face any light in its box (diffuse) plus the material's
+ * specular weight, which Blinn-Phong applies on both sides of the surface.
+ * Lights lit from behind by a whole cluster are skipped in one step, and the
+ * walk costs O(log lights) however many there are.
+ *
+ * A light that can contribute at the point always has a nonzero chance of
+ * being picked, so dividing its contribution by that chance (pdf) gives an
+ * unbiased estimate of the sum over all lights.
+ */
+class LightTree {
+public:
+    struct Pick {
+        uint32_t light = 0;  // Index into the lights built over
+        double pdf = 0.0;    // Probability of this pick; 0 if no light can contribute
+    };
+
+    // Build over the lights (replaces any previous tree)
+    void build(const std::vector<Light>& lights);
+
+    bool empty() const { return bvh_.empty(); }
+
+    // Pick a light for a point with the given normal, u uniform in [0, 1).
+    // diffuse and specular weigh the material's two lobes: the diffuse
+    // coefficient times the mean of its color, and its specular coefficient.
+    Pick sample(const Vector3& point, const Vector3& normal, double diffuse, double specular,
+                double u) const;
+
+private:
+    BVH bvh_;
+    std::vector<double> node_power_;   // Indexed like bvh_.nodes()
+    std::vector<double> light_power_;  // Mean intensity over the color channels
+    std::vector<Vector3> positions_;
+
+    // Bound on the contribution of node's lights at the point
+    double node_importance(uint32_t node, const Vector3& point, const Vector3& normal,
+                           double diffuse, double specular) const;
+
+    // Fill node_power_ for node's subtree; returns the node's power
+    double sum_power(uint32_t node);
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+/**
+ * MappedBuffer - Zero-initialized array in anonymous memory or a scratch file
+ *
+ * With a scratch file the array lives in a shared file mapping (the file is
+ * unlinked right away), so the kernel can write cold pages back to disk and
+ * evict them instead of the process needing the whole array in RAM.
+ */
+template <typename T>
+class MappedBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "MappedBuffer holds plain data");
+
+public:
+    MappedBuffer() = default;
+    ~MappedBuffer() { release(); }
+
+    MappedBuffer(MappedBuffer&& other) noexcept : data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    MappedBuffer& operator=(MappedBuffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    MappedBuffer(const MappedBuffer&) = delete;
+    MappedBuffer& operator=(const MappedBuffer&) = delete;
+
+    // Replace the contents with count zeroed elements
+    void allocate(size_t count, const std::string& scratch_file = "") {
+        release();
+        if (count == 0) {
+            return;
+        }
+
+        size_t bytes = count * sizeof(T);
+        void* memory;
+        if (scratch_file.empty()) {
+            memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        } else {
+            // The file must be new: it is unlinked once mapped, so a mistyped
+            // path naming an existing file would otherwise destroy it
+            int fd = open(scratch_file.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+            if (fd < 0 && errno == EEXIST) {
+                throw std::runtime_error("Scratch file already exists: " + scratch_file);
+            }
+            if (fd < 0) {
+                throw std::runtime_error("Failed to create scratch file: " + scratch_file);
+            }
+            if (ftruncate(fd, static_cast<off_t>(bytes)) < 0) {
+                close(fd);
+                unlink(scratch_file.c_str());
+                throw std::runtime_error("Failed to size scratch file: " + scratch_file);
+            }
+            memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            unlink(scratch_file.c_str());
+        }
+        if (memory == MAP_FAILED) {
+            throw std::runtime_error("Failed to map " + std::to_string(bytes) + " bytes");
+        }
+        data_ = static_cast<T*>(memory);
+        size_ = count;
+    }
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+
+    T* begin() { return data_; }
+    T* end() { return data_ + size_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+
+private:
+    T* data_ = nullptr;
+    size_t size_ = 0;
+
+    void release() {
+        if (data_) {
+            munmap(data_, size_ * sizeof(T));
+            data_ = nullptr;
+            size_ = 0;
+        }
+    }
+};
+
+/**
+ * MappedFile - Whole file mapped read-only
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { release(); }
+
+    MappedFile(MappedFile&& other) noexcept : data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            release();
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file does not exist; throws on any other failure
+    bool open(const std::string& filename) {
+        release();
+        int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT) {
+                return false;
+            }
+            throw std::runtime_error("Failed to open file: " + filename);
+        }
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            close(fd);
+            throw std::runtime_error("Failed to stat file: " + filename);
+        }
+        size_t bytes = static_cast<size_t>(info.st_size);
+        if (bytes > 0) {
+            void* memory = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (memory == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Failed to map file: " + filename);
+            }
+            data_ = static_cast<const char*>(memory);
+            size_ = bytes;
+        }
+        close(fd);
+        return true;
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+
+    void release() {
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+            data_ = nullptr;
+            size_ = 0;
+        }
+    }
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "bvh.h"
+#include "vector3.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Transform - Affine transform as a row-major 3x4 matrix
+ */
+struct Transform {
+    double m[3][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+
+    static Transform translate(const Vector3& offset);
+    static Transform scale(const Vector3& factors);
+    static Transform rotate(int axis, double degrees);  // axis: 0 = x, 1 = y, 2 = z
+
+    // this * other: apply other first
+    Transform operator*(const Transform& other) const;
+    Transform inverse() const;  // Throws if singular
+
+    Vector3 apply_point(const Vector3& p) const;
+    Vector3 apply_vector(const Vector3& v) const;
+};
+
+/**
+ * TriangleMesh - Indexed triangles with their own BVH
+ *
+ * Positions are packed floats (12 bytes per vertex) and triangles are three
+ * 32-bit vertex indices, stored in BVH leaf order so every leaf is a
+ * contiguous run of triangles. A mesh is immutable once built and shared by
+ * every instance that places it in a scene.
+ */
+class TriangleMesh {
+public:
+    // Builds the BVH; indices holds three vertex indices per triangle
+    TriangleMesh(std::vector<float> positions, std::vector<uint32_t> indices);
+
+    // Load a Wavefront OBJ: "v" and "f" records (polygons are fan
+    // triangulated, texture/normal references ignored); parsed on num_threads
+    static std::shared_ptr<TriangleMesh> load_obj(const std::string& filename, int num_threads);
+
+    // Nearest triangle hit with t in (t_min, t_max), Möller-Trumbore in
+    // single precision. The direction need not be unit length; t is in units
+    // of it. Shrinks t_max and sets triangle on a hit.
+    bool intersect(const float origin[3], const float direction[3], float t_min, float& t_max,
+                   uint32_t& triangle) const;
+
+    // Whether any triangle is hit with t in (t_min, t_max)
+    bool occluded(const float origin[3], const float direction[3], float t_min, float t_max) const;
+
+    // Unnormalized geometric normal (counter-clockwise winding)
+    Vector3 normal(uint32_t triangle) const;
+
+    // Packed positions and triangle indices, the latter in BVH leaf order
+    const std::vector<float>& positions() const { return positions_; }
+    const std::vector<uint32_t>& indices() const { return indices_; }
+
+    const AABB& bounds() const { return bounds_; }
+    size_t vertex_count() const { return positions_.size() / 3; }
+    size_t triangle_count() const { return indices_.size() / 3; }
+    size_t memory_bytes() const;
+
+private:
+    std::vector<float> positions_;
+    std::vector<uint32_t> indices_;
+    BVH bvh_;
+    AABB bounds_;
+
+    // Hit distance for one triangle, or a negative value for a miss
+    float intersect_triangle(uint32_t triangle, const float origin[3], const float direction[3],
+                             float t_min, float t_max) const;
+};
+
+/**
+ * MeshInstance - One placement of a shared mesh: 56 bytes
+ *
+ * Only the world-to-object transform is stored; rays are moved into object
+ * space for intersection and normals go back through its transpose.
+ */
+struct MeshInstance {
+    float world_to_object[3][4];
+    uint32_t mesh;
+    uint32_t material;
+
+    MeshInstance(uint32_t mesh, uint32_t material, const Transform& object_to_world);
+
+    Transform object_to_world() const;
+};
+static_assert(sizeof(MeshInstance) == 56, "MeshInstance should stay compact");
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "vector3.h"
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * PixelEstimate - Running mean and variance of one pixel's samples
+ *
+ * Color is accumulated as a plain float sum; the convergence test runs
+ * Welford's algorithm on the sample luminance. Plain data so whole buffers
+ * can be checkpointed with a single write.
+ */
+struct PixelEstimate {
+    float sum[3] = {0.0f, 0.0f, 0.0f};
+    float mean = 0.0f;  // Of luminance
+    float m2 = 0.0f;    // Sum of squared deviations from the mean
+    uint32_t samples = 0;
+    uint32_t converged = 0;
+
+    void add(const Vector3& color) {
+        sum[0] += static_cast<float>(color.x);
+        sum[1] += static_cast<float>(color.y);
+        sum[2] += static_cast<float>(color.z);
+        float luminance = static_cast<float>(0.2126 * color.x + 0.7152 * color.y + 0.0722 * color.z);
+        ++samples;
+        float delta = luminance - mean;
+        mean += delta / samples;
+        m2 += delta * (luminance - mean);
+    }
+
+    Vector3 value() const {
+        if (samples == 0) return Vector3(0, 0, 0);
+        return Vector3(sum[0], sum[1], sum[2]) / samples;
+    }
+
+    // Half width of the 95% confidence interval of the mean luminance
+    double confidence_half_width() const {
+        if (samples < 2) return INFINITY;
+        double variance = static_cast<double>(m2) / (samples - 1);
+        return 1.96 * std::sqrt(variance / samples);
+    }
+};
+static_assert(std::is_trivially_copyable<PixelEstimate>::value, "PixelEstimate is written raw");
+static_assert(sizeof(PixelEstimate) == 28, "PixelEstimate layout is part of the checkpoint format");
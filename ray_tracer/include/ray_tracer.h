@@ -1,70 +1,324 @@
 #pragma once
 
+#include "denoiser.h"
+#include "image_encoder.h"
+#include "light_tree.h"
+#include "mapped_buffer.h"
+#include "pixel_estimate.h"
+#include "sampler.h"
+#include "texture.h"
+#include "tile_scheduler.h"
 #include "vector3.h"
+#include <atomic>
+#include <future>
 #include <memory>
+#include <string>
+#include <vector>
 
+class Animation;
 class Scene;
-class PPMWriter;
+struct Material;
+class SceneAccelerator;
+struct RayStream;
+
+/**
+ * RenderStats - Ray counts and timing of the last render
+ */
+struct RenderStats {
+    uint64_t primary_rays = 0;    // Camera rays
+    uint64_t secondary_rays = 0;  // Reflection rays
+    uint64_t shadow_rays = 0;
+    double render_seconds = 0.0;  // Tracing only: no BVH build or image write
+};
 
 /**
  * RayTracer - Main ray tracing engine with:
- * - Ray-sphere intersection
+ * - Ray-sphere intersection accelerated by a SAH BVH
  * - Reflection and refraction
  * - Soft shadows with area lights
- * - Multi-threaded rendering
+ * - Multi-threaded tile rendering
  */
 class RayTracer {
 public:
     RayTracer(int width = 800, int height = 600, int samples_per_pixel = 10);
+    ~RayTracer();
 
-    // Render the scene and save to file
+    // Render the scene and save to file (.ppm, .png or .pfm)
     void render_scene(const Scene& scene, const std::string& output_file);
 
+    // Render every frame of animation, posing scene for each, into files
+    // named by frame_filename(output_pattern, frame); heatmaps are numbered
+    // the same way. Render threads start once, the BVH is refit rather than
+    // rebuilt while refits keep it tight, and each frame is encoded and
+    // written while the next one renders. Cannot stream or checkpoint.
+    void render_sequence(Scene& scene, const Animation& animation,
+                         const std::string& output_pattern);
+
+    // Render only the pixels of region (image coordinates) and store their
+    // averaged colors in rgb, three floats per pixel row by row. Each pixel
+    // comes out exactly as in a full render_scene with the same settings, so
+    // one image can be split across processes. The BVH is built by the first
+    // call and kept for later regions of the same scene (set_accelerator
+    // replaces it); no files are written and no time budget applies.
+    void render_region(const Scene& scene, const Tile& region, std::vector<float>& rgb);
+
     // Get dimensions
     int get_width() const { return width_; }
     int get_height() const { return height_; }
     int get_samples_per_pixel() const { return samples_per_pixel_; }
 
+    // Counts and timing of the most recent render_scene
+    const RenderStats& last_render_stats() const { return stats_; }
+
     // Set number of threads for parallel rendering
     void set_num_threads(int num_threads) { num_threads_ = num_threads; }
 
     // Set max reflection depth
     void set_max_depth(int depth) { max_depth_ = depth; }
 
+    // Sample generator for pixel jitter and light sampling, and its seed;
+    // a render is reproducible from both regardless of threads and tiles
+    void set_sampler(SamplerType type) { sampler_type_ = type; }
+    void set_seed(uint64_t seed) { seed_ = seed; }
+
+    // Use an accelerator built ahead of time (e.g. from a SceneCache) for the
+    // next render instead of building one; it must be for that render's scene
+    void set_accelerator(std::unique_ptr<SceneAccelerator> accelerator);
+
+    // Adaptive sampling: a pixel stops once the 95% confidence interval of its
+    // luminance is within noise_threshold of its mean (0 disables). Every
+    // pixel gets at least min_samples and at most samples_per_pixel.
+    void set_adaptive_sampling(double noise_threshold, int min_samples = 4) {
+        noise_threshold_ = noise_threshold;
+        min_samples_ = min_samples;
+    }
+
+    // Stop refining unconverged pixels after this many seconds (0 = no limit)
+    void set_time_budget(double seconds) { time_budget_seconds_ = seconds; }
+
+    // Also write a map of samples taken per pixel (empty = don't)
+    void set_heatmap_file(const std::string& filename) { heatmap_file_ = filename; }
+
+    // Also write a map of the time spent on each pixel (empty = don't).
+    // Needs a build with RAY_TRACER_INSTRUMENTATION, which also prints a
+    // per-thread table of rays, BVH steps and tile times after each render
+    void set_cost_heatmap_file(const std::string& filename) { cost_heatmap_file_ = filename; }
+
+    // Also write first-hit albedo, normal and depth and per-pixel variance as
+    // <prefix>_albedo.pfm and so on (empty = don't)
+    void set_feature_prefix(const std::string& prefix) { feature_prefix_ = prefix; }
+
+    // Filter the finished image with the feature-guided à-trous denoiser
+    // before writing it; the samples themselves are left as they are
+    void set_denoise(bool denoise, const DenoiseOptions& options = DenoiseOptions()) {
+        denoise_ = denoise;
+        denoise_options_ = options;
+    }
+
+    // Progressive rendering: each pass adds pass_samples to every unfinished
+    // pixel, and the output image is rewritten as a preview at most every
+    // preview_interval seconds (0 = only at the end)
+    void set_progressive(int pass_samples, double preview_interval = 10.0) {
+        pass_samples_ = pass_samples;
+        preview_interval_seconds_ = preview_interval;
+    }
+
+    // Save the accumulated samples to filename every interval seconds and
+    // whenever rendering stops; with resume, continue from it if it exists
+    void set_checkpoint(const std::string& filename, double interval = 60.0, bool resume = false) {
+        checkpoint_file_ = filename;
+        checkpoint_interval_seconds_ = interval;
+        resume_ = resume;
+    }
+
+    // Streaming: render one row of tiles at a time and append it to the
+    // output file as soon as it is done, so memory stays proportional to
+    // tile_size * width instead of the image size (no checkpoints or previews)
+    void set_streaming(bool streaming) { streaming_ = streaming; }
+
+    // Keep the per-pixel sample buffer in an mmap'd scratch file instead of
+    // anonymous memory, letting the kernel page it out (empty = don't). The
+    // file must not exist yet; it is unlinked as soon as it is mapped.
+    void set_scratch_file(const std::string& filename) { scratch_file_ = filename; }
+
+    // Finish the tiles in flight, then checkpoint and write the image.
+    // Only stores an atomic flag, so it is safe to call from a signal handler.
+    void request_stop() { stop_requested_.store(true, std::memory_order_relaxed); }
+
+    // Soft shadows: shadow rays per light always traced, and the most traced
+    // when those disagree (the point lies in a penumbra)
+    void set_shadow_samples(int probe_samples, int max_samples) {
+        shadow_probe_samples_ = probe_samples;
+        shadow_max_samples_ = max_samples;
+    }
+
+    // Many lights: shade each point by light_samples lights picked through a
+    // LightTree by their likely contribution, each weighted by
+    // 1 / (pdf * light_samples), so the cost per hit no longer grows with the
+    // light count. 0, or at least as many as the scene has, shades by every light.
+    void set_light_samples(int light_samples) { light_samples_ = light_samples; }
+
+    // Wavefront mode: trace each tile's camera rays as one stream, stage by
+    // stage over structure-of-arrays queues, instead of recursing ray by ray
+    // (see RayStream). Samples are the same, so images match to rounding.
+    void set_wavefront(bool wavefront) { wavefront_ = wavefront; }
+
+    // Tile scheduling: tile edge in pixels, order tiles are handed out in,
+    // and whether render threads are pinned to CPUs
+    void set_tile_size(int tile_size) { tile_options_.tile_size = tile_size; }
+    void set_tile_order(TileOrder order) { tile_options_.order = order; }
+    void set_pin_threads(bool pin) { tile_options_.pin_threads = pin; }
+
+    // Called periodically from the thread running render_scene
+    void set_progress_callback(TileScheduler::ProgressCallback callback) {
+        tile_options_.progress = std::move(callback);
+    }
+
 private:
     int width_;
     int height_;
     int samples_per_pixel_;
     int max_depth_ = 3;
     int num_threads_ = 4;
+    int shadow_probe_samples_ = 4;
+    SamplerType sampler_type_ = SamplerType::SOBOL;
+    uint64_t seed_ = 0;
+    double noise_threshold_ = 0.0;
+    int min_samples_ = 4;
+    double time_budget_seconds_ = 0.0;
+    std::string heatmap_file_;
+    std::string cost_heatmap_file_;
+    std::string feature_prefix_;
+    bool denoise_ = false;
+    DenoiseOptions denoise_options_;
+    bool wavefront_ = false;
+    int pass_samples_ = 0;  // 0 = not progressive
+    double preview_interval_seconds_ = 0.0;
+    std::string checkpoint_file_;
+    double checkpoint_interval_seconds_ = 0.0;
+    bool resume_ = false;
+    bool streaming_ = false;
+    std::string scratch_file_;
+    std::atomic<bool> stop_requested_{false};
+    int shadow_max_samples_ = 16;
+    int light_samples_ = 0;
+    TileScheduler::Options tile_options_;
+    std::unique_ptr<SceneAccelerator> accelerator_;  // Rebuilt by each render_scene
+    std::unique_ptr<SceneAccelerator> prebuilt_accelerator_;
+    RenderStats stats_;
+    std::unique_ptr<WorkerPool> pool_;  // Render threads, kept from one render to the next
+    std::future<MappedBuffer<PixelEstimate>> pending_output_;  // Frame still being written
+    MappedBuffer<PixelEstimate> spare_pixels_;  // Samples of a written frame, for reuse
+
+    struct FrameOutputs {
+        std::string image;
+        std::string heatmap;       // Empty = none
+        std::string cost_heatmap;  // Empty = none
+        std::string features;      // Prefix of the feature buffers, empty = none
+        std::vector<float>* region_rgb = nullptr;  // Set to render just region into it instead
+        Tile region = {0, 0, 0, 0, 0};
+    };
 
     struct HitInfo {
         bool hit;
         double t;
         Vector3 point;
         Vector3 normal;
-        const class Sphere* sphere;
+        uint32_t material;  // Index into the scene's material table
+        double footprint = 0.0;  // Width of the pixel's ray cone at the hit, for mip levels
+        double radius = 0.0;     // Of the sphere hit, 0 for triangles
+    };
+
+    // Camera ray of one pixel sample, traced before shading so a tile's
+    // samples can be shaded grouped by material
+    struct PrimarySample {
+        size_t pixel;
+        uint32_t x, y, index;  // Image position and sample number, to resume the sampler
+        Vector3 direction;
+        HitInfo hit;
     };
 
-    // Ray casting with advanced lighting
+    // Shading is specialized at compile time per texture pattern and on
+    // whether the material reflects; render_scene picks one per material
+    using ShadeKernel = Vector3 (RayTracer::*)(const HitInfo& hit, const Vector3& view_dir,
+                                               const Scene& scene, int depth);
+    struct MaterialShading {
+        ShadeKernel kernel;
+        uint32_t kind;  // Which kernel, for grouping hits
+        Vector3 tint;   // Constant texture color of solid materials
+    };
+    std::vector<MaterialShading> material_shading_;  // Indexed like the scene's materials
+
+    // Angle between neighbouring camera rays: ray cones, which pick texture
+    // mip levels, widen by this much per unit of distance travelled
+    double pixel_spread_ = 0.0;
+
+    // Built per frame when lights are sampled (light_picks_ > 0), as lights move
+    LightTree light_tree_;
+    uint32_t light_picks_ = 0;
+
+    // Ray casting with advanced lighting; cone_width is the width of the
+    // pixel's ray cone at origin
     Vector3 cast_ray(const Vector3& origin, const Vector3& direction, 
-                     const Scene& scene, int depth = 0);
+                     const Scene& scene, int depth = 0, double cone_width = 0.0);
 
-    // Check ray-sphere intersection
+    // Nearest sphere or triangle hit in accelerator_
     HitInfo check_intersection(const Vector3& origin, const Vector3& direction,
-                               const Scene& scene);
+                               double cone_width = 0.0);
+
+    // Choose the shading kernel of every material in scene
+    void prepare_shading(const Scene& scene);
+
+    // Render one image with accelerator_. Pipelined frames hand encoding and
+    // writing to a background task and return as soon as tracing is done.
+    void render_frame(const Scene& scene, const FrameOutputs& outputs, bool pipelined);
+
+    // Wait for the frame being written, rethrowing its errors, and keep its buffer
+    void finish_output();
+
+    template <Texture::Type Pattern, bool Reflective>
+    Vector3 shade(const HitInfo& hit, const Vector3& view_dir, const Scene& scene, int depth);
+
+    // Color shade() multiplies the lighting by: the tint or texture at the hit
+    Vector3 surface_albedo(const HitInfo& hit, const Scene& scene) const;
+
+    // Light pick through light_tree_ for shading hit with material, u in [0, 1)
+    LightTree::Pick pick_light(const HitInfo& hit, const Material& material, double u) const;
+
+    // Image texture filtered over the hit's footprint
+    Vector3 image_color(const Texture& texture, const HitInfo& hit) const;
+
+    // Trace every path queued in stream to completion (wavefront.cpp)
+    void trace_wavefront(RayStream& stream, const Scene& scene, Sampler& sampler);
 
     // Calculate lighting with soft shadows
-    Vector3 calculate_lighting(const HitInfo& hit, const Vector3& view_dir,
-                               const Scene& scene, int depth);
+    Vector3 calculate_lighting(const HitInfo& hit, const Vector3& view_dir, const Scene& scene);
 
     // Calculate reflection
     Vector3 calculate_reflection(const HitInfo& hit, const Vector3& view_dir,
                                  const Scene& scene, int depth);
 
-    // Generate random point on sphere (for soft shadows)
-    Vector3 random_on_sphere(double radius) const;
+    // Rows of averaged samples for the image encoder; estimates starts at
+    // image row first_row
+    ImageEncoder::RowSource estimate_rows(const PixelEstimate* estimates, int first_row) const;
+
+    // Rows of an image already resolved to RGB floats
+    ImageEncoder::RowSource color_rows(const float* rgb) const;
+
+    // Rows of the samples-per-pixel heatmap, laid out like estimate_rows
+    ImageEncoder::RowSource heatmap_rows(const PixelEstimate* estimates, int first_row,
+                                         int max_samples) const;
+
+    // Average the accumulated samples into an image file
+    void write_image(const PixelEstimate* estimates, const std::string& filename) const;
+
+    // Write samples taken per pixel as a false-color image
+    void write_sample_heatmap(const PixelEstimate* estimates, int max_samples,
+                              const std::string& filename) const;
+
+    // Write per-pixel cost as a false-color image scaled to its 99th percentile
+    void write_cost_heatmap(const std::vector<uint64_t>& cost, const std::string& filename) const;
 
-    // Random number generator [0, 1)
-    double random_float() const;
+    // Map a 2D sample to a point on a sphere (for soft shadows)
+    Vector3 random_on_sphere(double radius, const Sample2D& sample) const;
 };
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+enum class SamplerType {
+    RANDOM,     // PCG stream seeded from (pixel, sample, dimension)
+    SOBOL,      // Owen-scrambled Sobol points, scrambled independently per pixel
+    BLUE_NOISE  // Sobol points shared by all pixels, shifted per pixel by a blue-noise mask
+};
+
+SamplerType parse_sampler_type(const std::string& name);
+const char* sampler_type_name(SamplerType type);
+
+struct Sample2D {
+    double u, v;  // Both in [0, 1)
+};
+
+/**
+ * Sampler - Deterministic sample points for one pixel sample at a time
+ *
+ * A point is a pure function of (seed, pixel, sample index, dimension), so
+ * a render does not depend on how pixels are split among threads or tiles.
+ * Each use of randomness along a path claims the next 2D dimension in a
+ * fixed order: pixel jitter first, then one per light and bounce. An inner
+ * loop that draws several points per sample (e.g. shadow rays) claims one
+ * dimension and indexes it with loop_point(), so its points and those of
+ * neighbouring samples are stratified together.
+ */
+class Sampler {
+public:
+    virtual ~Sampler() = default;
+
+    // Begin sample `index` of pixel (x, y); dimensions restart at first_dimension
+    void start_sample(uint32_t x, uint32_t y, uint32_t index, uint32_t first_dimension = 0) {
+        x_ = x;
+        y_ = y;
+        index_ = index;
+        dimension_ = first_dimension;
+    }
+
+    // Point in the next dimension
+    Sample2D next_2d() { return sample_2d(dimension_++, index_); }
+
+    // Claim a dimension for an inner loop drawing up to count points per sample
+    uint32_t next_dimension() { return dimension_++; }
+
+    // Point j of such a loop
+    Sample2D loop_point(uint32_t dimension, uint32_t j, uint32_t count) const {
+        return sample_2d(dimension, static_cast<uint64_t>(index_) * count + j);
+    }
+
+protected:
+    explicit Sampler(uint64_t seed) : seed_(seed) {}
+
+    virtual Sample2D sample_2d(uint32_t dimension, uint64_t index) const = 0;
+
+    uint64_t seed_;
+    uint32_t x_ = 0;
+    uint32_t y_ = 0;
+    uint32_t index_ = 0;
+    uint32_t dimension_ = 0;
+};
+
+// Sampler of the given type; cheap to create, one per thread
+std::unique_ptr<Sampler> make_sampler(SamplerType type, uint64_t seed);
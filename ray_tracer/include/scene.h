@@ -1,36 +1,46 @@
 #pragma once
 
+#include "mesh.h"
 #include "vector3.h"
 #include "texture.h"
-#include <vector>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 /**
  * Material - Surface properties for objects
+ *
+ * Textures live in the scene's texture table and are referenced by index.
+ * An untextured material is tinted by its own color, as if it carried a
+ * solid texture of that color.
  */
 struct Material {
+    static constexpr uint32_t no_texture = UINT32_MAX;
+
     Vector3 color;
     double ambient = 0.1;
     double diffuse = 0.7;
     double specular = 0.2;
     double shininess = 32.0;
     double reflection = 0.0;  // 0.0 = no reflection, 1.0 = perfect mirror
-    std::shared_ptr<Texture> texture;
+    uint32_t texture = no_texture;
 
     Material(const Vector3& col = Vector3(1, 1, 1), double refl = 0.0)
-        : color(col), reflection(refl),
-          texture(std::make_shared<Texture>(Texture::Type::SOLID, col)) {}
+        : color(col), reflection(refl) {}
+
+    bool operator==(const Material& other) const;
 };
 
 /**
- * Sphere - A sphere object with material properties
+ * Sphere - A sphere referring to a material in the scene's material table
  */
 struct Sphere {
     Vector3 center;
     double radius;
-    Material material;
+    uint32_t material;
 
-    Sphere(const Vector3& center, double radius, const Material& material)
+    Sphere(const Vector3& center, double radius, uint32_t material)
         : center(center), radius(radius), material(material) {}
 };
 
@@ -46,6 +56,26 @@ struct Light {
         : position(pos), intensity(intensity), radius(radius) {}
 };
 
+/**
+ * Camera - Pinhole camera looking from position towards look_at
+ */
+struct Camera {
+    Vector3 position = Vector3(0, 1, 2);
+    Vector3 look_at = Vector3(0, 1, 1);
+    Vector3 up = Vector3(0, 1, 0);
+    double fov = 60.0;  // Vertical field of view in degrees
+};
+
+/**
+ * RenderSettings - Defaults a scene file may suggest for rendering it
+ */
+struct RenderSettings {
+    int width = 800;
+    int height = 600;
+    int samples_per_pixel = 10;
+    int max_depth = 3;
+};
+
 /**
  * Scene - Collection of objects and lights to render
  */
@@ -53,23 +83,72 @@ class Scene {
 public:
     Scene();
 
-    // Add sphere to scene
+    // Add sphere to scene; its material must already be in the table
     void add_sphere(const Sphere& sphere);
 
     // Add light to scene
     void add_light(const Light& light);
 
+    // Move the sphere or light added index-th (from 0), e.g. between
+    // animation frames; accelerators over the scene must then be refit
+    void move_sphere(size_t index, const Vector3& center);
+    void move_light(size_t index, const Vector3& position);
+
+    // Preallocate for count spheres in total
+    void reserve_spheres(size_t count) { spheres_.reserve(count); }
+
+    // Intern a texture or material: equal ones share one table entry, whose
+    // index is returned
+    uint32_t add_texture(const Texture& texture);
+    uint32_t add_material(const Material& material);
+
+    // Add a mesh that instances can place; returns its index
+    uint32_t add_mesh(std::shared_ptr<const TriangleMesh> mesh);
+
+    // Place mesh (an add_mesh index) with a material (an add_material index)
+    void add_instance(uint32_t mesh, uint32_t material, const Transform& object_to_world);
+
+    // Add an instance exactly as another scene stores it
+    void add_instance(const MeshInstance& instance);
+
     // Get spheres
     const std::vector<Sphere>& get_spheres() const { return spheres_; }
 
     // Get lights
     const std::vector<Light>& get_lights() const { return lights_; }
 
+    const std::vector<Texture>& get_textures() const { return textures_; }
+    const std::vector<Material>& get_materials() const { return materials_; }
+    const std::vector<std::shared_ptr<const TriangleMesh>>& get_meshes() const { return meshes_; }
+    const std::vector<MeshInstance>& get_instances() const { return instances_; }
+
     // Get background color
     Vector3 get_background_color() const { return background_color_; }
+    void set_background_color(const Vector3& color) { background_color_ = color; }
+
+    const Camera& get_camera() const { return camera_; }
+    void set_camera(const Camera& camera) { camera_ = camera; }
+
+    const RenderSettings& get_render_settings() const { return render_settings_; }
+    void set_render_settings(const RenderSettings& settings) { render_settings_ = settings; }
 
 private:
+    struct TextureHash {
+        size_t operator()(const Texture& texture) const;
+    };
+    struct MaterialHash {
+        size_t operator()(const Material& material) const;
+    };
+
     std::vector<Sphere> spheres_;
     std::vector<Light> lights_;
+    std::vector<Texture> textures_;
+    std::vector<Material> materials_;
+    std::unordered_map<Texture, uint32_t, TextureHash> texture_index_;
+    std::unordered_map<Material, uint32_t, MaterialHash> material_index_;
+    std::vector<std::shared_ptr<const TriangleMesh>> meshes_;
+    std::vector<MeshInstance> instances_;
     Vector3 background_color_;
+    Camera camera_;
+    RenderSettings render_settings_;
 };
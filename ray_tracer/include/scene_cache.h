@@ -0,0 +1,59 @@
+#pragma once
+
+#include "accelerator.h"
+#include "mapped_buffer.h"
+#include <memory>
+#include <string>
+
+class Scene;
+
+/**
+ * SceneCache - Parsed scene and its BVH in one versioned binary file
+ *
+ * The file is mapped read-only and its BVH nodes, primitive indices and
+ * leaf-ordered sphere arrays are handed to SceneAccelerator where they lie,
+ * so opening a cached scene costs a validation pass plus rebuilding the
+ * sphere and material tables, instead of parsing text and building a BVH.
+ * A cache records the size and modification time of the scene file it was
+ * made from and is ignored once that file changes.
+ */
+class SceneCache : public std::enable_shared_from_this<SceneCache> {
+public:
+    // Map filename; nullptr if it is missing, was written by another version
+    // or precision, is damaged, or does not match source_file (empty = any)
+    static std::shared_ptr<const SceneCache> open(const std::string& filename,
+                                                  const std::string& source_file = "");
+
+    // Save scene and the accelerator built for it, atomically (temporary
+    // file + rename)
+    static void write(const std::string& filename, const std::string& source_file,
+                      const Scene& scene, const SceneAccelerator& accelerator);
+
+    // Fill an empty scene with the cached spheres, materials, lights, camera
+    // and render settings
+    void load_scene(Scene& scene) const;
+
+    // Accelerator over the mapped BVH for a scene filled by load_scene; the
+    // mapping stays alive as long as the accelerator does
+    std::unique_ptr<SceneAccelerator> make_accelerator(
+        const Scene& scene, SimdLevel simd_level = detect_simd_level()) const;
+
+    size_t sphere_count() const;
+
+private:
+    struct Header;
+
+    MappedFile file_;
+    const Header* header_ = nullptr;
+    int bvh_depth_ = 0;  // Measured by validate()
+
+    SceneCache() = default;
+
+    template <typename T>
+    const T* section(uint64_t offset) const {
+        return reinterpret_cast<const T*>(file_.data() + offset);
+    }
+
+    // Check every index and offset, and measure the BVH's depth
+    bool validate();
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+class Animation;
+class Scene;
+
+/**
+ * Scene files - Line-based text description of a scene
+ *
+ * One statement per line, '#' starts a comment. Vectors are three numbers.
+ * Names must be defined before they are used.
+ *
+ *   render <width> <height> <samples> [max_depth]
+ *   camera <position> <look_at> <fov> [up <vector>]
+ *   background <color>
+ *   texture <name> solid <color>
+ *   texture <name> checkerboard|gradient <color> <color>
+ *   texture <name> image <file>     (.ppm, .png or .rtx, path relative to the scene file)
+ *   material <name> <color> [reflection|ambient|diffuse|specular|shininess <value>]
+ *                           [texture <name>]
+ *   sphere <center> <radius> <material>
+ *   light <position> <intensity> [radius]
+ *   mesh <name> <file.obj>          (path relative to the scene file)
+ *   instance <mesh> <material> [translate <vector>] [rotate x|y|z <degrees>]
+ *                              [scale <factor> | scale <vector>]
+ *   frames <count>
+ *   key <frame> sphere <index> <center>
+ *   key <frame> light <index> <position>
+ *   key <frame> camera <position> <look_at>
+ *   key <frame> orbit <degrees>
+ *
+ * Image textures wrap around spheres by latitude and longitude; a PPM or
+ * PNG is converted to <file>.rtx next to it, once per version of the image.
+ *
+ * Instance operations apply in the order written, so "scale 2 translate 0 1 0"
+ * scales first and then moves.
+ *
+ * Keys animate the sphere or light defined index-th (from 0) and must come
+ * after it; frames sets the sequence length, which otherwise ends at the
+ * last key. An orbit turns the camera about its target around its up vector.
+ */
+
+// Parse filename into scene (which should be empty) and its keyframes into
+// animation, if given; throws with the file name and line number on any error
+void load_scene_file(const std::string& filename, Scene& scene, Animation* animation = nullptr);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * SphereView - Raw pointers into SphereArrays handed to the kernels
+ *
+ * The instruction-set specific units see only plain pointers so they never
+ * instantiate library templates that could be shared with scalar code.
+ */
+template <typename Real>
+struct SphereView {
+    const Real* center_x;
+    const Real* center_y;
+    const Real* center_z;
+    const Real* radius2;
+};
+
+/**
+ * SphereArrays - Structure-of-arrays sphere geometry for SIMD intersection
+ *
+ * Arrays are padded with spheres that can never be hit (negative radius²) so
+ * kernels may always load a full vector past the last real entry.
+ */
+template <typename Real>
+struct SphereArrays {
+    static constexpr size_t padding = 16;  // Widest vector: 16 floats (AVX-512)
+
+    std::vector<Real> center_x;
+    std::vector<Real> center_y;
+    std::vector<Real> center_z;
+    std::vector<Real> radius2;
+
+    void resize(size_t count) {
+        size_t padded = count + padding;
+        center_x.assign(padded, Real(0));
+        center_y.assign(padded, Real(0));
+        center_z.assign(padded, Real(0));
+        radius2.assign(padded, Real(-1));
+        size_ = count;
+    }
+
+    void set(size_t i, double cx, double cy, double cz, double radius) {
+        center_x[i] = static_cast<Real>(cx);
+        center_y[i] = static_cast<Real>(cy);
+        center_z[i] = static_cast<Real>(cz);
+        radius2[i] = static_cast<Real>(radius * radius);
+    }
+
+    size_t size() const { return size_; }
+
+    SphereView<Real> view() const {
+        return {center_x.data(), center_y.data(), center_z.data(), radius2.data()};
+    }
+
+private:
+    size_t size_ = 0;
+};
+
+/**
+ * KernelRay - Ray in kernel precision; dir must be unit length
+ */
+template <typename Real>
+struct KernelRay {
+    Real origin[3];
+    Real dir[3];
+};
+
+enum class SimdLevel { SCALAR, AVX2, AVX512 };
+
+/**
+ * SphereKernels - Ray-vs-sphere-batch kernels for one instruction set
+ */
+template <typename Real>
+struct SphereKernels {
+    SimdLevel level;
+    int lanes;  // Spheres tested per vector instruction
+
+    // Nearest sphere in [first, first + count) whose near root lies in
+    // (t_min, t_max). Shrinks t_max and returns its index, or -1 for a miss.
+    int64_t (*closest)(const SphereView<Real>& spheres, const KernelRay<Real>& ray,
+                       uint32_t first, uint32_t count, Real t_min, Real& t_max);
+
+    // Whether any sphere in [first, first + count) has its near root in (t_min, t_max)
+    bool (*any)(const SphereView<Real>& spheres, const KernelRay<Real>& ray,
+                uint32_t first, uint32_t count, Real t_min, Real t_max);
+};
+
+// Best level both compiled in and supported by the running CPU
+SimdLevel detect_simd_level();
+
+const char* simd_level_name(SimdLevel level);
+
+// Kernels for the requested level, falling back to the next lower available one
+template <typename Real>
+SphereKernels<Real> sphere_kernels(SimdLevel level);
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "sphere_kernels.h"
+
+// Shared body of the vector kernels. Only include this from a translation
+// unit compiled for the target instruction set, with V defined in an
+// anonymous namespace so each instantiation stays local to that unit.
+//
+// Nothing here may call into the standard library: a non-inlined instance
+// compiled with wider instructions could be picked by the linker for scalar
+// code too.
+//
+// V provides: real, reg, mask, lanes, infinity, set1, loadu, add, sub, mul, div, sqrt,
+// min, max, copysign, ge, gt, lt, mask_and, any, lane_mask, select,
+// reduce_min, first_lane_equal.
+
+template <typename V>
+struct SimdRay {
+    typename V::reg ox, oy, oz, dx, dy, dz;
+
+    explicit SimdRay(const KernelRay<typename V::real>& ray)
+        : ox(V::set1(ray.origin[0])), oy(V::set1(ray.origin[1])), oz(V::set1(ray.origin[2])),
+          dx(V::set1(ray.dir[0])), dy(V::set1(ray.dir[1])), dz(V::set1(ray.dir[2])) {}
+};
+
+// Near roots of the spheres starting at index i; valid is set for lanes that
+// hit at all and hold a real sphere
+template <typename V>
+typename V::reg sphere_near_roots(const SphereView<typename V::real>& spheres, const SimdRay<V>& ray,
+                                  uint32_t i, uint32_t remaining, typename V::mask& valid) {
+    using reg = typename V::reg;
+    const reg zero = V::set1(typename V::real(0));
+
+    reg ocx = V::sub(ray.ox, V::loadu(spheres.center_x + i));
+    reg ocy = V::sub(ray.oy, V::loadu(spheres.center_y + i));
+    reg ocz = V::sub(ray.oz, V::loadu(spheres.center_z + i));
+    reg r2 = V::loadu(spheres.radius2 + i);
+
+    // Roots of t² + 2bt + c. The discriminant comes from the distance of
+    // the center to the ray line and the near root from c / q, which stay
+    // accurate in single precision for large spheres and grazing rays.
+    reg b = V::add(V::add(V::mul(ocx, ray.dx), V::mul(ocy, ray.dy)), V::mul(ocz, ray.dz));
+    reg c = V::sub(V::add(V::add(V::mul(ocx, ocx), V::mul(ocy, ocy)), V::mul(ocz, ocz)), r2);
+    reg fx = V::sub(ocx, V::mul(b, ray.dx));
+    reg fy = V::sub(ocy, V::mul(b, ray.dy));
+    reg fz = V::sub(ocz, V::mul(b, ray.dz));
+    reg discriminant = V::sub(r2, V::add(V::add(V::mul(fx, fx), V::mul(fy, fy)), V::mul(fz, fz)));
+
+    reg root = V::sqrt(V::max(discriminant, zero));
+    reg q = V::sub(zero, V::add(b, V::copysign(root, b)));
+
+    valid = V::mask_and(V::ge(discriminant, zero), V::lane_mask(remaining));
+    return V::min(V::div(c, q), q);
+}
+
+template <typename V>
+int64_t closest_sphere_simd(const SphereView<typename V::real>& spheres,
+                            const KernelRay<typename V::real>& kernel_ray, uint32_t first,
+                            uint32_t count, typename V::real t_min, typename V::real& t_max) {
+    using reg = typename V::reg;
+
+    const SimdRay<V> ray(kernel_ray);
+    const reg lower = V::set1(t_min);
+
+    int64_t best = -1;
+    for (uint32_t i = first; i < first + count; i += V::lanes) {
+        typename V::mask valid;
+        reg t = sphere_near_roots<V>(spheres, ray, i, first + count - i, valid);
+        auto hit = V::mask_and(valid, V::mask_and(V::gt(t, lower), V::lt(t, V::set1(t_max))));
+        if (!V::any(hit)) {
+            continue;
+        }
+
+        reg candidates = V::select(hit, t, V::infinity());
+        typename V::real nearest = V::reduce_min(candidates);
+        t_max = nearest;
+        best = static_cast<int64_t>(i) + V::first_lane_equal(candidates, nearest);
+    }
+    return best;
+}
+
+template <typename V>
+bool any_sphere_simd(const SphereView<typename V::real>& spheres,
+                     const KernelRay<typename V::real>& kernel_ray, uint32_t first,
+                     uint32_t count, typename V::real t_min, typename V::real t_max) {
+    const SimdRay<V> ray(kernel_ray);
+    const typename V::reg lower = V::set1(t_min);
+    const typename V::reg upper = V::set1(t_max);
+
+    for (uint32_t i = first; i < first + count; i += V::lanes) {
+        typename V::mask valid;
+        typename V::reg t = sphere_near_roots<V>(spheres, ray, i, first + count - i, valid);
+        if (V::any(V::mask_and(valid, V::mask_and(V::gt(t, lower), V::lt(t, upper))))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Entry points of the instruction-set specific units (see sphere_kernels.cpp)
+void load_avx2_kernels(SphereKernels<float>& kernels);
+void load_avx2_kernels(SphereKernels<double>& kernels);
+void load_avx512_kernels(SphereKernels<float>& kernels);
+void load_avx512_kernels(SphereKernels<double>& kernels);
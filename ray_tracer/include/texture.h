@@ -1,22 +1,67 @@
 #pragma once
 
 #include "vector3.h"
+#include <cmath>
+#include <memory>
+
+class ImageTexture;
 
 /**
- * Texture - Simple procedural texture support
+ * Texture - Procedural textures, or an image looked up by surface coordinates
  */
 class Texture {
 public:
-    enum class Type { SOLID, CHECKERBOARD, GRADIENT };
+    enum class Type { SOLID, CHECKERBOARD, GRADIENT, IMAGE };
 
     Texture(Type type = Type::SOLID, const Vector3& color1 = Vector3(1, 1, 1),
             const Vector3& color2 = Vector3(0, 0, 0))
         : type_(type), color1_(color1), color2_(color2) {}
 
+    // Image texture; textures of the same ImageTexture compare equal
+    explicit Texture(std::shared_ptr<const ImageTexture> image)
+        : type_(Type::IMAGE), color1_(1, 1, 1), color2_(0, 0, 0), image_(std::move(image)) {}
+
+    // Color at surface coordinates (u, v) or point, whichever the type uses;
+    // images are sampled at full resolution
     Vector3 get_color(double u, double v, const Vector3& point) const;
 
+    // Filtered image color at (u, v) for a footprint of du x dv (IMAGE only)
+    Vector3 sample_image(double u, double v, double du, double dv) const;
+
+    // Color for a texture known to be of type T, for callers that have
+    // already dispatched on the type
+    template <Type T>
+    Vector3 evaluate(const Vector3& point) const {
+        static_assert(T != Type::IMAGE, "Images are sampled by surface coordinates");
+        if constexpr (T == Type::CHECKERBOARD) {
+            int scale = 10;
+            int u_check = static_cast<int>(point.x * scale) % 2;
+            int v_check = static_cast<int>(point.z * scale) % 2;
+            return (u_check == v_check) ? color1_ : color2_;
+        } else if constexpr (T == Type::GRADIENT) {
+            // Linear gradient based on y coordinate
+            double t = std::sin(point.y * 3.14159) * 0.5 + 0.5;
+            return color1_ * (1 - t) + color2_ * t;
+        } else {
+            return color1_;
+        }
+    }
+
+    Type type() const { return type_; }
+    const Vector3& color1() const { return color1_; }
+    const Vector3& color2() const { return color2_; }
+    const std::shared_ptr<const ImageTexture>& image() const { return image_; }
+
+    bool operator==(const Texture& other) const {
+        return type_ == other.type_ && image_ == other.image_ && color1_.x == other.color1_.x &&
+               color1_.y == other.color1_.y && color1_.z == other.color1_.z &&
+               color2_.x == other.color2_.x && color2_.y == other.color2_.y &&
+               color2_.z == other.color2_.z;
+    }
+
 private:
     Type type_;
     Vector3 color1_;
     Vector3 color2_;
+    std::shared_ptr<const ImageTexture> image_;  // IMAGE only
 };
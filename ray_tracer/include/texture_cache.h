@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class ImageTexture;
+
+/**
+ * TextureCache - Shared, bounded pool of image texture tiles
+ *
+ * Tiles are read from their textures' tiled files on first use and dropped
+ * least recently used first once the pool exceeds its byte budget, so
+ * scenes may reference far more texture data than fits in memory.
+ *
+ * The pool is split into shards by tile key, each with its own lock, LRU
+ * list and slice of the budget: no lock covers the whole cache, and threads
+ * reading different tiles rarely meet. Files are read outside any lock.
+ * Tiles are handed out as shared pointers, so evicting one only drops the
+ * cache's reference and readers still holding it keep valid texels.
+ */
+class TextureCache {
+public:
+    using Tile = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Stats {
+        uint64_t lookups = 0;    // Not counting those a render thread's memo answered
+        uint64_t misses = 0;     // Lookups that read the tile from disk
+        uint64_t evictions = 0;
+        uint64_t bytes_read = 0;
+        size_t resident_bytes = 0;
+    };
+
+    explicit TextureCache(size_t capacity_bytes = default_capacity);
+
+    // Budget for resident tiles; shrinking it evicts on the shards' next misses
+    void set_capacity(size_t capacity_bytes);
+    size_t capacity() const { return capacity_.load(std::memory_order_relaxed); }
+
+    // Tile number `tile` of texture, loading it if it is not resident.
+    // Thread-safe; throws std::runtime_error if the file cannot be read.
+    Tile get(const ImageTexture& texture, uint32_t tile);
+
+    Stats stats() const;
+
+    static constexpr size_t default_capacity = size_t(256) << 20;
+
+private:
+    static constexpr int shard_count = 64;
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::list<std::pair<uint64_t, Tile>> lru;  // Most recently used first
+        std::unordered_map<uint64_t, std::list<std::pair<uint64_t, Tile>>::iterator> index;
+        size_t bytes = 0;
+        uint64_t lookups = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    std::atomic<size_t> capacity_;
+    std::atomic<uint64_t> bytes_read_{0};
+    Shard shards_[shard_count];
+
+    static size_t shard_of(uint64_t key);
+};
+
+// The cache image textures load through unless given another
+std::shared_ptr<TextureCache> default_texture_cache();
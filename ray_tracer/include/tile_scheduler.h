@@ -0,0 +1,111 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Tile - Rectangle of pixels [x0, x1) x [y0, y1) rendered as one work item
+ */
+struct Tile {
+    int x0, y0, x1, y1;
+    size_t index;  // Position in the scheduling order
+};
+
+enum class TileOrder {
+    MORTON,   // Z-order curve: neighbouring tiles render close together in time
+    SPIRAL,   // Outward from the image center, where the subject usually is
+    SCANLINE
+};
+
+/**
+ * RenderProgress - Snapshot handed to the progress callback
+ */
+struct RenderProgress {
+    size_t tiles_done;
+    size_t tiles_total;
+    double elapsed_seconds;
+    double eta_seconds;  // Extrapolated from the tile completion rate
+};
+
+/**
+ * WorkerPool - Threads that stay alive across TileScheduler runs
+ *
+ * Progressive passes and animation frames each run the scheduler again;
+ * with a pool they wake the same threads instead of starting new ones.
+ */
+class WorkerPool {
+public:
+    using Job = std::function<void(int thread_index)>;
+
+    explicit WorkerPool(int num_threads, bool pin_threads = false);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int size() const { return static_cast<int>(threads_.size()); }
+    bool pinned() const { return pinned_; }
+
+    // Run job once on every thread; returns at once. job must stay valid
+    // until wait() returns, and exceptions must not escape it.
+    void start(const Job& job);
+
+    // Block until every thread has finished the started job
+    void wait();
+
+private:
+    std::vector<std::thread> threads_;
+    bool pinned_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const Job* job_ = nullptr;
+    uint64_t generation_ = 0;  // Bumped by each start()
+    int running_ = 0;
+    bool stopping_ = false;
+
+    void worker_loop(int thread_index);
+};
+
+/**
+ * TileScheduler - Splits an image into tiles and hands them out to threads
+ *
+ * Tiles are ordered once up front and claimed through a single atomic
+ * counter, so a thread that finishes early simply takes the next tile instead
+ * of waiting on a slow band of rows.
+ */
+class TileScheduler {
+public:
+    using ProgressCallback = std::function<void(const RenderProgress&)>;
+    using TileFn = std::function<void(const Tile& tile, int thread_index)>;
+
+    struct Options {
+        int tile_size = 16;
+        TileOrder order = TileOrder::MORTON;
+        int num_threads = 1;
+        bool pin_threads = false;          // Bind worker i to CPU i (Linux only)
+        WorkerPool* pool = nullptr;        // Run on these threads instead of new ones
+        double progress_interval = 0.5;    // Seconds between progress callbacks
+        ProgressCallback progress;         // Called on the thread that calls run()
+    };
+
+    TileScheduler(int width, int height, const Options& options);
+
+    // Render every tile, blocking until all are done. Exceptions thrown by
+    // render_tile stop the remaining work and are rethrown here.
+    void run(const TileFn& render_tile);
+
+    const std::vector<Tile>& tiles() const { return tiles_; }
+
+private:
+    Options options_;
+    std::vector<Tile> tiles_;
+};
+
+TileOrder parse_tile_order(const std::string& name);
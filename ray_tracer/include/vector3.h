@@ -2,6 +2,7 @@
 
 #include <cmath>
 #include <iostream>
+#include <string>
 
 /**
  * Vector3 - 3D vector for graphics operations
@@ -14,25 +15,47 @@ public:
     Vector3() : x(0), y(0), z(0) {}
     Vector3(double x, double y, double z) : x(x), y(y), z(z) {}
 
-    // Operators
-    Vector3 operator+(const Vector3& other) const;
-    Vector3 operator-(const Vector3& other) const;
-    Vector3 operator*(double scalar) const;
-    Vector3 operator*(const Vector3& other) const;  // Component-wise multiplication
-    Vector3 operator/(double scalar) const;
+    // Operators (inline: these sit in every inner loop of the renderer)
+    Vector3 operator+(const Vector3& other) const {
+        return Vector3(x + other.x, y + other.y, z + other.z);
+    }
+    Vector3 operator-(const Vector3& other) const {
+        return Vector3(x - other.x, y - other.y, z - other.z);
+    }
+    Vector3 operator*(double scalar) const {
+        return Vector3(x * scalar, y * scalar, z * scalar);
+    }
+    Vector3 operator*(const Vector3& other) const {  // Component-wise multiplication
+        return Vector3(x * other.x, y * other.y, z * other.z);
+    }
+    Vector3 operator/(double scalar) const {
+        return Vector3(x / scalar, y / scalar, z / scalar);
+    }
 
     // Dot product
-    double dot(const Vector3& other) const;
+    double dot(const Vector3& other) const {
+        return x * other.x + y * other.y + z * other.z;
+    }
 
     // Cross product
-    Vector3 cross(const Vector3& other) const;
+    Vector3 cross(const Vector3& other) const {
+        return Vector3(
+            y * other.z - z * other.y,
+            z * other.x - x * other.z,
+            x * other.y - y * other.x
+        );
+    }
 
     // Length
-    double length() const;
-    double length_squared() const;
+    double length() const { return std::sqrt(length_squared()); }
+    double length_squared() const { return x * x + y * y + z * z; }
 
     // Normalize
-    Vector3 normalize() const;
+    Vector3 normalize() const {
+        double len = length();
+        if (len == 0) return Vector3(0, 0, 0);
+        return *this / len;
+    }
 
     // String representation
     std::string to_string() const;
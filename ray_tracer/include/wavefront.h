@@ -0,0 +1,136 @@
+#pragma once
+
+#include "vector3.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Vector3Array - Vectors stored one component per array
+ */
+struct Vector3Array {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> z;
+
+    size_t size() const { return x.size(); }
+    void clear() {
+        x.clear();
+        y.clear();
+        z.clear();
+    }
+    void resize(size_t count) {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+    }
+    void push_back(const Vector3& v) {
+        x.push_back(v.x);
+        y.push_back(v.y);
+        z.push_back(v.z);
+    }
+    Vector3 get(size_t i) const { return Vector3(x[i], y[i], z[i]); }
+    void set(size_t i, const Vector3& v) {
+        x[i] = v.x;
+        y[i] = v.y;
+        z[i] = v.z;
+    }
+};
+
+// Camera rays per stream: enough for long, coherent stage loops, few enough
+// that the queues of every bounce stay in L2
+constexpr size_t wavefront_stream_paths = 1024;
+
+/**
+ * RayStream - Queues of the wavefront renderer, structure-of-arrays
+ *
+ * Each camera ray starts a path. Instead of recursing, a path carries a
+ * throughput weight: the product of tints and reflectivities along it, by
+ * which everything it reaches later is scaled into the path's radiance.
+ * Rays of all paths move through the stages together, one bounce at a time:
+ * intersect the stream, shade the hits grouped by material, trace shadow
+ * rays light by light, then queue the reflection rays for the next bounce.
+ *
+ * Kept per render thread and reused, so queues only grow.
+ */
+struct RayStream {
+    // Paths, indexed as add_camera_ray returned
+    std::vector<uint32_t> x;       // Pixel and sample index, for the sampler
+    std::vector<uint32_t> y;
+    std::vector<uint32_t> sample;
+    Vector3Array throughput;
+    Vector3Array radiance;  // The sample's color once traced
+
+    // First hit of each path, for feature buffers
+    std::vector<char> first_hit;
+    std::vector<double> first_t;
+    Vector3Array first_normal;
+    Vector3Array first_albedo;
+
+    // Rays of the current bounce and their hits
+    struct Rays {
+        std::vector<uint32_t> path;
+        Vector3Array origin;
+        Vector3Array direction;  // Unit length
+        std::vector<uint64_t> key;  // Coherence sort key: direction octant, then material
+        std::vector<double> cone;   // Width of the pixel's ray cone at the origin
+
+        std::vector<char> hit;
+        std::vector<double> t;
+        Vector3Array normal;
+        std::vector<uint32_t> material;
+        std::vector<double> radius;  // Of the sphere hit, 0 for triangles
+
+        size_t size() const { return path.size(); }
+        void clear();
+        void push_back(uint32_t ray_path, const Vector3& ray_origin, const Vector3& ray_direction,
+                       uint64_t sort_key, double cone_width);
+        void resize_hits();
+    };
+    Rays rays;
+    Rays next_rays;  // Reflections spawned by this bounce
+    Rays sorted;     // Scratch for reordering rays
+
+    // Hits being shaded, sorted by material
+    struct Shading {
+        std::vector<uint32_t> ray;  // Into rays
+        Vector3Array point;
+        Vector3Array shadow_origin;  // Point lifted off the surface
+        Vector3Array tint;
+        Vector3Array lighting;
+        // Per hit and light slot (every light, or each light picked)
+        std::vector<uint32_t> light;    // Into the scene's lights
+        std::vector<double> weight;     // 1 / (pdf * picks) of a pick, 0 if none was made
+        std::vector<uint32_t> visible;  // Shadow rays that reached the light
+        std::vector<uint32_t> traced;   // Shadow rays traced
+    };
+    Shading shading;
+    std::vector<std::pair<uint64_t, uint32_t>> order;  // Scratch for sorting
+
+    // Shadow rays of one light slot, in shading order; origins are the entries'
+    std::vector<uint32_t> shadow_entry;
+    Vector3Array shadow_direction;
+    std::vector<double> shadow_distance;
+
+    uint64_t camera_rays = 0;
+    uint64_t secondary_rays = 0;
+    uint64_t shadow_rays = 0;
+
+    // Drop every path and reset the ray counts; capacity is kept
+    void clear();
+
+    // Queue a camera ray of sample `sample_index` of pixel (px, py); returns the path
+    size_t add_camera_ray(uint32_t px, uint32_t py, uint32_t sample_index, const Vector3& origin,
+                          const Vector3& direction);
+
+    size_t size() const { return x.size(); }
+};
+
+// Sort key of a ray: its direction's octant above the material of the
+// surface it leaves, so rays heading the same way through the same part of
+// the scene are traced one after another
+inline uint64_t coherence_key(const Vector3& direction, uint32_t material) {
+    uint64_t octant = (direction.x < 0.0 ? 1 : 0) | (direction.y < 0.0 ? 2 : 0) |
+                      (direction.z < 0.0 ? 4 : 0);
+    return octant << 32 | material;
+}
@@ -0,0 +1,249 @@
+#include "accelerator.h"
+#include "scene.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+
+std::vector<AABB> sphere_bounds(const std::vector<Sphere>& spheres) {
+    std::vector<AABB> bounds;
+    bounds.reserve(spheres.size());
+    for (const auto& sphere : spheres) {
+        bounds.push_back(AABB::around_sphere(sphere.center.x, sphere.center.y,
+                                             sphere.center.z, sphere.radius));
+    }
+    return bounds;
+}
+
+}  // namespace
+
+SceneAccelerator::SceneAccelerator(const Scene& scene, int num_threads, SimdLevel simd_level)
+    : scene_(scene), kernels_(sphere_kernels<intersect_real>(simd_level)) {
+    auto start = std::chrono::steady_clock::now();
+
+    // One vector's worth of spheres per leaf
+    BVH::BuildOptions options;
+    options.max_leaf_size = std::max(options.max_leaf_size, kernels_.lanes);
+    options.num_threads = num_threads;
+    bvh_.build(sphere_bounds(scene.get_spheres()), options);
+    built_area_ = bvh_.interior_area();
+
+    fill_geometry();
+    build_instance_bvh(num_threads);
+
+    build_ms_ = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+SceneAccelerator::SceneAccelerator(const Scene& scene, Prebuilt prebuilt, SimdLevel simd_level)
+    : scene_(scene), kernels_(sphere_kernels<intersect_real>(simd_level)),
+      prebuilt_owner_(std::move(prebuilt.owner)) {
+    if (prebuilt.primitive_count != scene.get_spheres().size()) {
+        throw std::runtime_error("Prebuilt BVH does not match the scene");
+    }
+    bvh_.adopt(prebuilt.nodes, prebuilt.node_count, prebuilt.indices, prebuilt.primitive_count,
+               prebuilt.depth);
+    view_ = prebuilt.geometry;
+    built_area_ = bvh_.interior_area();
+    build_instance_bvh(1);
+}
+
+void SceneAccelerator::fill_geometry() {
+    const auto& spheres = scene_.get_spheres();
+    const uint32_t* indices = bvh_.primitive_indices();
+    geometry_.resize(bvh_.primitive_count());
+    for (size_t i = 0; i < bvh_.primitive_count(); ++i) {
+        const Sphere& sphere = spheres[indices[i]];
+        geometry_.set(i, sphere.center.x, sphere.center.y, sphere.center.z, sphere.radius);
+    }
+    view_ = geometry_.view();
+}
+
+bool SceneAccelerator::refit() {
+    if (scene_.get_spheres().size() != bvh_.primitive_count()) {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // Prebuilt geometry is mapped read-only, so it is copied on the first refit
+    bvh_.refit(sphere_bounds(scene_.get_spheres()));
+    fill_geometry();
+
+    build_ms_ = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return bvh_.interior_area() <= max_refit_growth * built_area_;
+}
+
+void SceneAccelerator::build_instance_bvh(int num_threads) {
+    const auto& instances = scene_.get_instances();
+    const auto& meshes = scene_.get_meshes();
+    std::vector<AABB> bounds(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        // World box around the eight transformed corners of the mesh box
+        const AABB& local = meshes[instances[i].mesh]->bounds();
+        Transform to_world = instances[i].object_to_world();
+        for (int corner = 0; corner < 8; ++corner) {
+            Vector3 p = to_world.apply_point(Vector3(corner & 1 ? local.max[0] : local.min[0],
+                                                     corner & 2 ? local.max[1] : local.min[1],
+                                                     corner & 4 ? local.max[2] : local.min[2]));
+            AABB point = AABB::around_sphere(p.x, p.y, p.z, 0.0);
+            bounds[i].expand(point);
+        }
+    }
+
+    BVH::BuildOptions options;
+    options.max_leaf_size = 2;
+    options.num_threads = num_threads;
+    instance_bvh_.build(bounds, options);
+}
+
+namespace {
+
+// Ray in an instance's object space; the direction keeps the world ray's
+// parameterization so distances compare directly
+void to_object_space(const MeshInstance& instance, const Vector3& origin, const Vector3& direction,
+                     float object_origin[3], float object_direction[3]) {
+    const auto& m = instance.world_to_object;
+    for (int i = 0; i < 3; ++i) {
+        object_origin[i] = static_cast<float>(m[i][0] * origin.x + m[i][1] * origin.y +
+                                              m[i][2] * origin.z + m[i][3]);
+        object_direction[i] = static_cast<float>(m[i][0] * direction.x + m[i][1] * direction.y +
+                                                 m[i][2] * direction.z);
+    }
+}
+
+// World normal: object normal through the transpose of world_to_object
+Vector3 to_world_normal(const MeshInstance& instance, const Vector3& n) {
+    const auto& m = instance.world_to_object;
+    return Vector3(m[0][0] * n.x + m[1][0] * n.y + m[2][0] * n.z,
+                   m[0][1] * n.x + m[1][1] * n.y + m[2][1] * n.z,
+                   m[0][2] * n.x + m[1][2] * n.y + m[2][2] * n.z);
+}
+
+}  // namespace
+
+double SceneAccelerator::prepare_ray(const Vector3& origin, const Vector3& direction,
+                                     KernelRay<intersect_real>& kernel_ray) const {
+    // Kernels work on a unit direction
+    double length = direction.length();
+    if (length == 0) {
+        return 0.0;
+    }
+    Vector3 unit = direction / length;
+
+    kernel_ray.origin[0] = static_cast<intersect_real>(origin.x);
+    kernel_ray.origin[1] = static_cast<intersect_real>(origin.y);
+    kernel_ray.origin[2] = static_cast<intersect_real>(origin.z);
+    kernel_ray.dir[0] = static_cast<intersect_real>(unit.x);
+    kernel_ray.dir[1] = static_cast<intersect_real>(unit.y);
+    kernel_ray.dir[2] = static_cast<intersect_real>(unit.z);
+    return length;
+}
+
+SceneAccelerator::Hit SceneAccelerator::closest_hit(const Vector3& origin, const Vector3& direction,
+                                                    double t_min, double t_max) const {
+    Hit closest;
+    KernelRay<intersect_real> kernel_ray;
+    double length = prepare_ray(origin, direction, kernel_ray);
+    if (length == 0) {
+        return closest;
+    }
+    intersect_real kernel_t_min = static_cast<intersect_real>(t_min * length);
+
+    int64_t best = -1;
+    double limit = t_max * length;
+    BVHRay ray(origin.x, origin.y, origin.z, kernel_ray.dir[0], kernel_ray.dir[1], kernel_ray.dir[2]);
+    bvh_.traverse(ray, limit, [&](uint32_t first, uint32_t count, double& t_limit) {
+        intersect_real kernel_t_max = static_cast<intersect_real>(t_limit);
+        RT_COUNT(intersection_tests, count);
+        int64_t index = kernels_.closest(view_, kernel_ray, first, count, kernel_t_min, kernel_t_max);
+        if (index >= 0) {
+            best = index;
+            t_limit = kernel_t_max;
+        }
+        return false;
+    });
+
+    // Instances only need to beat the nearest sphere
+    const MeshInstance* hit_instance = nullptr;
+    uint32_t hit_triangle = 0;
+    if (!instance_bvh_.empty()) {
+        const auto& instances = scene_.get_instances();
+        const auto& meshes = scene_.get_meshes();
+        Vector3 unit = direction / length;
+        const uint32_t* order = instance_bvh_.primitive_indices();
+        instance_bvh_.traverse(ray, limit, [&](uint32_t first, uint32_t count, double& t_limit) {
+            for (uint32_t i = first; i < first + count; ++i) {
+                const MeshInstance& instance = instances[order[i]];
+                float object_origin[3], object_direction[3];
+                to_object_space(instance, origin, unit, object_origin, object_direction);
+                float t_far = static_cast<float>(t_limit);
+                if (meshes[instance.mesh]->intersect(object_origin, object_direction,
+                                                     static_cast<float>(kernel_t_min), t_far,
+                                                     hit_triangle)) {
+                    t_limit = t_far;
+                    hit_instance = &instance;
+                }
+            }
+            return false;
+        });
+    }
+
+    if (hit_instance) {
+        closest.hit = true;
+        closest.t = limit / length;
+        closest.instance = hit_instance;
+        closest.material = hit_instance->material;
+        Vector3 normal = to_world_normal(
+            *hit_instance, scene_.get_meshes()[hit_instance->mesh]->normal(hit_triangle)).normalize();
+        closest.normal = normal.dot(direction) > 0 ? normal * -1.0 : normal;
+    } else if (best >= 0) {
+        closest.hit = true;
+        closest.t = limit / length;
+        closest.sphere = &scene_.get_spheres()[bvh_.primitive_indices()[best]];
+        closest.material = closest.sphere->material;
+        closest.normal = (origin + direction * closest.t - closest.sphere->center).normalize();
+    }
+    return closest;
+}
+
+bool SceneAccelerator::occluded(const Vector3& origin, const Vector3& direction,
+                                double t_min, double t_max) const {
+    KernelRay<intersect_real> kernel_ray;
+    double length = prepare_ray(origin, direction, kernel_ray);
+    if (length == 0) {
+        return false;
+    }
+    intersect_real kernel_t_min = static_cast<intersect_real>(t_min * length);
+    intersect_real kernel_t_max = static_cast<intersect_real>(t_max * length);
+
+    bool blocked = false;
+    double limit = t_max * length;
+    BVHRay ray(origin.x, origin.y, origin.z, kernel_ray.dir[0], kernel_ray.dir[1], kernel_ray.dir[2]);
+    bvh_.traverse(ray, limit, [&](uint32_t first, uint32_t count, double&) {
+        RT_COUNT(intersection_tests, count);
+        blocked = kernels_.any(view_, kernel_ray, first, count, kernel_t_min, kernel_t_max);
+        return blocked;
+    });
+
+    if (!blocked && !instance_bvh_.empty()) {
+        const auto& instances = scene_.get_instances();
+        const auto& meshes = scene_.get_meshes();
+        Vector3 unit = direction / length;
+        const uint32_t* order = instance_bvh_.primitive_indices();
+        limit = t_max * length;
+        instance_bvh_.traverse(ray, limit, [&](uint32_t first, uint32_t count, double&) {
+            for (uint32_t i = first; i < first + count && !blocked; ++i) {
+                const MeshInstance& instance = instances[order[i]];
+                float object_origin[3], object_direction[3];
+                to_object_space(instance, origin, unit, object_origin, object_direction);
+                blocked = meshes[instance.mesh]->occluded(object_origin, object_direction,
+                                                         static_cast<float>(kernel_t_min),
+                                                         static_cast<float>(kernel_t_max));
+            }
+            return blocked;
+        });
+    }
+    return blocked;
+}
@@ -0,0 +1,130 @@
+#include "animation.h"
+#include "scene.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Rodrigues' rotation of v by angle (radians) about the unit axis
+Vector3 rotate_about(const Vector3& v, const Vector3& axis, double angle) {
+    double c = std::cos(angle);
+    double s = std::sin(angle);
+    return v * c + axis.cross(v) * s + axis * (axis.dot(v) * (1.0 - c));
+}
+
+}  // namespace
+
+void Animation::add_key(Target target, uint32_t index, int frame, const Vector3& value) {
+    if (frame < 0) {
+        throw std::out_of_range("Animation key at negative frame " + std::to_string(frame));
+    }
+    auto track = std::find_if(tracks_.begin(), tracks_.end(), [&](const Track& t) {
+        return t.target == target && t.index == index;
+    });
+    if (track == tracks_.end()) {
+        tracks_.push_back({target, index, {}});
+        track = tracks_.end() - 1;
+    }
+
+    auto key = std::lower_bound(track->keys.begin(), track->keys.end(), frame,
+                                [](const Key& k, int f) { return k.frame < f; });
+    if (key != track->keys.end() && key->frame == frame) {
+        key->value = value;
+    } else {
+        track->keys.insert(key, {frame, value});
+    }
+}
+
+Animation Animation::turntable(int frames) {
+    Animation animation;
+    animation.add_key(Target::CAMERA_ORBIT, 0, 0, Vector3(0, 0, 0));
+    animation.add_key(Target::CAMERA_ORBIT, 0, frames, Vector3(360, 0, 0));
+    animation.set_frame_count(frames);
+    return animation;
+}
+
+int Animation::frame_count() const {
+    if (frame_count_ > 0) {
+        return frame_count_;
+    }
+    int frames = 1;
+    for (const auto& track : tracks_) {
+        frames = std::max(frames, track.keys.back().frame + 1);
+    }
+    return frames;
+}
+
+bool Animation::moves_spheres() const {
+    return std::any_of(tracks_.begin(), tracks_.end(),
+                       [](const Track& track) { return track.target == Target::SPHERE_CENTER; });
+}
+
+Vector3 Animation::value_at(const Track& track, int frame) {
+    const auto& keys = track.keys;
+    if (frame <= keys.front().frame) {
+        return keys.front().value;
+    }
+    if (frame >= keys.back().frame) {
+        return keys.back().value;
+    }
+    auto next = std::upper_bound(keys.begin(), keys.end(), frame,
+                                 [](int f, const Key& k) { return f < k.frame; });
+    auto previous = next - 1;
+    double t = static_cast<double>(frame - previous->frame) / (next->frame - previous->frame);
+    return previous->value + (next->value - previous->value) * t;
+}
+
+void Animation::apply(int frame, const Camera& base_camera, Scene& scene) const {
+    Camera camera = base_camera;
+    double orbit_degrees = 0.0;
+    for (const auto& track : tracks_) {
+        Vector3 value = value_at(track, frame);
+        switch (track.target) {
+            case Target::SPHERE_CENTER:
+                scene.move_sphere(track.index, value);
+                break;
+            case Target::LIGHT_POSITION:
+                scene.move_light(track.index, value);
+                break;
+            case Target::CAMERA_POSITION:
+                camera.position = value;
+                break;
+            case Target::CAMERA_LOOK_AT:
+                camera.look_at = value;
+                break;
+            case Target::CAMERA_ORBIT:
+                orbit_degrees = value.x;
+                break;
+        }
+    }
+
+    // Orbit after the keyed position and target, whatever the track order
+    if (orbit_degrees != 0.0) {
+        Vector3 offset = camera.position - camera.look_at;
+        camera.position = camera.look_at +
+                          rotate_about(offset, camera.up.normalize(), orbit_degrees * M_PI / 180.0);
+    }
+    scene.set_camera(camera);
+}
+
+std::string frame_filename(const std::string& pattern, int frame) {
+    std::string number = std::to_string(frame);
+    size_t first = pattern.find('#');
+    if (first == std::string::npos) {
+        size_t dot = pattern.find_last_of('.');
+        size_t slash = pattern.find_last_of('/');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            dot = pattern.size();
+        }
+        std::string padded = std::string(number.size() < 4 ? 4 - number.size() : 0, '0') + number;
+        return pattern.substr(0, dot) + "_" + padded + pattern.substr(dot);
+    }
+    size_t last = pattern.find_first_not_of('#', first);
+    size_t width = (last == std::string::npos ? pattern.size() : last) - first;
+    if (number.size() < width) {
+        number.insert(0, width - number.size(), '0');
+    }
+    return pattern.substr(0, first) + number + pattern.substr(first + width);
+}
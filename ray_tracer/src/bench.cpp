@@ -0,0 +1,393 @@
+#include "ray_tracer.h"
+#include "scene.h"
+#include "texture.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Fixed-seed generator so every run builds identical scenes
+struct XorShift {
+    uint64_t state;
+    explicit XorShift(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+    double next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return (state >> 11) * 0x1p-53;
+    }
+};
+
+// Silences std::cout for the lifetime of the object (the renderer logs to stdout)
+class QuietStdout {
+public:
+    QuietStdout() : old_(std::cout.rdbuf(sink_.rdbuf())) {}
+    ~QuietStdout() { std::cout.rdbuf(old_); }
+
+private:
+    std::ostringstream sink_;
+    std::streambuf* old_;
+};
+
+// ---------------------------------------------------------------------------
+// Canonical scenes
+// ---------------------------------------------------------------------------
+
+void look(Scene& scene, const Vector3& position, const Vector3& target, double fov) {
+    Camera camera;
+    camera.position = position;
+    camera.look_at = target;
+    camera.fov = fov;
+    scene.set_camera(camera);
+}
+
+// 40k small spheres on a ground plane: BVH traversal and primary-ray bound
+void build_spheres(Scene& scene) {
+    XorShift rng(1);
+    uint32_t ground = scene.add_material(Material(Vector3(0.6, 0.6, 0.6)));
+    scene.add_sphere(Sphere(Vector3(0, -1000, 0), 1000, ground));
+    uint32_t materials[4] = {
+        scene.add_material(Material(Vector3(0.9, 0.3, 0.2))),
+        scene.add_material(Material(Vector3(0.2, 0.8, 0.3))),
+        scene.add_material(Material(Vector3(0.2, 0.3, 0.9))),
+        scene.add_material(Material(Vector3(0.9, 0.9, 0.9), 0.5)),
+    };
+    for (int z = 0; z < 200; ++z) {
+        for (int x = 0; x < 200; ++x) {
+            double radius = 0.03 + 0.05 * rng.next();
+            Vector3 center(-10 + x * 0.1 + 0.04 * rng.next(), radius,
+                           -2 - z * 0.1 + 0.04 * rng.next());
+            scene.add_sphere(Sphere(center, radius, materials[(x + z) % 4]));
+        }
+    }
+    scene.add_light(Light(Vector3(5, 8, 2), Vector3(1, 1, 1), 0.5));
+    look(scene, Vector3(0, 2.5, 3), Vector3(0, 0, -6), 60);
+}
+
+// Camera inside a ring of facing mirrors: reflection-depth bound
+void build_mirrors(Scene& scene) {
+    uint32_t mirror = scene.add_material(Material(Vector3(0.95, 0.95, 0.95), 0.95));
+    for (int i = 0; i < 8; ++i) {
+        double angle = i * 3.14159265358979 / 4;
+        scene.add_sphere(Sphere(Vector3(4 * std::cos(angle), 0, 4 * std::sin(angle)), 1.8, mirror));
+    }
+    uint32_t orange = scene.add_material(Material(Vector3(1, 0.4, 0.1)));
+    uint32_t floor = scene.add_material(Material(Vector3(0.5, 0.5, 0.5), 0.5));
+    scene.add_sphere(Sphere(Vector3(0, 0, 0), 0.6, orange));
+    scene.add_sphere(Sphere(Vector3(0, -1002, 0), 1000, floor));
+    scene.add_light(Light(Vector3(0, 6, 0), Vector3(1, 1, 1), 0.3));
+    look(scene, Vector3(0, 0.5, 2.2), Vector3(0, 0, -4), 70);
+}
+
+// 32 area lights over a few spheres: shadow-ray bound
+void build_lights(Scene& scene) {
+    uint32_t ground = scene.add_material(Material(Vector3(0.7, 0.7, 0.7)));
+    scene.add_sphere(Sphere(Vector3(0, -1000, 0), 1000, ground));
+    uint32_t matte = scene.add_material(Material(Vector3(0.8, 0.5, 0.3)));
+    for (int i = 0; i < 9; ++i) {
+        scene.add_sphere(Sphere(Vector3(-2 + (i % 3) * 2, 0.6, -3 - (i / 3) * 2), 0.6, matte));
+    }
+    for (int i = 0; i < 32; ++i) {
+        Vector3 position(-7 + (i % 8) * 2, 5, 2 - (i / 8) * 3);
+        scene.add_light(Light(position, Vector3(0.06, 0.06, 0.06), 0.15));
+    }
+    look(scene, Vector3(0, 3, 3), Vector3(0, 0, -5), 60);
+}
+
+// 4096 dim area lights in a dome over build_lights' spheres, 8 picked per hit
+// through the light tree: light-selection bound
+void build_many_lights(Scene& scene) {
+    XorShift rng(4);
+    uint32_t ground = scene.add_material(Material(Vector3(0.7, 0.7, 0.7)));
+    scene.add_sphere(Sphere(Vector3(0, -1000, 0), 1000, ground));
+    uint32_t matte = scene.add_material(Material(Vector3(0.8, 0.5, 0.3)));
+    for (int i = 0; i < 9; ++i) {
+        scene.add_sphere(Sphere(Vector3(-2 + (i % 3) * 2, 0.6, -3 - (i / 3) * 2), 0.6, matte));
+    }
+    for (int i = 0; i < 4096; ++i) {
+        double angle = 2 * 3.14159265358979 * rng.next();
+        double height = rng.next();
+        double spread = 8 * std::sqrt(1 - height * height);
+        Vector3 position(spread * std::cos(angle), 0.5 + 6 * height,
+                         -5 + spread * std::sin(angle));
+        Vector3 color(0.3 + 0.7 * rng.next(), 0.3 + 0.7 * rng.next(), 0.3 + 0.7 * rng.next());
+        scene.add_light(Light(position, color * (2.0 / 4096), 0.05));
+    }
+    look(scene, Vector3(0, 3, 3), Vector3(0, 0, -5), 60);
+}
+
+// Checkerboard ground out to the horizon: texture and large-primitive bound
+void build_ground(Scene& scene) {
+    Material ground(Vector3(0.8, 0.8, 0.8), 0.15);
+    ground.texture = scene.add_texture(Texture(Texture::Type::CHECKERBOARD, Vector3(1, 1, 1),
+                                               Vector3(0.2, 0.2, 0.2)));
+    scene.add_sphere(Sphere(Vector3(0, -10000, 0), 10000, scene.add_material(ground)));
+    uint32_t red = scene.add_material(Material(Vector3(1, 0.2, 0.2)));
+    uint32_t mirror = scene.add_material(Material(Vector3(1, 1, 1), 0.8));
+    scene.add_sphere(Sphere(Vector3(-1.5, 1, -6), 1, red));
+    scene.add_sphere(Sphere(Vector3(1.5, 1, -8), 1, mirror));
+    scene.add_light(Light(Vector3(3, 6, 0), Vector3(1, 1, 1), 0.4));
+    scene.set_background_color(Vector3(0.5, 0.7, 1.0));
+    look(scene, Vector3(0, 0.6, 2), Vector3(0, 0.4, -10), 60);
+}
+
+struct BenchScene {
+    const char* name;
+    int max_depth;
+    void (*build)(Scene&);
+    int light_samples = 0;  // Lights picked per hit, 0 = all
+};
+
+const BenchScene bench_scenes[] = {
+    {"spheres", 3, build_spheres},
+    {"mirrors", 16, build_mirrors},
+    {"lights", 3, build_lights},
+    {"ground", 3, build_ground},
+    {"many_lights", 3, build_many_lights, 8},
+};
+
+// ---------------------------------------------------------------------------
+// Measurement
+// ---------------------------------------------------------------------------
+
+/**
+ * BenchResult - One row of the report
+ */
+struct BenchResult {
+    std::string scene;
+    int width;
+    int height;
+    int threads;
+    int samples;
+    double ms_per_frame;
+    RenderStats stats;
+    double efficiency;  // Speedup over one thread divided by threads
+
+    double per_second(uint64_t rays) const { return rays / (ms_per_frame / 1000.0); }
+    uint64_t total_rays() const {
+        return stats.primary_rays + stats.secondary_rays + stats.shadow_rays;
+    }
+};
+
+struct BenchOptions {
+    std::vector<std::pair<int, int>> resolutions = {{320, 240}, {640, 480}};
+    std::vector<std::string> scenes;  // Empty = all
+    int max_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int samples = 4;
+    uint64_t seed = 1;
+    int repeat = 1;
+    bool wavefront = false;  // Wavefront renderer instead of the recursive one
+};
+
+// 1, 2, 4, ... up to and including max_threads
+std::vector<int> thread_counts(int max_threads) {
+    std::vector<int> counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(max_threads);
+    return counts;
+}
+
+// Best of options.repeat renders; ray counts are identical across repeats
+BenchResult run(const BenchScene& bench_scene, const Scene& scene, int width, int height,
+                int threads, const BenchOptions& options, const std::string& output_file) {
+    BenchResult result{bench_scene.name, width, height, threads, options.samples, 0.0, {}, 1.0};
+    for (int i = 0; i < options.repeat; ++i) {
+        RayTracer tracer(width, height, options.samples);
+        tracer.set_num_threads(threads);
+        tracer.set_max_depth(bench_scene.max_depth);
+        tracer.set_seed(options.seed);
+        tracer.set_wavefront(options.wavefront);
+        tracer.set_light_samples(bench_scene.light_samples);
+        {
+            QuietStdout quiet;
+            tracer.render_scene(scene, output_file);
+        }
+        double ms = tracer.last_render_stats().render_seconds * 1000.0;
+        if (i == 0 || ms < result.ms_per_frame) {
+            result.ms_per_frame = ms;
+            result.stats = tracer.last_render_stats();
+        }
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Reporting
+// ---------------------------------------------------------------------------
+
+void print_table(const std::vector<BenchResult>& results) {
+    std::cerr << std::left << std::setw(10) << "scene"
+              << std::right << std::setw(11) << "resolution"
+              << std::setw(8) << "threads"
+              << std::setw(12) << "ms/frame"
+              << std::setw(12) << "primary/s"
+              << std::setw(12) << "second/s"
+              << std::setw(12) << "shadow/s"
+              << std::setw(10) << "Mrays/s"
+              << std::setw(8) << "eff" << "\n";
+    std::cerr << std::fixed;
+    for (const auto& r : results) {
+        std::cerr << std::left << std::setw(10) << r.scene
+                  << std::right << std::setw(11)
+                  << (std::to_string(r.width) + "x" + std::to_string(r.height))
+                  << std::setw(8) << r.threads
+                  << std::setw(12) << std::setprecision(1) << r.ms_per_frame
+                  << std::setw(12) << std::setprecision(0) << r.per_second(r.stats.primary_rays)
+                  << std::setw(12) << r.per_second(r.stats.secondary_rays)
+                  << std::setw(12) << r.per_second(r.stats.shadow_rays)
+                  << std::setw(10) << std::setprecision(2) << r.per_second(r.total_rays()) / 1e6
+                  << std::setw(8) << r.efficiency << "\n";
+    }
+}
+
+void write_json(std::ostream& out, const std::vector<BenchResult>& results,
+                const BenchOptions& options) {
+    out << "{\n  \"seed\": " << options.seed << ",\n  \"samples_per_pixel\": " << options.samples
+        << ",\n  \"renderer\": \"" << (options.wavefront ? "wavefront" : "recursive")
+        << "\",\n  \"benchmarks\": [\n";
+    out << std::fixed;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << "    {\"scene\": \"" << r.scene << "\""
+            << ", \"width\": " << r.width
+            << ", \"height\": " << r.height
+            << ", \"threads\": " << r.threads
+            << std::setprecision(3)
+            << ", \"ms_per_frame\": " << r.ms_per_frame
+            << ", \"primary_rays\": " << r.stats.primary_rays
+            << ", \"secondary_rays\": " << r.stats.secondary_rays
+            << ", \"shadow_rays\": " << r.stats.shadow_rays
+            << std::setprecision(1)
+            << ", \"primary_rays_per_sec\": " << r.per_second(r.stats.primary_rays)
+            << ", \"secondary_rays_per_sec\": " << r.per_second(r.stats.secondary_rays)
+            << ", \"shadow_rays_per_sec\": " << r.per_second(r.stats.shadow_rays)
+            << ", \"rays_per_sec\": " << r.per_second(r.total_rays())
+            << std::setprecision(3)
+            << ", \"scaling_efficiency\": " << r.efficiency << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+std::vector<std::string> split(const std::string& text) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    for (std::string part; std::getline(stream, part, ',');) {
+        if (!part.empty()) {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string json_path;
+    BenchOptions options;
+
+    // Parse command line arguments
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--json" && i + 1 < argc) {
+                json_path = argv[++i];
+            } else if (arg == "--threads" && i + 1 < argc) {
+                options.max_threads = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--resolutions" && i + 1 < argc) {
+                options.resolutions.clear();
+                for (const auto& size : split(argv[++i])) {
+                    size_t x = size.find('x');
+                    if (x == std::string::npos) {
+                        throw std::invalid_argument(size);
+                    }
+                    options.resolutions.emplace_back(std::stoi(size.substr(0, x)),
+                                                     std::stoi(size.substr(x + 1)));
+                }
+            } else if (arg == "--scenes" && i + 1 < argc) {
+                options.scenes = split(argv[++i]);
+            } else if (arg == "--samples" && i + 1 < argc) {
+                options.samples = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--seed" && i + 1 < argc) {
+                options.seed = std::stoull(argv[++i]);
+            } else if (arg == "--repeat" && i + 1 < argc) {
+                options.repeat = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--wavefront") {
+                options.wavefront = true;
+            } else {
+                throw std::invalid_argument(arg);
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--json <file>] [--threads N] [--resolutions WxH,...] [--scenes a,b,...]"
+                     " [--samples N] [--seed N] [--repeat N] [--wavefront]\n"
+                  << "Scenes: spheres, mirrors, lights, ground, many_lights\n";
+        return 1;
+    }
+
+    // Frames are written to a scratch file; only tracing time is reported
+    std::string output_file = (std::filesystem::temp_directory_path() /
+                               ("rt_bench_" + std::to_string(getpid()) + ".ppm")).string();
+
+    std::vector<BenchResult> results;
+    bool progress = isatty(STDERR_FILENO);
+    for (const auto& bench_scene : bench_scenes) {
+        if (!options.scenes.empty() && std::find(options.scenes.begin(), options.scenes.end(),
+                                                 bench_scene.name) == options.scenes.end()) {
+            continue;
+        }
+        Scene scene;
+        bench_scene.build(scene);
+        for (const auto& [width, height] : options.resolutions) {
+            double single_thread_ms = 0.0;
+            for (int threads : thread_counts(options.max_threads)) {
+                if (progress) {
+                    std::cerr << "\r" << bench_scene.name << " " << width << "x" << height << " x"
+                              << threads << "...          " << std::flush;
+                }
+                BenchResult result =
+                    run(bench_scene, scene, width, height, threads, options, output_file);
+                if (threads == 1) {
+                    single_thread_ms = result.ms_per_frame;
+                }
+                result.efficiency = single_thread_ms / (result.ms_per_frame * threads);
+                results.push_back(result);
+            }
+        }
+    }
+    if (progress) {
+        std::cerr << "\r" << std::string(40, ' ') << "\r";
+    }
+    std::remove(output_file.c_str());
+
+    print_table(results);
+
+    // JSON goes to stdout unless a file was requested, so runs can be diffed
+    if (json_path.empty()) {
+        write_json(std::cout, results, options);
+    } else {
+        std::ofstream file(json_path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file: " << json_path << "\n";
+            return 1;
+        }
+        write_json(file, results, options);
+    }
+
+    return 0;
+}
@@ -0,0 +1,329 @@
+#include "bvh.h"
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+struct BuildPrimitive {
+    AABB bounds;
+    float centroid[3];
+    uint32_t index;
+};
+
+struct BuildNode {
+    AABB bounds;
+    std::unique_ptr<BuildNode> children[2];
+    uint32_t first = 0;
+    uint32_t count = 0;
+    int axis = 0;
+};
+
+struct Bin {
+    AABB bounds;
+    uint32_t count = 0;
+};
+
+// Below this many primitives a subtree is not worth a thread of its own
+constexpr size_t parallel_threshold = 4096;
+constexpr size_t max_leaf_primitives = 255;
+
+class Builder {
+public:
+    Builder(std::vector<BuildPrimitive>& primitives, const BVH::BuildOptions& options, int max_depth)
+        : primitives_(primitives), options_(options), max_depth_(max_depth) {
+        parallel_depth_ = 0;
+        while ((1 << parallel_depth_) < options.num_threads) {
+            ++parallel_depth_;
+        }
+    }
+
+    std::unique_ptr<BuildNode> build(size_t begin, size_t end, int depth) {
+        auto node = std::make_unique<BuildNode>();
+        AABB centroid_bounds;
+        for (size_t i = begin; i < end; ++i) {
+            node->bounds.expand(primitives_[i].bounds);
+            centroid_bounds.expand(primitives_[i].centroid);
+        }
+
+        size_t count = end - begin;
+        if (count <= static_cast<size_t>(options_.max_leaf_size) || depth >= max_depth_ - 1) {
+            return make_leaf(std::move(node), begin, count);
+        }
+
+        int axis = -1;
+        size_t split_bin = 0;
+        float best_cost = find_split(begin, end, node->bounds, centroid_bounds, axis, split_bin);
+
+        size_t mid;
+        if (axis < 0) {
+            // All centroids coincide: split by count only if the leaf would be too big
+            if (count <= max_leaf_primitives) {
+                return make_leaf(std::move(node), begin, count);
+            }
+            axis = 0;
+            mid = begin + count / 2;
+        } else {
+            // SAH says a leaf is cheaper than any split
+            if (best_cost >= static_cast<float>(count) && count <= max_leaf_primitives) {
+                return make_leaf(std::move(node), begin, count);
+            }
+
+            float lo = centroid_bounds.min[axis];
+            float scale = options_.bins / (centroid_bounds.max[axis] - lo);
+            auto it = std::partition(primitives_.begin() + begin, primitives_.begin() + end,
+                                     [&](const BuildPrimitive& p) {
+                                         return bin_index(p.centroid[axis], lo, scale) <= split_bin;
+                                     });
+            mid = static_cast<size_t>(it - primitives_.begin());
+            if (mid == begin || mid == end) {
+                mid = begin + count / 2;
+            }
+        }
+
+        node->axis = axis;
+        if (depth < parallel_depth_ && count >= parallel_threshold) {
+            auto left = std::async(std::launch::async, [this, begin, mid, depth]() {
+                return build(begin, mid, depth + 1);
+            });
+            node->children[1] = build(mid, end, depth + 1);
+            node->children[0] = left.get();
+        } else {
+            node->children[0] = build(begin, mid, depth + 1);
+            node->children[1] = build(mid, end, depth + 1);
+        }
+        return node;
+    }
+
+private:
+    std::vector<BuildPrimitive>& primitives_;
+    const BVH::BuildOptions& options_;
+    int max_depth_;
+    int parallel_depth_;
+
+    size_t bin_index(float centroid, float lo, float scale) const {
+        int b = static_cast<int>((centroid - lo) * scale);
+        return static_cast<size_t>(std::clamp(b, 0, options_.bins - 1));
+    }
+
+    std::unique_ptr<BuildNode> make_leaf(std::unique_ptr<BuildNode> node, size_t begin, size_t count) {
+        node->first = static_cast<uint32_t>(begin);
+        node->count = static_cast<uint32_t>(count);
+        return node;
+    }
+
+    // Returns the SAH cost (in units of one primitive test) of the best split
+    float find_split(size_t begin, size_t end, const AABB& bounds, const AABB& centroid_bounds,
+                     int& best_axis, size_t& best_bin) const {
+        const int bins = options_.bins;
+        float parent_area = bounds.surface_area();
+        float best_cost = std::numeric_limits<float>::infinity();
+        best_axis = -1;
+
+        std::vector<Bin> bin(bins);
+        std::vector<float> right_area(bins);
+        std::vector<uint32_t> right_count(bins);
+
+        for (int axis = 0; axis < 3; ++axis) {
+            float lo = centroid_bounds.min[axis];
+            float extent = centroid_bounds.max[axis] - lo;
+            if (!(extent > 0.0f)) {
+                continue;
+            }
+            float scale = bins / extent;
+
+            std::fill(bin.begin(), bin.end(), Bin());
+            for (size_t i = begin; i < end; ++i) {
+                Bin& b = bin[bin_index(primitives_[i].centroid[axis], lo, scale)];
+                b.bounds.expand(primitives_[i].bounds);
+                ++b.count;
+            }
+
+            // Sweep from the right to get the cost of every "bins[0..k] | rest" split
+            AABB accumulated;
+            uint32_t accumulated_count = 0;
+            for (int k = bins - 1; k > 0; --k) {
+                accumulated.expand(bin[k].bounds);
+                accumulated_count += bin[k].count;
+                right_area[k] = accumulated.surface_area();
+                right_count[k] = accumulated_count;
+            }
+
+            accumulated = AABB();
+            accumulated_count = 0;
+            for (int k = 0; k < bins - 1; ++k) {
+                accumulated.expand(bin[k].bounds);
+                accumulated_count += bin[k].count;
+                if (accumulated_count == 0 || right_count[k + 1] == 0) {
+                    continue;
+                }
+                float cost = 1.0f + (accumulated.surface_area() * accumulated_count +
+                                     right_area[k + 1] * right_count[k + 1]) /
+                                        std::max(parent_area, 1e-20f);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = static_cast<size_t>(k);
+                }
+            }
+        }
+        return best_cost;
+    }
+};
+
+uint32_t flatten(const BuildNode& node, std::vector<BVHNode>& nodes, int depth, int& max_depth) {
+    max_depth = std::max(max_depth, depth + 1);
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    BVHNode flat;
+    for (int i = 0; i < 3; ++i) {
+        flat.bounds_min[i] = node.bounds.min[i];
+        flat.bounds_max[i] = node.bounds.max[i];
+    }
+    flat.axis = static_cast<uint8_t>(node.axis);
+    flat.pad = 0;
+
+    if (!node.children[0]) {
+        flat.offset = node.first;
+        flat.count = static_cast<uint16_t>(node.count);
+    } else {
+        flat.count = 0;
+        flatten(*node.children[0], nodes, depth + 1, max_depth);
+        flat.offset = flatten(*node.children[1], nodes, depth + 1, max_depth);
+    }
+
+    nodes[index] = flat;
+    return index;
+}
+
+}  // namespace
+
+AABB AABB::around_sphere(double cx, double cy, double cz, double radius) {
+    // Pad by a relative epsilon so float rounding never shrinks the box
+    double center[3] = {cx, cy, cz};
+    AABB box;
+    for (int i = 0; i < 3; ++i) {
+        double pad = std::fabs(radius) * 1e-5 + std::fabs(center[i]) * 1e-6 + 1e-6;
+        box.min[i] = static_cast<float>(center[i] - radius - pad);
+        box.max[i] = static_cast<float>(center[i] + radius + pad);
+    }
+    return box;
+}
+
+BVHRay::BVHRay(double ox, double oy, double oz, double dx, double dy, double dz) {
+    double o[3] = {ox, oy, oz};
+    double d[3] = {dx, dy, dz};
+    for (int i = 0; i < 3; ++i) {
+        // Keep 1/d finite so slab tests never produce 0 * inf
+        double component = std::fabs(d[i]) < 1e-20 ? std::copysign(1e-20, d[i]) : d[i];
+        origin[i] = static_cast<float>(o[i]);
+        inv_dir[i] = static_cast<float>(1.0 / component);
+        dir_negative[i] = component < 0 ? 1 : 0;
+    }
+}
+
+void BVH::build(const std::vector<AABB>& primitive_bounds, const BuildOptions& options) {
+    node_storage_.clear();
+    index_storage_.clear();
+    nodes_ = nullptr;
+    node_count_ = 0;
+    indices_ = nullptr;
+    primitive_count_ = 0;
+    depth_ = 0;
+    if (primitive_bounds.empty()) {
+        return;
+    }
+
+    std::vector<BuildPrimitive> primitives(primitive_bounds.size());
+    for (size_t i = 0; i < primitive_bounds.size(); ++i) {
+        primitives[i].bounds = primitive_bounds[i];
+        for (int axis = 0; axis < 3; ++axis) {
+            primitives[i].centroid[axis] = primitive_bounds[i].centroid(axis);
+        }
+        primitives[i].index = static_cast<uint32_t>(i);
+    }
+
+    Builder builder(primitives, options, max_depth);
+    std::unique_ptr<BuildNode> root = builder.build(0, primitives.size(), 0);
+
+    node_storage_.reserve(2 * primitives.size() / std::max(1, options.max_leaf_size) + 1);
+    flatten(*root, node_storage_, 0, depth_);
+
+    index_storage_.resize(primitives.size());
+    for (size_t i = 0; i < primitives.size(); ++i) {
+        index_storage_[i] = primitives[i].index;
+    }
+
+    nodes_ = node_storage_.data();
+    node_count_ = node_storage_.size();
+    indices_ = index_storage_.data();
+    primitive_count_ = index_storage_.size();
+}
+
+void BVH::refit(const std::vector<AABB>& primitive_bounds) {
+    if (primitive_bounds.size() != primitive_count_) {
+        throw std::runtime_error("BVH refit with " + std::to_string(primitive_bounds.size()) +
+                                 " primitives, built with " + std::to_string(primitive_count_));
+    }
+    if (node_storage_.empty()) {
+        node_storage_.assign(nodes_, nodes_ + node_count_);
+        nodes_ = node_storage_.data();
+    }
+
+    // Children are stored after their parent, so a backward sweep sees them first
+    auto node_box = [](const BVHNode& node) {
+        AABB box;
+        for (int axis = 0; axis < 3; ++axis) {
+            box.min[axis] = node.bounds_min[axis];
+            box.max[axis] = node.bounds_max[axis];
+        }
+        return box;
+    };
+    for (size_t i = node_storage_.size(); i-- > 0;) {
+        BVHNode& node = node_storage_[i];
+        AABB box;
+        if (node.is_leaf()) {
+            for (uint32_t j = node.offset; j < node.offset + node.count; ++j) {
+                box.expand(primitive_bounds[indices_[j]]);
+            }
+        } else {
+            box = node_box(node_storage_[i + 1]);
+            box.expand(node_box(node_storage_[node.offset]));
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            node.bounds_min[axis] = box.min[axis];
+            node.bounds_max[axis] = box.max[axis];
+        }
+    }
+}
+
+double BVH::interior_area() const {
+    double area = 0.0;
+    for (size_t i = 0; i < node_count_; ++i) {
+        const BVHNode& node = nodes_[i];
+        if (!node.is_leaf()) {
+            double dx = node.bounds_max[0] - node.bounds_min[0];
+            double dy = node.bounds_max[1] - node.bounds_min[1];
+            double dz = node.bounds_max[2] - node.bounds_min[2];
+            area += 2.0 * (dx * dy + dy * dz + dz * dx);
+        }
+    }
+    return area;
+}
+
+void BVH::adopt(const BVHNode* nodes, size_t node_count, const uint32_t* indices,
+                size_t primitive_count, int depth) {
+    if (depth < 0 || depth > max_depth) {
+        throw std::runtime_error("BVH too deep to traverse: " + std::to_string(depth));
+    }
+    node_storage_.clear();
+    index_storage_.clear();
+    nodes_ = nodes;
+    node_count_ = node_count;
+    indices_ = indices;
+    primitive_count_ = primitive_count;
+    depth_ = depth;
+}
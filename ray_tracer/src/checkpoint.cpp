@@ -0,0 +1,82 @@
+#include "checkpoint.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr char checkpoint_magic[8] = {'R', 'T', 'C', 'K', 'P', 'T', '0', '1'};
+constexpr uint32_t checkpoint_version = 1;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t passes;
+    uint64_t seed;
+    uint32_t target_samples;
+    uint32_t pixel_size;  // sizeof(PixelEstimate) when written
+};
+
+}  // namespace
+
+void save_checkpoint(const std::string& filename, const RenderCheckpoint& checkpoint) {
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, checkpoint_magic, sizeof(header.magic));
+    header.version = checkpoint_version;
+    header.width = static_cast<uint32_t>(checkpoint.width);
+    header.height = static_cast<uint32_t>(checkpoint.height);
+    header.passes = checkpoint.passes;
+    header.seed = checkpoint.seed;
+    header.target_samples = checkpoint.target_samples;
+    header.pixel_size = sizeof(PixelEstimate);
+
+    std::string temporary = filename + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Failed to open checkpoint file: " + temporary);
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(checkpoint.pixels.data(), sizeof(PixelEstimate),
+                          checkpoint.pixels.size(), file) == checkpoint.pixels.size();
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Failed to write checkpoint file: " + filename);
+    }
+}
+
+bool load_checkpoint(const std::string& filename, RenderCheckpoint& checkpoint,
+                     const std::string& scratch_file) {
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        if (errno == ENOENT) {
+            return false;
+        }
+        throw std::runtime_error("Failed to open checkpoint file: " + filename);
+    }
+
+    CheckpointHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, checkpoint_magic, sizeof(header.magic)) == 0 &&
+              header.version == checkpoint_version && header.pixel_size == sizeof(PixelEstimate);
+    if (ok) {
+        checkpoint.width = static_cast<int>(header.width);
+        checkpoint.height = static_cast<int>(header.height);
+        checkpoint.passes = header.passes;
+        checkpoint.seed = header.seed;
+        checkpoint.target_samples = header.target_samples;
+        checkpoint.pixels.allocate(static_cast<size_t>(header.width) * header.height, scratch_file);
+        ok = std::fread(checkpoint.pixels.data(), sizeof(PixelEstimate), checkpoint.pixels.size(),
+                        file) == checkpoint.pixels.size();
+    }
+    std::fclose(file);
+
+    if (!ok) {
+        throw std::runtime_error("Invalid or truncated checkpoint file: " + filename);
+    }
+    return true;
+}
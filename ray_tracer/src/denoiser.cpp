@@ -0,0 +1,261 @@
+#include "denoiser.h"
+#include "denoise_kernels.h"
+#include "image_encoder.h"
+#include "sphere_kernels.h"
+#include "tile_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+namespace {
+
+struct ScalarFloat {
+    using reg = float;
+    static constexpr int lanes = 1;
+
+    static reg set1(float v) { return v; }
+    static reg loadu(const float* p) { return *p; }
+    static void storeu(float* p, reg a) { *p = a; }
+    static reg add(reg a, reg b) { return a + b; }
+    static reg sub(reg a, reg b) { return a - b; }
+    static reg mul(reg a, reg b) { return a * b; }
+    static reg div(reg a, reg b) { return a / b; }
+    static reg max(reg a, reg b) { return a > b ? a : b; }
+    static reg abs(reg a) { return a < 0.0f ? -a : a; }
+};
+
+void atrous_row_scalar(const DenoisePlanes& planes, int y, int width, int step) {
+    atrous_row<ScalarFloat>(planes, y, width, step);
+}
+
+AtrousRowFn select_atrous_row() {
+#ifdef RAY_TRACER_HAVE_AVX2
+    if (detect_simd_level() != SimdLevel::SCALAR) {
+        return avx2_atrous_row();
+    }
+#endif
+    return atrous_row_scalar;
+}
+
+// Run row(y) for every image row on the pool's threads
+void parallel_rows(WorkerPool& pool, int rows, const std::function<void(int)>& row) {
+    std::atomic<int> next{0};
+    WorkerPool::Job job = [&](int) {
+        for (int y = next.fetch_add(1); y < rows; y = next.fetch_add(1)) {
+            row(y);
+        }
+    };
+    pool.start(job);
+    pool.wait();
+}
+
+float luminance(float r, float g, float b) {
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// Below this an albedo channel stops dividing the color, so black surfaces
+// keep their (black) color instead of amplifying noise
+constexpr float min_albedo = 1e-3f;
+
+}  // namespace
+
+void FeatureBuffers::allocate(int w, int h) {
+    width = w;
+    height = h;
+    size_t pixels = static_cast<size_t>(w) * h;
+    albedo.assign(3 * pixels, 0.0f);
+    normal.assign(3 * pixels, 0.0f);
+    depth.assign(pixels, 0.0f);
+    variance.assign(pixels, 0.0f);
+}
+
+void FeatureBuffers::resolve(const PixelEstimate* estimates) {
+    size_t pixels = static_cast<size_t>(width) * height;
+    std::vector<char> measured(pixels);
+    for (size_t i = 0; i < pixels; ++i) {
+        const PixelEstimate& estimate = estimates[i];
+        float scale = estimate.samples ? 1.0f / estimate.samples : 0.0f;
+        for (int c = 0; c < 3; ++c) {
+            albedo[3 * i + c] *= scale;
+        }
+        depth[i] *= scale;
+
+        float* n = &normal[3 * i];
+        float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0f) {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        }
+
+        measured[i] = estimate.samples >= 2;
+        if (measured[i]) {
+            variance[i] = estimate.m2 / (estimate.samples - 1) / estimate.samples;
+        }
+    }
+
+    // Spread of the 3x3 neighbourhood's means stands in for a single sample's
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            size_t i = static_cast<size_t>(y) * width + x;
+            if (measured[i]) {
+                continue;
+            }
+            float sum = 0.0f;
+            float sum_squares = 0.0f;
+            int count = 0;
+            for (int ny = std::max(0, y - 1); ny <= std::min(height - 1, y + 1); ++ny) {
+                for (int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); ++nx) {
+                    float mean = estimates[static_cast<size_t>(ny) * width + nx].mean;
+                    sum += mean;
+                    sum_squares += mean * mean;
+                    ++count;
+                }
+            }
+            float mean = sum / count;
+            variance[i] = count > 1 ? std::max(0.0f, (sum_squares - count * mean * mean) / (count - 1))
+                                    : 0.0f;
+        }
+    }
+}
+
+void FeatureBuffers::write(const std::string& prefix) const {
+    auto write_plane = [&](const char* name, const std::function<void(size_t, float*)>& pixel) {
+        std::string filename = prefix + "_" + name + ".pfm";
+        ImageEncoder encoder(width, height, image_format_for(filename));
+        encoder.encode_remaining(
+            [&](int y, float* row) {
+                for (int x = 0; x < width; ++x) {
+                    pixel(static_cast<size_t>(y) * width + x, row + 3 * x);
+                }
+            },
+            1);
+        encoder.write(filename);
+    };
+    auto vector_plane = [](const std::vector<float>& plane) {
+        return [&plane](size_t i, float* out) { std::copy_n(&plane[3 * i], 3, out); };
+    };
+    auto scalar_plane = [](const std::vector<float>& plane) {
+        return [&plane](size_t i, float* out) { std::fill_n(out, 3, plane[i]); };
+    };
+    write_plane("albedo", vector_plane(albedo));
+    write_plane("normal", vector_plane(normal));
+    write_plane("depth", scalar_plane(depth));
+    write_plane("variance", scalar_plane(variance));
+    std::cout << "Wrote feature buffers to " << prefix << "_{albedo,normal,depth,variance}.pfm\n";
+}
+
+std::vector<float> denoise(const std::vector<float>& color, const FeatureBuffers& features,
+                           const DenoiseOptions& options, WorkerPool& pool) {
+    const int width = features.width;
+    const int height = features.height;
+    const ptrdiff_t stride = width + 2 * denoise_padding;
+    const size_t plane_size = static_cast<size_t>(stride) * (height + 2 * denoise_padding);
+    auto at = [&](int x, int y) { return (y + denoise_padding) * stride + x + denoise_padding; };
+
+    // Color and variance alternate between two sets of planes, one read and
+    // one written by each pass
+    auto plane = [&]() { return std::vector<float>(plane_size, 0.0f); };
+    std::vector<float> red[2] = {plane(), plane()};
+    std::vector<float> green[2] = {plane(), plane()};
+    std::vector<float> blue[2] = {plane(), plane()};
+    std::vector<float> variance[2] = {plane(), plane()};
+    std::vector<float> normal_x = plane(), normal_y = plane(), normal_z = plane();
+    std::vector<float> depth = plane(), valid = plane(), gradient = plane();
+    std::vector<float> luminance_scale = plane(), depth_scale = plane();
+
+    parallel_rows(pool, height, [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            size_t i = static_cast<size_t>(y) * width + x;
+            ptrdiff_t p = at(x, y);
+            const float* a = &features.albedo[3 * i];
+            float ar = std::max(a[0], min_albedo);
+            float ag = std::max(a[1], min_albedo);
+            float ab = std::max(a[2], min_albedo);
+            red[0][p] = color[3 * i] / ar;
+            green[0][p] = color[3 * i + 1] / ag;
+            blue[0][p] = color[3 * i + 2] / ab;
+            float albedo_luminance = std::max(luminance(ar, ag, ab), min_albedo);
+            variance[0][p] = features.variance[i] / (albedo_luminance * albedo_luminance);
+            normal_x[p] = features.normal[3 * i];
+            normal_y[p] = features.normal[3 * i + 1];
+            normal_z[p] = features.normal[3 * i + 2];
+            depth[p] = features.depth[i];
+            valid[p] = 1.0f;
+        }
+    });
+    parallel_rows(pool, height, [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            auto depth_at = [&](int px, int py) {
+                return features.depth[static_cast<size_t>(std::clamp(py, 0, height - 1)) * width +
+                                      std::clamp(px, 0, width - 1)];
+            };
+            gradient[at(x, y)] = 0.5f * (std::fabs(depth_at(x + 1, y) - depth_at(x - 1, y)) +
+                                         std::fabs(depth_at(x, y + 1) - depth_at(x, y - 1)));
+        }
+    });
+
+    AtrousRowFn filter_row = select_atrous_row();
+    int current = 0;
+    for (int iteration = 0; iteration < options.iterations; ++iteration) {
+        int step = std::min(1 << std::min(iteration, 30), denoise_max_step);
+        const std::vector<float>& noise = variance[current];
+
+        // Edge-stopping scales from the noise left after the previous pass,
+        // its variance blurred 3x3 so single outliers do not stop the filter
+        parallel_rows(pool, height, [&](int y) {
+            static const float blur[3] = {0.25f, 0.5f, 0.25f};
+            for (int x = 0; x < width; ++x) {
+                ptrdiff_t p = at(x, y);
+                float sum = 0.0f;
+                float weight = 0.0f;
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        ptrdiff_t q = p + dy * stride + dx;
+                        float w = blur[dx + 1] * blur[dy + 1] * valid[q];
+                        sum += w * noise[q];
+                        weight += w;
+                    }
+                }
+                float deviation = std::sqrt(std::max(0.0f, sum / weight));
+                luminance_scale[p] = 1.0f / (options.sigma_luminance * deviation + 1e-4f);
+                depth_scale[p] = 1.0f / (options.sigma_depth * gradient[p] * step + 1e-4f);
+            }
+        });
+
+        int next = 1 - current;
+        DenoisePlanes planes = {stride,
+                                red[current].data(),
+                                green[current].data(),
+                                blue[current].data(),
+                                variance[current].data(),
+                                normal_x.data(),
+                                normal_y.data(),
+                                normal_z.data(),
+                                depth.data(),
+                                valid.data(),
+                                luminance_scale.data(),
+                                depth_scale.data(),
+                                red[next].data(),
+                                green[next].data(),
+                                blue[next].data(),
+                                variance[next].data()};
+        parallel_rows(pool, height, [&](int y) { filter_row(planes, y, width, step); });
+        current = next;
+    }
+
+    std::vector<float> result(color.size());
+    parallel_rows(pool, height, [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            size_t i = static_cast<size_t>(y) * width + x;
+            ptrdiff_t p = at(x, y);
+            const float* a = &features.albedo[3 * i];
+            result[3 * i] = red[current][p] * std::max(a[0], min_albedo);
+            result[3 * i + 1] = green[current][p] * std::max(a[1], min_albedo);
+            result[3 * i + 2] = blue[current][p] * std::max(a[2], min_albedo);
+        }
+    });
+    return result;
+}
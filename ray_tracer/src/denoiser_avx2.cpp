@@ -0,0 +1,30 @@
+// Compiled with -mavx2 -mfma; only reached after a runtime CPU check
+#include "denoise_kernels.h"
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Float {
+    using reg = __m256;
+    static constexpr int lanes = 8;
+
+    static reg set1(float v) { return _mm256_set1_ps(v); }
+    static reg loadu(const float* p) { return _mm256_loadu_ps(p); }
+    static void storeu(float* p, reg a) { _mm256_storeu_ps(p, a); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+    static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static reg abs(reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+};
+
+void atrous_row_avx2(const DenoisePlanes& planes, int y, int width, int step) {
+    atrous_row<Avx2Float>(planes, y, width, step);
+}
+
+}  // namespace
+
+AtrousRowFn avx2_atrous_row() {
+    return atrous_row_avx2;
+}
@@ -0,0 +1,865 @@
+#include "distributed.h"
+#include "accelerator.h"
+#include "image_encoder.h"
+#include "image_texture.h"
+#include "mesh.h"
+#include "ray_tracer.h"
+#include "scene.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr char protocol_magic[8] = {'R', 'T', 'D', 'I', 'S', 'T', '0', '1'};
+constexpr uint32_t protocol_version = 3;
+
+// Every message is a header followed by size bytes of payload
+enum class MessageType : uint32_t {
+    HELLO = 1,  // Worker -> coordinator: Hello
+    SCENE,      // Coordinator -> worker: settings and scene, see write_job
+    TILE,       // Coordinator -> worker: x0, y0, x1, y1 as int32
+    RESULT,     // Worker -> coordinator: averaged RGB floats of the tile, row by row
+    ERROR,      // Either way: message text, then the sender hangs up
+    DONE        // Coordinator -> worker: no more tiles
+};
+
+struct MessageHeader {
+    uint32_t type;
+    uint32_t tile;  // Index of the tile a TILE or RESULT is about
+    uint64_t size;
+};
+
+struct Hello {
+    char magic[8];
+    uint32_t version;
+    uint32_t threads;
+    uint32_t real_size;  // Workers of another intersection precision would render other pixels
+    uint32_t pad;
+};
+
+/**
+ * MessageWriter - Appends raw values to a message payload
+ */
+class MessageWriter {
+public:
+    template <typename T>
+    void put(const T& value) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        data_.insert(data_.end(), bytes, bytes + sizeof(T));
+    }
+
+    void put_vector(const Vector3& v) {
+        put(v.x);
+        put(v.y);
+        put(v.z);
+    }
+
+    template <typename T>
+    void put_array(const std::vector<T>& values) {
+        put<uint64_t>(values.size());
+        const char* bytes = reinterpret_cast<const char*>(values.data());
+        data_.insert(data_.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    const std::string& data() const { return data_; }
+
+private:
+    std::string data_;
+};
+
+/**
+ * MessageReader - Reads values back in the order a MessageWriter put them
+ */
+class MessageReader {
+public:
+    MessageReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    void get_bytes(void* out, size_t size) { std::memcpy(out, take(size), size); }
+
+    Vector3 get_vector() {
+        double x = get<double>();
+        double y = get<double>();
+        double z = get<double>();
+        return Vector3(x, y, z);
+    }
+
+    template <typename T>
+    std::vector<T> get_array() {
+        uint64_t count = get<uint64_t>();
+        if (count > (size_ - offset_) / sizeof(T)) {
+            throw std::runtime_error("Truncated scene message");
+        }
+        std::vector<T> values(count);
+        std::memcpy(values.data(), take(count * sizeof(T)), count * sizeof(T));
+        return values;
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t offset_ = 0;
+
+    const char* take(size_t bytes) {
+        if (bytes > size_ - offset_) {
+            throw std::runtime_error("Truncated scene message");
+        }
+        const char* at = data_ + offset_;
+        offset_ += bytes;
+        return at;
+    }
+};
+
+// Settings, then the scene's tables in index order so they intern to the
+// same indices on the other side
+std::string write_job(const Scene& scene, const DistributedSettings& settings) {
+    MessageWriter out;
+    out.put<int32_t>(settings.width);
+    out.put<int32_t>(settings.height);
+    out.put<int32_t>(settings.samples_per_pixel);
+    out.put<int32_t>(settings.max_depth);
+    out.put<uint32_t>(static_cast<uint32_t>(settings.sampler));
+    out.put<uint64_t>(settings.seed);
+    out.put<double>(settings.noise_threshold);
+    out.put<int32_t>(settings.min_samples);
+    out.put<int32_t>(settings.pass_samples);
+    out.put<int32_t>(settings.shadow_probe_samples);
+    out.put<int32_t>(settings.shadow_max_samples);
+    out.put<int32_t>(settings.light_samples);
+
+    const Camera& camera = scene.get_camera();
+    out.put_vector(camera.position);
+    out.put_vector(camera.look_at);
+    out.put_vector(camera.up);
+    out.put<double>(camera.fov);
+    out.put_vector(scene.get_background_color());
+
+    out.put<uint64_t>(scene.get_textures().size());
+    for (const auto& texture : scene.get_textures()) {
+        out.put<uint32_t>(static_cast<uint32_t>(texture.type()));
+        out.put_vector(texture.color1());
+        out.put_vector(texture.color2());
+        if (texture.type() == Texture::Type::IMAGE) {
+            const std::string& path = texture.image()->path();
+            out.put_array(std::vector<char>(path.begin(), path.end()));
+        }
+    }
+    out.put<uint64_t>(scene.get_materials().size());
+    for (const auto& material : scene.get_materials()) {
+        out.put_vector(material.color);
+        out.put<double>(material.ambient);
+        out.put<double>(material.diffuse);
+        out.put<double>(material.specular);
+        out.put<double>(material.shininess);
+        out.put<double>(material.reflection);
+        out.put<uint32_t>(material.texture);
+    }
+    out.put<uint64_t>(scene.get_spheres().size());
+    for (const auto& sphere : scene.get_spheres()) {
+        out.put_vector(sphere.center);
+        out.put<double>(sphere.radius);
+        out.put<uint32_t>(sphere.material);
+    }
+    out.put<uint64_t>(scene.get_lights().size());
+    for (const auto& light : scene.get_lights()) {
+        out.put_vector(light.position);
+        out.put_vector(light.intensity);
+        out.put<double>(light.radius);
+    }
+    out.put<uint64_t>(scene.get_meshes().size());
+    for (const auto& mesh : scene.get_meshes()) {
+        out.put_array(mesh->positions());
+        out.put_array(mesh->indices());
+    }
+    // Instances go as stored: rebuilding from object_to_world() could round
+    // their float transforms differently
+    out.put<uint64_t>(scene.get_instances().size());
+    for (const auto& instance : scene.get_instances()) {
+        out.put(instance);
+    }
+    return out.data();
+}
+
+void read_job(const char* data, size_t size, Scene& scene, DistributedSettings& settings) {
+    MessageReader in(data, size);
+    settings.width = in.get<int32_t>();
+    settings.height = in.get<int32_t>();
+    settings.samples_per_pixel = in.get<int32_t>();
+    settings.max_depth = in.get<int32_t>();
+    settings.sampler = static_cast<SamplerType>(in.get<uint32_t>());
+    settings.seed = in.get<uint64_t>();
+    settings.noise_threshold = in.get<double>();
+    settings.min_samples = in.get<int32_t>();
+    settings.pass_samples = in.get<int32_t>();
+    settings.shadow_probe_samples = in.get<int32_t>();
+    settings.shadow_max_samples = in.get<int32_t>();
+    settings.light_samples = in.get<int32_t>();
+
+    Camera camera;
+    camera.position = in.get_vector();
+    camera.look_at = in.get_vector();
+    camera.up = in.get_vector();
+    camera.fov = in.get<double>();
+    scene.set_camera(camera);
+    scene.set_background_color(in.get_vector());
+
+    auto check_index = [](uint32_t index, uint64_t expected) {
+        if (index != expected) {
+            throw std::runtime_error("Scene message repeats a texture or material");
+        }
+    };
+    // References are checked against the tables received so far, as the
+    // scene cache does, so a mismatched coordinator cannot index past them
+    auto check_reference = [](uint64_t index, uint64_t count, const char* what) {
+        if (index >= count) {
+            throw std::runtime_error(std::string("Scene message refers to a missing ") + what);
+        }
+    };
+    uint64_t textures = in.get<uint64_t>();
+    for (uint64_t i = 0; i < textures; ++i) {
+        uint32_t type_value = in.get<uint32_t>();
+        if (type_value > static_cast<uint32_t>(Texture::Type::IMAGE)) {
+            throw std::runtime_error("Scene message has an unknown texture type");
+        }
+        auto type = static_cast<Texture::Type>(type_value);
+        Vector3 color1 = in.get_vector();
+        Vector3 color2 = in.get_vector();
+        if (type == Texture::Type::IMAGE) {
+            std::vector<char> path = in.get_array<char>();
+            auto image = ImageTexture::open(std::string(path.begin(), path.end()));
+            check_index(scene.add_texture(Texture(image)), i);
+        } else {
+            check_index(scene.add_texture(Texture(type, color1, color2)), i);
+        }
+    }
+    uint64_t materials = in.get<uint64_t>();
+    for (uint64_t i = 0; i < materials; ++i) {
+        Material material(in.get_vector());
+        material.ambient = in.get<double>();
+        material.diffuse = in.get<double>();
+        material.specular = in.get<double>();
+        material.shininess = in.get<double>();
+        material.reflection = in.get<double>();
+        material.texture = in.get<uint32_t>();
+        if (material.texture != Material::no_texture) {
+            check_reference(material.texture, textures, "texture");
+        }
+        check_index(scene.add_material(material), i);
+    }
+    uint64_t spheres = in.get<uint64_t>();
+    scene.reserve_spheres(spheres);
+    for (uint64_t i = 0; i < spheres; ++i) {
+        Vector3 center = in.get_vector();
+        double radius = in.get<double>();
+        uint32_t material = in.get<uint32_t>();
+        check_reference(material, materials, "material");
+        scene.add_sphere(Sphere(center, radius, material));
+    }
+    uint64_t lights = in.get<uint64_t>();
+    for (uint64_t i = 0; i < lights; ++i) {
+        Vector3 position = in.get_vector();
+        Vector3 intensity = in.get_vector();
+        scene.add_light(Light(position, intensity, in.get<double>()));
+    }
+    uint64_t meshes = in.get<uint64_t>();
+    for (uint64_t i = 0; i < meshes; ++i) {
+        std::vector<float> positions = in.get_array<float>();
+        std::vector<uint32_t> indices = in.get_array<uint32_t>();
+        scene.add_mesh(std::make_shared<TriangleMesh>(std::move(positions), std::move(indices)));
+    }
+    uint64_t instances = in.get<uint64_t>();
+    for (uint64_t i = 0; i < instances; ++i) {
+        MeshInstance instance(0, 0, Transform());
+        in.get_bytes(&instance, sizeof(instance));
+        check_reference(instance.mesh, meshes, "mesh");
+        check_reference(instance.material, materials, "material");
+        scene.add_instance(instance);
+    }
+}
+
+void send_all(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t sent = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            throw std::runtime_error(std::string("Connection lost: ") + std::strerror(errno));
+        }
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+}
+
+void send_message(int fd, MessageType type, uint32_t tile, const void* payload, size_t size) {
+    MessageHeader header = {static_cast<uint32_t>(type), tile, size};
+    send_all(fd, &header, sizeof(header));
+    send_all(fd, payload, size);
+}
+
+// False on a clean hang-up before the first byte
+bool receive_all(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    size_t received = 0;
+    while (received < size) {
+        ssize_t got = ::recv(fd, bytes + received, size - received, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got == 0 && received == 0) {
+            return false;
+        }
+        if (got <= 0) {
+            throw std::runtime_error("Connection to coordinator lost");
+        }
+        received += static_cast<size_t>(got);
+    }
+    return true;
+}
+
+// Whether a DONE is among the messages already received on fd, read
+// without blocking
+bool done_received(int fd) {
+    std::vector<char> pending;
+    char buffer[4096];
+    ssize_t got;
+    while ((got = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        pending.insert(pending.end(), buffer, buffer + got);
+    }
+    size_t offset = 0;
+    while (offset + sizeof(MessageHeader) <= pending.size()) {
+        MessageHeader header;
+        std::memcpy(&header, pending.data() + offset, sizeof(header));
+        if (static_cast<MessageType>(header.type) == MessageType::DONE) {
+            return true;
+        }
+        offset += sizeof(header) + header.size;
+    }
+    return false;
+}
+
+void configure_socket(int fd, double send_timeout_seconds) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (send_timeout_seconds > 0.0) {
+        timeval timeout;
+        timeout.tv_sec = static_cast<time_t>(send_timeout_seconds);
+        timeout.tv_usec = static_cast<suseconds_t>((send_timeout_seconds - timeout.tv_sec) * 1e6);
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    }
+}
+
+/**
+ * SocketGuard - Closes a connected socket however its owner exits
+ */
+class SocketGuard {
+public:
+    explicit SocketGuard(int fd) : fd_(fd) {}
+    ~SocketGuard() { ::close(fd_); }
+
+    SocketGuard(const SocketGuard&) = delete;
+    SocketGuard& operator=(const SocketGuard&) = delete;
+
+private:
+    int fd_;
+};
+
+size_t tile_floats(const Tile& tile) {
+    return 3 * static_cast<size_t>(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+}
+
+}  // namespace
+
+TileCoordinator::TileCoordinator(const Options& options) : options_(options) {
+    if (options_.tile_size <= 0 || options_.tiles_in_flight <= 0) {
+        throw std::runtime_error("Tile size and tiles in flight must be positive");
+    }
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error(std::string("Failed to create socket: ") + std::strerror(errno));
+    }
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(options_.port));
+    socklen_t length = sizeof(address);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        ::listen(listen_fd_, 64) < 0 ||
+        ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length) < 0) {
+        std::string error = std::strerror(errno);
+        ::close(listen_fd_);
+        throw std::runtime_error("Failed to listen on port " + std::to_string(options_.port) +
+                                 ": " + error);
+    }
+    port_ = ntohs(address.sin_port);
+}
+
+TileCoordinator::~TileCoordinator() {
+    ::close(listen_fd_);
+}
+
+void TileCoordinator::render(const Scene& scene, const DistributedSettings& settings,
+                             const std::string& output_file) {
+    const std::string job = write_job(scene, settings);
+    TileScheduler::Options tile_options;
+    tile_options.tile_size = options_.tile_size;
+    tile_options.order = options_.order;
+    const std::vector<Tile> tiles =
+        TileScheduler(settings.width, settings.height, tile_options).tiles();
+
+    struct Worker {
+        int fd;
+        std::string name;
+        bool ready = false;  // Has said hello and been sent the scene
+        std::vector<char> inbox;
+        std::deque<size_t> assigned;   // Tiles in the order sent, which is the order rendered
+        Clock::time_point busy_since;  // Since the last result, while tiles are out
+        size_t tiles_done = 0;
+
+        ~Worker() {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    };
+
+    std::vector<float> image(3 * static_cast<size_t>(settings.width) * settings.height);
+    std::vector<char> done(tiles.size(), 0);
+    std::vector<int> holders(tiles.size(), 0);  // Workers the tile is out with
+    std::deque<size_t> queue;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        queue.push_back(i);
+    }
+    size_t tiles_done = 0;
+    size_t requeued = 0;
+    size_t copies_sent = 0;
+    size_t workers_lost = 0;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // Events go on their own line below the progress line
+    bool progress_shown = false;
+    auto log = [&](const std::string& message) {
+        if (progress_shown) {
+            std::cerr << "\n";
+            progress_shown = false;
+        }
+        if (!message.empty()) {
+            std::cerr << message << "\n";
+        }
+    };
+
+    // Nothing a worker sends is larger than a full tile's result
+    size_t max_message =
+        std::max<size_t>(3 * sizeof(float) * options_.tile_size * options_.tile_size, 4096);
+
+    auto drop = [&](Worker& worker, const std::string& reason) {
+        // Newest first, so the queue keeps the original order at its front
+        size_t returned = 0;
+        for (auto it = worker.assigned.rbegin(); it != worker.assigned.rend(); ++it) {
+            if (--holders[*it] == 0 && !done[*it]) {
+                queue.push_front(*it);
+                ++returned;
+            }
+        }
+        requeued += returned;
+        if (worker.ready) {
+            ++workers_lost;
+        }
+        log("Worker " + worker.name + " dropped (" + reason + "), " + std::to_string(returned) +
+            " tiles requeued");
+        worker.assigned.clear();
+        ::close(worker.fd);
+        worker.fd = -1;
+    };
+
+    auto send_tile = [&](Worker& worker, size_t index) {
+        const Tile& tile = tiles[index];
+        int32_t rect[4] = {tile.x0, tile.y0, tile.x1, tile.y1};
+        if (worker.assigned.empty()) {
+            worker.busy_since = Clock::now();
+        }
+        worker.assigned.push_back(index);
+        ++holders[index];
+        send_message(worker.fd, MessageType::TILE, static_cast<uint32_t>(index), rect,
+                     sizeof(rect));
+    };
+
+    // A tile for a free slot: the next unassigned one, or for an idle worker
+    // once there are none, a copy of the tile out longest with one other worker
+    auto next_tile = [&](size_t& index) {
+        while (!queue.empty()) {
+            index = queue.front();
+            queue.pop_front();
+            if (!done[index] && holders[index] == 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto copy_tile = [&](const Worker& worker, size_t& index) {
+        bool found = false;
+        Clock::time_point oldest;
+        for (const auto& other : workers) {
+            if (other.get() == &worker || other->fd < 0 || other->assigned.empty()) {
+                continue;
+            }
+            size_t tile = other->assigned.front();
+            if (holders[tile] == 1 && (!found || other->busy_since < oldest)) {
+                index = tile;
+                oldest = other->busy_since;
+                found = true;
+            }
+        }
+        return found;
+    };
+
+    auto handle_message = [&](Worker& worker, const MessageHeader& header, const char* payload) {
+        switch (static_cast<MessageType>(header.type)) {
+            case MessageType::HELLO: {
+                Hello hello;
+                if (worker.ready || header.size != sizeof(hello)) {
+                    drop(worker, "bad hello");
+                    return;
+                }
+                std::memcpy(&hello, payload, sizeof(hello));
+                try {
+                    if (std::memcmp(hello.magic, protocol_magic, sizeof(hello.magic)) != 0 ||
+                        hello.version != protocol_version ||
+                        hello.real_size != sizeof(intersect_real)) {
+                        std::string error = "Coordinator runs another protocol or precision";
+                        send_message(worker.fd, MessageType::ERROR, 0, error.data(), error.size());
+                        drop(worker, "incompatible build");
+                        return;
+                    }
+                    send_message(worker.fd, MessageType::SCENE, 0, job.data(), job.size());
+                } catch (const std::runtime_error& e) {
+                    drop(worker, e.what());
+                    return;
+                }
+                worker.ready = true;
+                log("Worker " + worker.name + " joined with " + std::to_string(hello.threads) +
+                    " threads");
+                return;
+            }
+            case MessageType::RESULT: {
+                auto it = std::find(worker.assigned.begin(), worker.assigned.end(), header.tile);
+                if (it == worker.assigned.end() ||
+                    header.size != tile_floats(tiles[header.tile]) * sizeof(float)) {
+                    drop(worker, "unexpected result");
+                    return;
+                }
+                worker.assigned.erase(it);
+                worker.busy_since = Clock::now();
+                --holders[header.tile];
+                if (done[header.tile]) {
+                    return;  // The other copy came back first
+                }
+                const Tile& tile = tiles[header.tile];
+                size_t row_bytes = 3 * sizeof(float) * (tile.x1 - tile.x0);
+                for (int y = tile.y0; y < tile.y1; ++y) {
+                    std::memcpy(&image[3 * (static_cast<size_t>(y) * settings.width + tile.x0)],
+                                payload + (y - tile.y0) * row_bytes, row_bytes);
+                }
+                done[header.tile] = 1;
+                ++tiles_done;
+                ++worker.tiles_done;
+                return;
+            }
+            case MessageType::ERROR:
+                throw std::runtime_error("Worker " + worker.name + " failed: " +
+                                         std::string(payload, header.size));
+            default:
+                drop(worker, "unexpected message");
+                return;
+        }
+    };
+
+    std::cout << "Coordinating " << tiles.size() << " tiles of " << options_.tile_size << "x"
+              << options_.tile_size << ", waiting for workers on port " << port_ << "\n"
+              << std::flush;  // Scripts starting workers may be waiting for the port
+    auto start = Clock::now();
+    auto last_report = start;
+    auto timeout = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options_.timeout_seconds));
+    std::vector<pollfd> polled;
+    std::vector<char> buffer(1 << 16);
+    while (tiles_done < tiles.size()) {
+        for (auto& worker : workers) {
+            try {
+                while (worker->fd >= 0 && worker->ready &&
+                       worker->assigned.size() < static_cast<size_t>(options_.tiles_in_flight)) {
+                    size_t index = 0;
+                    if (next_tile(index)) {
+                        send_tile(*worker, index);
+                    } else if (worker->assigned.empty() && copy_tile(*worker, index)) {
+                        send_tile(*worker, index);
+                        ++copies_sent;
+                    } else {
+                        break;
+                    }
+                }
+            } catch (const std::runtime_error& e) {
+                drop(*worker, e.what());
+            }
+        }
+
+        polled.clear();
+        polled.push_back({listen_fd_, POLLIN, 0});
+        for (const auto& worker : workers) {
+            polled.push_back({worker->fd, POLLIN, 0});
+        }
+        if (::poll(polled.data(), polled.size(), 250) < 0 && errno != EINTR) {
+            throw std::runtime_error(std::string("poll failed: ") + std::strerror(errno));
+        }
+
+        // Polled workers keep their positions; new ones are appended after them
+        for (size_t i = 1; i < polled.size(); ++i) {
+            Worker& worker = *workers[i - 1];
+            if (worker.fd < 0 || !(polled[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            ssize_t got = ::recv(worker.fd, buffer.data(), buffer.size(), 0);
+            if (got <= 0) {
+                drop(worker, got == 0 ? "disconnected" : std::strerror(errno));
+                continue;
+            }
+            worker.inbox.insert(worker.inbox.end(), buffer.data(), buffer.data() + got);
+
+            size_t offset = 0;
+            while (worker.fd >= 0 && worker.inbox.size() - offset >= sizeof(MessageHeader)) {
+                MessageHeader header;
+                std::memcpy(&header, worker.inbox.data() + offset, sizeof(header));
+                if (header.size > max_message) {
+                    drop(worker, "oversized message");
+                    break;
+                }
+                if (worker.inbox.size() - offset - sizeof(header) < header.size) {
+                    break;
+                }
+                handle_message(worker, header, worker.inbox.data() + offset + sizeof(header));
+                offset += sizeof(header) + header.size;
+            }
+            worker.inbox.erase(worker.inbox.begin(),
+                               worker.inbox.begin() + std::min(offset, worker.inbox.size()));
+        }
+
+        if (polled[0].revents & POLLIN) {
+            sockaddr_in peer;
+            socklen_t length = sizeof(peer);
+            int fd = ::accept(listen_fd_, reinterpret_cast<sockaddr*>(&peer), &length);
+            if (fd >= 0) {
+                configure_socket(fd, options_.timeout_seconds);
+                char host[INET_ADDRSTRLEN] = "?";
+                inet_ntop(AF_INET, &peer.sin_addr, host, sizeof(host));
+                auto worker = std::make_unique<Worker>();
+                worker->fd = fd;
+                worker->name = std::string(host) + ":" + std::to_string(ntohs(peer.sin_port));
+                worker->busy_since = Clock::now();
+                workers.push_back(std::move(worker));
+            }
+        }
+
+        // A worker silent too long with tiles out, or that never says hello, is lost
+        auto now = Clock::now();
+        for (auto& worker : workers) {
+            if (worker->fd >= 0 && (!worker->assigned.empty() || !worker->ready) &&
+                now - worker->busy_since > timeout) {
+                drop(*worker, "timed out");
+            }
+        }
+        workers.erase(std::remove_if(workers.begin(), workers.end(),
+                                     [](const std::unique_ptr<Worker>& w) { return w->fd < 0; }),
+                      workers.end());
+
+        if (options_.progress && now - last_report >= std::chrono::seconds(1)) {
+            std::cerr << "\rProgress: " << tiles_done << "/" << tiles.size() << " tiles ("
+                      << 100 * tiles_done / tiles.size() << "%), " << workers.size()
+                      << " workers   ";
+            progress_shown = true;
+            last_report = now;
+        }
+    }
+
+    for (auto& worker : workers) {
+        try {
+            send_message(worker->fd, MessageType::DONE, 0, nullptr, 0);
+        } catch (const std::runtime_error&) {
+            // Done anyway; it exits when the connection closes
+        }
+    }
+    log("");
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "Distributed render: " << tiles.size() << " tiles in " << seconds << " s, "
+              << copies_sent << " copies sent to idle workers, " << requeued
+              << " tiles requeued from " << workers_lost << " lost workers\n";
+    for (const auto& worker : workers) {
+        std::cout << "  " << worker->name << ": " << worker->tiles_done << " tiles\n";
+    }
+    workers.clear();
+
+    std::cout << "Writing image to " << output_file << "\n";
+    ImageEncoder encoder(settings.width, settings.height, image_format_for(output_file));
+    encoder.encode_remaining(
+        [&](int y, float* row) {
+            std::memcpy(row, &image[3 * static_cast<size_t>(y) * settings.width],
+                        3 * sizeof(float) * settings.width);
+        },
+        static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+    encoder.write(output_file);
+}
+
+void run_tile_worker(const std::string& host, int port, int num_threads, double retry_seconds) {
+    std::string address = host + ":" + std::to_string(port);
+    auto give_up = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                      std::chrono::duration<double>(retry_seconds));
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    // The coordinator may still be starting up
+    int fd = -1;
+    while (true) {
+        addrinfo* found = nullptr;
+        int status = ::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found);
+        if (status != 0) {
+            throw std::runtime_error("Failed to resolve " + host + ": " + gai_strerror(status));
+        }
+        for (addrinfo* candidate = found; candidate && fd < 0; candidate = candidate->ai_next) {
+            fd = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+            if (fd >= 0 && ::connect(fd, candidate->ai_addr, candidate->ai_addrlen) < 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        ::freeaddrinfo(found);
+        if (fd >= 0) {
+            break;
+        }
+        if (Clock::now() >= give_up) {
+            throw std::runtime_error("Failed to connect to coordinator at " + address);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    SocketGuard guard(fd);
+    configure_socket(fd, 0.0);
+
+    Hello hello;
+    std::memset(&hello, 0, sizeof(hello));
+    std::memcpy(hello.magic, protocol_magic, sizeof(hello.magic));
+    hello.version = protocol_version;
+    hello.threads = static_cast<uint32_t>(std::max(1, num_threads));
+    hello.real_size = sizeof(intersect_real);
+    send_message(fd, MessageType::HELLO, 0, &hello, sizeof(hello));
+
+    Scene scene;
+    std::unique_ptr<RayTracer> tracer;
+    std::vector<char> payload;
+    std::vector<float> rgb;
+    size_t tiles = 0;
+    auto start = Clock::now();
+    auto report = [&]() {
+        std::cout << "Worker: rendered " << tiles << " tiles in "
+                  << std::chrono::duration<double>(Clock::now() - start).count() << " s\n";
+    };
+    while (true) {
+        MessageHeader header;
+        if (!receive_all(fd, &header, sizeof(header))) {
+            throw std::runtime_error("Coordinator at " + address + " hung up");
+        }
+        payload.resize(header.size);
+        if (header.size > 0 && !receive_all(fd, payload.data(), header.size)) {
+            throw std::runtime_error("Connection to coordinator lost");
+        }
+
+        switch (static_cast<MessageType>(header.type)) {
+            case MessageType::SCENE: {
+                DistributedSettings settings;
+                read_job(payload.data(), payload.size(), scene, settings);
+                tracer = std::make_unique<RayTracer>(settings.width, settings.height,
+                                                     settings.samples_per_pixel);
+                tracer->set_num_threads(num_threads);
+                tracer->set_max_depth(settings.max_depth);
+                tracer->set_sampler(settings.sampler);
+                tracer->set_seed(settings.seed);
+                tracer->set_adaptive_sampling(settings.noise_threshold, settings.min_samples);
+                tracer->set_progressive(settings.pass_samples, 0.0);
+                tracer->set_shadow_samples(settings.shadow_probe_samples,
+                                           settings.shadow_max_samples);
+                tracer->set_light_samples(settings.light_samples);
+                std::cout << "Worker: " << settings.width << "x" << settings.height << " at "
+                          << settings.samples_per_pixel << " samples, "
+                          << scene.get_spheres().size() << " spheres and "
+                          << scene.get_instances().size() << " instances from " << address
+                          << "\n";
+                break;
+            }
+            case MessageType::TILE: {
+                int32_t rect[4];
+                if (!tracer || header.size != sizeof(rect)) {
+                    throw std::runtime_error("Unexpected tile message from coordinator");
+                }
+                std::memcpy(rect, payload.data(), sizeof(rect));
+                try {
+                    tracer->render_region(scene, {rect[0], rect[1], rect[2], rect[3], 0}, rgb);
+                } catch (const std::exception& e) {
+                    // Deterministic, so any other worker would fail the same way
+                    std::string error = e.what();
+                    send_message(fd, MessageType::ERROR, header.tile, error.data(), error.size());
+                    throw;
+                }
+                try {
+                    send_message(fd, MessageType::RESULT, header.tile, rgb.data(),
+                                 rgb.size() * sizeof(float));
+                } catch (const std::runtime_error&) {
+                    // The coordinator does not wait for copies of tiles that
+                    // came back from elsewhere; its DONE is already here
+                    if (!done_received(fd)) {
+                        throw;
+                    }
+                    report();
+                    return;
+                }
+                ++tiles;
+                break;
+            }
+            case MessageType::ERROR:
+                throw std::runtime_error("Coordinator refused this worker: " +
+                                         std::string(payload.begin(), payload.end()));
+            case MessageType::DONE:
+                report();
+                return;
+            default:
+                throw std::runtime_error("Unexpected message from coordinator");
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#include "framebuffer.h"
+#include "image_encoder.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+Framebuffer::Framebuffer(int width, int height, const std::string& scratch_file)
+    : width_(width), height_(height) {
+    pixels_.allocate(static_cast<size_t>(width) * height * 3, scratch_file);
+}
+
+size_t Framebuffer::bytes() const {
+    return pixels_.size() * sizeof(float);
+}
+
+void Framebuffer::set_pixel(int x, int y, const Vector3& color) {
+    if (x < 0 || x >= width_ || y < 0 || y >= height_) {
+        return;
+    }
+    size_t i = (static_cast<size_t>(y) * width_ + x) * 3;
+    pixels_[i] = static_cast<float>(color.x);
+    pixels_[i + 1] = static_cast<float>(color.y);
+    pixels_[i + 2] = static_cast<float>(color.z);
+}
+
+Vector3 Framebuffer::get_pixel(int x, int y) const {
+    size_t i = (static_cast<size_t>(y) * width_ + x) * 3;
+    return Vector3(pixels_[i], pixels_[i + 1], pixels_[i + 2]);
+}
+
+void Framebuffer::read_row(int y, float* rgb) const {
+    size_t first = static_cast<size_t>(y) * width_ * 3;
+    size_t count = static_cast<size_t>(width_) * 3;
+    std::memcpy(rgb, pixels_.data() + first, count * sizeof(float));
+}
+
+void Framebuffer::write(const std::string& filename) const {
+    ImageEncoder encoder(width_, height_, image_format_for(filename));
+    encoder.encode_remaining([this](int y, float* row) { read_row(y, row); },
+                             static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+    encoder.write(filename);
+}
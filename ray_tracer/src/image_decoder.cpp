@@ -0,0 +1,231 @@
+#include "image_decoder.h"
+#include "image_encoder.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace {
+
+std::string read_file(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open image: " + filename);
+    }
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+uint32_t read_be32(const std::string& data, size_t at) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.data() + at);
+    return static_cast<uint32_t>(bytes[0]) << 24 | static_cast<uint32_t>(bytes[1]) << 16 |
+           static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+}
+
+DecodedImage decode_ppm(const std::string& data, const std::string& filename) {
+    size_t at = 0;
+    auto fail = [&]() -> void { throw std::runtime_error("Not a binary PPM (P6): " + filename); };
+
+    // Header fields are separated by whitespace and may be followed by comments
+    auto field = [&]() {
+        while (at < data.size()) {
+            if (data[at] == '#') {
+                while (at < data.size() && data[at] != '\n') {
+                    ++at;
+                }
+            } else if (std::isspace(static_cast<unsigned char>(data[at]))) {
+                ++at;
+            } else {
+                break;
+            }
+        }
+        size_t start = at;
+        while (at < data.size() && !std::isspace(static_cast<unsigned char>(data[at]))) {
+            ++at;
+        }
+        return data.substr(start, at - start);
+    };
+    auto number = [&]() {
+        std::string text = field();
+        char* end = nullptr;
+        long value = std::strtol(text.c_str(), &end, 10);
+        if (text.empty() || *end != '\0' || value <= 0) {
+            fail();
+        }
+        return value;
+    };
+
+    if (field() != "P6") {
+        fail();
+    }
+    long width = number();
+    long height = number();
+    long max_value = number();
+    if (width > 1 << 20 || height > 1 << 20 || max_value > 65535) {
+        fail();
+    }
+    ++at;  // The single whitespace byte ending the header
+
+    DecodedImage image;
+    image.width = static_cast<int>(width);
+    image.height = static_cast<int>(height);
+    size_t samples = static_cast<size_t>(width) * height * 3;
+    size_t sample_bytes = max_value > 255 ? 2 : 1;
+    if (at > data.size() || data.size() - at < samples * sample_bytes) {
+        throw std::runtime_error("Truncated PPM: " + filename);
+    }
+    image.rgb.resize(samples);
+    const auto* in = reinterpret_cast<const uint8_t*>(data.data() + at);
+    for (size_t i = 0; i < samples; ++i) {
+        long value = sample_bytes == 2 ? (in[2 * i] << 8 | in[2 * i + 1]) : in[i];
+        image.rgb[i] = static_cast<uint8_t>((value * 255 + max_value / 2) / max_value);
+    }
+    return image;
+}
+
+// Undo one row's PNG filter in place; prev is the unfiltered row above or null
+void unfilter_row(int filter, uint8_t* row, const uint8_t* prev, size_t length, size_t bpp,
+                  const std::string& filename) {
+    for (size_t i = 0; i < length; ++i) {
+        int left = i >= bpp ? row[i - bpp] : 0;
+        int up = prev ? prev[i] : 0;
+        int up_left = (prev && i >= bpp) ? prev[i - bpp] : 0;
+        int predicted = 0;
+        switch (filter) {
+            case 0: break;
+            case 1: predicted = left; break;
+            case 2: predicted = up; break;
+            case 3: predicted = (left + up) / 2; break;
+            case 4: {
+                int p = left + up - up_left;
+                int pa = std::abs(p - left), pb = std::abs(p - up), pc = std::abs(p - up_left);
+                predicted = (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : up_left);
+                break;
+            }
+            default:
+                throw std::runtime_error("Damaged PNG (bad filter type): " + filename);
+        }
+        row[i] = static_cast<uint8_t>(row[i] + predicted);
+    }
+}
+
+DecodedImage decode_png(const std::string& data, const std::string& filename) {
+    if (data.size() < 8 || data.compare(0, 8, "\x89PNG\r\n\x1a\n") != 0) {
+        throw std::runtime_error("Not a PNG file: " + filename);
+    }
+
+    uint32_t width = 0, height = 0;
+    int bit_depth = 0, color_type = -1;
+    std::string palette;
+    std::string compressed;
+    for (size_t at = 8; at + 12 <= data.size();) {
+        uint32_t length = read_be32(data, at);
+        if (length > data.size() - at - 12) {
+            throw std::runtime_error("Truncated PNG: " + filename);
+        }
+        std::string type = data.substr(at + 4, 4);
+        size_t body = at + 8;
+        if (type == "IHDR" && length >= 13) {
+            width = read_be32(data, body);
+            height = read_be32(data, body + 4);
+            bit_depth = static_cast<uint8_t>(data[body + 8]);
+            color_type = static_cast<uint8_t>(data[body + 9]);
+            if (data[body + 12] != 0) {
+                throw std::runtime_error("Interlaced PNGs are not supported: " + filename);
+            }
+        } else if (type == "PLTE") {
+            palette = data.substr(body, length);
+        } else if (type == "IDAT") {
+            compressed.append(data, body, length);
+        } else if (type == "IEND") {
+            break;
+        }
+        at = body + length + 4;  // Skip the CRC
+    }
+
+    int channels = 0;
+    switch (color_type) {
+        case 0: channels = 1; break;  // Gray
+        case 2: channels = 3; break;  // RGB
+        case 3: channels = 1; break;  // Palette indices
+        case 4: channels = 2; break;  // Gray + alpha
+        case 6: channels = 4; break;  // RGBA
+        default: throw std::runtime_error("Damaged PNG (no valid IHDR): " + filename);
+    }
+    bool sub_byte_allowed = color_type == 0 || color_type == 3;
+    if (!(bit_depth == 8 || (bit_depth == 16 && color_type != 3) ||
+          (sub_byte_allowed && (bit_depth == 1 || bit_depth == 2 || bit_depth == 4))) ||
+        width == 0 || height == 0 || width > 1 << 20 || height > 1 << 20) {
+        throw std::runtime_error("Unsupported PNG layout: " + filename);
+    }
+    if (color_type == 3 && palette.size() < 3) {
+        throw std::runtime_error("Damaged PNG (missing palette): " + filename);
+    }
+
+    size_t bits_per_pixel = static_cast<size_t>(channels) * bit_depth;
+    size_t row_bytes = (width * bits_per_pixel + 7) / 8;
+    size_t bpp = std::max<size_t>(1, bits_per_pixel / 8);
+    std::vector<uint8_t> raw((row_bytes + 1) * height);
+    uLongf raw_size = static_cast<uLongf>(raw.size());
+    if (uncompress(raw.data(), &raw_size, reinterpret_cast<const Bytef*>(compressed.data()),
+                   static_cast<uLong>(compressed.size())) != Z_OK ||
+        raw_size != raw.size()) {
+        throw std::runtime_error("Damaged PNG (bad image data): " + filename);
+    }
+
+    DecodedImage image;
+    image.width = static_cast<int>(width);
+    image.height = static_cast<int>(height);
+    image.rgb.resize(static_cast<size_t>(width) * height * 3);
+    int max_value = (1 << std::min(bit_depth, 8)) - 1;
+    const uint8_t* prev = nullptr;
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t* row = &raw[y * (row_bytes + 1)];
+        unfilter_row(row[0], row + 1, prev, row_bytes, bpp, filename);
+        prev = row + 1;
+
+        // Channel c of pixel x, reduced to 8 bits (not yet scaled for sub-byte depths)
+        auto sample = [&](uint32_t x, int c) -> int {
+            if (bit_depth >= 8) {
+                return prev[(x * channels + c) * (bit_depth / 8)];
+            }
+            size_t bit = static_cast<size_t>(x) * bit_depth;
+            return (prev[bit / 8] >> (8 - bit_depth - bit % 8)) & max_value;
+        };
+        uint8_t* out = &image.rgb[static_cast<size_t>(y) * width * 3];
+        for (uint32_t x = 0; x < width; ++x, out += 3) {
+            if (color_type == 3) {
+                size_t entry = static_cast<size_t>(sample(x, 0)) * 3;
+                if (entry + 3 > palette.size()) {
+                    throw std::runtime_error("Damaged PNG (palette index): " + filename);
+                }
+                std::memcpy(out, palette.data() + entry, 3);
+            } else if (channels >= 3) {
+                out[0] = static_cast<uint8_t>(sample(x, 0));
+                out[1] = static_cast<uint8_t>(sample(x, 1));
+                out[2] = static_cast<uint8_t>(sample(x, 2));
+            } else {
+                out[0] = out[1] = out[2] = static_cast<uint8_t>(sample(x, 0) * 255 / max_value);
+            }
+        }
+    }
+    return image;
+}
+
+}  // namespace
+
+DecodedImage decode_image(const std::string& filename) {
+    ImageFormat format = image_format_for(filename);
+    std::string data = read_file(filename);
+    switch (format) {
+        case ImageFormat::PPM:
+            return decode_ppm(data, filename);
+        case ImageFormat::PNG:
+            return decode_png(data, filename);
+        default:
+            throw std::runtime_error("Textures must be PPM or PNG images: " + filename);
+    }
+}
@@ -0,0 +1,368 @@
+#include "image_encoder.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <zlib.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct ImageEncoder::Strip {
+    std::atomic<bool> encoded{false};
+    std::string data;
+    uLong adler = 1;     // PNG: Adler-32 of the filtered bytes
+    uLong raw_size = 0;  // PNG: number of filtered bytes
+};
+
+namespace {
+
+void append_be32(std::string& out, uint32_t value) {
+    char bytes[4] = {static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+                     static_cast<char>(value >> 8), static_cast<char>(value)};
+    out.append(bytes, 4);
+}
+
+void append_png_chunk(std::string& out, const char type[4], const char* data, size_t size) {
+    append_be32(out, static_cast<uint32_t>(size));
+    size_t start = out.size();
+    out.append(type, 4);
+    out.append(data, size);
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(out.data() + start), static_cast<uInt>(size + 4));
+    append_be32(out, static_cast<uint32_t>(crc));
+}
+
+uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+// Filter one row with every PNG filter type and keep the one with the
+// smallest sum of absolute values (the heuristic suggested by the PNG spec).
+// prev is null on the first row of a strip, which limits it to None and Sub
+// so strips stay independent.
+void filter_row(const uint8_t* row, const uint8_t* prev, size_t length, uint8_t* out) {
+    constexpr int bpp = 3;
+    std::vector<uint8_t> candidate(length);
+    uint64_t best_score = UINT64_MAX;
+    int filters = prev ? 5 : 2;
+
+    for (int filter = 0; filter < filters; ++filter) {
+        uint64_t score = 0;
+        for (size_t i = 0; i < length; ++i) {
+            int left = i >= bpp ? row[i - bpp] : 0;
+            int up = prev ? prev[i] : 0;
+            int up_left = (prev && i >= bpp) ? prev[i - bpp] : 0;
+            uint8_t predicted = 0;
+            switch (filter) {
+                case 1: predicted = static_cast<uint8_t>(left); break;
+                case 2: predicted = static_cast<uint8_t>(up); break;
+                case 3: predicted = static_cast<uint8_t>((left + up) / 2); break;
+                case 4: predicted = paeth(left, up, up_left); break;
+                default: break;
+            }
+            uint8_t value = static_cast<uint8_t>(row[i] - predicted);
+            candidate[i] = value;
+            score += static_cast<int8_t>(value) < 0 ? 256 - value : value;
+        }
+        if (score < best_score) {
+            best_score = score;
+            out[0] = static_cast<uint8_t>(filter);
+            std::memcpy(out + 1, candidate.data(), length);
+        }
+    }
+}
+
+}  // namespace
+
+ImageFormat image_format_for(const std::string& filename) {
+    auto dot = filename.rfind('.');
+    std::string extension = dot == std::string::npos ? "" : filename.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension == "ppm") return ImageFormat::PPM;
+    if (extension == "png") return ImageFormat::PNG;
+    if (extension == "pfm") return ImageFormat::PFM;
+    throw std::runtime_error("Unsupported image format: " + filename);
+}
+
+void convert_to_srgb8(const float* linear, uint8_t* out, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 16 values per iteration: clamp, sqrt, scale, then pack 32 -> 16 -> 8 bits
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.99f);
+    for (; i + 16 <= count; i += 16) {
+        __m128i quads[4];
+        for (int q = 0; q < 4; ++q) {
+            __m128 v = _mm_loadu_ps(linear + i + 4 * q);
+            v = _mm_min_ps(_mm_max_ps(v, zero), one);  // NaN becomes 0
+            quads[q] = _mm_cvttps_epi32(_mm_mul_ps(_mm_sqrt_ps(v), scale));
+        }
+        __m128i low = _mm_packs_epi32(quads[0], quads[1]);
+        __m128i high = _mm_packs_epi32(quads[2], quads[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(low, high));
+    }
+#endif
+    for (; i < count; ++i) {
+        float v = linear[i];
+        v = v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+        out[i] = static_cast<uint8_t>(std::sqrt(v) * 255.99f);
+    }
+}
+
+ImageEncoder::ImageEncoder(int width, int height, ImageFormat format, int strip_height)
+    : width_(width), height_(height), format_(format), strip_height_(std::max(1, strip_height)) {
+    int count = (height_ + strip_height_ - 1) / strip_height_;
+    for (int i = 0; i < count; ++i) {
+        strips_.push_back(std::make_unique<Strip>());
+    }
+}
+
+ImageEncoder::~ImageEncoder() = default;
+
+void ImageEncoder::encode_strip(int strip, const RowSource& source) {
+    Strip& out = *strips_.at(strip);
+    int y0 = strip * strip_height_;
+    int y1 = std::min(height_, y0 + strip_height_);
+    size_t row_values = static_cast<size_t>(width_) * 3;
+    std::vector<float> row(row_values);
+
+    out.data.clear();
+    switch (format_) {
+        case ImageFormat::PPM: {
+            out.data.resize(row_values * (y1 - y0));
+            for (int y = y0; y < y1; ++y) {
+                source(y, row.data());
+                convert_to_srgb8(row.data(), reinterpret_cast<uint8_t*>(&out.data[(y - y0) * row_values]),
+                                 row_values);
+            }
+            break;
+        }
+        case ImageFormat::PFM: {
+            // PFM stores rows bottom to top; strips are written in reverse by write()
+            size_t row_bytes = row_values * sizeof(float);
+            out.data.resize(row_bytes * (y1 - y0));
+            for (int y = y0; y < y1; ++y) {
+                source(y, row.data());
+                std::memcpy(&out.data[(y1 - 1 - y) * row_bytes], row.data(), row_bytes);
+            }
+            break;
+        }
+        case ImageFormat::PNG:
+            encode_png_strip(strip, source, out);
+            break;
+    }
+    out.encoded.store(true, std::memory_order_release);
+
+    if (stream_) {
+        flush_stream();
+    }
+}
+
+bool ImageEncoder::strip_encoded(int strip) const {
+    return strips_.at(strip)->encoded.load(std::memory_order_acquire);
+}
+
+int ImageEncoder::strip_in_file_order(int position) const {
+    return format_ == ImageFormat::PFM ? strip_count() - 1 - position : position;
+}
+
+void ImageEncoder::flush_stream() {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    while (stream_position_ < strip_count()) {
+        Strip& strip = *strips_[strip_in_file_order(stream_position_)];
+        if (!strip.encoded.load(std::memory_order_acquire)) {
+            break;
+        }
+        write_strip(*stream_, strip, stream_adler_);
+        std::string().swap(strip.data);
+        ++stream_position_;
+    }
+}
+
+void ImageEncoder::begin_stream(const std::string& filename) {
+    auto file = std::make_unique<std::ofstream>(filename, std::ios::binary);
+    if (!file->is_open()) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    write_header(*file);
+    stream_filename_ = filename;
+    stream_position_ = 0;
+    stream_adler_ = 1;
+    stream_ = std::move(file);
+}
+
+void ImageEncoder::finish_stream() {
+    if (!stream_) {
+        return;
+    }
+    flush_stream();
+    if (stream_position_ != strip_count()) {
+        throw std::runtime_error("Image strip not encoded: " + stream_filename_);
+    }
+    write_trailer(*stream_, stream_adler_);
+    stream_->close();
+    bool ok = !stream_->fail();
+    stream_.reset();
+    if (!ok) {
+        throw std::runtime_error("Failed to write file: " + stream_filename_);
+    }
+}
+
+void ImageEncoder::encode_png_strip(int strip, const RowSource& source, Strip& out) const {
+    int y0 = strip * strip_height_;
+    int y1 = std::min(height_, y0 + strip_height_);
+    size_t row_values = static_cast<size_t>(width_) * 3;
+    std::vector<float> row(row_values);
+    std::vector<uint8_t> current(row_values), previous(row_values);
+
+    std::vector<uint8_t> filtered((row_values + 1) * (y1 - y0));
+    for (int y = y0; y < y1; ++y) {
+        source(y, row.data());
+        convert_to_srgb8(row.data(), current.data(), row_values);
+        filter_row(current.data(), y > y0 ? previous.data() : nullptr, row_values,
+                   &filtered[(y - y0) * (row_values + 1)]);
+        std::swap(current, previous);
+    }
+
+    // Raw deflate; every strip but the last ends on a byte boundary with a
+    // full flush so the pieces concatenate into one valid stream
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("Failed to initialize deflate");
+    }
+    bool last = strip == static_cast<int>(strips_.size()) - 1;
+    out.data.resize(deflateBound(&stream, static_cast<uLong>(filtered.size())) + 16);
+    stream.next_in = filtered.data();
+    stream.avail_in = static_cast<uInt>(filtered.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out.data[0]);
+    stream.avail_out = static_cast<uInt>(out.data.size());
+    int rc = deflate(&stream, last ? Z_FINISH : Z_FULL_FLUSH);
+    bool complete = last ? rc == Z_STREAM_END : (rc == Z_OK && stream.avail_out > 0);
+    out.data.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (!complete) {
+        throw std::runtime_error("Failed to deflate image strip");
+    }
+
+    out.adler = adler32(1L, filtered.data(), static_cast<uInt>(filtered.size()));
+    out.raw_size = static_cast<uLong>(filtered.size());
+}
+
+void ImageEncoder::encode_remaining(const RowSource& source, int num_threads) {
+    std::atomic<int> next{0};
+    auto worker = [&]() {
+        while (true) {
+            int strip = next.fetch_add(1, std::memory_order_relaxed);
+            if (strip >= strip_count()) {
+                break;
+            }
+            if (!strips_[strip]->encoded.load(std::memory_order_acquire)) {
+                encode_strip(strip, source);
+            }
+        }
+    };
+
+    int threads_to_start = std::max(0, std::min(num_threads, strip_count()) - 1);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_to_start; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void ImageEncoder::write(const std::string& filename) const {
+    for (const auto& strip : strips_) {
+        if (!strip->encoded.load(std::memory_order_acquire)) {
+            throw std::runtime_error("Image strip not encoded: " + filename);
+        }
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+
+    write_header(file);
+    uLong adler = 1;
+    for (int position = 0; position < strip_count(); ++position) {
+        write_strip(file, *strips_[strip_in_file_order(position)], adler);
+    }
+    write_trailer(file, adler);
+
+    if (!file) {
+        throw std::runtime_error("Failed to write file: " + filename);
+    }
+}
+
+void ImageEncoder::write_header(std::ostream& out) const {
+    switch (format_) {
+        case ImageFormat::PPM:
+            out << "P6\n" << width_ << " " << height_ << "\n255\n";
+            break;
+
+        case ImageFormat::PFM: {
+            // Negative scale marks little-endian floats
+            uint16_t probe = 1;
+            bool little_endian = *reinterpret_cast<uint8_t*>(&probe) == 1;
+            out << "PF\n" << width_ << " " << height_ << "\n" << (little_endian ? "-1.0" : "1.0") << "\n";
+            break;
+        }
+
+        case ImageFormat::PNG: {
+            std::string header = "\x89PNG\r\n\x1a\n";
+            char ihdr[13];
+            for (int i = 0; i < 4; ++i) {
+                ihdr[i] = static_cast<char>(static_cast<uint32_t>(width_) >> (24 - 8 * i));
+                ihdr[4 + i] = static_cast<char>(static_cast<uint32_t>(height_) >> (24 - 8 * i));
+            }
+            ihdr[8] = 8;   // Bit depth
+            ihdr[9] = 2;   // Truecolor RGB
+            ihdr[10] = 0;  // Deflate
+            ihdr[11] = 0;  // Adaptive filtering
+            ihdr[12] = 0;  // No interlace
+            append_png_chunk(header, "IHDR", ihdr, sizeof(ihdr));
+
+            // zlib stream header; strips follow as IDAT chunks
+            append_png_chunk(header, "IDAT", "\x78\x9c", 2);
+            out.write(header.data(), static_cast<std::streamsize>(header.size()));
+            break;
+        }
+    }
+}
+
+void ImageEncoder::write_strip(std::ostream& out, const Strip& strip, unsigned long& adler) const {
+    if (format_ != ImageFormat::PNG) {
+        out.write(strip.data.data(), static_cast<std::streamsize>(strip.data.size()));
+        return;
+    }
+    std::string chunk;
+    append_png_chunk(chunk, "IDAT", strip.data.data(), strip.data.size());
+    out.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    adler = adler32_combine(adler, strip.adler, static_cast<z_off_t>(strip.raw_size));
+}
+
+void ImageEncoder::write_trailer(std::ostream& out, unsigned long adler) const {
+    if (format_ != ImageFormat::PNG) {
+        return;
+    }
+    std::string trailer;
+    append_be32(trailer, static_cast<uint32_t>(adler));
+    std::string chunk;
+    append_png_chunk(chunk, "IDAT", trailer.data(), trailer.size());
+    append_png_chunk(chunk, "IEND", "", 0);
+    out.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+}
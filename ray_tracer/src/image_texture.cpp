@@ -0,0 +1,358 @@
+#include "image_texture.h"
+#include "image_decoder.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char texture_magic[8] = {'R', 'T', 'T', 'I', 'L', 'E', 'S', '1'};
+constexpr uint32_t texture_version = 1;
+constexpr uint64_t data_alignment = 4096;  // Tiles start on a page boundary
+
+struct TiledHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tile_size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+    uint32_t pad;
+    uint64_t file_size;
+    uint64_t source_size;  // Of the image the file was made from, 0 if none
+    int64_t source_mtime_ns;
+};
+
+uint64_t data_offset() {
+    return (sizeof(TiledHeader) + data_alignment - 1) & ~(data_alignment - 1);
+}
+
+// Width and height of every mip level, halving (rounding down) to 1x1
+std::vector<std::pair<int, int>> level_sizes(int width, int height) {
+    std::vector<std::pair<int, int>> sizes = {{width, height}};
+    while (width > 1 || height > 1) {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        sizes.emplace_back(width, height);
+    }
+    return sizes;
+}
+
+int tiles_across(int pixels) {
+    return (pixels + ImageTexture::tile_size - 1) / ImageTexture::tile_size;
+}
+
+// Texel bytes to linear values: the inverse of the output's gamma 2.0
+const std::array<float, 256>& gamma_table() {
+    static const std::array<float, 256> table = []() {
+        std::array<float, 256> values;
+        for (int i = 0; i < 256; ++i) {
+            values[i] = static_cast<float>(i * i) / (255.0f * 255.0f);
+        }
+        return values;
+    }();
+    return table;
+}
+
+uint8_t encode_gamma(float linear) {
+    return static_cast<uint8_t>(std::sqrt(std::clamp(linear, 0.0f, 1.0f)) * 255.0f + 0.5f);
+}
+
+bool stat_source(const std::string& source_file, uint64_t& size, int64_t& mtime_ns) {
+    struct stat info;
+    if (stat(source_file.c_str(), &info) != 0) {
+        return false;
+    }
+    size = static_cast<uint64_t>(info.st_size);
+    mtime_ns = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+    return true;
+}
+
+bool read_at(int fd, void* out, size_t bytes, uint64_t offset) {
+    auto* at = static_cast<char*>(out);
+    while (bytes > 0) {
+        ssize_t got = pread(fd, at, bytes, static_cast<off_t>(offset));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        at += got;
+        bytes -= static_cast<size_t>(got);
+        offset += static_cast<uint64_t>(got);
+    }
+    return true;
+}
+
+// Whether filename is a tiled file made from the current version of source_file
+bool tiled_file_current(const std::string& filename, const std::string& source_file) {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    TiledHeader header;
+    bool read = read_at(fd, &header, sizeof(header), 0);
+    ::close(fd);
+
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    return read && std::memcmp(header.magic, texture_magic, sizeof(texture_magic)) == 0 &&
+           header.version == texture_version && stat_source(source_file, size, mtime_ns) &&
+           size == header.source_size && mtime_ns == header.source_mtime_ns;
+}
+
+// Tile keys must differ between textures of every cache a thread may use
+std::atomic<uint32_t> next_cache_id{0};
+
+// The tiles a render thread fetched last, direct-mapped by key, so most
+// texel lookups skip the cache's locks. Keeps up to `size` tiles per thread
+// alive beyond the cache's budget.
+struct TileMemo {
+    static constexpr int size = 32;
+    uint64_t keys[size];
+    TextureCache::Tile tiles[size];
+
+    TileMemo() { std::fill_n(keys, size, UINT64_MAX); }
+};
+thread_local TileMemo tile_memo;
+
+}  // namespace
+
+ImageTexture::~ImageTexture() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+std::shared_ptr<const ImageTexture> ImageTexture::open(const std::string& filename,
+                                                       std::shared_ptr<TextureCache> cache) {
+    std::shared_ptr<ImageTexture> texture(new ImageTexture());
+    texture->path_ = filename;
+    texture->fd_ = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (texture->fd_ < 0) {
+        throw std::runtime_error("Failed to open tiled texture: " + filename);
+    }
+
+    TiledHeader header;
+    struct stat info;
+    if (!read_at(texture->fd_, &header, sizeof(header), 0) || fstat(texture->fd_, &info) != 0 ||
+        std::memcmp(header.magic, texture_magic, sizeof(texture_magic)) != 0 ||
+        header.version != texture_version || header.tile_size != tile_size ||
+        header.width == 0 || header.height == 0 || header.width > 1 << 24 ||
+        header.height > 1 << 24 || header.file_size != static_cast<uint64_t>(info.st_size)) {
+        throw std::runtime_error("Damaged or outdated tiled texture: " + filename);
+    }
+
+    // Count tiles in 64 bits: at the largest sizes the header allows, the
+    // count overflows int, and it must fit both uint32_t and the file
+    texture->data_offset_ = data_offset();
+    texture->file_bytes_ = header.file_size;
+    uint64_t max_tiles = 0;
+    if (header.file_size >= texture->data_offset_) {
+        max_tiles = std::min<uint64_t>(UINT32_MAX, (header.file_size - texture->data_offset_) /
+                                                       texture->tile_bytes());
+    }
+    uint64_t tiles = 0;
+    for (const auto& size : level_sizes(header.width, header.height)) {
+        int tiles_x = tiles_across(size.first);
+        uint32_t first_tile = static_cast<uint32_t>(tiles);
+        texture->levels_.push_back({size.first, size.second, tiles_x, first_tile});
+        tiles += static_cast<uint64_t>(tiles_x) * tiles_across(size.second);
+        if (tiles > max_tiles) {
+            throw std::runtime_error("Damaged or outdated tiled texture: " + filename);
+        }
+    }
+    texture->tile_count_ = static_cast<uint32_t>(tiles);
+    if (header.level_count != texture->levels_.size() ||
+        header.file_size != texture->data_offset_ + tiles * texture->tile_bytes()) {
+        throw std::runtime_error("Damaged or outdated tiled texture: " + filename);
+    }
+
+    texture->cache_ = std::move(cache);
+    texture->cache_id_ = next_cache_id.fetch_add(1, std::memory_order_relaxed);
+    return texture;
+}
+
+std::shared_ptr<const ImageTexture> ImageTexture::load(const std::string& filename,
+                                                       std::shared_ptr<TextureCache> cache) {
+    auto dot = filename.rfind('.');
+    if (dot != std::string::npos && filename.substr(dot) == ".rtx") {
+        return open(filename, std::move(cache));
+    }
+    std::string tiled = filename + ".rtx";
+    if (!tiled_file_current(tiled, filename)) {
+        write_tiled(decode_image(filename), tiled, filename);
+    }
+    return open(tiled, std::move(cache));
+}
+
+void ImageTexture::write_tiled(const DecodedImage& image, const std::string& filename,
+                               const std::string& source_file) {
+    auto sizes = level_sizes(image.width, image.height);
+    const size_t tile_bytes = static_cast<size_t>(tile_size) * tile_size * 3;
+    uint64_t tiles = 0;
+    for (const auto& size : sizes) {
+        tiles += static_cast<uint64_t>(tiles_across(size.first)) * tiles_across(size.second);
+    }
+
+    TiledHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, texture_magic, sizeof(header.magic));
+    header.version = texture_version;
+    header.tile_size = tile_size;
+    header.width = static_cast<uint32_t>(image.width);
+    header.height = static_cast<uint32_t>(image.height);
+    header.level_count = static_cast<uint32_t>(sizes.size());
+    header.file_size = data_offset() + tiles * tile_bytes;
+    if (!source_file.empty() &&
+        !stat_source(source_file, header.source_size, header.source_mtime_ns)) {
+        throw std::runtime_error("Image not found: " + source_file);
+    }
+
+    std::string temporary = filename + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Failed to open tiled texture file: " + temporary);
+    }
+    std::vector<uint8_t> padding(data_offset() - sizeof(header), 0);
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(padding.data(), 1, padding.size(), file) == padding.size();
+
+    // One level in memory at a time: cut it into tiles (edge tiles repeat
+    // the last row and column), then filter it down to the next
+    const auto& linear = gamma_table();
+    std::vector<uint8_t> level = image.rgb;
+    std::vector<uint8_t> tile(tile_bytes);
+    for (size_t l = 0; l < sizes.size() && ok; ++l) {
+        int width = sizes[l].first;
+        int height = sizes[l].second;
+        for (int ty = 0; ty < tiles_across(height) && ok; ++ty) {
+            for (int tx = 0; tx < tiles_across(width) && ok; ++tx) {
+                for (int y = 0; y < tile_size; ++y) {
+                    int source_y = std::min(ty * tile_size + y, height - 1);
+                    for (int x = 0; x < tile_size; ++x) {
+                        int source_x = std::min(tx * tile_size + x, width - 1);
+                        std::memcpy(&tile[(static_cast<size_t>(y) * tile_size + x) * 3],
+                                    &level[(static_cast<size_t>(source_y) * width + source_x) * 3], 3);
+                    }
+                }
+                ok = std::fwrite(tile.data(), 1, tile_bytes, file) == tile_bytes;
+            }
+        }
+        if (l + 1 == sizes.size()) {
+            break;
+        }
+
+        // Box filter: each texel of the next level averages the 2x2 (or,
+        // across an odd edge, up to 3x3) texels it covers
+        int next_width = sizes[l + 1].first;
+        int next_height = sizes[l + 1].second;
+        std::vector<uint8_t> next(static_cast<size_t>(next_width) * next_height * 3);
+        for (int y = 0; y < next_height; ++y) {
+            int y0 = y * height / next_height;
+            int y1 = std::max(y0 + 1, ((y + 1) * height + next_height - 1) / next_height);
+            for (int x = 0; x < next_width; ++x) {
+                int x0 = x * width / next_width;
+                int x1 = std::max(x0 + 1, ((x + 1) * width + next_width - 1) / next_width);
+                float sum[3] = {0.0f, 0.0f, 0.0f};
+                for (int sy = y0; sy < y1; ++sy) {
+                    for (int sx = x0; sx < x1; ++sx) {
+                        const uint8_t* texel = &level[(static_cast<size_t>(sy) * width + sx) * 3];
+                        for (int c = 0; c < 3; ++c) {
+                            sum[c] += linear[texel[c]];
+                        }
+                    }
+                }
+                float scale = 1.0f / static_cast<float>((y1 - y0) * (x1 - x0));
+                for (int c = 0; c < 3; ++c) {
+                    next[(static_cast<size_t>(y) * next_width + x) * 3 + c] =
+                        encode_gamma(sum[c] * scale);
+                }
+            }
+        }
+        level = std::move(next);
+    }
+
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Failed to write tiled texture file: " + filename);
+    }
+}
+
+void ImageTexture::read_tile(uint32_t tile, uint8_t* out) const {
+    if (tile >= tile_count_ ||
+        !read_at(fd_, out, tile_bytes(), data_offset_ + static_cast<uint64_t>(tile) * tile_bytes())) {
+        throw std::runtime_error("Failed to read tile " + std::to_string(tile) + " of " + path_);
+    }
+}
+
+Vector3 ImageTexture::texel(int level, int x, int y) const {
+    const Level& info = levels_[level];
+    uint32_t tile = info.first_tile + static_cast<uint32_t>(y / tile_size) * info.tiles_x +
+                    static_cast<uint32_t>(x / tile_size);
+    uint64_t key = static_cast<uint64_t>(cache_id_) << 32 | tile;
+    size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 59);
+    if (tile_memo.keys[slot] != key) {
+        tile_memo.tiles[slot] = cache_->get(*this, tile);
+        tile_memo.keys[slot] = key;
+    }
+
+    const uint8_t* bytes =
+        tile_memo.tiles[slot]->data() + ((y % tile_size) * tile_size + x % tile_size) * 3;
+    const auto& linear = gamma_table();
+    return Vector3(linear[bytes[0]], linear[bytes[1]], linear[bytes[2]]);
+}
+
+Vector3 ImageTexture::bilinear(int level, double u, double v) const {
+    const Level& info = levels_[level];
+    double x = u * info.width - 0.5;
+    double y = v * info.height - 0.5;
+    double x_floor = std::floor(x);
+    double y_floor = std::floor(y);
+    double fx = x - x_floor;
+    double fy = y - y_floor;
+
+    // Columns wrap around, rows stop at the edges
+    int x0 = static_cast<int>(x_floor);
+    int y0 = static_cast<int>(y_floor);
+    int xa = (x0 % info.width + info.width) % info.width;
+    int xb = (xa + 1) % info.width;
+    int ya = std::clamp(y0, 0, info.height - 1);
+    int yb = std::clamp(y0 + 1, 0, info.height - 1);
+
+    Vector3 top = texel(level, xa, ya) * (1.0 - fx) + texel(level, xb, ya) * fx;
+    Vector3 bottom = texel(level, xa, yb) * (1.0 - fx) + texel(level, xb, yb) * fx;
+    return top * (1.0 - fy) + bottom * fy;
+}
+
+Vector3 ImageTexture::sample(double u, double v, double du, double dv) const {
+    if (!std::isfinite(u) || !std::isfinite(v)) {
+        u = v = 0.0;
+    }
+    u -= std::floor(u);
+    v = std::clamp(v, 0.0, 1.0);
+
+    // Level of detail: log2 of the footprint in level 0 texels
+    double texels = std::max(du * width(), dv * height());
+    double lod = texels > 1.0 ? std::log2(texels) : 0.0;
+    lod = std::min(lod, static_cast<double>(level_count() - 1));
+    int level = static_cast<int>(lod);
+    double blend = lod - level;
+
+    Vector3 color = bilinear(level, u, v);
+    if (blend > 0.0 && level + 1 < level_count()) {
+        color = color * (1.0 - blend) + bilinear(level + 1, u, v) * blend;
+    }
+    return color;
+}
@@ -0,0 +1,153 @@
+#include "light_tree.h"
+#include "scene.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Largest double below 1, so rescaled sample numbers stay in [0, 1)
+constexpr double one_minus_epsilon = 0x1.fffffffffffffp-1;
+
+}  // namespace
+
+void LightTree::build(const std::vector<Light>& lights) {
+    light_power_.clear();
+    positions_.clear();
+    std::vector<AABB> bounds;
+    for (const auto& light : lights) {
+        const Vector3& p = light.position;
+        bounds.push_back(AABB::around_sphere(p.x, p.y, p.z, light.radius));
+        light_power_.push_back((light.intensity.x + light.intensity.y + light.intensity.z) / 3.0);
+        positions_.push_back(p);
+    }
+
+    bvh_ = BVH();
+    node_power_.clear();
+    if (lights.empty()) {
+        return;
+    }
+    BVH::BuildOptions options;
+    options.max_leaf_size = 1;
+    bvh_.build(bounds, options);
+    node_power_.resize(bvh_.node_count());
+    sum_power(0);
+}
+
+double LightTree::sum_power(uint32_t index) {
+    const BVHNode& node = bvh_.nodes()[index];
+    double power = 0.0;
+    if (node.is_leaf()) {
+        const uint32_t* indices = bvh_.primitive_indices();
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+            power += light_power_[indices[i]];
+        }
+    } else {
+        power = sum_power(index + 1) + sum_power(node.offset);
+    }
+    node_power_[index] = power;
+    return power;
+}
+
+double LightTree::node_importance(uint32_t index, const Vector3& point, const Vector3& normal,
+                                  double diffuse, double specular) const {
+    double power = node_power_[index];
+    if (power <= 0.0) {
+        return 0.0;
+    }
+
+    // Largest cosine between the normal and a direction into the box's
+    // bounding sphere: the normal's angle to its center less the sphere's
+    // angular radius, or 1 from inside it
+    const BVHNode& node = bvh_.nodes()[index];
+    Vector3 center(0.5 * (node.bounds_min[0] + node.bounds_max[0]),
+                   0.5 * (node.bounds_min[1] + node.bounds_max[1]),
+                   0.5 * (node.bounds_min[2] + node.bounds_max[2]));
+    Vector3 half_extent(0.5 * (node.bounds_max[0] - node.bounds_min[0]),
+                        0.5 * (node.bounds_max[1] - node.bounds_min[1]),
+                        0.5 * (node.bounds_max[2] - node.bounds_min[2]));
+    Vector3 to_center = center - point;
+    double distance = to_center.length();
+    double radius = half_extent.length();
+    double cos_bound = 1.0;
+    if (distance > radius) {
+        double cos_theta = normal.dot(to_center) / distance;
+        double sin_alpha = radius / distance;
+        double cos_alpha = std::sqrt(1.0 - sin_alpha * sin_alpha);
+        if (cos_theta < cos_alpha) {
+            double sin_theta = std::sqrt(std::max(0.0, 1.0 - cos_theta * cos_theta));
+            cos_bound = std::max(0.0, cos_theta * cos_alpha + sin_theta * sin_alpha);
+        }
+    }
+    return power * (diffuse * cos_bound + specular);
+}
+
+LightTree::Pick LightTree::sample(const Vector3& point, const Vector3& normal, double diffuse,
+                                  double specular, double u) const {
+    Pick pick;
+    if (empty()) {
+        return pick;
+    }
+
+    // Walk down choosing children by importance, reusing u rescaled to the
+    // chosen child's share at every step
+    const BVHNode* nodes = bvh_.nodes();
+    uint32_t index = 0;
+    double pdf = 1.0;
+    while (!nodes[index].is_leaf()) {
+        uint32_t left = index + 1;
+        uint32_t right = nodes[index].offset;
+        double left_importance = node_importance(left, point, normal, diffuse, specular);
+        double right_importance = node_importance(right, point, normal, diffuse, specular);
+        double total = left_importance + right_importance;
+        if (total <= 0.0) {
+            return pick;
+        }
+        double p_left = left_importance / total;
+        if (u < p_left) {
+            u /= p_left;
+            pdf *= p_left;
+            index = left;
+        } else {
+            u = (u - p_left) / (1.0 - p_left);
+            pdf *= 1.0 - p_left;
+            index = right;
+        }
+        u = std::min(u, one_minus_epsilon);
+    }
+
+    // Lights sharing a leaf, each by its own contribution bound: the diffuse
+    // term is lit by the direction to the light's center
+    const BVHNode& leaf = nodes[index];
+    const uint32_t* indices = bvh_.primitive_indices() + leaf.offset;
+    auto light_weight = [&](uint32_t light) {
+        Vector3 to_light = positions_[light] - point;
+        double distance = to_light.length();
+        double cos_theta = distance > 0.0 ? std::max(0.0, normal.dot(to_light) / distance) : 1.0;
+        return light_power_[light] * (diffuse * cos_theta + specular);
+    };
+    double total = 0.0;
+    for (uint32_t i = 0; i < leaf.count; ++i) {
+        total += light_weight(indices[i]);
+    }
+    if (total <= 0.0) {
+        return pick;
+    }
+
+    // Rounding may run past the end: the last light that can contribute
+    // takes the remainder
+    double target = u * total;
+    double weight = 0.0;
+    for (uint32_t i = 0; i < leaf.count; ++i) {
+        double w = light_weight(indices[i]);
+        if (w > 0.0) {
+            pick.light = indices[i];
+            weight = w;
+            if (target < w) {
+                break;
+            }
+            target -= w;
+        }
+    }
+    pick.pdf = pdf * weight / total;
+    return pick;
+}
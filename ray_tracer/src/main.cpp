@@ -1,72 +1,404 @@
+#include "accelerator.h"
+#include "animation.h"
+#include "distributed.h"
+#include "image_texture.h"
 #include "ray_tracer.h"
 #include "scene.h"
+#include "scene_cache.h"
+#include "scene_loader.h"
 #include "texture.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
+
+namespace {
+
+RayTracer* active_tracer = nullptr;
+
+void handle_stop_signal(int) {
+    // Preemption: finish the tiles in flight, checkpoint and write the image
+    if (active_tracer) {
+        active_tracer->request_stop();
+    }
+}
+
+size_t image_textures(const Scene& scene) {
+    return std::count_if(scene.get_textures().begin(), scene.get_textures().end(),
+                         [](const Texture& texture) { return texture.image() != nullptr; });
+}
+
+// Built-in demo scene, used when no scene file is given
+void build_default_scene(Scene& scene) {
+    // Ground plane (checkerboard texture, reflective)
+    Material ground_material(Vector3(0.8, 0.8, 0.8), 0.15);
+    ground_material.texture = scene.add_texture(Texture(
+        Texture::Type::CHECKERBOARD,
+        Vector3(1.0, 1.0, 1.0),
+        Vector3(0.2, 0.2, 0.2)
+    ));
+    scene.add_sphere(Sphere(Vector3(0, -101, -5), 100, scene.add_material(ground_material)));
+
+    // Red sphere (matte)
+    uint32_t red_material = scene.add_material(Material(Vector3(1, 0.2, 0.2), 0.0));
+    scene.add_sphere(Sphere(Vector3(-1.5, 0, -4), 1.0, red_material));
+
+    // Green sphere (reflective)
+    uint32_t green_material = scene.add_material(Material(Vector3(0.2, 1, 0.2), 0.4));
+    scene.add_sphere(Sphere(Vector3(0, 0, -5), 1.0, green_material));
+
+    // Blue sphere (highly reflective)
+    uint32_t blue_material = scene.add_material(Material(Vector3(0.2, 0.2, 1), 0.7));
+    scene.add_sphere(Sphere(Vector3(1.5, 0, -6), 1.0, blue_material));
+
+    // Mirror sphere
+    uint32_t mirror_material = scene.add_material(Material(Vector3(1, 1, 1), 0.95));
+    scene.add_sphere(Sphere(Vector3(0, 1.2, -7), 0.8, mirror_material));
+
+    // Add lights with soft shadows
+    scene.add_light(Light(Vector3(3, 3, -2), Vector3(1, 1, 1), 0.3));
+    scene.add_light(Light(Vector3(-3, 2, -3), Vector3(0.5, 0.7, 1), 0.2));
+}
+
+}  // namespace
 
 int main(int argc, char* argv[]) {
-    int width = 800;
-    int height = 600;
-    int samples = 10;
     int num_threads = std::thread::hardware_concurrency();
 
-    // Parse command line arguments
-    if (argc > 1) width = std::stoi(argv[1]);
-    if (argc > 2) height = std::stoi(argv[2]);
-    if (argc > 3) samples = std::stoi(argv[3]);
-    if (argc > 4) num_threads = std::stoi(argv[4]);
+    int tile_size = 16;
+    TileOrder tile_order = TileOrder::MORTON;
+    bool pin_threads = false;
+    bool wavefront = false;
+    bool show_progress = true;
+    double noise_threshold = 0.0;
+    int min_samples = 4;
+    int light_samples = 0;
+    double time_budget = 0.0;
+    std::string heatmap_file;
+    std::string cost_heatmap_file;
+    std::string feature_prefix;
+    bool denoise = false;
+    std::string output_file = "output.ppm";
+    int pass_samples = 0;
+    double preview_interval = 10.0;
+    std::string checkpoint_file;
+    double checkpoint_interval = 60.0;
+    bool resume = false;
+    bool streaming = false;
+    std::string scene_file;
+    std::string scene_cache_file;
+    std::string scratch_file;
+    SamplerType sampler_type = SamplerType::SOBOL;
+    uint64_t seed = 0;
+    int frames = 0;
+    int turntable_frames = 0;
+    int coordinator_port = -1;
+    std::string worker_address;
+    int distributed_tile_size = 64;
+    double worker_timeout = 120.0;
+    double texture_cache_mb = TextureCache::default_capacity / (1024.0 * 1024.0);
+
+    // Parse command line arguments: width height samples threads, plus options
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--tile-size" && i + 1 < argc) {
+            tile_size = std::stoi(argv[++i]);
+        } else if (arg == "--tile-order" && i + 1 < argc) {
+            tile_order = parse_tile_order(argv[++i]);
+        } else if (arg == "--sampler" && i + 1 < argc) {
+            sampler_type = parse_sampler_type(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--wavefront") {
+            // Trace rays in per-tile streams instead of one path at a time
+            wavefront = true;
+        } else if (arg == "--light-samples" && i + 1 < argc) {
+            // Lights picked per hit through the light tree instead of all of them
+            light_samples = std::stoi(argv[++i]);
+        } else if (arg == "--pin-threads") {
+            pin_threads = true;
+        } else if (arg == "--noise-threshold" && i + 1 < argc) {
+            // Relative noise a pixel may keep; samples becomes the per-pixel maximum
+            noise_threshold = std::stod(argv[++i]);
+        } else if (arg == "--min-samples" && i + 1 < argc) {
+            min_samples = std::stoi(argv[++i]);
+        } else if (arg == "--time-budget" && i + 1 < argc) {
+            time_budget = std::stod(argv[++i]);
+        } else if (arg == "--heatmap" && i + 1 < argc) {
+            heatmap_file = argv[++i];
+        } else if (arg == "--cost-heatmap" && i + 1 < argc) {
+            // Time spent per pixel; instrumented builds only
+            cost_heatmap_file = argv[++i];
+        } else if (arg == "--aovs" && i + 1 < argc) {
+            // Albedo, normal, depth and variance images named <prefix>_albedo.pfm etc.
+            feature_prefix = argv[++i];
+        } else if (arg == "--denoise") {
+            denoise = true;
+        } else if (arg == "--progressive" && i + 1 < argc) {
+            pass_samples = std::stoi(argv[++i]);
+        } else if (arg == "--preview-interval" && i + 1 < argc) {
+            preview_interval = std::stod(argv[++i]);
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpoint_file = argv[++i];
+        } else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+            checkpoint_interval = std::stod(argv[++i]);
+        } else if (arg == "--resume") {
+            resume = true;
+        } else if (arg == "--stream") {
+            // Write each finished row of tiles straight to the output file
+            streaming = true;
+        } else if (arg == "--scratch" && i + 1 < argc) {
+            scratch_file = argv[++i];
+        } else if (arg == "--scene" && i + 1 < argc) {
+            scene_file = argv[++i];
+        } else if (arg == "--scene-cache" && i + 1 < argc) {
+            // Binary cache of the scene file and its BVH, rebuilt when stale
+            scene_cache_file = argv[++i];
+        } else if (arg == "--texture-cache" && i + 1 < argc) {
+            // Memory for image texture tiles, in MB; the rest stays on disk
+            texture_cache_mb = std::stod(argv[++i]);
+        } else if (arg == "--frames" && i + 1 < argc) {
+            // Sequence length; the scene's keys are held past their last frame
+            frames = std::stoi(argv[++i]);
+        } else if (arg == "--turntable" && i + 1 < argc) {
+            // One camera turn around its target over this many frames
+            turntable_frames = std::stoi(argv[++i]);
+        } else if (arg == "--coordinator" && i + 1 < argc) {
+            // Render on worker processes that connect to this port
+            coordinator_port = std::stoi(argv[++i]);
+        } else if (arg == "--worker" && i + 1 < argc) {
+            // Render tiles for the coordinator at host:port, then exit
+            worker_address = argv[++i];
+        } else if (arg == "--distributed-tile" && i + 1 < argc) {
+            distributed_tile_size = std::stoi(argv[++i]);
+        } else if (arg == "--worker-timeout" && i + 1 < argc) {
+            worker_timeout = std::stod(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            num_threads = std::stoi(argv[++i]);
+        } else if (arg == "--output" && i + 1 < argc) {
+            output_file = argv[++i];
+        } else if (arg == "--quiet") {
+            show_progress = false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() > 3) num_threads = std::stoi(positional[3]);
 
     std::cout << "==== C++ Advanced Ray Tracer ====\n";
-    std::cout << "Resolution: " << width << "x" << height << "\n";
-    std::cout << "Samples per pixel: " << samples << "\n";
-    std::cout << "Threads: " << num_threads << "\n";
-    std::cout << "Features: Reflections, Soft Shadows, Textures, Parallelization\n";
 
     try {
-        RayTracer tracer(width, height, samples);
-        tracer.set_num_threads(num_threads);
-        tracer.set_max_depth(3);
+        default_texture_cache()->set_capacity(
+            static_cast<size_t>(std::max(0.0, texture_cache_mb) * 1024.0 * 1024.0));
 
-        // Create a complex scene with various materials and effects
-        Scene scene;
+        // Workers get everything else from the coordinator
+        if (!worker_address.empty()) {
+            size_t colon = worker_address.rfind(':');
+            if (colon == std::string::npos) {
+                throw std::runtime_error("--worker needs <host>:<port>");
+            }
+            run_tile_worker(worker_address.substr(0, colon),
+                            std::stoi(worker_address.substr(colon + 1)), num_threads);
+            return 0;
+        }
 
-        // Ground plane (checkerboard texture, reflective)
-        Material ground_material(Vector3(0.8, 0.8, 0.8), 0.15);
-        ground_material.texture = std::make_shared<Texture>(
-            Texture::Type::CHECKERBOARD,
-            Vector3(1.0, 1.0, 1.0),
-            Vector3(0.2, 0.2, 0.2)
-        );
-        scene.add_sphere(Sphere(Vector3(0, -101, -5), 100, ground_material));
+        if (!scene_cache_file.empty() && scene_file.empty()) {
+            throw std::runtime_error("--scene-cache needs --scene <file>");
+        }
 
-        // Red sphere (matte)
-        Material red_material(Vector3(1, 0.2, 0.2), 0.0);
-        scene.add_sphere(Sphere(Vector3(-1.5, 0, -4), 1.0, red_material));
+        // The built-in scene, a scene file, or that file's binary cache
+        Scene scene;
+        Animation animation;
+        std::unique_ptr<SceneAccelerator> accelerator;
+        if (scene_file.empty()) {
+            build_default_scene(scene);
+        } else {
+            auto load_start = std::chrono::steady_clock::now();
+            std::shared_ptr<const SceneCache> cache;
+            if (!scene_cache_file.empty()) {
+                cache = SceneCache::open(scene_cache_file, scene_file);
+            }
+            if (cache) {
+                cache->load_scene(scene);
+                accelerator = cache->make_accelerator(scene);
+                std::cout << "Scene: " << scene_cache_file;
+            } else {
+                load_scene_file(scene_file, scene, &animation);
+                std::cout << "Scene: " << scene_file;
+                if (!scene_cache_file.empty() && !scene.get_instances().empty()) {
+                    // The cache format holds spheres only
+                    std::cout << " (meshes are not cached, skipping " << scene_cache_file << ")";
+                } else if (!scene_cache_file.empty() && image_textures(scene) > 0) {
+                    // Nor images, which live in their own tiled files
+                    std::cout << " (image textures are not cached, skipping " << scene_cache_file
+                              << ")";
+                } else if (!scene_cache_file.empty() && !animation.empty()) {
+                    // Nor keyframes: a cache hit must mean the file has none
+                    std::cout << " (animations are not cached, skipping " << scene_cache_file << ")";
+                } else if (!scene_cache_file.empty()) {
+                    accelerator = std::make_unique<SceneAccelerator>(scene, num_threads);
+                    SceneCache::write(scene_cache_file, scene_file, scene, *accelerator);
+                    std::cout << " (cached to " << scene_cache_file << ")";
+                }
+            }
+            std::cout << " loaded in " << std::chrono::duration<double, std::milli>(
+                                              std::chrono::steady_clock::now() - load_start).count()
+                      << " ms\n";
+        }
 
-        // Green sphere (reflective)
-        Material green_material(Vector3(0.2, 1, 0.2), 0.4);
-        scene.add_sphere(Sphere(Vector3(0, 0, -5), 1.0, green_material));
+        if (turntable_frames > 0) {
+            if (!animation.empty()) {
+                throw std::runtime_error("--turntable needs a scene without keyframes");
+            }
+            animation = Animation::turntable(turntable_frames);
+        }
+        if (frames > 0) {
+            animation.set_frame_count(frames);
+        }
+        bool sequence = !animation.empty() || frames > 1;
 
-        // Blue sphere (highly reflective)
-        Material blue_material(Vector3(0.2, 0.2, 1), 0.7);
-        scene.add_sphere(Sphere(Vector3(1.5, 0, -6), 1.0, blue_material));
+        // Workers return finished pixels only, and must all render the same ones
+        bool distributed = coordinator_port >= 0;
+        if (distributed && (sequence || streaming || !checkpoint_file.empty() ||
+                            time_budget > 0.0 || !heatmap_file.empty() ||
+                            !cost_heatmap_file.empty() || denoise || !feature_prefix.empty())) {
+            throw std::runtime_error("--coordinator renders single images without streaming, "
+                                     "checkpoints, time budgets, heatmaps or denoising");
+        }
 
-        // Mirror sphere
-        Material mirror_material(Vector3(1, 1, 1), 0.95);
-        scene.add_sphere(Sphere(Vector3(0, 1.2, -7), 0.8, mirror_material));
+        // Command line arguments override the scene's render settings
+        RenderSettings settings = scene.get_render_settings();
+        if (positional.size() > 0) settings.width = std::stoi(positional[0]);
+        if (positional.size() > 1) settings.height = std::stoi(positional[1]);
+        if (positional.size() > 2) settings.samples_per_pixel = std::stoi(positional[2]);
 
-        // Add lights with soft shadows
-        scene.add_light(Light(Vector3(3, 3, -2), Vector3(1, 1, 1), 0.3));
-        scene.add_light(Light(Vector3(-3, 2, -3), Vector3(0.5, 0.7, 1), 0.2));
+        std::cout << "Resolution: " << settings.width << "x" << settings.height << "\n";
+        std::cout << "Samples per pixel: " << settings.samples_per_pixel << "\n";
+        std::cout << "Threads: " << num_threads << "\n";
+        std::cout << "Sampler: " << sampler_type_name(sampler_type) << ", seed " << seed << "\n";
+        std::cout << "Features: Reflections, Soft Shadows, Textures, Parallelization\n";
+
+        RayTracer tracer(settings.width, settings.height, settings.samples_per_pixel);
+        tracer.set_num_threads(num_threads);
+        tracer.set_max_depth(settings.max_depth);
+        if (accelerator) {
+            tracer.set_accelerator(std::move(accelerator));
+        }
+        tracer.set_sampler(sampler_type);
+        tracer.set_seed(seed);
+        tracer.set_tile_size(tile_size);
+        tracer.set_tile_order(tile_order);
+        tracer.set_pin_threads(pin_threads);
+        tracer.set_wavefront(wavefront);
+        tracer.set_light_samples(light_samples);
+        tracer.set_adaptive_sampling(noise_threshold, min_samples);
+        tracer.set_time_budget(time_budget);
+        tracer.set_heatmap_file(heatmap_file);
+        tracer.set_cost_heatmap_file(cost_heatmap_file);
+        tracer.set_feature_prefix(feature_prefix);
+        tracer.set_denoise(denoise);
+        tracer.set_progressive(pass_samples, preview_interval);
+        tracer.set_streaming(streaming);
+        tracer.set_scratch_file(scratch_file);
+        if (!checkpoint_file.empty()) {
+            tracer.set_checkpoint(checkpoint_file, checkpoint_interval, resume);
+        } else if (resume) {
+            throw std::runtime_error("--resume needs --checkpoint <file>");
+        }
+        // Sequences report one line per frame instead
+        if (show_progress && !sequence) {
+            tracer.set_progress_callback([](const RenderProgress& progress) {
+                std::cerr << "\rProgress: " << progress.tiles_done << "/" << progress.tiles_total
+                          << " tiles (" << (100 * progress.tiles_done / progress.tiles_total)
+                          << "%), ETA " << static_cast<int>(progress.eta_seconds + 0.5) << "s   ";
+                if (progress.tiles_done == progress.tiles_total) {
+                    std::cerr << "\n";
+                }
+            });
+        }
 
         std::cout << "\nRendering scene with:\n";
-        std::cout << "  - 5 spheres with different materials\n";
-        std::cout << "  - 2 area lights for soft shadows\n";
+        std::cout << "  - " << scene.get_spheres().size() << " spheres\n";
+        if (!scene.get_instances().empty()) {
+            size_t triangles = 0;
+            size_t mesh_bytes = 0;
+            for (const auto& mesh : scene.get_meshes()) {
+                triangles += mesh->triangle_count();
+                mesh_bytes += mesh->memory_bytes();
+            }
+            std::cout << "  - " << scene.get_meshes().size() << " meshes, " << triangles
+                      << " triangles (" << mesh_bytes / (1024.0 * 1024.0) << " MB)\n";
+            std::cout << "  - " << scene.get_instances().size() << " instances ("
+                      << scene.get_instances().size() * sizeof(MeshInstance) / 1024.0 << " KB)\n";
+        }
+        if (image_textures(scene) > 0) {
+            uint64_t tiled_bytes = 0;
+            for (const auto& texture : scene.get_textures()) {
+                if (texture.image()) {
+                    tiled_bytes += texture.image()->file_bytes();
+                }
+            }
+            std::cout << "  - " << image_textures(scene) << " image textures ("
+                      << tiled_bytes / (1024.0 * 1024.0) << " MB of tiles, "
+                      << default_texture_cache()->capacity() / (1024.0 * 1024.0)
+                      << " MB cache)\n";
+        }
+        std::cout << "  - " << scene.get_lights().size() << " area lights for soft shadows";
+        if (light_samples > 0 && static_cast<size_t>(light_samples) < scene.get_lights().size()) {
+            std::cout << ", " << light_samples << " picked per hit";
+        }
+        std::cout << "\n";
         std::cout << "  - Reflections and textures\n";
         std::cout << "\nStarting render...\n";
 
-        tracer.render_scene(scene, "output.ppm");
-        std::cout << "\nSuccess! Image saved to output.ppm\n";
+        active_tracer = &tracer;
+        std::signal(SIGINT, handle_stop_signal);
+        std::signal(SIGTERM, handle_stop_signal);
+        if (distributed) {
+            TileCoordinator::Options options;
+            options.port = coordinator_port;
+            options.tile_size = distributed_tile_size;
+            options.order = tile_order;
+            options.timeout_seconds = worker_timeout;
+            options.progress = show_progress;
+            TileCoordinator coordinator(options);
+
+            DistributedSettings job;
+            job.width = settings.width;
+            job.height = settings.height;
+            job.samples_per_pixel = settings.samples_per_pixel;
+            job.max_depth = settings.max_depth;
+            job.sampler = sampler_type;
+            job.seed = seed;
+            job.noise_threshold = noise_threshold;
+            job.min_samples = min_samples;
+            job.pass_samples = pass_samples;
+            job.light_samples = light_samples;
+            coordinator.render(scene, job, output_file);
+            active_tracer = nullptr;
+            std::cout << "\nSuccess! Image saved to " << output_file << "\n";
+        } else if (sequence) {
+            tracer.render_sequence(scene, animation, output_file);
+            active_tracer = nullptr;
+            std::cout << "\nSuccess! Frames saved as " << frame_filename(output_file, 0) << " to "
+                      << frame_filename(output_file, animation.frame_count() - 1) << "\n";
+        } else {
+            tracer.render_scene(scene, output_file);
+            active_tracer = nullptr;
+            std::cout << "\nSuccess! Image saved to " << output_file << "\n";
+        }
+        if (image_textures(scene) > 0 && !distributed) {
+            TextureCache::Stats stats = default_texture_cache()->stats();
+            std::cout << "Texture cache: " << stats.misses << " tiles read ("
+                      << stats.bytes_read / (1024.0 * 1024.0) << " MB), " << stats.evictions
+                      << " evicted, " << stats.resident_bytes / (1024.0 * 1024.0)
+                      << " MB resident\n";
+        }
 
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
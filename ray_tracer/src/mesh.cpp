@@ -0,0 +1,401 @@
+#include "mesh.h"
+#include "mapped_buffer.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+constexpr int mesh_leaf_size = 4;
+
+/**
+ * ObjChunk - Lines [begin, end) of an OBJ file parsed by one thread
+ */
+struct ObjChunk {
+    ObjChunk(const char* begin, const char* end) : begin(begin), end(end) {}
+
+    const char* begin;
+    const char* end;
+    size_t vertex_base = 0;  // Vertices defined in earlier chunks (first pass: in this one)
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    std::string error;
+};
+
+const char* skip_spaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        ++p;
+    }
+    return p;
+}
+
+const char* line_end(const char* p, const char* end) {
+    while (p < end && *p != '\n') {
+        ++p;
+    }
+    return p;
+}
+
+bool is_vertex_line(const char* p, const char* end) {
+    return p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t');
+}
+
+void count_vertices(ObjChunk& chunk) {
+    for (const char* line = chunk.begin; line < chunk.end;) {
+        const char* p = skip_spaces(line, chunk.end);
+        if (is_vertex_line(p, chunk.end)) {
+            ++chunk.vertex_base;
+        }
+        line = line_end(p, chunk.end) + 1;
+    }
+}
+
+void parse_chunk(ObjChunk& chunk) {
+    size_t vertex_count = chunk.vertex_base;
+    std::vector<int64_t> polygon;
+
+    for (const char* line = chunk.begin; line < chunk.end && chunk.error.empty();) {
+        const char* end = line_end(line, chunk.end);
+        const char* p = skip_spaces(line, end);
+
+        if (is_vertex_line(p, end)) {
+            p += 1;
+            for (int i = 0; i < 3; ++i) {
+                p = skip_spaces(p, end);
+                float value = 0.0f;
+                auto result = std::from_chars(p, end, value);
+                if (result.ec != std::errc()) {
+                    chunk.error = "bad vertex";
+                    break;
+                }
+                chunk.positions.push_back(value);
+                p = result.ptr;
+            }
+            ++vertex_count;
+        } else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            // Corners look like v, v/vt, v//vn or v/vt/vn; only v is used
+            polygon.clear();
+            p = skip_spaces(p + 1, end);
+            while (p < end && *p != '#') {
+                int64_t index = 0;
+                auto result = std::from_chars(p, end, index);
+                if (result.ec != std::errc() || index == 0) {
+                    chunk.error = "bad face";
+                    break;
+                }
+                // Negative indices count back from the latest vertex
+                int64_t resolved = index > 0 ? index - 1 : static_cast<int64_t>(vertex_count) + index;
+                polygon.push_back(resolved);
+                p = result.ptr;
+                while (p < end && *p != ' ' && *p != '\t' && *p != '\r') {
+                    ++p;
+                }
+                p = skip_spaces(p, end);
+            }
+            if (std::any_of(polygon.begin(), polygon.end(), [](int64_t v) { return v < 0; })) {
+                chunk.error = "face index out of range";
+            }
+            for (size_t i = 2; i < polygon.size() && chunk.error.empty(); ++i) {
+                chunk.indices.push_back(static_cast<uint32_t>(polygon[0]));
+                chunk.indices.push_back(static_cast<uint32_t>(polygon[i - 1]));
+                chunk.indices.push_back(static_cast<uint32_t>(polygon[i]));
+            }
+        }
+        line = end + 1;
+    }
+}
+
+template <typename Fn>
+void for_each_chunk(std::vector<ObjChunk>& chunks, Fn fn) {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        threads.emplace_back(fn, std::ref(chunks[i]));
+    }
+    fn(chunks[0]);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+float dot3(const float a[3], const float b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void cross3(const float a[3], const float b[3], float out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+}  // namespace
+
+Transform Transform::translate(const Vector3& offset) {
+    Transform t;
+    t.m[0][3] = offset.x;
+    t.m[1][3] = offset.y;
+    t.m[2][3] = offset.z;
+    return t;
+}
+
+Transform Transform::scale(const Vector3& factors) {
+    Transform t;
+    t.m[0][0] = factors.x;
+    t.m[1][1] = factors.y;
+    t.m[2][2] = factors.z;
+    return t;
+}
+
+Transform Transform::rotate(int axis, double degrees) {
+    double radians = degrees * 3.14159265358979323846 / 180.0;
+    double c = std::cos(radians);
+    double s = std::sin(radians);
+    int a = (axis + 1) % 3;
+    int b = (axis + 2) % 3;
+    Transform t;
+    t.m[a][a] = c;
+    t.m[a][b] = -s;
+    t.m[b][a] = s;
+    t.m[b][b] = c;
+    return t;
+}
+
+Transform Transform::operator*(const Transform& other) const {
+    Transform result;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            double sum = j == 3 ? m[i][3] : 0.0;
+            for (int k = 0; k < 3; ++k) {
+                sum += m[i][k] * other.m[k][j];
+            }
+            result.m[i][j] = sum;
+        }
+    }
+    return result;
+}
+
+Transform Transform::inverse() const {
+    // Inverse of the linear part by cofactors, then undo the translation
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                 m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                 m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    if (std::fabs(det) < 1e-300) {
+        throw std::runtime_error("Transform is not invertible");
+    }
+    double inv = 1.0 / det;
+
+    Transform result;
+    result.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv;
+    result.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv;
+    result.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv;
+    result.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * inv;
+    result.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv;
+    result.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv;
+    result.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv;
+    result.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv;
+    result.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv;
+    for (int i = 0; i < 3; ++i) {
+        result.m[i][3] = -(result.m[i][0] * m[0][3] + result.m[i][1] * m[1][3] +
+                           result.m[i][2] * m[2][3]);
+    }
+    return result;
+}
+
+Vector3 Transform::apply_point(const Vector3& p) const {
+    return Vector3(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                   m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                   m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+}
+
+Vector3 Transform::apply_vector(const Vector3& v) const {
+    return Vector3(m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                   m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                   m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+}
+
+TriangleMesh::TriangleMesh(std::vector<float> positions, std::vector<uint32_t> indices)
+    : positions_(std::move(positions)) {
+    if (positions_.size() % 3 != 0 || indices.size() % 3 != 0) {
+        throw std::runtime_error("Mesh arrays must hold whole vertices and triangles");
+    }
+    size_t vertices = positions_.size() / 3;
+    size_t triangles = indices.size() / 3;
+
+    std::vector<AABB> triangle_bounds(triangles);
+    for (size_t t = 0; t < triangles; ++t) {
+        for (int corner = 0; corner < 3; ++corner) {
+            uint32_t vertex = indices[3 * t + corner];
+            if (vertex >= vertices) {
+                throw std::runtime_error("Mesh triangle references vertex " + std::to_string(vertex) +
+                                         " of " + std::to_string(vertices));
+            }
+            triangle_bounds[t].expand(&positions_[3 * static_cast<size_t>(vertex)]);
+        }
+        bounds_.expand(triangle_bounds[t]);
+    }
+
+    BVH::BuildOptions options;
+    options.max_leaf_size = mesh_leaf_size;
+    bvh_.build(triangle_bounds, options);
+
+    // Store triangles in leaf order so leaves index them directly
+    indices_.resize(indices.size());
+    const uint32_t* order = bvh_.primitive_indices();
+    for (size_t t = 0; t < triangles; ++t) {
+        for (int corner = 0; corner < 3; ++corner) {
+            indices_[3 * t + corner] = indices[3 * static_cast<size_t>(order[t]) + corner];
+        }
+    }
+}
+
+std::shared_ptr<TriangleMesh> TriangleMesh::load_obj(const std::string& filename, int num_threads) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        throw std::runtime_error("Mesh file not found: " + filename);
+    }
+
+    // Split at line boundaries; pass one counts vertices per chunk so pass two
+    // can resolve relative (negative) face indices in parallel
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    size_t chunk_count = std::max<size_t>(1, std::min<size_t>(std::max(1, num_threads),
+                                                               file.size() / (1 << 20) + 1));
+    std::vector<ObjChunk> chunks;
+    const char* chunk_begin = begin;
+    for (size_t i = 0; i < chunk_count && (chunk_begin < end || chunks.empty()); ++i) {
+        const char* chunk_end = end;
+        if (i + 1 < chunk_count) {
+            chunk_end = line_end(std::max(chunk_begin, begin + file.size() * (i + 1) / chunk_count), end);
+            if (chunk_end < end) {
+                ++chunk_end;  // Keep the newline with its line
+            }
+        }
+        chunks.emplace_back(chunk_begin, chunk_end);
+        chunk_begin = chunk_end;
+    }
+
+    for_each_chunk(chunks, count_vertices);
+    size_t vertex_base = 0;
+    for (auto& chunk : chunks) {
+        size_t count = chunk.vertex_base;
+        chunk.vertex_base = vertex_base;
+        vertex_base += count;
+    }
+    for_each_chunk(chunks, parse_chunk);
+
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    for (auto& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            throw std::runtime_error("Invalid OBJ file " + filename + ": " + chunk.error);
+        }
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        indices.insert(indices.end(), chunk.indices.begin(), chunk.indices.end());
+        std::vector<float>().swap(chunk.positions);
+        std::vector<uint32_t>().swap(chunk.indices);
+    }
+    return std::make_shared<TriangleMesh>(std::move(positions), std::move(indices));
+}
+
+size_t TriangleMesh::memory_bytes() const {
+    return positions_.size() * sizeof(float) + indices_.size() * sizeof(uint32_t) +
+           bvh_.node_count() * sizeof(BVHNode) + bvh_.primitive_count() * sizeof(uint32_t);
+}
+
+float TriangleMesh::intersect_triangle(uint32_t triangle, const float origin[3],
+                                       const float direction[3], float t_min, float t_max) const {
+    const float* v0 = &positions_[3 * static_cast<size_t>(indices_[3 * triangle])];
+    const float* v1 = &positions_[3 * static_cast<size_t>(indices_[3 * triangle + 1])];
+    const float* v2 = &positions_[3 * static_cast<size_t>(indices_[3 * triangle + 2])];
+
+    float edge1[3] = {v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
+    float edge2[3] = {v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]};
+    float p[3];
+    cross3(direction, edge2, p);
+    float det = dot3(edge1, p);
+    if (det == 0.0f) {
+        return -1.0f;  // Ray parallel to the triangle's plane
+    }
+    float inv_det = 1.0f / det;
+
+    float s[3] = {origin[0] - v0[0], origin[1] - v0[1], origin[2] - v0[2]};
+    float u = dot3(s, p) * inv_det;
+    if (u < 0.0f || u > 1.0f) {
+        return -1.0f;
+    }
+    float q[3];
+    cross3(s, edge1, q);
+    float v = dot3(direction, q) * inv_det;
+    if (v < 0.0f || u + v > 1.0f) {
+        return -1.0f;
+    }
+    float t = dot3(edge2, q) * inv_det;
+    return (t > t_min && t < t_max) ? t : -1.0f;
+}
+
+bool TriangleMesh::intersect(const float origin[3], const float direction[3], float t_min,
+                             float& t_max, uint32_t& triangle) const {
+    bool found = false;
+    double limit = t_max;
+    BVHRay ray(origin[0], origin[1], origin[2], direction[0], direction[1], direction[2]);
+    bvh_.traverse(ray, limit, [&](uint32_t first, uint32_t count, double& t_limit) {
+        for (uint32_t i = first; i < first + count; ++i) {
+            RT_COUNT(intersection_tests, 1);
+            float t = intersect_triangle(i, origin, direction, t_min, t_max);
+            if (t >= 0.0f) {
+                t_max = t;
+                t_limit = t;
+                triangle = i;
+                found = true;
+            }
+        }
+        return false;
+    });
+    return found;
+}
+
+bool TriangleMesh::occluded(const float origin[3], const float direction[3], float t_min,
+                            float t_max) const {
+    bool blocked = false;
+    double limit = t_max;
+    BVHRay ray(origin[0], origin[1], origin[2], direction[0], direction[1], direction[2]);
+    bvh_.traverse(ray, limit, [&](uint32_t first, uint32_t count, double&) {
+        for (uint32_t i = first; i < first + count && !blocked; ++i) {
+            RT_COUNT(intersection_tests, 1);
+            blocked = intersect_triangle(i, origin, direction, t_min, t_max) >= 0.0f;
+        }
+        return blocked;
+    });
+    return blocked;
+}
+
+Vector3 TriangleMesh::normal(uint32_t triangle) const {
+    const float* v0 = &positions_[3 * static_cast<size_t>(indices_[3 * triangle])];
+    const float* v1 = &positions_[3 * static_cast<size_t>(indices_[3 * triangle + 1])];
+    const float* v2 = &positions_[3 * static_cast<size_t>(indices_[3 * triangle + 2])];
+    Vector3 edge1(v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]);
+    Vector3 edge2(v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]);
+    return edge1.cross(edge2);
+}
+
+MeshInstance::MeshInstance(uint32_t mesh, uint32_t material, const Transform& object_to_world)
+    : mesh(mesh), material(material) {
+    Transform inverse = object_to_world.inverse();
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            world_to_object[i][j] = static_cast<float>(inverse.m[i][j]);
+        }
+    }
+}
+
+Transform MeshInstance::object_to_world() const {
+    Transform world_to_object_transform;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            world_to_object_transform.m[i][j] = world_to_object[i][j];
+        }
+    }
+    return world_to_object_transform.inverse();
+}
@@ -1,27 +1,129 @@
 #include "ray_tracer.h"
+#include "accelerator.h"
+#include "animation.h"
+#include "checkpoint.h"
+#include "framebuffer.h"
+#include "image_encoder.h"
+#include "instrumentation.h"
 #include "scene.h"
-#include "ppm_writer.h"
+#include "pixel_estimate.h"
 #include "texture.h"
+#include "wavefront.h"
 #include <cmath>
 #include <algorithm>
-#include <random>
-#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <vector>
+#include <iomanip>
 #include <iostream>
 
+namespace {
+
+// Sampler of the tile the thread is rendering
+thread_local Sampler* thread_sampler = nullptr;
+
+// Rays traced by this thread in the current tile
+struct RayCounts {
+    uint64_t primary = 0;
+    uint64_t secondary = 0;
+    uint64_t shadow = 0;
+};
+thread_local RayCounts thread_rays;
+
+// Blue (t = 0) through green to red (t = 1)
+Vector3 heatmap_color(double t) {
+    t = std::clamp(t, 0.0, 1.0);
+    return t < 0.5 ? Vector3(0, 2 * t, 1 - 2 * t) : Vector3(2 * t - 1, 2 - 2 * t, 0);
+}
+
+// Average each pixel's summed samples into RGB
+void average_samples(const PixelEstimate* estimates, size_t count, float* rgb) {
+    for (size_t i = 0; i < count; ++i) {
+        float scale = estimates[i].samples ? 1.0f / estimates[i].samples : 0.0f;
+        rgb[3 * i] = estimates[i].sum[0] * scale;
+        rgb[3 * i + 1] = estimates[i].sum[1] * scale;
+        rgb[3 * i + 2] = estimates[i].sum[2] * scale;
+    }
+}
+
+#ifdef RAY_TRACER_INSTRUMENT
+/**
+ * ThreadProfile - One render thread's instrumentation totals
+ */
+struct ThreadProfile {
+    TraceCounters counters;
+    uint64_t camera_rays = 0;
+    uint64_t reflection_rays = 0;
+    uint64_t shadow_rays = 0;
+    uint64_t tiles = 0;  // Tile visits: each pass visits every tile again
+    double tile_seconds = 0.0;
+    double max_tile_seconds = 0.0;
+};
+
+void print_profile(const std::vector<ThreadProfile>& profiles) {
+    ThreadProfile total;
+    for (const auto& profile : profiles) {
+        total.counters.node_visits += profile.counters.node_visits;
+        total.counters.intersection_tests += profile.counters.intersection_tests;
+        total.counters.max_depth = std::max(total.counters.max_depth, profile.counters.max_depth);
+        total.camera_rays += profile.camera_rays;
+        total.reflection_rays += profile.reflection_rays;
+        total.shadow_rays += profile.shadow_rays;
+        total.tiles += profile.tiles;
+        total.tile_seconds += profile.tile_seconds;
+        total.max_tile_seconds = std::max(total.max_tile_seconds, profile.max_tile_seconds);
+    }
+
+    auto row = [](const std::string& name, const ThreadProfile& profile) {
+        double mean_ms = profile.tiles ? 1000.0 * profile.tile_seconds / profile.tiles : 0.0;
+        std::cout << std::left << std::setw(7) << name << std::right << std::setw(7)
+                  << profile.tiles << std::fixed << std::setprecision(2) << std::setw(10)
+                  << mean_ms << std::setw(10) << 1000.0 * profile.max_tile_seconds
+                  << std::setw(12) << profile.camera_rays << std::setw(12)
+                  << profile.reflection_rays << std::setw(12) << profile.shadow_rays
+                  << std::setw(14) << profile.counters.node_visits << std::setw(14)
+                  << profile.counters.intersection_tests << std::setw(6)
+                  << profile.counters.max_depth << "\n";
+    };
+
+    std::cout << "Render profile:\n"
+              << std::left << std::setw(7) << "thread" << std::right << std::setw(7) << "tiles"
+              << std::setw(10) << "tile ms" << std::setw(10) << "max ms" << std::setw(12)
+              << "camera" << std::setw(12) << "reflection" << std::setw(12) << "shadow"
+              << std::setw(14) << "BVH nodes" << std::setw(14) << "tests" << std::setw(6)
+              << "depth" << "\n";
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        row(std::to_string(i), profiles[i]);
+    }
+    row("total", total);
+
+    uint64_t rays = total.camera_rays + total.reflection_rays + total.shadow_rays;
+    if (rays > 0) {
+        std::cout << std::setprecision(1) << "Per ray: "
+                  << static_cast<double>(total.counters.node_visits) / rays << " BVH nodes, "
+                  << static_cast<double>(total.counters.intersection_tests) / rays
+                  << " intersection tests\n";
+    }
+    std::cout.copyfmt(std::ios(nullptr));
+}
+#endif
+
+}  // namespace
+
 RayTracer::RayTracer(int width, int height, int samples_per_pixel)
     : width_(width), height_(height), samples_per_pixel_(samples_per_pixel) {
 }
 
-double RayTracer::random_float() const {
-    static thread_local std::mt19937 gen(std::random_device{}());
-    static thread_local std::uniform_real_distribution<> dis(0.0, 1.0);
-    return dis(gen);
+RayTracer::~RayTracer() = default;
+
+void RayTracer::set_accelerator(std::unique_ptr<SceneAccelerator> accelerator) {
+    prebuilt_accelerator_ = std::move(accelerator);
 }
 
-Vector3 RayTracer::random_on_sphere(double radius) const {
-    double u = random_float();
-    double v = random_float();
+Vector3 RayTracer::random_on_sphere(double radius, const Sample2D& sample) const {
+    double u = sample.u;
+    double v = sample.v;
     double theta = 2.0 * 3.14159 * u;
     double phi = std::acos(2.0 * v - 1.0);
     
@@ -32,64 +134,81 @@ Vector3 RayTracer::random_on_sphere(double radius) const {
     return Vector3(x, y, z);
 }
 
-RayTracer::HitInfo RayTracer::check_intersection(const Vector3& origin, 
-                                                  const Vector3& direction,
-                                                  const Scene& scene) {
-    HitInfo closest = {false, 1e10, Vector3(), Vector3(), nullptr};
-
-    for (const auto& sphere : scene.get_spheres()) {
-        // Ray-sphere intersection (quadratic equation)
-        Vector3 oc = origin - sphere.center;
-        double a = direction.dot(direction);
-        double b = 2.0 * oc.dot(direction);
-        double c = oc.dot(oc) - sphere.radius * sphere.radius;
-        double discriminant = b * b - 4 * a * c;
-
-        if (discriminant >= 0) {
-            double t = (-b - std::sqrt(discriminant)) / (2 * a);
-            if (t > 0.001 && t < closest.t) {
-                closest.hit = true;
-                closest.t = t;
-                closest.point = origin + direction * t;
-                closest.normal = (closest.point - sphere.center).normalize();
-                closest.sphere = &sphere;
-            }
-        }
+RayTracer::HitInfo RayTracer::check_intersection(const Vector3& origin,
+                                                  const Vector3& direction, double cone_width) {
+    HitInfo closest = {false, 1e10, Vector3(), Vector3(), 0};
+
+    SceneAccelerator::Hit hit = accelerator_->closest_hit(origin, direction, 0.001, 1e10);
+    if (hit.hit) {
+        closest.hit = true;
+        closest.t = hit.t;
+        closest.point = origin + direction * hit.t;
+        closest.normal = hit.normal;
+        closest.material = hit.material;
+        closest.footprint = cone_width + hit.t * pixel_spread_;
+        closest.radius = hit.sphere ? hit.sphere->radius : 0.0;
     }
 
     return closest;
 }
 
 Vector3 RayTracer::calculate_lighting(const HitInfo& hit, const Vector3& view_dir,
-                                       const Scene& scene, int depth) {
-    if (!hit.sphere) {
-        return scene.get_background_color();
-    }
-
-    const auto& material = hit.sphere->material;
+                                       const Scene& scene) {
+    const auto& material = scene.get_materials()[hit.material];
     Vector3 color(0, 0, 0);
 
     // Ambient light
     color = color + material.color * material.ambient;
 
-    // Process each light
-    for (const auto& light : scene.get_lights()) {
+    // Every light in turn, or light_picks_ of them picked by their likely
+    // contribution: each pick claims a shadow dimension after the one its
+    // choice is drawn from, so paths use the same dimensions in wavefront mode
+    const auto& lights = scene.get_lights();
+    uint32_t pick_count = light_picks_ > 0 ? light_picks_ : static_cast<uint32_t>(lights.size());
+    uint32_t pick_dimension = light_picks_ > 0 ? thread_sampler->next_dimension() : 0;
+    for (uint32_t j = 0; j < pick_count; ++j) {
+        uint32_t dimension = thread_sampler->next_dimension();
+        uint32_t light_index = j;
+        double weight = 1.0;
+        if (light_picks_ > 0) {
+            Sample2D choice = thread_sampler->loop_point(pick_dimension, j, pick_count);
+            LightTree::Pick pick = pick_light(hit, material, choice.u);
+            if (pick.pdf <= 0.0) {
+                continue;
+            }
+            light_index = pick.light;
+            weight = 1.0 / (pick.pdf * pick_count);
+        }
+        const Light& light = lights[light_index];
         Vector3 light_dir = (light.position - hit.point).normalize();
         
-        // Soft shadow calculation
-        double shadow_factor = 1.0;
-        int shadow_samples = 5;
-        
-        for (int s = 0; s < shadow_samples; ++s) {
-            Vector3 jittered_light = light.position + random_on_sphere(light.radius);
-            Vector3 shadow_ray_dir = (jittered_light - hit.point).normalize();
-            HitInfo shadow_hit = check_intersection(hit.point + hit.normal * 0.001, 
-                                                   shadow_ray_dir, scene);
-            
-            if (!shadow_hit.hit) {
-                shadow_factor += 1.0 / shadow_samples;
+        // Soft shadow: fraction of jittered light positions visible, refined
+        // beyond the probe samples only inside a penumbra
+        Vector3 shadow_origin = hit.point + hit.normal * 0.001;
+        int samples = 0;
+        int visible = 0;
+        int max_samples = std::max({1, shadow_probe_samples_, shadow_max_samples_});
+        auto trace_shadow_ray = [&]() {
+            Sample2D sample = thread_sampler->loop_point(dimension, samples, max_samples);
+            ++thread_rays.shadow;
+            Vector3 to_light =
+                light.position + random_on_sphere(light.radius, sample) - shadow_origin;
+            double distance = to_light.length();
+            if (!accelerator_->occluded(shadow_origin, to_light / distance, 0.001, distance)) {
+                ++visible;
             }
+            ++samples;
+        };
+
+        while (samples < std::max(1, shadow_probe_samples_)) {
+            trace_shadow_ray();
         }
+        if (visible != 0 && visible != samples) {
+            while (samples < shadow_max_samples_) {
+                trace_shadow_ray();
+            }
+        }
+        double shadow_factor = static_cast<double>(visible) / samples * weight;
 
         // Diffuse shading
         double diffuse_intensity = std::max(0.0, hit.normal.dot(light_dir));
@@ -108,7 +227,8 @@ Vector3 RayTracer::calculate_lighting(const HitInfo& hit, const Vector3& view_di
 
 Vector3 RayTracer::calculate_reflection(const HitInfo& hit, const Vector3& view_dir,
                                         const Scene& scene, int depth) {
-    if (hit.sphere->material.reflection <= 0.0 || depth >= max_depth_) {
+    const auto& material = scene.get_materials()[hit.material];
+    if (material.reflection <= 0.0 || depth >= max_depth_) {
         return Vector3(0, 0, 0);
     }
 
@@ -116,91 +236,835 @@ Vector3 RayTracer::calculate_reflection(const HitInfo& hit, const Vector3& view_
     Vector3 reflect_dir = view_dir - hit.normal * 2.0 * view_dir.dot(hit.normal);
     reflect_dir = reflect_dir.normalize();
 
+    ++thread_rays.secondary;
+    // The cone keeps widening as if the mirror were flat
     Vector3 reflected_color = cast_ray(hit.point + hit.normal * 0.001, 
-                                       reflect_dir, scene, depth + 1);
+                                       reflect_dir, scene, depth + 1, hit.footprint);
     
-    return reflected_color * hit.sphere->material.reflection;
+    return reflected_color * material.reflection;
 }
 
 Vector3 RayTracer::cast_ray(const Vector3& origin, const Vector3& direction,
-                            const Scene& scene, int depth) {
-    HitInfo hit = check_intersection(origin, direction, scene);
+                            const Scene& scene, int depth, double cone_width) {
+    RT_COUNT_MAX(max_depth, static_cast<uint32_t>(depth));
+    HitInfo hit = check_intersection(origin, direction, cone_width);
 
     if (!hit.hit) {
         return scene.get_background_color();
     }
 
     Vector3 view_dir = direction.normalize();
-    Vector3 color = calculate_lighting(hit, view_dir, scene, depth);
-    
+    return (this->*material_shading_[hit.material].kernel)(hit, view_dir, scene, depth);
+}
+
+template <Texture::Type Pattern, bool Reflective>
+Vector3 RayTracer::shade(const HitInfo& hit, const Vector3& view_dir, const Scene& scene, int depth) {
+    Vector3 color = calculate_lighting(hit, view_dir, scene);
+
     // Add reflection
-    color = color + calculate_reflection(hit, view_dir, scene, depth);
+    if constexpr (Reflective) {
+        color = color + calculate_reflection(hit, view_dir, scene, depth);
+    }
 
     // Apply texture
-    if (hit.sphere->material.texture) {
-        Vector3 texture_color = hit.sphere->material.texture->get_color(0, 0, hit.point);
-        color = color * texture_color;
+    if constexpr (Pattern == Texture::Type::SOLID) {
+        return color * material_shading_[hit.material].tint;
+    } else if constexpr (Pattern == Texture::Type::IMAGE) {
+        const auto& texture = scene.get_textures()[scene.get_materials()[hit.material].texture];
+        return color * image_color(texture, hit);
+    } else {
+        const auto& texture = scene.get_textures()[scene.get_materials()[hit.material].texture];
+        return color * texture.evaluate<Pattern>(hit.point);
     }
+}
 
-    return color;
+Vector3 RayTracer::surface_albedo(const HitInfo& hit, const Scene& scene) const {
+    const MaterialShading& shading = material_shading_[hit.material];
+    if (shading.kind / 2 == static_cast<uint32_t>(Texture::Type::SOLID)) {
+        return shading.tint;
+    }
+    const auto& texture = scene.get_textures()[scene.get_materials()[hit.material].texture];
+    if (shading.kind / 2 == static_cast<uint32_t>(Texture::Type::IMAGE)) {
+        return image_color(texture, hit);
+    }
+    return texture.get_color(0.0, 0.0, hit.point);
+}
+
+Vector3 RayTracer::image_color(const Texture& texture, const HitInfo& hit) const {
+    // Latitude and longitude of the normal, which on a sphere points away
+    // from its center. Meshes carry no texture coordinates and are mapped by
+    // their normals the same way, without a footprint (full resolution).
+    constexpr double pi = 3.14159265358979323846;
+    const Vector3& n = hit.normal;
+    double u = 0.5 + std::atan2(n.z, n.x) / (2.0 * pi);
+    double v = 0.5 - std::asin(std::clamp(n.y, -1.0, 1.0)) / pi;
+
+    // The footprint spans 1 / (2 pi r) of u along the equator and 1 / (pi r)
+    // of v
+    double du = 0.0;
+    double dv = 0.0;
+    if (hit.radius > 0.0) {
+        du = hit.footprint / (2.0 * pi * hit.radius);
+        dv = hit.footprint / (pi * hit.radius);
+    }
+    return texture.sample_image(u, v, du, dv);
+}
+
+LightTree::Pick RayTracer::pick_light(const HitInfo& hit, const Material& material,
+                                     double u) const {
+    const Vector3& color = material.color;
+    double diffuse = material.diffuse * (color.x + color.y + color.z) / 3.0;
+    return light_tree_.sample(hit.point, hit.normal, diffuse, material.specular, u);
+}
+
+void RayTracer::prepare_shading(const Scene& scene) {
+    static const ShadeKernel kernels[4][2] = {
+        {&RayTracer::shade<Texture::Type::SOLID, false>,
+         &RayTracer::shade<Texture::Type::SOLID, true>},
+        {&RayTracer::shade<Texture::Type::CHECKERBOARD, false>,
+         &RayTracer::shade<Texture::Type::CHECKERBOARD, true>},
+        {&RayTracer::shade<Texture::Type::GRADIENT, false>,
+         &RayTracer::shade<Texture::Type::GRADIENT, true>},
+        {&RayTracer::shade<Texture::Type::IMAGE, false>,
+         &RayTracer::shade<Texture::Type::IMAGE, true>},
+    };
+
+    material_shading_.clear();
+    material_shading_.reserve(scene.get_materials().size());
+    for (const auto& material : scene.get_materials()) {
+        // Untextured materials are tinted by their own color
+        Texture::Type pattern = Texture::Type::SOLID;
+        Vector3 tint = material.color;
+        if (material.texture != Material::no_texture) {
+            const auto& texture = scene.get_textures()[material.texture];
+            pattern = texture.type();
+            tint = texture.color1();
+        }
+        uint32_t kind = static_cast<uint32_t>(pattern) * 2 + (material.reflection > 0.0 ? 1 : 0);
+        material_shading_.push_back({kernels[kind / 2][kind % 2], kind, tint});
+    }
 }
 
 void RayTracer::render_scene(const Scene& scene, const std::string& output_file) {
-    PPMWriter writer(width_, height_);
+    stop_requested_.store(false, std::memory_order_relaxed);
+
+    if (prebuilt_accelerator_) {
+        accelerator_ = std::move(prebuilt_accelerator_);
+    } else {
+        accelerator_ = std::make_unique<SceneAccelerator>(scene, num_threads_);
+    }
+    std::cout << "BVH: " << accelerator_->bvh().node_count() << " nodes, depth "
+              << accelerator_->bvh().depth() << ", built in " << accelerator_->build_ms()
+              << " ms, " << simd_level_name(accelerator_->simd_level()) << " kernels ("
+              << (sizeof(intersect_real) == 4 ? "float" : "double") << ")\n";
+
+    std::cout << "Rendering with " << num_threads_ << " threads in "
+              << tile_options_.tile_size << "x" << tile_options_.tile_size << " tiles...\n";
+    std::cout << "Max reflection depth: " << max_depth_ << "\n";
+
+    render_frame(scene, {output_file, heatmap_file_, cost_heatmap_file_, feature_prefix_}, false);
+}
+
+void RayTracer::render_sequence(Scene& scene, const Animation& animation,
+                                const std::string& output_pattern) {
+    stop_requested_.store(false, std::memory_order_relaxed);
+    if (streaming_ || !checkpoint_file_.empty()) {
+        throw std::runtime_error("Sequences cannot be streamed or checkpointed");
+    }
+
+    int frames = animation.frame_count();
+    Camera base_camera = scene.get_camera();
+    std::cout << "Rendering " << frames << " frames with " << num_threads_ << " threads in "
+              << tile_options_.tile_size << "x" << tile_options_.tile_size << " tiles to "
+              << output_pattern << "\n";
+
+    // Built on the first frame unless given; an earlier render's is for another scene
+    accelerator_ = std::move(prebuilt_accelerator_);
+    auto start = std::chrono::steady_clock::now();
+    double trace_seconds = 0.0;
+    int builds = 0;
+    int refits = 0;
+    int rendered = 0;
+    for (int frame = 0; frame < frames && !stop_requested_.load(std::memory_order_relaxed); ++frame) {
+        auto frame_start = std::chrono::steady_clock::now();
+        animation.apply(frame, base_camera, scene);
+
+        // Spheres only move, so the tree keeps its shape; rebuild once
+        // refits have loosened it too much
+        std::string bvh_update = "reused";
+        if (!accelerator_ || (animation.moves_spheres() && !accelerator_->refit())) {
+            accelerator_ = std::make_unique<SceneAccelerator>(scene, num_threads_);
+            bvh_update = "built";
+            ++builds;
+        } else if (animation.moves_spheres()) {
+            bvh_update = "refit";
+            ++refits;
+        }
+
+        FrameOutputs outputs;
+        outputs.image = frame_filename(output_pattern, frame);
+        if (!heatmap_file_.empty()) {
+            outputs.heatmap = frame_filename(heatmap_file_, frame);
+        }
+        if (!cost_heatmap_file_.empty()) {
+            outputs.cost_heatmap = frame_filename(cost_heatmap_file_, frame);
+        }
+        if (!feature_prefix_.empty()) {
+            outputs.features = frame_filename(feature_prefix_, frame);
+        }
+        render_frame(scene, outputs, true);
+        trace_seconds += stats_.render_seconds;
+        ++rendered;
+
+        double frame_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - frame_start).count();
+        std::cout << "Frame " << frame + 1 << "/" << frames << ": " << outputs.image << ", "
+                  << frame_ms << " ms, BVH " << bvh_update;
+        if (bvh_update != "reused") {
+            std::cout << " in " << accelerator_->build_ms() << " ms";
+        }
+        std::cout << "\n";
+    }
+    finish_output();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Sequence: " << rendered << " frames in " << seconds << " s ("
+              << 1000.0 * seconds / std::max(1, rendered) << " ms/frame, "
+              << 1000.0 * (seconds - trace_seconds) / std::max(1, rendered)
+              << " ms/frame outside tracing), BVH " << builds << " builds, " << refits
+              << " refits\n";
+    if (stop_requested_.load(std::memory_order_relaxed)) {
+        std::cout << "Sequence stopped after frame " << rendered << "\n";
+    }
+}
+
+void RayTracer::render_region(const Scene& scene, const Tile& region, std::vector<float>& rgb) {
+    stop_requested_.store(false, std::memory_order_relaxed);
+    if (prebuilt_accelerator_) {
+        accelerator_ = std::move(prebuilt_accelerator_);
+    } else if (!accelerator_) {
+        accelerator_ = std::make_unique<SceneAccelerator>(scene, num_threads_);
+    }
+
+    FrameOutputs outputs;
+    outputs.region_rgb = &rgb;
+    outputs.region = region;
+    render_frame(scene, outputs, false);
+}
+
+void RayTracer::finish_output() {
+    if (pending_output_.valid()) {
+        spare_pixels_ = pending_output_.get();
+    }
+}
+
+void RayTracer::render_frame(const Scene& scene, const FrameOutputs& outputs, bool pipelined) {
+#ifndef RAY_TRACER_INSTRUMENT
+    if (!outputs.cost_heatmap.empty()) {
+        throw std::runtime_error("Cost heatmaps need a build with RAY_TRACER_INSTRUMENTATION=ON");
+    }
+#endif
+    if (wavefront_ && !outputs.cost_heatmap.empty()) {
+        throw std::runtime_error("Cost heatmaps time pixels one at a time: not in wavefront mode");
+    }
 
     // Camera setup (simple perspective camera)
-    Vector3 camera_pos(0, 1, 2);
-    double fov = 60.0;
+    const Camera& camera = scene.get_camera();
+    Vector3 camera_pos = camera.position;
+    Vector3 forward = (camera.look_at - camera.position).normalize();
+    Vector3 right = forward.cross(camera.up).normalize();
+    Vector3 camera_up = right.cross(forward);
     double aspect_ratio = static_cast<double>(width_) / height_;
-    double h = std::tan(fov * 3.14159 / 360.0);
+    double h = std::tan(camera.fov * 3.14159 / 360.0);
     double w = h * aspect_ratio;
+    pixel_spread_ = 2.0 * h / height_;
 
-    std::cout << "Rendering with " << num_threads_ << " threads...\n";
-    std::cout << "Max reflection depth: " << max_depth_ << "\n";
+    prepare_shading(scene);
+
+    // Sampling fewer lights than the scene has needs this frame's light tree
+    const auto& lights = scene.get_lights();
+    light_picks_ = 0;
+    if (light_samples_ > 0 && static_cast<size_t>(light_samples_) < lights.size()) {
+        light_tree_.build(lights);
+        light_picks_ = static_cast<uint32_t>(light_samples_);
+    }
+
+    // Threads are started once and woken for every pass and frame
+    int num_threads = std::max(1, num_threads_);
+    if (!pool_ || pool_->size() != num_threads || pool_->pinned() != tile_options_.pin_threads) {
+        pool_.reset();
+        pool_ = std::make_unique<WorkerPool>(num_threads, tile_options_.pin_threads);
+    }
+    TileScheduler::Options tile_options = tile_options_;
+    tile_options.num_threads = num_threads;
+    tile_options.pool = pool_.get();
+
+    // Without a noise threshold every pixel takes exactly samples_per_pixel_;
+    // progressive mode always works in passes of pass_samples_
+    bool adaptive = noise_threshold_ > 0.0;
+    int max_samples = std::max(1, samples_per_pixel_);
+    int min_samples = adaptive ? std::clamp(min_samples_, 1, max_samples) : max_samples;
+    int pass_samples = pass_samples_ > 0 ? std::min(pass_samples_, max_samples) : min_samples;
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                std::chrono::duration<double>(time_budget_seconds_));
+    bool region_only = outputs.region_rgb != nullptr;
+    bool has_deadline = time_budget_seconds_ > 0.0 && !region_only;
+
+    // Streaming renders one row of tiles at a time and writes it out before
+    // starting the next, so only that band's samples are ever held
+    if (streaming_ && !checkpoint_file_.empty()) {
+        throw std::runtime_error("Streaming renders cannot be checkpointed");
+    }
+    int band_rows = streaming_ ? tile_options.tile_size : height_;
+
+    // A region is one band covering only its window of columns and rows
+    int window_x0 = 0;
+    int window_width = width_;
+    if (region_only) {
+        const Tile& region = outputs.region;
+        if (region.x0 < 0 || region.y0 < 0 || region.x1 > width_ || region.y1 > height_ ||
+            region.x0 >= region.x1 || region.y0 >= region.y1) {
+            throw std::out_of_range("Region is empty or outside the image");
+        }
+        if (streaming_ || !checkpoint_file_.empty()) {
+            throw std::runtime_error("Regions cannot be streamed or checkpointed");
+        }
+        window_x0 = region.x0;
+        window_width = region.x1 - region.x0;
+        band_rows = region.y1 - region.y0;
+    }
+
+    // Feature buffers follow the camera samples of a whole image in memory
+    bool features_on = !region_only && (denoise_ || !outputs.features.empty());
+    if (features_on && (streaming_ || !checkpoint_file_.empty())) {
+        throw std::runtime_error("Denoising and feature buffers cannot be streamed or checkpointed");
+    }
+    FeatureBuffers features;
+    if (features_on) {
+        features.allocate(width_, height_);
+    }
+
+    // A pixel is done at max_samples, or once its noise is within the threshold
+    auto pixel_converged = [&](const PixelEstimate& estimate) {
+        double tolerance = adaptive ? noise_threshold_ * std::max<double>(estimate.mean, 0.01)
+                                    : 0.0;
+        return estimate.samples >= static_cast<uint32_t>(max_samples) ||
+               (estimate.samples >= static_cast<uint32_t>(min_samples) &&
+                estimate.confidence_half_width() <= tolerance);
+    };
 
-    // Parallel rendering using threads
-    std::vector<std::thread> threads;
-    int rows_per_thread = (height_ + num_threads_ - 1) / num_threads_;
-
-    auto render_rows = [this, &writer, &scene, camera_pos, w, h, aspect_ratio]
-                       (int start_y, int end_y) {
-        for (int y = start_y; y < end_y && y < height_; ++y) {
-            for (int x = 0; x < width_; ++x) {
-                Vector3 color(0, 0, 0);
-
-                // Multi-sampling for anti-aliasing
-                for (int s = 0; s < samples_per_pixel_; ++s) {
-                    double u = (2.0 * x - width_) / height_ * w;
-                    double v = (height_ - 2.0 * y) / height_ * h;
-                    
-                    // Add jitter for anti-aliasing
-                    u += (random_float() - 0.5) * 0.01;
-                    v += (random_float() - 0.5) * 0.01;
-
-                    Vector3 ray_dir = Vector3(u, v, -1).normalize();
-                    color = color + cast_ray(camera_pos, ray_dir, scene);
+    RenderCheckpoint state;
+    if (resume_ && !checkpoint_file_.empty() && load_checkpoint(checkpoint_file_, state, scratch_file_)) {
+        if (state.width != width_ || state.height != height_) {
+            throw std::runtime_error("Checkpoint " + checkpoint_file_ + " is for a " +
+                                     std::to_string(state.width) + "x" +
+                                     std::to_string(state.height) + " image");
+        }
+        // Settings may differ from the interrupted run: re-test every pixel
+        for (auto& estimate : state.pixels) {
+            estimate.converged = pixel_converged(estimate);
+        }
+        std::cout << "Resuming from " << checkpoint_file_ << " after " << state.passes
+                  << " passes\n";
+    } else {
+        state.width = width_;
+        state.height = height_;
+        state.seed = seed_;
+        size_t pixel_count = static_cast<size_t>(window_width) * band_rows;
+        if (spare_pixels_.size() == pixel_count) {
+            // Reusing an earlier frame's buffer skips mapping and faulting in fresh pages
+            state.pixels = std::move(spare_pixels_);
+            std::fill(state.pixels.begin(), state.pixels.end(), PixelEstimate());
+        } else {
+            state.pixels.allocate(pixel_count, scratch_file_);
+        }
+    }
+    MappedBuffer<PixelEstimate>& estimates = state.pixels;
+
+    // Strips of the output image are encoded as soon as the last tile covering
+    // them finishes its final pass, overlapping encoding with rendering
+    // (held by pointer so a pipelined frame can hand it to its writer)
+    std::unique_ptr<ImageEncoder> encoder;
+    if (!region_only) {
+        encoder = std::make_unique<ImageEncoder>(width_, height_, image_format_for(outputs.image),
+                                                 tile_options.tile_size);
+    }
+    std::unique_ptr<ImageEncoder> heatmap_encoder;
+    int band_y0 = 0;
+    ImageEncoder::RowSource final_rows;
+    int tiles_per_row = (width_ + tile_options.tile_size - 1) / tile_options.tile_size;
+    std::vector<std::atomic<int>> tiles_finished(encoder ? encoder->strip_count() : 0);
+    bool final_pass = false;
+    if (streaming_) {
+        std::cout << "Streaming " << encoder->strip_count() << " bands of " << band_rows
+                  << " rows to " << outputs.image << "\n";
+        encoder->begin_stream(outputs.image);
+        if (!outputs.heatmap.empty()) {
+            heatmap_encoder = std::make_unique<ImageEncoder>(
+                width_, height_, image_format_for(outputs.heatmap), tile_options.tile_size);
+            heatmap_encoder->begin_stream(outputs.heatmap);
+        }
+    }
+
+    std::atomic<size_t> active_pixels{0};
+    std::atomic<uint64_t> primary_rays{0};
+    std::atomic<uint64_t> secondary_rays{0};
+    std::atomic<uint64_t> shadow_rays{0};
+    std::atomic<bool> interrupted{false};
+    uint32_t target_samples = 0;
+    bool image_complete = false;
+#ifdef RAY_TRACER_INSTRUMENT
+    // Written by the tile owning each pixel, read after rendering
+    std::vector<ThreadProfile> profiles(std::max(1, num_threads_));
+    std::vector<uint64_t> pixel_cost(outputs.cost_heatmap.empty() ? 0 : static_cast<size_t>(width_) * height_);
+#endif
+
+    // Jittered camera ray through image pixel (image_x, image_y) for a sample
+    auto camera_ray = [&](Sampler& sampler, int image_x, int image_y, uint32_t index) {
+        double u = (2.0 * image_x - width_) / height_ * w;
+        double v = (height_ - 2.0 * image_y) / height_ * h;
+
+        // Add jitter for anti-aliasing
+        sampler.start_sample(image_x, image_y, index);
+        Sample2D jitter = sampler.next_2d();
+        u += (jitter.u - 0.5) * 0.01;
+        v += (jitter.v - 0.5) * 0.01;
+        return (right * u + camera_up * v + forward).normalize();
+    };
+
+    auto add_features = [&](size_t pixel, const HitInfo& hit) {
+        if (hit.hit) {
+            features.add(pixel, surface_albedo(hit, scene), hit.normal, hit.t);
+        } else {
+            features.add(pixel, Vector3(1, 1, 1), Vector3(0, 0, 0), 0.0);
+        }
+    };
+
+    auto render_tile = [&](const Tile& tile, [[maybe_unused]] int thread_index) {
+        // Once every pixel has a sample, refinement may stop at any tile
+        if (stop_requested_.load(std::memory_order_relaxed) ||
+            (image_complete && has_deadline && std::chrono::steady_clock::now() >= deadline)) {
+            interrupted.store(true, std::memory_order_relaxed);
+            return;
+        }
+        std::unique_ptr<Sampler> sampler = make_sampler(sampler_type_, state.seed);
+        thread_sampler = sampler.get();
+        thread_rays = RayCounts();
+#ifdef RAY_TRACER_INSTRUMENT
+        auto tile_start = std::chrono::steady_clock::now();
+        thread_counters = TraceCounters();
+        bool record_cost = !pixel_cost.empty();
+#endif
+
+        // One round per sample: every pixel short of target_samples traces a
+        // camera ray, then the hits are shaded grouped by material so each
+        // kernel runs over a coherent batch
+        thread_local std::vector<PrimarySample> batch;
+        thread_local std::vector<std::pair<uint64_t, uint32_t>> order;
+        while (!wavefront_) {
+            batch.clear();
+            for (int y = tile.y0; y < tile.y1; ++y) {
+                int image_y = band_y0 + y;
+                for (int x = tile.x0; x < tile.x1; ++x) {
+                    size_t pixel = static_cast<size_t>(y) * window_width + x;
+                    const PixelEstimate& estimate = estimates[pixel];
+                    if (estimate.converged || estimate.samples >= target_samples) {
+                        continue;
+                    }
+
+                    int image_x = window_x0 + x;
+                    Vector3 ray_dir = camera_ray(*sampler, image_x, image_y, estimate.samples);
+#ifdef RAY_TRACER_INSTRUMENT
+                    uint64_t trace_start = record_cost ? cost_clock() : 0;
+#endif
+                    batch.push_back({pixel, static_cast<uint32_t>(image_x),
+                                     static_cast<uint32_t>(image_y),
+                                     estimate.samples, ray_dir,
+                                     check_intersection(camera_pos, ray_dir)});
+#ifdef RAY_TRACER_INSTRUMENT
+                    if (record_cost) {
+                        pixel_cost[static_cast<size_t>(image_y) * width_ + image_x] +=
+                            cost_clock() - trace_start;
+                    }
+#endif
                 }
+            }
+            if (batch.empty()) {
+                break;
+            }
+            thread_rays.primary += batch.size();
+
+            // Sorted by kernel kind, then material; misses last
+            order.clear();
+            for (size_t i = 0; i < batch.size(); ++i) {
+                const HitInfo& hit = batch[i].hit;
+                uint64_t kind = hit.hit ? material_shading_[hit.material].kind : UINT32_MAX;
+                uint64_t material = hit.hit ? hit.material : 0;
+                order.emplace_back(kind << 32 | material, static_cast<uint32_t>(i));
+            }
+            std::sort(order.begin(), order.end());
 
-                color = color / samples_per_pixel_;
-                writer.set_pixel(x, y, color);
+            for (const auto& entry : order) {
+                const PrimarySample& sample = batch[entry.second];
+                Vector3 color = scene.get_background_color();
+                if (sample.hit.hit) {
+#ifdef RAY_TRACER_INSTRUMENT
+                    uint64_t shade_start = record_cost ? cost_clock() : 0;
+#endif
+                    sampler->start_sample(sample.x, sample.y, sample.index, 1);
+                    color = (this->*material_shading_[sample.hit.material].kernel)(
+                        sample.hit, sample.direction, scene, 0);
+#ifdef RAY_TRACER_INSTRUMENT
+                    if (record_cost) {
+                        pixel_cost[static_cast<size_t>(sample.y) * width_ + sample.x] +=
+                            cost_clock() - shade_start;
+                    }
+#endif
+                }
+                if (features_on) {
+                    add_features(sample.pixel, sample.hit);
+                }
+                estimates[sample.pixel].add(color);
             }
         }
+
+        // Wavefront mode: the samples the tile still owes this pass go into
+        // streams of about wavefront_stream_paths, so each stage runs over
+        // many rays at once while the queues stay in cache
+        if (wavefront_) {
+            thread_local RayStream stream;
+            thread_local std::vector<size_t> stream_pixels;
+            auto trace_stream = [&]() {
+                trace_wavefront(stream, scene, *sampler);
+                for (size_t path = 0; path < stream.size(); ++path) {
+                    if (features_on && stream.first_hit[path]) {
+                        features.add(stream_pixels[path], stream.first_albedo.get(path),
+                                     stream.first_normal.get(path), stream.first_t[path]);
+                    } else if (features_on) {
+                        features.add(stream_pixels[path], Vector3(1, 1, 1), Vector3(0, 0, 0), 0.0);
+                    }
+                    estimates[stream_pixels[path]].add(stream.radiance.get(path));
+                }
+                thread_rays.primary += stream.camera_rays;
+                thread_rays.secondary += stream.secondary_rays;
+                thread_rays.shadow += stream.shadow_rays;
+                stream.clear();
+                stream_pixels.clear();
+            };
+
+            for (int y = tile.y0; y < tile.y1; ++y) {
+                int image_y = band_y0 + y;
+                for (int x = tile.x0; x < tile.x1; ++x) {
+                    size_t pixel = static_cast<size_t>(y) * window_width + x;
+                    const PixelEstimate& estimate = estimates[pixel];
+                    if (estimate.converged) {
+                        continue;
+                    }
+                    if (stream.size() >= wavefront_stream_paths) {
+                        trace_stream();
+                    }
+                    int image_x = window_x0 + x;
+                    for (uint32_t index = estimate.samples; index < target_samples; ++index) {
+                        stream.add_camera_ray(image_x, image_y, index, camera_pos,
+                                              camera_ray(*sampler, image_x, image_y, index));
+                        stream_pixels.push_back(pixel);
+                    }
+                }
+            }
+            trace_stream();
+        }
+
+        size_t active = 0;
+        for (int y = tile.y0; y < tile.y1; ++y) {
+            for (int x = tile.x0; x < tile.x1; ++x) {
+                PixelEstimate& estimate = estimates[static_cast<size_t>(y) * window_width + x];
+                if (estimate.converged) {
+                    continue;
+                }
+                if (pixel_converged(estimate)) {
+                    estimate.converged = 1;
+                } else {
+                    ++active;
+                }
+            }
+        }
+        active_pixels.fetch_add(active, std::memory_order_relaxed);
+        primary_rays.fetch_add(thread_rays.primary, std::memory_order_relaxed);
+        secondary_rays.fetch_add(thread_rays.secondary, std::memory_order_relaxed);
+        shadow_rays.fetch_add(thread_rays.shadow, std::memory_order_relaxed);
+#ifdef RAY_TRACER_INSTRUMENT
+        ThreadProfile& profile = profiles[thread_index];
+        profile.counters.node_visits += thread_counters.node_visits;
+        profile.counters.intersection_tests += thread_counters.intersection_tests;
+        profile.counters.max_depth = std::max(profile.counters.max_depth, thread_counters.max_depth);
+        profile.camera_rays += thread_rays.primary;
+        profile.reflection_rays += thread_rays.secondary;
+        profile.shadow_rays += thread_rays.shadow;
+        double tile_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - tile_start).count();
+        ++profile.tiles;
+        profile.tile_seconds += tile_seconds;
+        profile.max_tile_seconds = std::max(profile.max_tile_seconds, tile_seconds);
+#endif
+
+        int strip = (band_y0 + tile.y0) / tile_options.tile_size;
+        if (encoder && !denoise_ && final_pass && tiles_finished[strip].fetch_add(1) + 1 == tiles_per_row) {
+            encoder->encode_strip(strip, final_rows);
+        }
     };
 
-    // Create threads for parallel rendering
-    for (int t = 0; t < num_threads_; ++t) {
-        int start_y = t * rows_per_thread;
-        int end_y = start_y + rows_per_thread;
-        threads.emplace_back(render_rows, start_y, end_y);
+    auto save_state = [&]() {
+        if (!checkpoint_file_.empty()) {
+            save_checkpoint(checkpoint_file_, state);
+        }
+    };
+
+    uint64_t total_samples = 0;
+    size_t unconverged_pixels = 0;
+    int passes = 0;
+
+    // PFM files store the bottom band first, so stream bands in file order
+    int band_count = streaming_ ? encoder->strip_count() : 1;
+    for (int position = 0; position < band_count; ++position) {
+        int band = streaming_ ? encoder->strip_in_file_order(position) : 0;
+        band_y0 = region_only ? outputs.region.y0 : band * band_rows;
+        int band_height = std::min(band_rows, height_ - band_y0);
+        TileScheduler scheduler(window_width, band_height, tile_options);
+        final_rows = estimate_rows(estimates.data(), band_y0);
+
+        if (streaming_ && position > 0) {
+            std::fill(estimates.begin(), estimates.end(), PixelEstimate());
+            state.passes = 0;
+            state.target_samples = 0;
+        }
+        image_complete = state.passes > 0;
+        interrupted.store(false, std::memory_order_relaxed);
+
+        // A resumed render picks up after its last full pass, unless that
+        // already finished every pixel
+        bool finished = false;
+        if (image_complete) {
+            target_samples = std::min<uint32_t>(max_samples, state.target_samples + pass_samples);
+            finished = std::all_of(estimates.begin(), estimates.end(),
+                                   [](const PixelEstimate& e) { return e.converged != 0; });
+        } else {
+            target_samples = std::min(min_samples, pass_samples);
+        }
+
+        // Each pass tops unfinished pixels up by another pass_samples
+        auto last_preview = std::chrono::steady_clock::now();
+        auto last_checkpoint = last_preview;
+        while (!finished) {
+            active_pixels.store(0, std::memory_order_relaxed);
+            final_pass = target_samples >= static_cast<uint32_t>(max_samples);
+            scheduler.run(render_tile);
+            if (interrupted.load(std::memory_order_relaxed)) {
+                // Tiles that ran are consistent per pixel; the rest are redone on resume
+                break;
+            }
+            ++state.passes;
+            ++passes;
+            state.target_samples = target_samples;
+            image_complete = true;
+
+            if (active_pixels.load(std::memory_order_relaxed) == 0 ||
+                (has_deadline && std::chrono::steady_clock::now() >= deadline)) {
+                break;
+            }
+            target_samples = std::min<uint32_t>(max_samples, target_samples + pass_samples);
+
+            auto now = std::chrono::steady_clock::now();
+            if (encoder && !streaming_ && pass_samples_ > 0 && preview_interval_seconds_ > 0.0 &&
+                std::chrono::duration<double>(now - last_preview).count() >= preview_interval_seconds_) {
+                write_image(estimates.data(), outputs.image);
+                last_preview = now;
+            }
+            if (checkpoint_interval_seconds_ > 0.0 &&
+                std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint_interval_seconds_) {
+                save_state();
+                last_checkpoint = now;
+            }
+        }
+
+        size_t band_pixels = static_cast<size_t>(window_width) * band_height;
+        for (size_t i = 0; i < band_pixels; ++i) {
+            total_samples += estimates[i].samples;
+        }
+        unconverged_pixels += active_pixels.load(std::memory_order_relaxed);
+
+        if (streaming_) {
+            // A stopped render still streams every band so the file stays valid
+            if (!encoder->strip_encoded(band)) {
+                encoder->encode_strip(band, final_rows);
+            }
+            if (heatmap_encoder) {
+                heatmap_encoder->encode_strip(band, heatmap_rows(estimates.data(), band_y0, max_samples));
+            }
+        }
+    }
+    save_state();
+
+    stats_.primary_rays = primary_rays.load();
+    stats_.secondary_rays = secondary_rays.load();
+    stats_.shadow_rays = shadow_rays.load();
+    stats_.render_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+#ifdef RAY_TRACER_INSTRUMENT
+    if (!region_only) {
+        print_profile(profiles);
+    }
+    if (!outputs.cost_heatmap.empty()) {
+        write_cost_heatmap(pixel_cost, outputs.cost_heatmap);
+    }
+#endif
+
+    if (stop_requested_.load(std::memory_order_relaxed)) {
+        std::cout << "Render stopped after " << state.passes << " passes"
+                  << (checkpoint_file_.empty() ? "" : "; continue with --resume") << "\n";
+    }
+
+    if (region_only) {
+        std::vector<float>& rgb = *outputs.region_rgb;
+        rgb.resize(3 * estimates.size());
+        average_samples(estimates.data(), estimates.size(), rgb.data());
+        spare_pixels_ = std::move(state.pixels);
+        return;
+    }
+
+    if (adaptive || pass_samples_ > 0) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Sampling: " << passes << " passes, "
+                  << static_cast<double>(total_samples) / (static_cast<double>(width_) * height_)
+                  << " samples/pixel average, " << unconverged_pixels << " pixels unconverged, "
+                  << seconds << " s\n";
+    }
+
+    // A denoised frame is encoded from the filtered colors, not the samples
+    std::vector<float> denoised;
+    if (features_on) {
+        features.resolve(estimates.data());
+        if (!outputs.features.empty()) {
+            features.write(outputs.features);
+        }
+        if (denoise_) {
+            auto denoise_start = std::chrono::steady_clock::now();
+            std::vector<float> color(3 * estimates.size());
+            average_samples(estimates.data(), estimates.size(), color.data());
+            denoised = denoise(color, features, denoise_options_, *pool_);
+            double denoise_seconds =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - denoise_start)
+                    .count();
+            std::cout << "Denoised in " << 1000.0 * denoise_seconds << " ms ("
+                      << 100.0 * denoise_seconds / stats_.render_seconds << "% of render time)\n";
+            final_rows = color_rows(denoised.data());
+        }
+    }
+
+    if (streaming_) {
+        encoder->finish_stream();
+        if (heatmap_encoder) {
+            heatmap_encoder->finish_stream();
+            std::cout << "Wrote sample heatmap to " << outputs.heatmap << "\n";
+        }
+        std::cout << "Wrote image to " << outputs.image << "\n";
+        return;
+    }
+
+    if (!outputs.heatmap.empty()) {
+        write_sample_heatmap(estimates.data(), max_samples, outputs.heatmap);
     }
 
-    // Wait for all threads to complete
-    for (auto& thread : threads) {
-        if (thread.joinable()) {
-            thread.join();
+    if (!pipelined) {
+        std::cout << "Writing image to " << outputs.image << "\n";
+        encoder->encode_remaining(final_rows, num_threads_);
+        encoder->write(outputs.image);
+        return;
+    }
+
+    // The writer takes the encoder and samples so the next frame can start
+    // now; their buffer comes back for reuse. At most one frame is in flight.
+    auto write_frame = [this, encoder = std::move(encoder), pixels = std::move(state.pixels),
+                        denoised = std::move(denoised), filename = outputs.image]() mutable {
+        encoder->encode_remaining(denoised.empty() ? estimate_rows(pixels.data(), 0)
+                                                   : color_rows(denoised.data()),
+                                  1);
+        encoder->write(filename);
+        return std::move(pixels);
+    };
+    finish_output();
+    pending_output_ = std::async(std::launch::async, std::move(write_frame));
+}
+
+ImageEncoder::RowSource RayTracer::estimate_rows(const PixelEstimate* estimates, int first_row) const {
+    return [this, estimates, first_row](int y, float* row) {
+        const PixelEstimate* pixels = estimates + static_cast<size_t>(y - first_row) * width_;
+        for (int x = 0; x < width_; ++x) {
+            float scale = pixels[x].samples ? 1.0f / pixels[x].samples : 0.0f;
+            row[3 * x] = pixels[x].sum[0] * scale;
+            row[3 * x + 1] = pixels[x].sum[1] * scale;
+            row[3 * x + 2] = pixels[x].sum[2] * scale;
+        }
+    };
+}
+
+ImageEncoder::RowSource RayTracer::color_rows(const float* rgb) const {
+    return [this, rgb](int y, float* row) {
+        std::copy_n(rgb + 3 * static_cast<size_t>(y) * width_, 3 * width_, row);
+    };
+}
+
+ImageEncoder::RowSource RayTracer::heatmap_rows(const PixelEstimate* estimates, int first_row,
+                                                int max_samples) const {
+    return [this, estimates, first_row, max_samples](int y, float* row) {
+        const PixelEstimate* pixels = estimates + static_cast<size_t>(y - first_row) * width_;
+        for (int x = 0; x < width_; ++x) {
+            Vector3 color = heatmap_color(static_cast<double>(pixels[x].samples) / max_samples);
+            row[3 * x] = static_cast<float>(color.x);
+            row[3 * x + 1] = static_cast<float>(color.y);
+            row[3 * x + 2] = static_cast<float>(color.z);
+        }
+    };
+}
+
+void RayTracer::write_image(const PixelEstimate* estimates, const std::string& filename) const {
+    ImageEncoder encoder(width_, height_, image_format_for(filename));
+    encoder.encode_remaining(estimate_rows(estimates, 0), num_threads_);
+    encoder.write(filename);
+}
+
+void RayTracer::write_sample_heatmap(const PixelEstimate* estimates, int max_samples,
+                                     const std::string& filename) const {
+    Framebuffer heatmap(width_, height_);
+    for (int y = 0; y < height_; ++y) {
+        for (int x = 0; x < width_; ++x) {
+            heatmap.set_pixel(x, y, heatmap_color(
+                static_cast<double>(estimates[static_cast<size_t>(y) * width_ + x].samples) / max_samples));
         }
     }
+    std::cout << "Writing sample heatmap to " << filename << "\n";
+    heatmap.write(filename);
+}
 
-    std::cout << "Writing image to " << output_file << "\n";
-    writer.write(output_file);
+#ifdef RAY_TRACER_INSTRUMENT
+void RayTracer::write_cost_heatmap(const std::vector<uint64_t>& cost,
+                                   const std::string& filename) const {
+    // A few pixels (e.g. deep reflections) can cost far more than the rest,
+    // so scale to the 99th percentile rather than the maximum
+    std::vector<uint64_t> sorted(cost);
+    size_t rank = sorted.size() * 99 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    double full_scale = std::max<double>(1.0, static_cast<double>(sorted[rank]));
+
+    Framebuffer heatmap(width_, height_);
+    for (int y = 0; y < height_; ++y) {
+        for (int x = 0; x < width_; ++x) {
+            heatmap.set_pixel(x, y, heatmap_color(cost[static_cast<size_t>(y) * width_ + x] / full_scale));
+        }
+    }
+    std::cout << "Writing cost heatmap to " << filename << " (red = " << full_scale << " "
+              << cost_clock_unit() << " per pixel)\n";
+    heatmap.write(filename);
 }
+#endif
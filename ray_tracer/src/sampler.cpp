@@ -0,0 +1,240 @@
+#include "sampler.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// SplitMix64 finalizer
+uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t hash(uint64_t a, uint64_t b) {
+    return mix(a ^ (b + 0x9E3779B97F4A7C15ULL + (a << 6) + (a >> 2)));
+}
+
+double to_unit(uint32_t bits) {
+    return bits * 0x1p-32;
+}
+
+/**
+ * Pcg32 - PCG-XSH-RR generator (O'Neill), one short-lived stream per point
+ */
+class Pcg32 {
+public:
+    Pcg32(uint64_t seed, uint64_t stream) : inc_((stream << 1) | 1) {
+        next();
+        state_ += seed;
+        next();
+    }
+
+    uint32_t next() {
+        uint64_t old = state_;
+        state_ = old * 6364136223846793005ULL + inc_;
+        uint32_t shifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        uint32_t rotation = static_cast<uint32_t>(old >> 59);
+        return (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+    }
+
+private:
+    uint64_t state_ = 0;
+    uint64_t inc_;
+};
+
+uint32_t reverse_bits(uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00FF00FFu) << 8) | ((x & 0xFF00FF00u) >> 8);
+    x = ((x & 0x0F0F0F0Fu) << 4) | ((x & 0xF0F0F0F0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xCCCCCCCCu) >> 2);
+    return ((x & 0x55555555u) << 1) | ((x & 0xAAAAAAAAu) >> 1);
+}
+
+// Second Sobol dimension (the first is the bit-reversed index). Indices are
+// shuffled to full 32-bit values, so the generator matrix is applied a byte
+// at a time from tables
+struct SobolTables {
+    uint32_t bytes[4][256];
+
+    SobolTables() {
+        uint32_t columns[32];
+        uint32_t v = 1u << 31;
+        for (int bit = 0; bit < 32; ++bit, v ^= v >> 1) {
+            columns[bit] = v;
+        }
+        for (int byte = 0; byte < 4; ++byte) {
+            for (uint32_t value = 0; value < 256; ++value) {
+                uint32_t result = 0;
+                for (int bit = 0; bit < 8; ++bit) {
+                    if (value & (1u << bit)) {
+                        result ^= columns[byte * 8 + bit];
+                    }
+                }
+                bytes[byte][value] = result;
+            }
+        }
+    }
+};
+
+uint32_t sobol_second(uint32_t index) {
+    static const SobolTables tables;
+    return tables.bytes[0][index & 0xFF] ^ tables.bytes[1][(index >> 8) & 0xFF] ^
+           tables.bytes[2][(index >> 16) & 0xFF] ^ tables.bytes[3][index >> 24];
+}
+
+// Hash-based Owen scrambling (Burley, "Practical Hash-based Owen
+// Scrambling", 2020): each output bit is flipped depending only on the
+// bits above it, which keeps every aligned block of 2^k points a net
+uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits(x);
+    x ^= x * 0x3D20ADEAu;
+    x += seed;
+    x *= (seed >> 16) | 1;
+    x ^= x * 0x05526C56u;
+    x ^= x * 0x53A22864u;
+    return reverse_bits(x);
+}
+
+// Owen-scrambled (0,2)-sequence point: the index is shuffled too, so
+// different seeds give decorrelated sequences for padding dimensions
+Sample2D scrambled_sobol(uint32_t index, uint32_t seed) {
+    uint32_t shuffled = nested_uniform_scramble(index, seed);
+    uint32_t u_seed = static_cast<uint32_t>(hash(seed, 1));
+    uint32_t v_seed = static_cast<uint32_t>(hash(seed, 2));
+    uint32_t u = nested_uniform_scramble(reverse_bits(shuffled), u_seed);
+    uint32_t v = nested_uniform_scramble(sobol_second(shuffled), v_seed);
+    return {to_unit(u), to_unit(v)};
+}
+
+constexpr int mask_size = 64;
+
+// Void-and-cluster style ranking: each pixel in turn is placed in the
+// largest void left by those before it (lowest Gaussian energy on the
+// torus), so every prefix of the ranking is evenly spread
+std::vector<float> build_blue_noise_mask() {
+    constexpr int n = mask_size * mask_size;
+    constexpr double sigma = 1.9;
+    std::vector<double> kernel(n);
+    for (int dy = 0; dy < mask_size; ++dy) {
+        for (int dx = 0; dx < mask_size; ++dx) {
+            int wx = std::min(dx, mask_size - dx);
+            int wy = std::min(dy, mask_size - dy);
+            kernel[dy * mask_size + dx] = std::exp(-(wx * wx + wy * wy) / (2.0 * sigma * sigma));
+        }
+    }
+
+    std::vector<double> energy(n, 0.0);
+    std::vector<bool> placed(n, false);
+    std::vector<float> mask(n);
+    int next = 0;
+    for (int rank = 0; rank < n; ++rank) {
+        placed[next] = true;
+        mask[next] = (rank + 0.5f) / n;
+        int px = next % mask_size;
+        int py = next / mask_size;
+        int best = -1;
+        for (int y = 0; y < mask_size; ++y) {
+            const double* row = &kernel[((y - py + mask_size) % mask_size) * mask_size];
+            for (int x = 0; x < mask_size; ++x) {
+                int i = y * mask_size + x;
+                energy[i] += row[(x - px + mask_size) % mask_size];
+                if (!placed[i] && (best < 0 || energy[i] < energy[best])) {
+                    best = i;
+                }
+            }
+        }
+        next = best;
+    }
+    return mask;
+}
+
+const std::vector<float>& blue_noise_mask() {
+    static const std::vector<float> mask = build_blue_noise_mask();
+    return mask;
+}
+
+class RandomSampler : public Sampler {
+public:
+    explicit RandomSampler(uint64_t seed) : Sampler(seed) {}
+
+private:
+    Sample2D sample_2d(uint32_t dimension, uint64_t index) const override {
+        uint64_t pixel = static_cast<uint64_t>(y_) << 32 | x_;
+        Pcg32 rng(hash(hash(seed_, pixel), index), dimension);
+        double u = to_unit(rng.next());
+        return {u, to_unit(rng.next())};
+    }
+};
+
+class SobolSampler : public Sampler {
+public:
+    explicit SobolSampler(uint64_t seed) : Sampler(seed) {}
+
+private:
+    Sample2D sample_2d(uint32_t dimension, uint64_t index) const override {
+        uint64_t pixel = static_cast<uint64_t>(y_) << 32 | x_;
+        return scrambled_sobol(static_cast<uint32_t>(index),
+                               static_cast<uint32_t>(hash(hash(seed_, pixel), dimension)));
+    }
+};
+
+// Blue-noise dithered sampling (Georgiev and Fajardo, 2016): all pixels use
+// the same scrambled points, toroidally shifted by a blue-noise mask, so
+// neighbouring pixels err in opposite directions and the remaining noise
+// is high-frequency
+class BlueNoiseSampler : public Sampler {
+public:
+    explicit BlueNoiseSampler(uint64_t seed) : Sampler(seed), mask_(blue_noise_mask()) {}
+
+private:
+    const std::vector<float>& mask_;
+
+    Sample2D sample_2d(uint32_t dimension, uint64_t index) const override {
+        uint64_t dimension_seed = hash(seed_, dimension);
+        Sample2D point = scrambled_sobol(static_cast<uint32_t>(index),
+                                         static_cast<uint32_t>(dimension_seed));
+        // Each dimension reads the mask at its own offsets
+        uint64_t offsets = mix(dimension_seed);
+        point.u = wrap(point.u + mask_at(x_ + (offsets & 63), y_ + ((offsets >> 8) & 63)));
+        point.v = wrap(point.v + mask_at(x_ + ((offsets >> 16) & 63), y_ + ((offsets >> 24) & 63)));
+        return point;
+    }
+
+    static double wrap(double value) {
+        return value >= 1.0 ? value - 1.0 : value;
+    }
+
+    double mask_at(uint64_t x, uint64_t y) const {
+        return mask_[(y % mask_size) * mask_size + x % mask_size];
+    }
+};
+
+}  // namespace
+
+SamplerType parse_sampler_type(const std::string& name) {
+    if (name == "random") return SamplerType::RANDOM;
+    if (name == "sobol") return SamplerType::SOBOL;
+    if (name == "bluenoise") return SamplerType::BLUE_NOISE;
+    throw std::runtime_error("Unknown sampler: " + name);
+}
+
+const char* sampler_type_name(SamplerType type) {
+    switch (type) {
+        case SamplerType::RANDOM: return "random";
+        case SamplerType::SOBOL: return "sobol";
+        case SamplerType::BLUE_NOISE: return "bluenoise";
+    }
+    return "unknown";
+}
+
+std::unique_ptr<Sampler> make_sampler(SamplerType type, uint64_t seed) {
+    switch (type) {
+        case SamplerType::RANDOM: return std::make_unique<RandomSampler>(seed);
+        case SamplerType::SOBOL: return std::make_unique<SobolSampler>(seed);
+        case SamplerType::BLUE_NOISE: return std::make_unique<BlueNoiseSampler>(seed);
+    }
+    throw std::runtime_error("Unknown sampler type");
+}
@@ -1,12 +1,117 @@
 #include "scene.h"
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+void hash_combine(size_t& seed, double value) {
+    seed ^= std::hash<double>()(value) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+void hash_combine(size_t& seed, const Vector3& v) {
+    hash_combine(seed, v.x);
+    hash_combine(seed, v.y);
+    hash_combine(seed, v.z);
+}
+
+void hash_combine(size_t& seed, const void* pointer) {
+    seed ^= std::hash<const void*>()(pointer) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+bool same(const Vector3& a, const Vector3& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+}  // namespace
+
+bool Material::operator==(const Material& other) const {
+    return same(color, other.color) && ambient == other.ambient && diffuse == other.diffuse &&
+           specular == other.specular && shininess == other.shininess &&
+           reflection == other.reflection && texture == other.texture;
+}
+
+size_t Scene::TextureHash::operator()(const Texture& texture) const {
+    size_t seed = static_cast<size_t>(texture.type());
+    hash_combine(seed, texture.color1());
+    hash_combine(seed, texture.color2());
+    hash_combine(seed, texture.image().get());
+    return seed;
+}
+
+size_t Scene::MaterialHash::operator()(const Material& material) const {
+    size_t seed = material.texture;
+    hash_combine(seed, material.color);
+    hash_combine(seed, material.ambient);
+    hash_combine(seed, material.diffuse);
+    hash_combine(seed, material.specular);
+    hash_combine(seed, material.shininess);
+    hash_combine(seed, material.reflection);
+    return seed;
+}
 
 Scene::Scene() : background_color_(0.1, 0.1, 0.1) {
 }
 
 void Scene::add_sphere(const Sphere& sphere) {
+    if (sphere.material >= materials_.size()) {
+        throw std::out_of_range("Sphere refers to a material not in the scene");
+    }
     spheres_.push_back(sphere);
 }
 
 void Scene::add_light(const Light& light) {
     lights_.push_back(light);
 }
+
+void Scene::move_sphere(size_t index, const Vector3& center) {
+    if (index >= spheres_.size()) {
+        throw std::out_of_range("No sphere " + std::to_string(index) + " in the scene");
+    }
+    spheres_[index].center = center;
+}
+
+void Scene::move_light(size_t index, const Vector3& position) {
+    if (index >= lights_.size()) {
+        throw std::out_of_range("No light " + std::to_string(index) + " in the scene");
+    }
+    lights_[index].position = position;
+}
+
+uint32_t Scene::add_texture(const Texture& texture) {
+    auto inserted = texture_index_.emplace(texture, static_cast<uint32_t>(textures_.size()));
+    if (inserted.second) {
+        textures_.push_back(texture);
+    }
+    return inserted.first->second;
+}
+
+uint32_t Scene::add_material(const Material& material) {
+    if (material.texture != Material::no_texture && material.texture >= textures_.size()) {
+        throw std::out_of_range("Material refers to a texture not in the scene");
+    }
+    auto inserted = material_index_.emplace(material, static_cast<uint32_t>(materials_.size()));
+    if (inserted.second) {
+        materials_.push_back(material);
+    }
+    return inserted.first->second;
+}
+
+uint32_t Scene::add_mesh(std::shared_ptr<const TriangleMesh> mesh) {
+    meshes_.push_back(std::move(mesh));
+    return static_cast<uint32_t>(meshes_.size() - 1);
+}
+
+void Scene::add_instance(uint32_t mesh, uint32_t material, const Transform& object_to_world) {
+    if (mesh >= meshes_.size() || material >= materials_.size()) {
+        throw std::out_of_range("Instance refers to a mesh or material not in the scene");
+    }
+    instances_.emplace_back(mesh, material, object_to_world);
+}
+
+void Scene::add_instance(const MeshInstance& instance) {
+    if (instance.mesh >= meshes_.size() || instance.material >= materials_.size()) {
+        throw std::out_of_range("Instance refers to a mesh or material not in the scene");
+    }
+    instances_.push_back(instance);
+}
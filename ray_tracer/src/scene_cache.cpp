@@ -0,0 +1,421 @@
+#include "scene_cache.h"
+#include "scene.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <vector>
+
+namespace {
+
+constexpr char cache_magic[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '1'};
+constexpr uint32_t cache_version = 2;
+constexpr uint64_t section_alignment = 64;
+
+struct TextureRecord {
+    uint32_t type;
+    uint32_t pad;
+    double color1[3];
+    double color2[3];
+};
+
+struct MaterialRecord {
+    double color[3];
+    double ambient;
+    double diffuse;
+    double specular;
+    double shininess;
+    double reflection;
+    uint32_t texture;  // Material::no_texture if untextured
+    uint32_t pad;
+};
+
+struct SphereRecord {
+    double center[3];
+    double radius;
+    uint32_t material;
+    uint32_t pad;
+};
+
+struct LightRecord {
+    double position[3];
+    double intensity[3];
+    double radius;
+};
+
+uint64_t align_up(uint64_t offset) {
+    return (offset + section_alignment - 1) & ~(section_alignment - 1);
+}
+
+void store(double out[3], const Vector3& v) {
+    out[0] = v.x;
+    out[1] = v.y;
+    out[2] = v.z;
+}
+
+Vector3 load(const double in[3]) {
+    return Vector3(in[0], in[1], in[2]);
+}
+
+// Size and modification time identify the version of the scene file
+bool stat_source(const std::string& source_file, uint64_t& size, int64_t& mtime_ns) {
+    struct stat info;
+    if (stat(source_file.c_str(), &info) != 0) {
+        return false;
+    }
+    size = static_cast<uint64_t>(info.st_size);
+    mtime_ns = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+    return true;
+}
+
+}  // namespace
+
+struct SceneCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t real_size;  // sizeof(intersect_real) of the geometry arrays
+    uint64_t file_size;
+    uint64_t source_size;
+    int64_t source_mtime_ns;
+
+    double camera_position[3];
+    double camera_look_at[3];
+    double camera_up[3];
+    double camera_fov;
+    double background[3];
+    int32_t width;
+    int32_t height;
+    int32_t samples_per_pixel;
+    int32_t max_depth;
+
+    uint32_t texture_count;
+    uint32_t material_count;
+    uint32_t light_count;
+    uint32_t bvh_depth;
+    uint64_t sphere_count;
+    uint64_t node_count;
+
+    // Byte offsets of each section, aligned to section_alignment
+    uint64_t textures;
+    uint64_t materials;
+    uint64_t lights;
+    uint64_t spheres;
+    uint64_t nodes;
+    uint64_t indices;
+    uint64_t geometry;  // center_x, center_y, center_z, radius2; each padded
+};
+
+size_t SceneCache::sphere_count() const {
+    return static_cast<size_t>(header_->sphere_count);
+}
+
+std::shared_ptr<const SceneCache> SceneCache::open(const std::string& filename,
+                                                   const std::string& source_file) {
+    std::shared_ptr<SceneCache> cache(new SceneCache());
+    if (!cache->file_.open(filename) || cache->file_.size() < sizeof(Header)) {
+        return nullptr;
+    }
+    cache->header_ = cache->section<Header>(0);
+    const Header& header = *cache->header_;
+    if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 ||
+        header.version != cache_version || header.real_size != sizeof(intersect_real) ||
+        header.file_size != cache->file_.size()) {
+        return nullptr;
+    }
+
+    if (!source_file.empty()) {
+        uint64_t size = 0;
+        int64_t mtime_ns = 0;
+        if (!stat_source(source_file, size, mtime_ns) || size != header.source_size ||
+            mtime_ns != header.source_mtime_ns) {
+            return nullptr;
+        }
+    }
+    return cache->validate() ? cache : nullptr;
+}
+
+bool SceneCache::validate() {
+    const Header& header = *header_;
+    uint64_t size = file_.size();
+    size_t padded = header.sphere_count + SphereArrays<intersect_real>::padding;
+
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t element) {
+        return offset % section_alignment == 0 && offset <= size &&
+               (element == 0 || count <= (size - offset) / element);
+    };
+    if (header.sphere_count > UINT32_MAX ||
+        !fits(header.textures, header.texture_count, sizeof(TextureRecord)) ||
+        !fits(header.materials, header.material_count, sizeof(MaterialRecord)) ||
+        !fits(header.lights, header.light_count, sizeof(LightRecord)) ||
+        !fits(header.spheres, header.sphere_count, sizeof(SphereRecord)) ||
+        !fits(header.nodes, header.node_count, sizeof(BVHNode)) ||
+        !fits(header.indices, header.sphere_count, sizeof(uint32_t)) ||
+        !fits(header.geometry, 4 * padded, sizeof(intersect_real))) {
+        return false;
+    }
+
+    // References are checked once here so rendering can trust them
+    const TextureRecord* textures = section<TextureRecord>(header.textures);
+    for (uint32_t i = 0; i < header.texture_count; ++i) {
+        if (textures[i].type > static_cast<uint32_t>(Texture::Type::GRADIENT)) {
+            return false;
+        }
+    }
+    const MaterialRecord* materials = section<MaterialRecord>(header.materials);
+    for (uint32_t i = 0; i < header.material_count; ++i) {
+        if (materials[i].texture >= header.texture_count &&
+            materials[i].texture != Material::no_texture) {
+            return false;
+        }
+    }
+    const SphereRecord* spheres = section<SphereRecord>(header.spheres);
+    for (uint64_t i = 0; i < header.sphere_count; ++i) {
+        if (spheres[i].material >= header.material_count) {
+            return false;
+        }
+    }
+    const uint32_t* indices = section<uint32_t>(header.indices);
+    for (uint64_t i = 0; i < header.sphere_count; ++i) {
+        if (indices[i] >= header.sphere_count) {
+            return false;
+        }
+    }
+    // Children always follow their parent, so one pass finds every node's
+    // deepest level; the header's depth is not trusted, since a deeper tree
+    // would overflow the traversal stack
+    const BVHNode* nodes = section<BVHNode>(header.nodes);
+    std::vector<uint8_t> levels(header.node_count, 0);
+    bvh_depth_ = 0;
+    if (header.node_count > 0) {
+        levels[0] = 1;
+    }
+    for (uint64_t i = 0; i < header.node_count; ++i) {
+        if (levels[i] > BVH::max_depth) {
+            return false;
+        }
+        bvh_depth_ = std::max(bvh_depth_, static_cast<int>(levels[i]));
+        if (nodes[i].is_leaf()) {
+            if (nodes[i].offset + uint64_t(nodes[i].count) > header.sphere_count) {
+                return false;
+            }
+            continue;
+        }
+        if (nodes[i].offset <= i + 1 || nodes[i].offset >= header.node_count ||
+            nodes[i].axis >= 3) {
+            return false;
+        }
+        uint8_t child_level = static_cast<uint8_t>(levels[i] + 1);
+        levels[i + 1] = std::max(levels[i + 1], child_level);
+        levels[nodes[i].offset] = std::max(levels[nodes[i].offset], child_level);
+    }
+    return (header.node_count == 0) == (header.sphere_count == 0);
+}
+
+void SceneCache::load_scene(Scene& scene) const {
+    const Header& header = *header_;
+
+    Camera camera;
+    camera.position = load(header.camera_position);
+    camera.look_at = load(header.camera_look_at);
+    camera.up = load(header.camera_up);
+    camera.fov = header.camera_fov;
+    scene.set_camera(camera);
+    scene.set_background_color(load(header.background));
+
+    RenderSettings settings;
+    settings.width = header.width;
+    settings.height = header.height;
+    settings.samples_per_pixel = header.samples_per_pixel;
+    settings.max_depth = header.max_depth;
+    scene.set_render_settings(settings);
+
+    // Table indices shift if the scene already held entries
+    std::vector<uint32_t> textures(header.texture_count);
+    const TextureRecord* texture_records = section<TextureRecord>(header.textures);
+    for (uint32_t i = 0; i < header.texture_count; ++i) {
+        const TextureRecord& record = texture_records[i];
+        textures[i] = scene.add_texture(Texture(static_cast<Texture::Type>(record.type),
+                                                load(record.color1), load(record.color2)));
+    }
+
+    std::vector<uint32_t> materials(header.material_count);
+    const MaterialRecord* material_records = section<MaterialRecord>(header.materials);
+    for (uint32_t i = 0; i < header.material_count; ++i) {
+        const MaterialRecord& record = material_records[i];
+        Material material(load(record.color), record.reflection);
+        material.ambient = record.ambient;
+        material.diffuse = record.diffuse;
+        material.specular = record.specular;
+        material.shininess = record.shininess;
+        material.texture =
+            record.texture == Material::no_texture ? Material::no_texture : textures[record.texture];
+        materials[i] = scene.add_material(material);
+    }
+
+    const LightRecord* lights = section<LightRecord>(header.lights);
+    for (uint32_t i = 0; i < header.light_count; ++i) {
+        scene.add_light(Light(load(lights[i].position), load(lights[i].intensity), lights[i].radius));
+    }
+
+    const SphereRecord* spheres = section<SphereRecord>(header.spheres);
+    scene.reserve_spheres(scene.get_spheres().size() + header.sphere_count);
+    for (uint64_t i = 0; i < header.sphere_count; ++i) {
+        scene.add_sphere(Sphere(load(spheres[i].center), spheres[i].radius,
+                                materials[spheres[i].material]));
+    }
+}
+
+std::unique_ptr<SceneAccelerator> SceneCache::make_accelerator(const Scene& scene,
+                                                               SimdLevel simd_level) const {
+    const Header& header = *header_;
+    size_t padded = header.sphere_count + SphereArrays<intersect_real>::padding;
+    const intersect_real* geometry = section<intersect_real>(header.geometry);
+
+    SceneAccelerator::Prebuilt prebuilt;
+    prebuilt.nodes = section<BVHNode>(header.nodes);
+    prebuilt.node_count = header.node_count;
+    prebuilt.indices = section<uint32_t>(header.indices);
+    prebuilt.primitive_count = header.sphere_count;
+    prebuilt.depth = bvh_depth_;
+    prebuilt.geometry = {geometry, geometry + padded, geometry + 2 * padded, geometry + 3 * padded};
+    prebuilt.owner = shared_from_this();
+    return std::make_unique<SceneAccelerator>(scene, std::move(prebuilt), simd_level);
+}
+
+void SceneCache::write(const std::string& filename, const std::string& source_file,
+                       const Scene& scene, const SceneAccelerator& accelerator) {
+    const auto& spheres = scene.get_spheres();
+    const auto& lights = scene.get_lights();
+    const BVH& bvh = accelerator.bvh();
+    if (bvh.primitive_count() != spheres.size()) {
+        throw std::runtime_error("Accelerator was not built for this scene");
+    }
+
+    std::vector<TextureRecord> textures(scene.get_textures().size());
+    for (size_t i = 0; i < textures.size(); ++i) {
+        const Texture& texture = scene.get_textures()[i];
+        if (texture.type() == Texture::Type::IMAGE) {
+            throw std::runtime_error("Scenes with image textures cannot be cached");
+        }
+        std::memset(&textures[i], 0, sizeof(TextureRecord));
+        textures[i].type = static_cast<uint32_t>(texture.type());
+        store(textures[i].color1, texture.color1());
+        store(textures[i].color2, texture.color2());
+    }
+
+    std::vector<MaterialRecord> materials(scene.get_materials().size());
+    for (size_t i = 0; i < materials.size(); ++i) {
+        const Material& material = scene.get_materials()[i];
+        MaterialRecord& record = materials[i];
+        std::memset(&record, 0, sizeof(record));
+        store(record.color, material.color);
+        record.ambient = material.ambient;
+        record.diffuse = material.diffuse;
+        record.specular = material.specular;
+        record.shininess = material.shininess;
+        record.reflection = material.reflection;
+        record.texture = material.texture;
+    }
+
+    std::vector<SphereRecord> sphere_records(spheres.size());
+    for (size_t i = 0; i < spheres.size(); ++i) {
+        SphereRecord& record = sphere_records[i];
+        std::memset(&record, 0, sizeof(record));
+        store(record.center, spheres[i].center);
+        record.radius = spheres[i].radius;
+        record.material = spheres[i].material;
+    }
+
+    std::vector<LightRecord> light_records(lights.size());
+    for (size_t i = 0; i < lights.size(); ++i) {
+        store(light_records[i].position, lights[i].position);
+        store(light_records[i].intensity, lights[i].intensity);
+        light_records[i].radius = lights[i].radius;
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cache_magic, sizeof(header.magic));
+    header.version = cache_version;
+    header.real_size = sizeof(intersect_real);
+    if (!source_file.empty() && !stat_source(source_file, header.source_size, header.source_mtime_ns)) {
+        throw std::runtime_error("Scene file not found: " + source_file);
+    }
+
+    const Camera& camera = scene.get_camera();
+    store(header.camera_position, camera.position);
+    store(header.camera_look_at, camera.look_at);
+    store(header.camera_up, camera.up);
+    header.camera_fov = camera.fov;
+    store(header.background, scene.get_background_color());
+    const RenderSettings& settings = scene.get_render_settings();
+    header.width = settings.width;
+    header.height = settings.height;
+    header.samples_per_pixel = settings.samples_per_pixel;
+    header.max_depth = settings.max_depth;
+
+    header.texture_count = static_cast<uint32_t>(textures.size());
+    header.material_count = static_cast<uint32_t>(materials.size());
+    header.light_count = static_cast<uint32_t>(lights.size());
+    header.bvh_depth = static_cast<uint32_t>(bvh.depth());
+    header.sphere_count = spheres.size();
+    header.node_count = bvh.node_count();
+
+    size_t padded = spheres.size() + SphereArrays<intersect_real>::padding;
+    uint64_t offset = align_up(sizeof(Header));
+    auto place = [&offset](uint64_t& field, uint64_t bytes) {
+        field = offset;
+        offset = align_up(offset + bytes);
+    };
+    place(header.textures, textures.size() * sizeof(TextureRecord));
+    place(header.materials, materials.size() * sizeof(MaterialRecord));
+    place(header.lights, light_records.size() * sizeof(LightRecord));
+    place(header.spheres, sphere_records.size() * sizeof(SphereRecord));
+    place(header.nodes, bvh.node_count() * sizeof(BVHNode));
+    place(header.indices, spheres.size() * sizeof(uint32_t));
+    place(header.geometry, 4 * padded * sizeof(intersect_real));
+    header.file_size = offset;
+
+    std::string temporary = filename + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Failed to open scene cache file: " + temporary);
+    }
+
+    uint64_t written = 0;
+    bool ok = true;
+    auto put = [&](uint64_t at, const void* data, uint64_t bytes) {
+        static const char zeros[section_alignment] = {};
+        while (ok && written < at) {
+            size_t gap = static_cast<size_t>(std::min<uint64_t>(at - written, sizeof(zeros)));
+            ok = std::fwrite(zeros, 1, gap, file) == gap;
+            written += gap;
+        }
+        if (ok && bytes > 0) {
+            ok = std::fwrite(data, 1, bytes, file) == bytes;
+            written += bytes;
+        }
+    };
+    put(0, &header, sizeof(header));
+    put(header.textures, textures.data(), textures.size() * sizeof(TextureRecord));
+    put(header.materials, materials.data(), materials.size() * sizeof(MaterialRecord));
+    put(header.lights, light_records.data(), light_records.size() * sizeof(LightRecord));
+    put(header.spheres, sphere_records.data(), sphere_records.size() * sizeof(SphereRecord));
+    put(header.nodes, bvh.nodes(), bvh.node_count() * sizeof(BVHNode));
+    put(header.indices, bvh.primitive_indices(), spheres.size() * sizeof(uint32_t));
+    const SphereView<intersect_real>& geometry = accelerator.geometry();
+    const intersect_real* arrays[4] = {geometry.center_x, geometry.center_y, geometry.center_z,
+                                       geometry.radius2};
+    for (int i = 0; i < 4; ++i) {
+        put(header.geometry + i * padded * sizeof(intersect_real), arrays[i],
+            padded * sizeof(intersect_real));
+    }
+    put(header.file_size, nullptr, 0);
+
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Failed to write scene cache file: " + filename);
+    }
+}
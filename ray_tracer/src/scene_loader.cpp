@@ -0,0 +1,363 @@
+#include "scene_loader.h"
+#include "animation.h"
+#include "image_texture.h"
+#include "mapped_buffer.h"
+#include "scene.h"
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+/**
+ * SceneParser - Single pass over the mapped file, one statement per line
+ *
+ * Tokens are views into the mapping and numbers go through from_chars, so
+ * sphere lines are parsed without allocating.
+ */
+class SceneParser {
+public:
+    SceneParser(const std::string& filename, Scene& scene, Animation& animation)
+        : filename_(filename), scene_(scene), animation_(animation) {}
+
+    void parse(const char* begin, const char* end) {
+        const char* line = begin;
+        while (line < end) {
+            const char* line_end = line;
+            while (line_end < end && *line_end != '\n') {
+                ++line_end;
+            }
+            ++line_number_;
+            cursor_ = line;
+            line_end_ = line_end;
+            parse_statement();
+            line = line_end + 1;
+        }
+    }
+
+private:
+    const std::string& filename_;
+    Scene& scene_;
+    Animation& animation_;
+    size_t line_number_ = 0;
+    const char* cursor_ = nullptr;
+    const char* line_end_ = nullptr;
+    // Names to indices in the scene's tables
+    std::unordered_map<std::string, uint32_t> textures_;
+    std::unordered_map<std::string, uint32_t> materials_;
+    std::unordered_map<std::string, uint32_t> meshes_;
+    // Images by path, so textures of one file share it (and intern to one entry)
+    std::unordered_map<std::string, std::shared_ptr<const ImageTexture>> images_;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error(filename_ + ":" + std::to_string(line_number_) + ": " + message);
+    }
+
+    // Next whitespace-separated token; empty at the end of the line or a comment
+    std::string_view token() {
+        while (cursor_ < line_end_ && (*cursor_ == ' ' || *cursor_ == '\t' || *cursor_ == '\r')) {
+            ++cursor_;
+        }
+        if (cursor_ == line_end_ || *cursor_ == '#') {
+            cursor_ = line_end_;
+            return {};
+        }
+        const char* start = cursor_;
+        while (cursor_ < line_end_ && *cursor_ != ' ' && *cursor_ != '\t' && *cursor_ != '\r' &&
+               *cursor_ != '#') {
+            ++cursor_;
+        }
+        return std::string_view(start, static_cast<size_t>(cursor_ - start));
+    }
+
+    // Whether another token follows on this line
+    bool more() {
+        while (cursor_ < line_end_ && (*cursor_ == ' ' || *cursor_ == '\t' || *cursor_ == '\r')) {
+            ++cursor_;
+        }
+        return cursor_ < line_end_ && *cursor_ != '#';
+    }
+
+    // Whether the next token on this line looks like a number
+    bool number_follows() {
+        if (!more()) {
+            return false;
+        }
+        char c = *cursor_;
+        return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+    }
+
+    std::string_view word(const char* what) {
+        std::string_view value = token();
+        if (value.empty()) {
+            fail(std::string("expected ") + what);
+        }
+        return value;
+    }
+
+    double number(const char* what) {
+        std::string_view text = word(what);
+        double value = 0.0;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+            fail(std::string("expected ") + what + ", got '" + std::string(text) + "'");
+        }
+        return value;
+    }
+
+    int integer(const char* what) {
+        std::string_view text = word(what);
+        int value = 0;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc() || result.ptr != text.data() + text.size() || value <= 0) {
+            fail(std::string("expected positive ") + what + ", got '" + std::string(text) + "'");
+        }
+        return value;
+    }
+
+    Vector3 vector(const char* what) {
+        double x = number(what);
+        double y = number(what);
+        double z = number(what);
+        return Vector3(x, y, z);
+    }
+
+    void end_of_statement() {
+        std::string_view extra = token();
+        if (!extra.empty()) {
+            fail("unexpected '" + std::string(extra) + "'");
+        }
+    }
+
+    // Mesh and image paths are relative to the scene file
+    std::string resolve_path(std::string_view path) const {
+        size_t slash = filename_.find_last_of('/');
+        if (path.empty() || path.front() == '/' || slash == std::string::npos) {
+            return std::string(path);
+        }
+        return filename_.substr(0, slash + 1) + std::string(path);
+    }
+
+    uint32_t material_index(std::string_view name) {
+        auto material = materials_.find(std::string(name));
+        if (material == materials_.end()) {
+            fail("unknown material '" + std::string(name) + "'");
+        }
+        return material->second;
+    }
+
+    // Index of an already defined sphere or light
+    uint32_t object_index(const char* what, size_t count) {
+        std::string_view text = word(what);
+        uint32_t value = 0;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+            fail(std::string("expected ") + what + ", got '" + std::string(text) + "'");
+        }
+        if (value >= count) {
+            fail(std::string(what) + " " + std::to_string(value) + " is not defined yet");
+        }
+        return value;
+    }
+
+    void parse_key() {
+        std::string_view text = word("key frame");
+        int frame = -1;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), frame);
+        if (result.ec != std::errc() || result.ptr != text.data() + text.size() || frame < 0) {
+            fail("expected key frame, got '" + std::string(text) + "'");
+        }
+
+        std::string_view target = word("key target");
+        if (target == "sphere") {
+            uint32_t index = object_index("sphere index", scene_.get_spheres().size());
+            animation_.add_key(Animation::Target::SPHERE_CENTER, index, frame,
+                               vector("sphere center"));
+        } else if (target == "light") {
+            uint32_t index = object_index("light index", scene_.get_lights().size());
+            animation_.add_key(Animation::Target::LIGHT_POSITION, index, frame,
+                               vector("light position"));
+        } else if (target == "camera") {
+            animation_.add_key(Animation::Target::CAMERA_POSITION, 0, frame,
+                               vector("camera position"));
+            animation_.add_key(Animation::Target::CAMERA_LOOK_AT, 0, frame,
+                               vector("camera target"));
+        } else if (target == "orbit") {
+            animation_.add_key(Animation::Target::CAMERA_ORBIT, 0, frame,
+                               Vector3(number("orbit angle"), 0, 0));
+        } else {
+            fail("unknown key target '" + std::string(target) + "'");
+        }
+        end_of_statement();
+    }
+
+    void parse_statement() {
+        std::string_view keyword = token();
+        if (keyword.empty()) {
+            return;
+        }
+
+        if (keyword == "sphere") {
+            // Most statements in a large scene: keep this path first and lean
+            Vector3 center = vector("sphere center");
+            double radius = number("sphere radius");
+            uint32_t material = material_index(word("material name"));
+            end_of_statement();
+            scene_.add_sphere(Sphere(center, radius, material));
+        } else if (keyword == "instance") {
+            std::string mesh_name(word("mesh name"));
+            auto mesh = meshes_.find(mesh_name);
+            if (mesh == meshes_.end()) {
+                fail("unknown mesh '" + mesh_name + "'");
+            }
+            uint32_t material = material_index(word("material name"));
+            // Operations apply in the order written
+            Transform object_to_world;
+            for (std::string_view op = token(); !op.empty(); op = token()) {
+                if (op == "translate") {
+                    object_to_world = Transform::translate(vector("translation")) * object_to_world;
+                } else if (op == "rotate") {
+                    std::string_view axis = word("rotation axis");
+                    if (axis != "x" && axis != "y" && axis != "z") {
+                        fail("expected rotation axis x, y or z, got '" + std::string(axis) + "'");
+                    }
+                    object_to_world =
+                        Transform::rotate(axis[0] - 'x', number("rotation angle")) * object_to_world;
+                } else if (op == "scale") {
+                    double x = number("scale");
+                    Vector3 factors(x, x, x);
+                    if (number_follows()) {
+                        double y = number("scale");
+                        factors = Vector3(x, y, number("scale"));
+                    }
+                    object_to_world = Transform::scale(factors) * object_to_world;
+                } else {
+                    fail("unknown instance operation '" + std::string(op) + "'");
+                }
+            }
+            try {
+                scene_.add_instance(mesh->second, material, object_to_world);
+            } catch (const std::exception& e) {
+                fail(e.what());
+            }
+        } else if (keyword == "mesh") {
+            std::string name(word("mesh name"));
+            std::string path = resolve_path(word("OBJ file"));
+            end_of_statement();
+            try {
+                int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+                meshes_[name] = scene_.add_mesh(TriangleMesh::load_obj(path, threads));
+            } catch (const std::exception& e) {
+                fail(e.what());
+            }
+        } else if (keyword == "material") {
+            std::string name(word("material name"));
+            Material material(vector("material color"));
+            for (std::string_view key = token(); !key.empty(); key = token()) {
+                if (key == "reflection") {
+                    material.reflection = number("reflection");
+                } else if (key == "ambient") {
+                    material.ambient = number("ambient");
+                } else if (key == "diffuse") {
+                    material.diffuse = number("diffuse");
+                } else if (key == "specular") {
+                    material.specular = number("specular");
+                } else if (key == "shininess") {
+                    material.shininess = number("shininess");
+                } else if (key == "texture") {
+                    std::string texture_name(word("texture name"));
+                    auto texture = textures_.find(texture_name);
+                    if (texture == textures_.end()) {
+                        fail("unknown texture '" + texture_name + "'");
+                    }
+                    material.texture = texture->second;
+                } else {
+                    fail("unknown material property '" + std::string(key) + "'");
+                }
+            }
+            materials_[name] = scene_.add_material(material);
+        } else if (keyword == "texture") {
+            std::string name(word("texture name"));
+            std::string_view type = word("texture type");
+            Texture texture;
+            if (type == "solid") {
+                texture = Texture(Texture::Type::SOLID, vector("texture color"));
+            } else if (type == "checkerboard" || type == "gradient") {
+                Vector3 color1 = vector("texture color");
+                Vector3 color2 = vector("texture color");
+                texture = Texture(
+                    type == "gradient" ? Texture::Type::GRADIENT : Texture::Type::CHECKERBOARD,
+                    color1, color2);
+            } else if (type == "image") {
+                std::string path = resolve_path(word("image file"));
+                auto& image = images_[path];
+                if (!image) {
+                    try {
+                        image = ImageTexture::load(path);
+                    } catch (const std::exception& e) {
+                        fail(e.what());
+                    }
+                }
+                texture = Texture(image);
+            } else {
+                fail("unknown texture type '" + std::string(type) + "'");
+            }
+            end_of_statement();
+            textures_[name] = scene_.add_texture(texture);
+        } else if (keyword == "light") {
+            Vector3 position = vector("light position");
+            Vector3 intensity = vector("light intensity");
+            double radius = more() ? number("light radius") : 0.1;
+            end_of_statement();
+            scene_.add_light(Light(position, intensity, radius));
+        } else if (keyword == "camera") {
+            Camera camera;
+            camera.position = vector("camera position");
+            camera.look_at = vector("camera target");
+            camera.fov = number("field of view");
+            for (std::string_view key = token(); !key.empty(); key = token()) {
+                if (key == "up") {
+                    camera.up = vector("camera up vector");
+                } else {
+                    fail("unknown camera property '" + std::string(key) + "'");
+                }
+            }
+            scene_.set_camera(camera);
+        } else if (keyword == "render") {
+            RenderSettings settings;
+            settings.width = integer("width");
+            settings.height = integer("height");
+            settings.samples_per_pixel = integer("samples per pixel");
+            if (more()) {
+                settings.max_depth = integer("max depth");
+            }
+            end_of_statement();
+            scene_.set_render_settings(settings);
+        } else if (keyword == "key") {
+            parse_key();
+        } else if (keyword == "frames") {
+            animation_.set_frame_count(integer("frame count"));
+            end_of_statement();
+        } else if (keyword == "background") {
+            scene_.set_background_color(vector("background color"));
+            end_of_statement();
+        } else {
+            fail("unknown statement '" + std::string(keyword) + "'");
+        }
+    }
+};
+
+}  // namespace
+
+void load_scene_file(const std::string& filename, Scene& scene, Animation* animation) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        throw std::runtime_error("Scene file not found: " + filename);
+    }
+    Animation ignored;
+    SceneParser parser(filename, scene, animation ? *animation : ignored);
+    parser.parse(file.data(), file.data() + file.size());
+}
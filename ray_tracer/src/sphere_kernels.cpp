@@ -0,0 +1,132 @@
+#include "sphere_kernels.h"
+#include "sphere_kernels_simd.h"
+#include <cmath>
+
+namespace {
+
+// Near root of sphere i, false if the ray misses it entirely
+template <typename Real>
+bool near_root(const SphereView<Real>& spheres, const KernelRay<Real>& ray, uint32_t i, Real& t) {
+    Real ocx = ray.origin[0] - spheres.center_x[i];
+    Real ocy = ray.origin[1] - spheres.center_y[i];
+    Real ocz = ray.origin[2] - spheres.center_z[i];
+    Real r2 = spheres.radius2[i];
+
+    // Same formulation as the vector kernels (see sphere_kernels_simd.h)
+    Real b = ocx * ray.dir[0] + ocy * ray.dir[1] + ocz * ray.dir[2];
+    Real fx = ocx - b * ray.dir[0];
+    Real fy = ocy - b * ray.dir[1];
+    Real fz = ocz - b * ray.dir[2];
+    Real discriminant = r2 - (fx * fx + fy * fy + fz * fz);
+    if (discriminant < 0) {
+        return false;
+    }
+
+    Real c = ocx * ocx + ocy * ocy + ocz * ocz - r2;
+    Real q = -(b + std::copysign(std::sqrt(discriminant), b));
+    t = std::fmin(c / q, q);
+    return true;
+}
+
+template <typename Real>
+int64_t closest_scalar(const SphereView<Real>& spheres, const KernelRay<Real>& ray,
+                       uint32_t first, uint32_t count, Real t_min, Real& t_max) {
+    int64_t best = -1;
+    for (uint32_t i = first; i < first + count; ++i) {
+        Real t;
+        if (near_root(spheres, ray, i, t) && t > t_min && t < t_max) {
+            t_max = t;
+            best = i;
+        }
+    }
+    return best;
+}
+
+template <typename Real>
+bool any_scalar(const SphereView<Real>& spheres, const KernelRay<Real>& ray,
+                uint32_t first, uint32_t count, Real t_min, Real t_max) {
+    for (uint32_t i = first; i < first + count; ++i) {
+        Real t;
+        if (near_root(spheres, ray, i, t) && t > t_min && t < t_max) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool cpu_supports(SimdLevel level) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    switch (level) {
+        case SimdLevel::AVX512:
+            return __builtin_cpu_supports("avx512f");
+        case SimdLevel::AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case SimdLevel::SCALAR:
+            return true;
+    }
+    return false;
+#else
+    return level == SimdLevel::SCALAR;
+#endif
+}
+
+bool compiled_in(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX512:
+#ifdef RAY_TRACER_HAVE_AVX512
+            return true;
+#else
+            return false;
+#endif
+        case SimdLevel::AVX2:
+#ifdef RAY_TRACER_HAVE_AVX2
+            return true;
+#else
+            return false;
+#endif
+        case SimdLevel::SCALAR:
+            return true;
+    }
+    return false;
+}
+
+bool available(SimdLevel level) {
+    return compiled_in(level) && cpu_supports(level);
+}
+
+}  // namespace
+
+SimdLevel detect_simd_level() {
+    if (available(SimdLevel::AVX512)) return SimdLevel::AVX512;
+    if (available(SimdLevel::AVX2)) return SimdLevel::AVX2;
+    return SimdLevel::SCALAR;
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX512: return "avx512";
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::SCALAR: return "scalar";
+    }
+    return "unknown";
+}
+
+template <typename Real>
+SphereKernels<Real> sphere_kernels(SimdLevel level) {
+    SphereKernels<Real> kernels = {SimdLevel::SCALAR, 1, closest_scalar<Real>, any_scalar<Real>};
+#ifdef RAY_TRACER_HAVE_AVX512
+    if (level == SimdLevel::AVX512 && available(SimdLevel::AVX512)) {
+        load_avx512_kernels(kernels);
+        return kernels;
+    }
+#endif
+#ifdef RAY_TRACER_HAVE_AVX2
+    if (level != SimdLevel::SCALAR && available(SimdLevel::AVX2)) {
+        load_avx2_kernels(kernels);
+    }
+#endif
+    return kernels;
+}
+
+template SphereKernels<float> sphere_kernels<float>(SimdLevel level);
+template SphereKernels<double> sphere_kernels<double>(SimdLevel level);
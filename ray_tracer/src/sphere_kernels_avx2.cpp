@@ -0,0 +1,118 @@
+// Compiled with -mavx2 -mfma; only reached after a runtime CPU check
+#include "sphere_kernels_simd.h"
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Float {
+    using real = float;
+    using reg = __m256;
+    using mask = __m256;
+    static constexpr int lanes = 8;
+
+    static reg infinity() { return _mm256_set1_ps(__builtin_inff()); }
+    static reg set1(float v) { return _mm256_set1_ps(v); }
+    static reg loadu(const float* p) { return _mm256_loadu_ps(p); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+    static reg sqrt(reg a) { return _mm256_sqrt_ps(a); }
+    static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+    static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static reg copysign(reg magnitude, reg sign) {
+        reg sign_bit = _mm256_set1_ps(-0.0f);
+        return _mm256_or_ps(_mm256_andnot_ps(sign_bit, magnitude), _mm256_and_ps(sign_bit, sign));
+    }
+    static mask ge(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static mask gt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static mask lt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static mask mask_and(mask a, mask b) { return _mm256_and_ps(a, b); }
+    static bool any(mask m) { return _mm256_movemask_ps(m) != 0; }
+    static mask lane_mask(uint32_t remaining) {
+        reg lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+        return _mm256_cmp_ps(lane, _mm256_set1_ps(static_cast<float>(remaining < 8 ? remaining : 8)),
+                             _CMP_LT_OQ);
+    }
+    static reg select(mask m, reg a, reg b) { return _mm256_blendv_ps(b, a, m); }
+    static float reduce_min(reg a) {
+        __m128 m = _mm_min_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+        return _mm_cvtss_f32(m);
+    }
+    static int first_lane_equal(reg a, float v) {
+        return __builtin_ctz(_mm256_movemask_ps(_mm256_cmp_ps(a, _mm256_set1_ps(v), _CMP_EQ_OQ)));
+    }
+};
+
+struct Avx2Double {
+    using real = double;
+    using reg = __m256d;
+    using mask = __m256d;
+    static constexpr int lanes = 4;
+
+    static reg infinity() { return _mm256_set1_pd(__builtin_inf()); }
+    static reg set1(double v) { return _mm256_set1_pd(v); }
+    static reg loadu(const double* p) { return _mm256_loadu_pd(p); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+    static reg sqrt(reg a) { return _mm256_sqrt_pd(a); }
+    static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+    static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+    static reg copysign(reg magnitude, reg sign) {
+        reg sign_bit = _mm256_set1_pd(-0.0);
+        return _mm256_or_pd(_mm256_andnot_pd(sign_bit, magnitude), _mm256_and_pd(sign_bit, sign));
+    }
+    static mask ge(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static mask gt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static mask lt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static mask mask_and(mask a, mask b) { return _mm256_and_pd(a, b); }
+    static bool any(mask m) { return _mm256_movemask_pd(m) != 0; }
+    static mask lane_mask(uint32_t remaining) {
+        reg lane = _mm256_setr_pd(0, 1, 2, 3);
+        return _mm256_cmp_pd(lane, _mm256_set1_pd(static_cast<double>(remaining < 4 ? remaining : 4)),
+                             _CMP_LT_OQ);
+    }
+    static reg select(mask m, reg a, reg b) { return _mm256_blendv_pd(b, a, m); }
+    static double reduce_min(reg a) {
+        __m128d m = _mm_min_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+        m = _mm_min_sd(m, _mm_unpackhi_pd(m, m));
+        return _mm_cvtsd_f64(m);
+    }
+    static int first_lane_equal(reg a, double v) {
+        return __builtin_ctz(_mm256_movemask_pd(_mm256_cmp_pd(a, _mm256_set1_pd(v), _CMP_EQ_OQ)));
+    }
+};
+
+int64_t closest_avx2_float(const SphereView<float>& spheres, const KernelRay<float>& ray,
+                           uint32_t first, uint32_t count, float t_min, float& t_max) {
+    return closest_sphere_simd<Avx2Float>(spheres, ray, first, count, t_min, t_max);
+}
+
+int64_t closest_avx2_double(const SphereView<double>& spheres, const KernelRay<double>& ray,
+                            uint32_t first, uint32_t count, double t_min, double& t_max) {
+    return closest_sphere_simd<Avx2Double>(spheres, ray, first, count, t_min, t_max);
+}
+
+bool any_avx2_float(const SphereView<float>& spheres, const KernelRay<float>& ray,
+                    uint32_t first, uint32_t count, float t_min, float t_max) {
+    return any_sphere_simd<Avx2Float>(spheres, ray, first, count, t_min, t_max);
+}
+
+bool any_avx2_double(const SphereView<double>& spheres, const KernelRay<double>& ray,
+                     uint32_t first, uint32_t count, double t_min, double t_max) {
+    return any_sphere_simd<Avx2Double>(spheres, ray, first, count, t_min, t_max);
+}
+
+}  // namespace
+
+void load_avx2_kernels(SphereKernels<float>& kernels) {
+    kernels = {SimdLevel::AVX2, Avx2Float::lanes, closest_avx2_float, any_avx2_float};
+}
+
+void load_avx2_kernels(SphereKernels<double>& kernels) {
+    kernels = {SimdLevel::AVX2, Avx2Double::lanes, closest_avx2_double, any_avx2_double};
+}
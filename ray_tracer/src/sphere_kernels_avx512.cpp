@@ -0,0 +1,109 @@
+// Compiled with -mavx512f; only reached after a runtime CPU check
+#include "sphere_kernels_simd.h"
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512Float {
+    using real = float;
+    using reg = __m512;
+    using mask = __mmask16;
+    static constexpr int lanes = 16;
+
+    static reg infinity() { return _mm512_set1_ps(__builtin_inff()); }
+    static reg set1(float v) { return _mm512_set1_ps(v); }
+    static reg loadu(const float* p) { return _mm512_loadu_ps(p); }
+    static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+    static reg sqrt(reg a) { return _mm512_sqrt_ps(a); }
+    static reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+    static reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+    static reg copysign(reg magnitude, reg sign) {
+        __m512i sign_bit = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+        __m512i m = _mm512_castps_si512(magnitude), s = _mm512_castps_si512(sign);
+        return _mm512_castsi512_ps(_mm512_or_si512(_mm512_andnot_si512(sign_bit, m),
+                                                   _mm512_and_si512(sign_bit, s)));
+    }
+    static mask ge(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static mask gt(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static mask lt(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static mask mask_and(mask a, mask b) { return a & b; }
+    static bool any(mask m) { return m != 0; }
+    static mask lane_mask(uint32_t remaining) {
+        return remaining >= 16 ? mask(0xFFFF) : mask((1u << remaining) - 1);
+    }
+    static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_ps(m, b, a); }
+    static float reduce_min(reg a) { return _mm512_reduce_min_ps(a); }
+    static int first_lane_equal(reg a, float v) {
+        return __builtin_ctz(_mm512_cmp_ps_mask(a, _mm512_set1_ps(v), _CMP_EQ_OQ));
+    }
+};
+
+struct Avx512Double {
+    using real = double;
+    using reg = __m512d;
+    using mask = __mmask8;
+    static constexpr int lanes = 8;
+
+    static reg infinity() { return _mm512_set1_pd(__builtin_inf()); }
+    static reg set1(double v) { return _mm512_set1_pd(v); }
+    static reg loadu(const double* p) { return _mm512_loadu_pd(p); }
+    static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+    static reg sqrt(reg a) { return _mm512_sqrt_pd(a); }
+    static reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+    static reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+    static reg copysign(reg magnitude, reg sign) {
+        __m512i sign_bit = _mm512_set1_epi64(static_cast<long long>(0x8000000000000000ull));
+        __m512i m = _mm512_castpd_si512(magnitude), s = _mm512_castpd_si512(sign);
+        return _mm512_castsi512_pd(_mm512_or_si512(_mm512_andnot_si512(sign_bit, m),
+                                                   _mm512_and_si512(sign_bit, s)));
+    }
+    static mask ge(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+    static mask gt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    static mask lt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static mask mask_and(mask a, mask b) { return a & b; }
+    static bool any(mask m) { return m != 0; }
+    static mask lane_mask(uint32_t remaining) {
+        return remaining >= 8 ? mask(0xFF) : mask((1u << remaining) - 1);
+    }
+    static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_pd(m, b, a); }
+    static double reduce_min(reg a) { return _mm512_reduce_min_pd(a); }
+    static int first_lane_equal(reg a, double v) {
+        return __builtin_ctz(_mm512_cmp_pd_mask(a, _mm512_set1_pd(v), _CMP_EQ_OQ));
+    }
+};
+
+int64_t closest_avx512_float(const SphereView<float>& spheres, const KernelRay<float>& ray,
+                             uint32_t first, uint32_t count, float t_min, float& t_max) {
+    return closest_sphere_simd<Avx512Float>(spheres, ray, first, count, t_min, t_max);
+}
+
+int64_t closest_avx512_double(const SphereView<double>& spheres, const KernelRay<double>& ray,
+                              uint32_t first, uint32_t count, double t_min, double& t_max) {
+    return closest_sphere_simd<Avx512Double>(spheres, ray, first, count, t_min, t_max);
+}
+
+bool any_avx512_float(const SphereView<float>& spheres, const KernelRay<float>& ray,
+                      uint32_t first, uint32_t count, float t_min, float t_max) {
+    return any_sphere_simd<Avx512Float>(spheres, ray, first, count, t_min, t_max);
+}
+
+bool any_avx512_double(const SphereView<double>& spheres, const KernelRay<double>& ray,
+                       uint32_t first, uint32_t count, double t_min, double t_max) {
+    return any_sphere_simd<Avx512Double>(spheres, ray, first, count, t_min, t_max);
+}
+
+}  // namespace
+
+void load_avx512_kernels(SphereKernels<float>& kernels) {
+    kernels = {SimdLevel::AVX512, Avx512Float::lanes, closest_avx512_float, any_avx512_float};
+}
+
+void load_avx512_kernels(SphereKernels<double>& kernels) {
+    kernels = {SimdLevel::AVX512, Avx512Double::lanes, closest_avx512_double, any_avx512_double};
+}
@@ -1,26 +1,23 @@
 #include "texture.h"
-#include <cmath>
+#include "image_texture.h"
 
 Vector3 Texture::get_color(double u, double v, const Vector3& point) const {
     switch (type_) {
-        case Type::SOLID:
-            return color1_;
+        case Type::CHECKERBOARD:
+            return evaluate<Type::CHECKERBOARD>(point);
 
-        case Type::CHECKERBOARD: {
-            // Checkerboard pattern
-            int scale = 10;
-            int u_check = static_cast<int>(point.x * scale) % 2;
-            int v_check = static_cast<int>(point.z * scale) % 2;
-            return (u_check == v_check) ? color1_ : color2_;
-        }
+        case Type::GRADIENT:
+            return evaluate<Type::GRADIENT>(point);
 
-        case Type::GRADIENT: {
-            // Linear gradient based on y coordinate
-            double t = std::sin(point.y * 3.14159) * 0.5 + 0.5;
-            return color1_ * (1 - t) + color2_ * t;
-        }
+        case Type::IMAGE:
+            return sample_image(u, v, 0.0, 0.0);
 
+        case Type::SOLID:
         default:
-            return color1_;
+            return evaluate<Type::SOLID>(point);
     }
 }
+
+Vector3 Texture::sample_image(double u, double v, double du, double dv) const {
+    return image_->sample(u, v, du, dv);
+}
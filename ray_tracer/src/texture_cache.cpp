@@ -0,0 +1,74 @@
+#include "texture_cache.h"
+#include "image_texture.h"
+
+TextureCache::TextureCache(size_t capacity_bytes) : capacity_(capacity_bytes) {}
+
+void TextureCache::set_capacity(size_t capacity_bytes) {
+    capacity_.store(capacity_bytes, std::memory_order_relaxed);
+}
+
+size_t TextureCache::shard_of(uint64_t key) {
+    // Fibonacci hashing: neighbouring tiles land on different shards
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 58);
+}
+
+TextureCache::Tile TextureCache::get(const ImageTexture& texture, uint32_t tile) {
+    uint64_t key = static_cast<uint64_t>(texture.cache_id()) << 32 | tile;
+    Shard& shard = shards_[shard_of(key)];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ++shard.lookups;
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+            return found->second->second;
+        }
+        ++shard.misses;
+    }
+
+    // Read without the lock; a thread missing on the same tile meanwhile
+    // reads it too, and the first copy inserted wins
+    auto data = std::make_shared<std::vector<uint8_t>>(texture.tile_bytes());
+    texture.read_tile(tile, data->data());
+    bytes_read_.fetch_add(data->size(), std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+        return found->second->second;
+    }
+    shard.lru.emplace_front(key, data);
+    shard.index.emplace(key, shard.lru.begin());
+    shard.bytes += data->size();
+
+    // Each shard keeps to its slice of the budget, but always holds the tile
+    // just loaded
+    size_t budget = capacity() / shard_count;
+    while (shard.bytes > budget && shard.lru.size() > 1) {
+        auto& oldest = shard.lru.back();
+        shard.bytes -= oldest.second->size();
+        shard.index.erase(oldest.first);
+        shard.lru.pop_back();
+        ++shard.evictions;
+    }
+    return data;
+}
+
+TextureCache::Stats TextureCache::stats() const {
+    Stats stats;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.lookups += shard.lookups;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.resident_bytes += shard.bytes;
+    }
+    stats.bytes_read = bytes_read_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::shared_ptr<TextureCache> default_texture_cache() {
+    static std::shared_ptr<TextureCache> cache = std::make_shared<TextureCache>();
+    return cache;
+}
@@ -0,0 +1,253 @@
+#include "tile_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+uint64_t morton_code(uint32_t x, uint32_t y) {
+    auto spread = [](uint64_t v) {
+        v &= 0xFFFFFFFF;
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+        v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+        v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        v = (v | (v << 2)) & 0x3333333333333333ULL;
+        v = (v | (v << 1)) & 0x5555555555555555ULL;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+void pin_to_cpu(int thread_index) {
+#ifdef __linux__
+    unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(static_cast<unsigned>(thread_index) % cpus, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)thread_index;
+#endif
+}
+
+}  // namespace
+
+WorkerPool::WorkerPool(int num_threads, bool pin_threads) : pinned_(pin_threads) {
+    int count = std::max(1, num_threads);
+    threads_.reserve(count);
+    for (int t = 0; t < count; ++t) {
+        threads_.emplace_back(&WorkerPool::worker_loop, this, t);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::start(const Job& job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &job;
+        running_ = size();
+        ++generation_;
+    }
+    wake_.notify_all();
+}
+
+void WorkerPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return running_ == 0; });
+    job_ = nullptr;
+}
+
+void WorkerPool::worker_loop(int thread_index) {
+    if (pinned_) {
+        pin_to_cpu(thread_index);
+    }
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+        if (stopping_) {
+            return;
+        }
+        seen = generation_;
+        const Job* job = job_;
+        lock.unlock();
+        (*job)(thread_index);
+        lock.lock();
+        if (--running_ == 0) {
+            done_.notify_all();
+        }
+    }
+}
+
+TileOrder parse_tile_order(const std::string& name) {
+    if (name == "morton") return TileOrder::MORTON;
+    if (name == "spiral") return TileOrder::SPIRAL;
+    if (name == "scanline") return TileOrder::SCANLINE;
+    throw std::runtime_error("Unknown tile order: " + name);
+}
+
+TileScheduler::TileScheduler(int width, int height, const Options& options) : options_(options) {
+    if (options_.tile_size <= 0) {
+        throw std::runtime_error("Tile size must be positive");
+    }
+    options_.num_threads = std::max(1, options_.num_threads);
+
+    int size = options_.tile_size;
+    int tiles_x = (width + size - 1) / size;
+    int tiles_y = (height + size - 1) / size;
+
+    struct Keyed {
+        double key;
+        Tile tile;
+    };
+    std::vector<Keyed> keyed;
+    keyed.reserve(static_cast<size_t>(tiles_x) * tiles_y);
+
+    double center_x = (tiles_x - 1) / 2.0;
+    double center_y = (tiles_y - 1) / 2.0;
+    for (int ty = 0; ty < tiles_y; ++ty) {
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            Tile tile = {tx * size, ty * size, std::min(width, (tx + 1) * size),
+                         std::min(height, (ty + 1) * size), 0};
+            double key = 0.0;
+            switch (options_.order) {
+                case TileOrder::MORTON:
+                    key = static_cast<double>(morton_code(tx, ty));
+                    break;
+                case TileOrder::SPIRAL: {
+                    // Ring number first, then angle around the center within the ring
+                    double dx = tx - center_x, dy = ty - center_y;
+                    double ring = std::max(std::fabs(dx), std::fabs(dy));
+                    key = ring * 8.0 + (std::atan2(dy, dx) + M_PI) / M_PI;
+                    break;
+                }
+                case TileOrder::SCANLINE:
+                    key = static_cast<double>(ty) * tiles_x + tx;
+                    break;
+            }
+            keyed.push_back({key, tile});
+        }
+    }
+
+    std::stable_sort(keyed.begin(), keyed.end(),
+                     [](const Keyed& a, const Keyed& b) { return a.key < b.key; });
+    tiles_.reserve(keyed.size());
+    for (auto& k : keyed) {
+        k.tile.index = tiles_.size();
+        tiles_.push_back(k.tile);
+    }
+}
+
+void TileScheduler::run(const TileFn& render_tile) {
+    std::atomic<size_t> next_tile{0};
+    std::atomic<size_t> tiles_done{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    // Pool threads were pinned when the pool started
+    int num_threads = options_.pool ? options_.pool->size() : options_.num_threads;
+    int workers_left = num_threads;
+
+    WorkerPool::Job worker = [&](int thread_index) {
+        if (options_.pin_threads && !options_.pool) {
+            pin_to_cpu(thread_index);
+        }
+        try {
+            while (!failed.load(std::memory_order_relaxed)) {
+                size_t index = next_tile.fetch_add(1, std::memory_order_relaxed);
+                if (index >= tiles_.size()) {
+                    break;
+                }
+                render_tile(tiles_[index], thread_index);
+                tiles_done.fetch_add(1, std::memory_order_relaxed);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            failed.store(true, std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--workers_left == 0) {
+            finished.notify_one();
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto report = [&]() {
+        if (!options_.progress) {
+            return;
+        }
+        RenderProgress progress;
+        progress.tiles_done = tiles_done.load(std::memory_order_relaxed);
+        progress.tiles_total = tiles_.size();
+        progress.elapsed_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        progress.eta_seconds = progress.tiles_done == 0
+            ? 0.0
+            : progress.elapsed_seconds * (progress.tiles_total - progress.tiles_done) /
+                  progress.tiles_done;
+        options_.progress(progress);
+    };
+
+    std::vector<std::thread> threads;
+    if (options_.pool) {
+        options_.pool->start(worker);
+    } else {
+        threads.reserve(num_threads);
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back(worker, t);
+        }
+    }
+
+    // The calling thread only reports progress, so callbacks never race each other
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto interval = std::chrono::duration<double>(std::max(0.01, options_.progress_interval));
+        while (workers_left > 0) {
+            finished.wait_for(lock, interval);
+            if (workers_left > 0) {
+                lock.unlock();
+                report();
+                lock.lock();
+            }
+        }
+    }
+
+    if (options_.pool) {
+        options_.pool->wait();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    report();
+}
@@ -0,0 +1,311 @@
+#include "wavefront.h"
+#include "accelerator.h"
+#include "instrumentation.h"
+#include "ray_tracer.h"
+#include "scene.h"
+#include <algorithm>
+#include <cmath>
+
+void RayStream::Rays::clear() {
+    path.clear();
+    origin.clear();
+    direction.clear();
+    key.clear();
+    cone.clear();
+}
+
+void RayStream::Rays::push_back(uint32_t ray_path, const Vector3& ray_origin,
+                                const Vector3& ray_direction, uint64_t sort_key,
+                                double cone_width) {
+    path.push_back(ray_path);
+    origin.push_back(ray_origin);
+    direction.push_back(ray_direction);
+    key.push_back(sort_key);
+    cone.push_back(cone_width);
+}
+
+void RayStream::Rays::resize_hits() {
+    hit.resize(size());
+    t.resize(size());
+    normal.resize(size());
+    material.resize(size());
+    radius.resize(size());
+}
+
+void RayStream::clear() {
+    x.clear();
+    y.clear();
+    sample.clear();
+    throughput.clear();
+    radiance.clear();
+    first_hit.clear();
+    first_t.clear();
+    first_normal.clear();
+    first_albedo.clear();
+    rays.clear();
+    next_rays.clear();
+    camera_rays = 0;
+    secondary_rays = 0;
+    shadow_rays = 0;
+}
+
+size_t RayStream::add_camera_ray(uint32_t px, uint32_t py, uint32_t sample_index,
+                                 const Vector3& origin, const Vector3& direction) {
+    size_t path = x.size();
+    x.push_back(px);
+    y.push_back(py);
+    sample.push_back(sample_index);
+    throughput.push_back(Vector3(1, 1, 1));
+    radiance.push_back(Vector3(0, 0, 0));
+    first_hit.push_back(0);
+    first_t.push_back(0.0);
+    first_normal.push_back(Vector3());
+    first_albedo.push_back(Vector3());
+
+    // Neighbouring pixels' camera rays are coherent already
+    rays.push_back(static_cast<uint32_t>(path), origin, direction, 0, 0.0);
+    ++camera_rays;
+    return path;
+}
+
+namespace {
+
+// Reorder rays by their coherence keys
+void sort_rays(RayStream& stream) {
+    RayStream::Rays& rays = stream.rays;
+    stream.order.clear();
+    for (size_t i = 0; i < rays.size(); ++i) {
+        stream.order.emplace_back(rays.key[i], static_cast<uint32_t>(i));
+    }
+    std::sort(stream.order.begin(), stream.order.end());
+
+    RayStream::Rays& sorted = stream.sorted;
+    sorted.clear();
+    for (const auto& entry : stream.order) {
+        uint32_t i = entry.second;
+        sorted.push_back(rays.path[i], rays.origin.get(i), rays.direction.get(i), rays.key[i],
+                         rays.cone[i]);
+    }
+    std::swap(rays, sorted);
+}
+
+}  // namespace
+
+void RayTracer::trace_wavefront(RayStream& stream, const Scene& scene, Sampler& sampler) {
+    const auto& materials = scene.get_materials();
+    const auto& lights = scene.get_lights();
+    const uint32_t light_count = static_cast<uint32_t>(lights.size());
+    // Light slots per hit, and sampler dimensions per bounce as calculate_lighting claims them
+    const uint32_t slot_count = light_picks_ > 0 ? light_picks_ : light_count;
+    const uint32_t bounce_dimensions = light_picks_ > 0 ? light_picks_ + 1 : light_count;
+    const Vector3 background = scene.get_background_color();
+    const uint32_t probe_samples = static_cast<uint32_t>(std::max(1, shadow_probe_samples_));
+    const uint32_t loop_samples =
+        static_cast<uint32_t>(std::max({1, shadow_probe_samples_, shadow_max_samples_}));
+    RayStream::Shading& shading = stream.shading;
+
+    for (int depth = 0; stream.rays.size() > 0; ++depth) {
+        RayStream::Rays& rays = stream.rays;
+        RT_COUNT_MAX(max_depth, static_cast<uint32_t>(depth));
+        if (depth > 0) {
+            sort_rays(stream);
+        }
+
+        // Intersect the whole stream
+        rays.resize_hits();
+        for (size_t i = 0; i < rays.size(); ++i) {
+            SceneAccelerator::Hit hit = accelerator_->closest_hit(
+                rays.origin.get(i), rays.direction.get(i), 0.001, 1e10);
+            rays.hit[i] = hit.hit;
+            if (hit.hit) {
+                rays.t[i] = hit.t;
+                rays.normal.set(i, hit.normal);
+                rays.material[i] = hit.material;
+                rays.radius[i] = hit.sphere ? hit.sphere->radius : 0.0;
+            }
+        }
+
+        // Misses see the background; hits are shaded sorted by kernel kind
+        // and material, as the recursive renderer groups camera hits
+        stream.order.clear();
+        for (size_t i = 0; i < rays.size(); ++i) {
+            if (!rays.hit[i]) {
+                uint32_t path = rays.path[i];
+                stream.radiance.set(path, stream.radiance.get(path) +
+                                              stream.throughput.get(path) * background);
+                continue;
+            }
+            uint64_t kind = material_shading_[rays.material[i]].kind;
+            stream.order.emplace_back(kind << 32 | rays.material[i], static_cast<uint32_t>(i));
+        }
+        std::sort(stream.order.begin(), stream.order.end());
+
+        size_t hit_count = stream.order.size();
+        shading.ray.resize(hit_count);
+        shading.point.resize(hit_count);
+        shading.shadow_origin.resize(hit_count);
+        shading.tint.resize(hit_count);
+        shading.lighting.resize(hit_count);
+        shading.light.resize(hit_count * slot_count);
+        shading.weight.resize(hit_count * slot_count);
+        shading.visible.assign(hit_count * slot_count, 0);
+        shading.traced.assign(hit_count * slot_count, 0);
+        for (size_t k = 0; k < hit_count; ++k) {
+            uint32_t i = stream.order[k].second;
+            HitInfo hit = {true,
+                           rays.t[i],
+                           rays.origin.get(i) + rays.direction.get(i) * rays.t[i],
+                           rays.normal.get(i),
+                           rays.material[i],
+                           rays.cone[i] + rays.t[i] * pixel_spread_,
+                           rays.radius[i]};
+            const Material& material = materials[hit.material];
+            shading.ray[k] = i;
+            shading.point.set(k, hit.point);
+            shading.shadow_origin.set(k, hit.point + hit.normal * 0.001);
+            shading.tint.set(k, surface_albedo(hit, scene));
+            shading.lighting.set(k, material.color * material.ambient);
+
+            // Lights to shade by: every light, or picks drawn from the
+            // dimensions calculate_lighting draws them from
+            uint32_t pick_dimension = 1 + static_cast<uint32_t>(depth) * bounce_dimensions;
+            if (light_picks_ > 0) {
+                uint32_t path = rays.path[i];
+                sampler.start_sample(stream.x[path], stream.y[path], stream.sample[path]);
+            }
+            for (uint32_t j = 0; j < slot_count; ++j) {
+                size_t slot = k * slot_count + j;
+                shading.light[slot] = j;
+                shading.weight[slot] = 1.0;
+                if (light_picks_ > 0) {
+                    Sample2D choice = sampler.loop_point(pick_dimension, j, slot_count);
+                    LightTree::Pick pick = pick_light(hit, material, choice.u);
+                    shading.light[slot] = pick.light;
+                    shading.weight[slot] = pick.pdf > 0.0 ? 1.0 / (pick.pdf * slot_count) : 0.0;
+                }
+            }
+
+            if (depth == 0) {
+                uint32_t path = rays.path[i];
+                stream.first_hit[path] = 1;
+                stream.first_t[path] = hit.t;
+                stream.first_normal.set(path, hit.normal);
+                stream.first_albedo.set(path, shading.tint.get(k));
+            }
+        }
+
+        // Soft shadows one light slot at a time: probe rays for all hits,
+        // then the rest only where the probes disagree (the point lies in a
+        // penumbra). Shading by every light, each slot's rays all head for
+        // the same light; picked lights differ from hit to hit.
+        for (uint32_t l = 0; l < slot_count; ++l) {
+            uint32_t dimension = 1 + static_cast<uint32_t>(depth) * bounce_dimensions +
+                                 (light_picks_ > 0 ? 1 : 0) + l;
+
+            auto trace_shadow_rays = [&](bool refine) {
+                stream.shadow_entry.clear();
+                stream.shadow_direction.clear();
+                stream.shadow_distance.clear();
+                for (size_t k = 0; k < hit_count; ++k) {
+                    size_t slot = k * slot_count + l;
+                    if (shading.weight[slot] == 0.0) {
+                        continue;
+                    }
+                    uint32_t visible = shading.visible[slot];
+                    uint32_t traced = shading.traced[slot];
+                    uint32_t target = probe_samples;
+                    if (refine) {
+                        if (visible == 0 || visible == traced) {
+                            continue;
+                        }
+                        target = static_cast<uint32_t>(std::max(0, shadow_max_samples_));
+                    }
+                    if (traced >= target) {
+                        continue;
+                    }
+
+                    uint32_t i = shading.ray[k];
+                    uint32_t path = rays.path[i];
+                    sampler.start_sample(stream.x[path], stream.y[path], stream.sample[path]);
+                    Vector3 origin = shading.shadow_origin.get(k);
+                    const Light& light = lights[shading.light[slot]];
+                    for (uint32_t j = traced; j < target; ++j) {
+                        Sample2D sample = sampler.loop_point(dimension, j, loop_samples);
+                        Vector3 to_light = light.position + random_on_sphere(light.radius, sample) -
+                                           origin;
+                        double distance = to_light.length();
+                        stream.shadow_entry.push_back(static_cast<uint32_t>(k));
+                        stream.shadow_direction.push_back(to_light / distance);
+                        stream.shadow_distance.push_back(distance);
+                    }
+                }
+
+                size_t count = stream.shadow_entry.size();
+                for (size_t s = 0; s < count; ++s) {
+                    uint32_t k = stream.shadow_entry[s];
+                    size_t slot = k * slot_count + l;
+                    if (!accelerator_->occluded(shading.shadow_origin.get(k),
+                                                stream.shadow_direction.get(s), 0.001,
+                                                stream.shadow_distance[s])) {
+                        ++shading.visible[slot];
+                    }
+                    ++shading.traced[slot];
+                }
+                stream.shadow_rays += count;
+            };
+            trace_shadow_rays(false);
+            trace_shadow_rays(true);
+
+            for (size_t k = 0; k < hit_count; ++k) {
+                size_t slot = k * slot_count + l;
+                if (shading.weight[slot] == 0.0) {
+                    continue;
+                }
+                uint32_t i = shading.ray[k];
+                const Material& material = materials[rays.material[i]];
+                const Light& light = lights[shading.light[slot]];
+                Vector3 point = shading.point.get(k);
+                Vector3 normal = rays.normal.get(i);
+                Vector3 light_dir = (light.position - point).normalize();
+                double shadow_factor = static_cast<double>(shading.visible[slot]) /
+                                       shading.traced[slot] * shading.weight[slot];
+
+                // Diffuse and Blinn-Phong specular, as calculate_lighting
+                double diffuse_intensity = std::max(0.0, normal.dot(light_dir));
+                Vector3 lighting = shading.lighting.get(k) + material.color * light.intensity *
+                                                                 material.diffuse *
+                                                                 diffuse_intensity * shadow_factor;
+                Vector3 halfway = (light_dir - rays.direction.get(i)).normalize();
+                double specular_intensity =
+                    std::pow(std::max(0.0, normal.dot(halfway)), material.shininess);
+                shading.lighting.set(k, lighting + light.intensity * material.specular *
+                                                       specular_intensity * shadow_factor);
+            }
+        }
+
+        // Weight each hit's light by its path's throughput and continue the
+        // path along the reflection with the throughput scaled down
+        RayStream::Rays& next_rays = stream.next_rays;
+        next_rays.clear();
+        for (size_t k = 0; k < hit_count; ++k) {
+            uint32_t i = shading.ray[k];
+            uint32_t path = rays.path[i];
+            const Material& material = materials[rays.material[i]];
+            Vector3 weight = stream.throughput.get(path) * shading.tint.get(k);
+            stream.radiance.set(path, stream.radiance.get(path) +
+                                          shading.lighting.get(k) * weight);
+
+            if (material.reflection > 0.0 && depth < max_depth_) {
+                Vector3 view_dir = rays.direction.get(i);
+                Vector3 normal = rays.normal.get(i);
+                Vector3 reflect_dir = (view_dir - normal * 2.0 * view_dir.dot(normal)).normalize();
+                next_rays.push_back(path, shading.point.get(k) + normal * 0.001, reflect_dir,
+                                    coherence_key(reflect_dir, rays.material[i]),
+                                    rays.cone[i] + rays.t[i] * pixel_spread_);
+                stream.throughput.set(path, weight * material.reflection);
+                ++stream.secondary_rays;
+            }
+        }
+        std::swap(stream.rays, stream.next_rays);
+    }
+}
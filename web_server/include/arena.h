@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Arena - Bump allocator for short-lived, per-connection allocations
+ *
+ * Memory is carved out of a chain of blocks and is only returned when the
+ * arena is reset or destroyed, so individual deallocation is free.
+ * Not thread-safe: an arena belongs to one connection on one event loop.
+ */
+class Arena {
+public:
+    explicit Arena(size_t block_size = 4096);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Allocate size bytes with the given alignment
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Release everything except the first block for reuse
+    void reset();
+
+    // Total bytes handed out since construction or the last reset
+    size_t bytes_allocated() const { return bytes_allocated_; }
+
+    // Lets coroutine frames that take an Arena& find their allocator
+    Arena* frame_arena() { return this; }
+
+private:
+    struct Block {
+        Block* next;
+        size_t capacity;
+        size_t used;
+    };
+
+    Block* head_;
+    size_t block_size_;
+    size_t bytes_allocated_;
+
+    Block* new_block(size_t min_size);
+};
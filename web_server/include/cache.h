@@ -6,6 +6,8 @@
 #include <chrono>
 #include <memory>
 
+class SharedResponseCache;
+
 /**
  * CacheEntry - A single cached response with TTL
  */
@@ -43,8 +45,13 @@ public:
     // Get cache size
     size_t size() const;
 
+    // Back this cache with a segment shared by several worker processes;
+    // entries too large for a shared slab stay process-local
+    void attach_shared(std::shared_ptr<SharedResponseCache> shared);
+
 private:
     std::unordered_map<std::string, CacheEntry> cache_;
+    std::shared_ptr<SharedResponseCache> shared_;
     mutable std::mutex mutex_;
     int default_ttl_;
 };
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "arena.h"
+#include "task.h"
+#include <string>
+#include <sys/types.h>
+
+class EventLoop;
+
+/**
+ * Connection - A non-blocking client socket driven by an EventLoop
+ *
+ * Owns the socket and the per-connection Arena; coroutines that take the
+ * connection (or a Request bound to it) allocate their frames from that arena.
+ */
+class Connection {
+public:
+    Connection(EventLoop& loop, int fd);
+    ~Connection();
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    // Read up to len bytes, suspending until data arrives (0 on EOF, -1 on error)
+    task<ssize_t> read_some(char* buffer, size_t len);
+
+    // Write all bytes, suspending while the socket is full (false on error)
+    task<bool> write_all(const char* data, size_t len);
+    task<bool> write_all(const std::string& data) { return write_all(data.data(), data.size()); }
+
+    int fd() const { return fd_; }
+    EventLoop& loop() { return loop_; }
+    Arena& arena() { return arena_; }
+    Arena* frame_arena() { return &arena_; }
+
+private:
+    EventLoop& loop_;
+    int fd_;
+    Arena arena_;
+};
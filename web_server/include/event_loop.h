@@ -0,0 +1,160 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * EventLoop - Single-threaded epoll reactor that resumes coroutines
+ *
+ * Coroutines suspend on socket readiness, timers or work offloaded to a
+ * ThreadPool, and are always resumed on the loop thread. Only post() and
+ * stop() may be called from other threads.
+ */
+class EventLoop {
+public:
+    EventLoop();
+    ~EventLoop();
+
+    // Run until stop() is called
+    void run();
+
+    // Ask the loop to exit (thread-safe)
+    void stop();
+
+    // Resume a coroutine / run a callback on the loop thread (thread-safe)
+    void post(std::coroutine_handle<> handle);
+    void post(std::function<void()> callback);
+
+    // Resume a coroutine on the next loop iteration (loop thread only, no locking)
+    void defer(std::coroutine_handle<> handle) { deferred_.push_back(handle); }
+
+    // Awaitable readiness of a non-blocking file descriptor
+    struct IoAwaiter {
+        EventLoop& loop;
+        int fd;
+        bool write;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { loop.watch(fd, write, h); }
+        void await_resume() const noexcept {}
+    };
+    IoAwaiter readable(int fd) { return {*this, fd, false}; }
+    IoAwaiter writable(int fd) { return {*this, fd, true}; }
+
+    // Awaitable timer
+    struct TimerAwaiter {
+        EventLoop& loop;
+        std::chrono::steady_clock::time_point deadline;
+        bool await_ready() const noexcept { return deadline <= std::chrono::steady_clock::now(); }
+        void await_suspend(std::coroutine_handle<> h) { loop.add_timer(deadline, h); }
+        void await_resume() const noexcept {}
+    };
+    TimerAwaiter sleep_for(std::chrono::milliseconds duration) {
+        return {*this, std::chrono::steady_clock::now() + duration};
+    }
+
+    // Awaitable that runs fn on a pool thread and resumes on the loop with its result
+    template <typename F>
+    class OffloadAwaiter {
+    public:
+        using result_type = std::invoke_result_t<F>;
+
+        OffloadAwaiter(EventLoop& loop, ThreadPool& pool, F fn)
+            : loop_(loop), pool_(pool), fn_(std::move(fn)) {}
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) {
+            pool_.enqueue([this, h]() {
+                try {
+                    if constexpr (std::is_void_v<result_type>) {
+                        fn_();
+                    } else {
+                        result_.emplace(fn_());
+                    }
+                } catch (...) {
+                    exception_ = std::current_exception();
+                }
+                loop_.post(h);
+            });
+        }
+        result_type await_resume() {
+            if (exception_) std::rethrow_exception(exception_);
+            if constexpr (!std::is_void_v<result_type>) {
+                return std::move(*result_);
+            }
+        }
+
+    private:
+        using storage_type = std::conditional_t<std::is_void_v<result_type>, bool, result_type>;
+
+        EventLoop& loop_;
+        ThreadPool& pool_;
+        F fn_;
+        std::optional<storage_type> result_;
+        std::exception_ptr exception_;
+    };
+
+    // Run CPU-heavy work on a compute pool and resume here afterwards
+    template <typename F>
+    OffloadAwaiter<F> offload(ThreadPool& pool, F fn) {
+        return OffloadAwaiter<F>(*this, pool, std::move(fn));
+    }
+
+    // Read a whole file on the blocking-I/O pool (nullopt if it cannot be read)
+    OffloadAwaiter<std::function<std::optional<std::string>()>> read_file(const std::string& path);
+
+    // Number of coroutines currently waiting on descriptors or timers
+    size_t pending() const { return waiters_.size() + timers_.size(); }
+
+private:
+    struct FdWaiters {
+        std::coroutine_handle<> reader;
+        std::coroutine_handle<> writer;
+        uint32_t registered = 0;
+    };
+
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        uint64_t sequence;
+        std::coroutine_handle<> handle;
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline
+                                              : sequence > other.sequence;
+        }
+    };
+
+    int epoll_fd_;
+    int wake_fd_;
+    std::atomic<bool> stopped_;
+
+    std::unordered_map<int, FdWaiters> waiters_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    uint64_t timer_sequence_ = 0;
+
+    std::vector<std::coroutine_handle<>> deferred_;
+
+    std::mutex post_mutex_;
+    std::vector<std::function<void()>> posted_;
+
+    // Blocking file I/O never runs on the loop thread
+    std::unique_ptr<ThreadPool> blocking_pool_;
+
+    void watch(int fd, bool write, std::coroutine_handle<> handle);
+    void update_registration(int fd, FdWaiters& waiters);
+    void add_timer(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle);
+    void wake();
+    void run_posted();
+    void run_expired_timers();
+    int next_timeout_ms() const;
+};
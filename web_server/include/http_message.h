@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class Arena;
+
+// Reason phrase for an HTTP status code ("OK", "Not Found", ...)
+std::string http_status_text(int status_code);
+
+/**
+ * Request - Parsed HTTP request handed to coroutine handlers
+ */
+struct Request {
+    std::string method;
+    std::string path;      // Path without the query string
+    std::string query;     // Everything after '?', empty if absent
+    std::string version;
+    std::string body;
+    std::string raw;       // Original request bytes
+    Arena* arena = nullptr;  // Per-connection arena (owned by the connection)
+
+    // Value of a header, empty if absent
+    std::string header(const std::string& name) const;
+
+    // Value of a query parameter, or fallback if absent
+    std::string query_param(const std::string& name, const std::string& fallback = "") const;
+
+    // Coroutine frames of handlers taking a Request& live in this arena
+    Arena* frame_arena() const { return arena; }
+};
+
+/**
+ * Response - Response produced by a coroutine handler
+ */
+struct Response {
+    int status = 200;
+    std::string content_type = "text/html";
+    std::string body;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    static Response json(const std::string& json_content, int status = 200);
+
+    // Serialize to HTTP/1.1 wire format
+    std::string serialize() const;
+};
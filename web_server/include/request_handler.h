@@ -1,10 +1,17 @@
 #pragma once
 
+#include "http_message.h"
+#include "task.h"
 #include <string>
 #include <memory>
+#include <functional>
+#include <unordered_map>
 
 class ResponseCache;
 
+// Coroutine handler: runs on the server's event loop and may co_await I/O
+using AsyncHandler = std::function<task<Response>(Request&)>;
+
 /**
  * RequestHandler - Processes HTTP requests and generates responses
  * Supports GET, POST, PUT, DELETE, HEAD, OPTIONS methods
@@ -16,11 +23,22 @@ public:
     // Parse and handle an HTTP request, return response
     std::string handle_request(const std::string& raw_request);
 
+    // Parse a raw request into a Request (arena left unset)
+    Request parse_request(const std::string& raw_request);
+
+    // Register a coroutine handler for an exact method + path (query ignored)
+    void register_async_route(const std::string& method, const std::string& path,
+                              AsyncHandler handler);
+
+    // Find the coroutine handler for a request, nullptr if it is a synchronous route
+    const AsyncHandler* find_async_route(const std::string& method, const std::string& path) const;
+
     // Get cache instance
     ResponseCache& get_cache() { return *cache_; }
 
 private:
     std::unique_ptr<ResponseCache> cache_;
+    std::unordered_map<std::string, AsyncHandler> async_routes_;
 
     // Helper methods for parsing
     std::string parse_method(const std::string& raw_request);
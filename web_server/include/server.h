@@ -1,14 +1,20 @@
 #pragma once
 
+#include "request_handler.h"
+#include "task.h"
+#include "trace.h"
+#include <atomic>
 #include <string>
 #include <memory>
 
-class RequestHandler;
 class ThreadPool;
+class EventLoop;
+class WebSocketHub;
 
 /**
  * HTTPServer - A multi-protocol server supporting both HTTP and HTTPS
- * Handles incoming requests using a thread pool
+ * Connections are multiplexed on an event loop; coroutine handlers run on the
+ * loop and synchronous handlers are dispatched to a thread pool
  */
 class HTTPServer {
 public:
@@ -29,13 +35,35 @@ public:
     // Get protocol
     Protocol get_protocol() const { return protocol_; }
 
+    // Let several processes bind the same port (SO_REUSEPORT); set before start()
+    void set_reuse_port(bool reuse_port) { reuse_port_ = reuse_port; }
+
+    // Request handler (and through it the response cache)
+    RequestHandler& get_request_handler() { return *request_handler_; }
+
+    // Register a coroutine handler for method + path (runs on the event loop)
+    void register_async_route(const std::string& method, const std::string& path,
+                              AsyncHandler handler);
+
+    // Event loop that drives connections and coroutine handlers
+    EventLoop& get_event_loop() { return *event_loop_; }
+
+    // Pool for synchronous handlers and CPU-heavy work offloaded by coroutines
+    ThreadPool& get_compute_pool() { return *thread_pool_; }
+
+    // Topic broadcast to WebSocket clients connected on /ws/<topic>
+    WebSocketHub& get_websocket_hub() { return *websocket_hub_; }
+
 private:
     int port_;
     Protocol protocol_;
     int server_socket_;
-    bool running_;
+    std::atomic<bool> running_;
+    bool reuse_port_ = false;
+    std::unique_ptr<EventLoop> event_loop_;  // Outlives the pool: workers post back to it
     std::unique_ptr<ThreadPool> thread_pool_;
     std::unique_ptr<RequestHandler> request_handler_;
+    std::unique_ptr<WebSocketHub> websocket_hub_;
 
     // TLS/SSL members
     void* ssl_context_;  // Actually SSL_CTX*
@@ -43,6 +71,8 @@ private:
     // Helper methods
     void setup_socket();
     void setup_ssl();
-    void accept_connections();
+    void register_builtin_routes();
+    task<void> accept_connections();
+    task<void> serve_connection(int client_socket, trace::Context ctx);
 };
 
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * SharedResponseCache - Response cache shared by several processes
+ *
+ * Lives in one shared-memory segment (an anonymous memfd inherited across
+ * fork(), or a named shm_open object) laid out as a fixed-size slab array:
+ * every slot holds one key + response up to slot_size bytes. Slots form an
+ * N-way set-associative index keyed by a 64-bit hash.
+ *
+ * Readers never lock: each slot carries a seqlock sequence and readers retry
+ * if a writer touched the slot while they copied it. Writers serialize per lock
+ * stripe on process-shared robust mutexes, so a worker that crashes while
+ * holding one does not wedge the others; the next writer repairs any slot the
+ * dead worker left half-written.
+ */
+class SharedResponseCache {
+public:
+    struct Options {
+        size_t slot_count = 2048;    // Total slabs (rounded to a multiple of ways)
+        size_t slot_size = 16384;    // Bytes per slab including its header
+        int default_ttl = 300;
+    };
+
+    // Create a new segment. An empty name uses an anonymous memfd that child
+    // processes inherit; otherwise a named POSIX shared memory object is
+    // created or attached to.
+    static std::shared_ptr<SharedResponseCache> create(const Options& options,
+                                                       const std::string& name = "");
+
+    ~SharedResponseCache();
+
+    SharedResponseCache(const SharedResponseCache&) = delete;
+    SharedResponseCache& operator=(const SharedResponseCache&) = delete;
+
+    // Store response; false if the entry does not fit in a slab
+    bool put(const std::string& key, const std::string& response, int ttl_seconds = -1);
+
+    // Retrieve response (nullptr if expired or not found)
+    std::shared_ptr<std::string> get(const std::string& key) const;
+
+    void remove(const std::string& key);
+    void clear();
+
+    // Number of live (non-expired) entries
+    size_t size() const;
+
+    // Times a lock was recovered from a process that died holding it
+    uint64_t recoveries() const;
+
+    // Largest key + response that fits in one slab
+    size_t max_entry_size() const;
+
+private:
+    struct Header;
+    struct Slot;
+
+    SharedResponseCache(void* base, size_t mapped_size);
+
+    void* base_;
+    size_t mapped_size_;
+    Header* header_;
+
+    Slot* slot(size_t index) const;
+    size_t set_of(uint64_t hash) const;
+    void lock_stripe(size_t set) const;
+    void unlock_stripe(size_t set) const;
+    void repair_stripe(size_t stripe) const;
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "arena.h"
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <utility>
+
+namespace detail {
+
+// Any coroutine argument exposing frame_arena() (a Request, a Connection or an
+// Arena itself) decides where the coroutine frame is allocated
+template <typename T>
+Arena* arena_of(T& value) {
+    if constexpr (requires { value.frame_arena(); }) {
+        return value.frame_arena();
+    } else {
+        return nullptr;
+    }
+}
+
+template <typename... Args>
+Arena* find_arena(Args&... args) {
+    Arena* arena = nullptr;
+    ((arena = arena ? arena : arena_of(args)), ...);
+    return arena;
+}
+
+/**
+ * FrameAllocator - Places coroutine frames in an Arena when one is available
+ *
+ * Each frame is prefixed with the owning arena (or nullptr for heap frames) so
+ * that deallocation knows whether there is anything to free.
+ */
+struct FrameAllocator {
+    static constexpr size_t header = alignof(std::max_align_t);
+
+    static void* allocate(size_t size, Arena* arena) {
+        void* base = arena ? arena->allocate(size + header)
+                           : ::operator new(size + header);
+        *static_cast<Arena**>(base) = arena;
+        return static_cast<char*>(base) + header;
+    }
+
+    static void deallocate(void* frame) {
+        void* base = static_cast<char*>(frame) - header;
+        if (*static_cast<Arena**>(base) == nullptr) {
+            ::operator delete(base);
+        }
+        // Arena frames are reclaimed when the arena is reset or destroyed
+    }
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    // Inlined so GCC's -Wmismatched-new-delete, which never pairs a template
+    // operator new with a non-template delete, sees only FrameAllocator
+    template <typename... Args>
+    [[gnu::always_inline]] static void* operator new(size_t size, Args&... args) {
+        return FrameAllocator::allocate(size, find_arena(args...));
+    }
+    static void* operator new(size_t size) {
+        return FrameAllocator::allocate(size, nullptr);
+    }
+    // Sized, as coroutines prefer; the frame header already says whether
+    // there is anything to free
+    static void operator delete(void* frame, size_t) {
+        FrameAllocator::deallocate(frame);
+    }
+
+    // Tasks are lazy: nothing runs until the task is awaited
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // On completion, transfer control straight back to the awaiting coroutine
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+            auto next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+}  // namespace detail
+
+/**
+ * task<T> - Lazily started coroutine producing a T
+ *
+ * Awaiting a task starts it and suspends the caller until it finishes; the
+ * result (or exception) is handed back through co_await. Frames are taken from
+ * the arena of any Request/Connection/Arena argument, otherwise the heap.
+ */
+template <typename T = void>
+class task {
+public:
+    struct promise_type : detail::PromiseBase {
+        std::optional<T> value;
+
+        task get_return_object() {
+            return task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        template <typename U>
+        void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+    };
+
+    task(task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    task& operator=(task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    ~task() { if (handle_) handle_.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+    T await_resume() {
+        auto& promise = handle_.promise();
+        if (promise.exception) std::rethrow_exception(promise.exception);
+        return std::move(*promise.value);
+    }
+
+private:
+    explicit task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <>
+class task<void> {
+public:
+    struct promise_type : detail::PromiseBase {
+        task get_return_object() {
+            return task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        void return_void() {}
+    };
+
+    task(task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    task& operator=(task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    ~task() { if (handle_) handle_.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+    void await_resume() {
+        if (handle_.promise().exception) std::rethrow_exception(handle_.promise().exception);
+    }
+
+private:
+    explicit task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/**
+ * detached_task - Fire-and-forget coroutine that frees itself on completion
+ */
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {
+            try {
+                std::rethrow_exception(std::current_exception());
+            } catch (const std::exception& e) {
+                std::cerr << "Unhandled exception in detached task: " << e.what() << "\n";
+            } catch (...) {
+                std::cerr << "Unhandled exception in detached task\n";
+            }
+        }
+    };
+};
+
+// Start a task without waiting for it; it runs until its first suspension now
+inline detached_task spawn(task<void> t) {
+    co_await std::move(t);
+}
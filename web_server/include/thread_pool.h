@@ -7,6 +7,9 @@
 #include <condition_variable>
 #include <functional>
 #include <future>
+#include <stdexcept>
+#include <type_traits>
+#include "trace.h"
 
 /**
  * ThreadPool - A simple thread pool for concurrent task execution
@@ -19,7 +22,7 @@ public:
     // Submit a task to the thread pool
     template <class F, class... Args>
     auto enqueue(F&& f, Args&&... args) 
-        -> std::future<typename std::result_of<F(Args...)>::type>;
+        -> std::future<std::invoke_result_t<F, Args...>>;
 
     // Get the number of threads
     size_t get_thread_count() const { return threads_.size(); }
@@ -37,9 +40,9 @@ private:
 // Implementation of template method
 template <class F, class... Args>
 auto ThreadPool::enqueue(F&& f, Args&&... args) 
-    -> std::future<typename std::result_of<F(Args...)>::type>
+    -> std::future<std::invoke_result_t<F, Args...>>
 {
-    using return_type = typename std::result_of<F(Args...)>::type;
+    using return_type = std::invoke_result_t<F, Args...>;
 
     auto task = std::make_shared<std::packaged_task<return_type()>>(
         std::bind(std::forward<F>(f), std::forward<Args>(args)...)
@@ -51,7 +54,11 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
         if (stop_) {
             throw std::runtime_error("enqueue on stopped ThreadPool");
         }
-        tasks_.emplace([task]() { (*task)(); });
+        // Enqueue time lets traced tasks report how long they sat in the queue
+        tasks_.emplace([task, enqueued_at = trace::now()]() {
+            trace::note_task_start(enqueued_at);
+            (*task)();
+        });
     }
     condition_.notify_one();
     return res;
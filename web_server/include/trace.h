@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * Request tracing - sampled, low-overhead spans exported as Chrome trace events
+ *
+ * Each thread records spans into its own fixed-size ring buffer (single
+ * writer, no locks on the hot path). Timestamps come from the TSC where
+ * available and are converted to microseconds only at export time. A request
+ * is either sampled as a whole or not at all, so unsampled requests cost one
+ * branch per span.
+ */
+namespace trace {
+
+// Raw timestamp (TSC ticks on x86, steady_clock nanoseconds elsewhere)
+uint64_t now();
+
+/**
+ * Context - Identity and sampling decision of one request
+ */
+struct Context {
+    uint64_t request_id = 0;
+    bool sampled = false;
+};
+
+// Decide whether a new request is sampled and assign it an id
+Context begin_request();
+
+// Context installed on this thread by ContextScope (empty if none)
+const Context& current();
+
+// Record a completed span in this thread's ring buffer
+void record(const Context& ctx, const char* name, uint64_t start, uint64_t end);
+
+// Called by ThreadPool workers before running a task: the first ContextScope
+// inside the task emits a queue_wait span ending now
+void note_task_start(uint64_t enqueued_at);
+
+// Fraction of requests to sample, 0 disables tracing (thread-safe)
+void set_sample_rate(double rate);
+double sample_rate();
+
+/**
+ * Capture - Raises the sampling rate to at least `rate` while it lives
+ *
+ * For on-demand captures: the steady-state rate is left alone, and
+ * overlapping captures each keep their own rate in effect until they end
+ * (the highest of them and the steady-state rate applies).
+ */
+class Capture {
+public:
+    explicit Capture(double rate);
+    ~Capture();
+
+    Capture(const Capture&) = delete;
+    Capture& operator=(const Capture&) = delete;
+
+private:
+    uint32_t threshold_;
+};
+
+// Chrome/Perfetto trace-event JSON of spans that ended in the last `seconds`
+std::string export_chrome_json(double seconds);
+
+/**
+ * ContextScope - Makes ctx the current context on this thread
+ *
+ * Only for synchronous code; coroutines interleave on the event loop thread
+ * and must pass their Context to Span explicitly.
+ */
+class ContextScope {
+public:
+    explicit ContextScope(const Context& ctx);
+    ~ContextScope();
+
+    ContextScope(const ContextScope&) = delete;
+    ContextScope& operator=(const ContextScope&) = delete;
+
+private:
+    Context previous_;
+};
+
+/**
+ * Span - Records [construction, destruction) as a named span when sampled
+ */
+class Span {
+public:
+    Span(const Context& ctx, const char* name)
+        : ctx_(ctx), name_(name), start_(ctx.sampled ? now() : 0) {}
+    explicit Span(const char* name) : Span(current(), name) {}
+    ~Span() {
+        if (ctx_.sampled) record(ctx_, name_, start_, now());
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    Context ctx_;
+    const char* name_;
+    uint64_t start_;
+};
+
+}  // namespace trace
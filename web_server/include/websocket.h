@@ -0,0 +1,171 @@
+#pragma once
+
+#include "task.h"
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Connection;
+class WebSocketHub;
+struct Request;
+
+// Serialized frame shared by every subscriber it is sent to
+using FrameBuffer = std::shared_ptr<const std::string>;
+
+/**
+ * WebSocketFrame - One decoded message (continuation frames already joined)
+ */
+struct WebSocketFrame {
+    enum Opcode : uint8_t {
+        CONTINUATION = 0x0, TEXT = 0x1, BINARY = 0x2,
+        CLOSE = 0x8, PING = 0x9, PONG = 0xA
+    };
+
+    uint8_t opcode = TEXT;
+    std::string payload;
+};
+
+/**
+ * WebSocketParser - Incremental RFC 6455 frame decoder for client frames
+ *
+ * Bytes are fed as they arrive; complete messages are returned in order.
+ * Client frames must be masked and control frames must not be fragmented.
+ */
+class WebSocketParser {
+public:
+    explicit WebSocketParser(size_t max_message_size = 1 << 20);
+
+    // Append received bytes and decode all complete frames; false on a protocol error
+    bool feed(const char* data, size_t len, std::vector<WebSocketFrame>& out);
+
+    // RFC 6455 close code describing the last protocol error
+    uint16_t error_code() const { return error_code_; }
+
+private:
+    std::string buffer_;
+    size_t consumed_ = 0;
+    size_t max_message_size_;
+    uint16_t error_code_ = 0;
+
+    // Data frames being reassembled from continuation frames
+    bool in_message_ = false;
+    uint8_t message_opcode_ = 0;
+    std::string message_;
+};
+
+// Encode an unmasked server-to-client frame
+std::string encode_websocket_frame(uint8_t opcode, const char* payload, size_t len);
+
+// Sec-WebSocket-Accept value for a client's Sec-WebSocket-Key
+std::string websocket_accept_key(const std::string& client_key);
+
+// True if the request asks for a WebSocket upgrade
+bool is_websocket_upgrade(const Request& request);
+
+/**
+ * WebSocketSession - An upgraded connection with a bounded send queue
+ *
+ * Outgoing frames are ref-counted buffers; the writer gathers several of them
+ * into one writev() without copying. When the queue would exceed its byte
+ * limit the slow-consumer policy either drops the frame or disconnects.
+ */
+class WebSocketSession {
+public:
+    enum class SlowConsumerPolicy { DROP, DISCONNECT };
+
+    struct Options {
+        size_t max_queued_bytes = 1 << 20;
+        SlowConsumerPolicy policy = SlowConsumerPolicy::DROP;
+        size_t max_message_size = 1 << 20;
+    };
+
+    WebSocketSession(Connection& connection, WebSocketHub& hub, const Options& options);
+    ~WebSocketSession();
+
+    WebSocketSession(const WebSocketSession&) = delete;
+    WebSocketSession& operator=(const WebSocketSession&) = delete;
+
+    // Complete the handshake, then read frames until the peer goes away
+    task<void> run(const Request& request, const std::string& topic);
+
+    // Queue a shared frame; false if it was dropped or the session is closing.
+    // Control frames (pong/close) bypass the byte limit.
+    bool enqueue(const FrameBuffer& frame, bool control = false);
+
+    // Start a close handshake with the given status code
+    void close(uint16_t code);
+
+    size_t queued_bytes() const { return queued_bytes_; }
+    uint64_t dropped_frames() const { return dropped_frames_; }
+
+    // Coroutine frames of session methods live in the connection's arena
+    Arena* frame_arena();
+
+private:
+    friend class WebSocketHub;
+
+    Connection& connection_;
+    WebSocketHub& hub_;
+    Options options_;
+
+    std::deque<FrameBuffer> queue_;
+    size_t queued_bytes_ = 0;
+    size_t front_offset_ = 0;  // Bytes of queue_.front() already written
+    uint64_t dropped_frames_ = 0;
+    bool closing_ = false;
+    bool failed_ = false;
+
+    std::coroutine_handle<> writer_waiting_;  // Writer parked on an empty queue
+    std::coroutine_handle<> reader_waiting_;  // Reader waiting for the writer to exit
+    bool writer_done_ = false;
+
+    // Topic name -> index of this session in the topic's subscriber list
+    std::unordered_map<std::string, size_t> subscriptions_;
+
+    task<void> write_loop();
+    void wake_writer();
+    void fail();
+};
+
+/**
+ * WebSocketHub - Topic-based fan-out of frames to subscribed sessions
+ *
+ * publish() serializes a message once and enqueues the same buffer to every
+ * subscriber. Must be used on the event loop thread; publish_async() is the
+ * thread-safe entry point.
+ */
+class WebSocketHub {
+public:
+    explicit WebSocketHub(class EventLoop& loop);
+
+    void subscribe(WebSocketSession* session, const std::string& topic);
+    void unsubscribe(WebSocketSession* session, const std::string& topic);
+    void unsubscribe_all(WebSocketSession* session);
+
+    // Send a message to every subscriber of topic; returns the number it was queued to
+    size_t publish(const std::string& topic, const std::string& payload,
+                   uint8_t opcode = WebSocketFrame::TEXT);
+
+    // Thread-safe publish: hops to the event loop first
+    void publish_async(const std::string& topic, std::string payload,
+                       uint8_t opcode = WebSocketFrame::TEXT);
+
+    size_t subscriber_count(const std::string& topic) const;
+    size_t session_count() const { return sessions_; }
+
+    // Limits applied to new sessions
+    WebSocketSession::Options& session_options() { return options_; }
+
+private:
+    friend class WebSocketSession;
+
+    class EventLoop& loop_;
+    std::unordered_map<std::string, std::vector<WebSocketSession*>> topics_;
+    WebSocketSession::Options options_;
+    size_t sessions_ = 0;
+};
@@ -0,0 +1,65 @@
+#include "arena.h"
+#include <cstdint>
+#include <new>
+
+namespace {
+constexpr size_t header_size = (sizeof(void*) * 3 + alignof(std::max_align_t) - 1) &
+                               ~(alignof(std::max_align_t) - 1);
+}
+
+Arena::Arena(size_t block_size)
+    : head_(nullptr), block_size_(block_size), bytes_allocated_(0) {
+}
+
+Arena::~Arena() {
+    while (head_) {
+        Block* next = head_->next;
+        ::operator delete(head_);
+        head_ = next;
+    }
+}
+
+Arena::Block* Arena::new_block(size_t min_size) {
+    size_t capacity = (min_size > block_size_) ? min_size : block_size_;
+    void* memory = ::operator new(header_size + capacity);
+    Block* block = static_cast<Block*>(memory);
+    block->next = head_;
+    block->capacity = capacity;
+    block->used = 0;
+    head_ = block;
+    return block;
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    Block* block = head_;
+    if (block) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(block) + header_size;
+        uintptr_t aligned = (base + block->used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        if (aligned + size <= base + block->capacity) {
+            block->used = aligned + size - base;
+            bytes_allocated_ += size;
+            return reinterpret_cast<void*>(aligned);
+        }
+    }
+
+    // Current block is full; start a new one large enough for this request
+    block = new_block(size + alignment);
+    uintptr_t base = reinterpret_cast<uintptr_t>(block) + header_size;
+    uintptr_t aligned = (base + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    block->used = aligned + size - base;
+    bytes_allocated_ += size;
+    return reinterpret_cast<void*>(aligned);
+}
+
+void Arena::reset() {
+    if (!head_) return;
+
+    // Keep the oldest block (the tail of the chain) and free the rest
+    while (head_->next) {
+        Block* next = head_->next;
+        ::operator delete(head_);
+        head_ = next;
+    }
+    head_->used = 0;
+    bytes_allocated_ = 0;
+}
@@ -1,15 +1,39 @@
 #include "cache.h"
+#include "shared_cache.h"
 
 ResponseCache::ResponseCache(int default_ttl) : default_ttl_(default_ttl) {
 }
 
+void ResponseCache::attach_shared(std::shared_ptr<SharedResponseCache> shared) {
+    shared_ = std::move(shared);
+}
+
 void ResponseCache::put(const std::string& key, const std::string& response, int ttl_seconds) {
-    std::unique_lock<std::mutex> lock(mutex_);
     int ttl = (ttl_seconds < 0) ? default_ttl_ : ttl_seconds;
+    // Only one tier may hold the key: get() asks the shared cache first, so
+    // an older shared copy would hide a local one, and an older local copy
+    // would resurface once the shared one is evicted
+    if (shared_ && shared_->put(key, response, ttl)) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cache_.erase(key);
+        return;
+    }
+    if (shared_) {
+        // Too large for a slab
+        shared_->remove(key);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
     cache_[key] = {response, std::chrono::steady_clock::now(), ttl};
 }
 
 std::shared_ptr<std::string> ResponseCache::get(const std::string& key) {
+    if (shared_) {
+        if (auto shared_hit = shared_->get(key)) {
+            return shared_hit;
+        }
+    }
+
     std::unique_lock<std::mutex> lock(mutex_);
     auto it = cache_.find(key);
     
@@ -26,16 +50,23 @@ std::shared_ptr<std::string> ResponseCache::get(const std::string& key) {
 }
 
 void ResponseCache::clear() {
+    if (shared_) {
+        shared_->clear();
+    }
     std::unique_lock<std::mutex> lock(mutex_);
     cache_.clear();
 }
 
 void ResponseCache::remove(const std::string& key) {
+    if (shared_) {
+        shared_->remove(key);
+    }
     std::unique_lock<std::mutex> lock(mutex_);
     cache_.erase(key);
 }
 
 size_t ResponseCache::size() const {
+    size_t shared_size = shared_ ? shared_->size() : 0;
     std::unique_lock<std::mutex> lock(mutex_);
-    return cache_.size();
+    return shared_size + cache_.size();
 }
@@ -0,0 +1,45 @@
+#include "connection.h"
+#include "event_loop.h"
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+Connection::Connection(EventLoop& loop, int fd) : loop_(loop), fd_(fd) {
+}
+
+Connection::~Connection() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+task<ssize_t> Connection::read_some(char* buffer, size_t len) {
+    while (true) {
+        ssize_t n = recv(fd_, buffer, len, 0);
+        if (n >= 0) {
+            co_return n;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            co_await loop_.readable(fd_);
+        } else if (errno != EINTR) {
+            co_return -1;
+        }
+    }
+}
+
+task<bool> Connection::write_all(const char* data, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(fd_, data + sent, len - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += static_cast<size_t>(n);
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            co_await loop_.writable(fd_);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            co_return false;
+        }
+    }
+    co_return true;
+}
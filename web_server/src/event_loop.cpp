@@ -0,0 +1,184 @@
+#include "event_loop.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+
+EventLoop::EventLoop()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      stopped_(false),
+      blocking_pool_(std::make_unique<ThreadPool>(2)) {
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        throw std::runtime_error("Failed to create event loop");
+    }
+
+    struct epoll_event ev {};
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev) < 0) {
+        throw std::runtime_error("Failed to register event loop wakeup");
+    }
+}
+
+EventLoop::~EventLoop() {
+    // Suspended coroutines still waiting here are abandoned, not resumed
+    blocking_pool_.reset();
+    close(wake_fd_);
+    close(epoll_fd_);
+}
+
+void EventLoop::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+    (void)ignored;
+}
+
+void EventLoop::stop() {
+    stopped_ = true;
+    wake();
+}
+
+void EventLoop::post(std::coroutine_handle<> handle) {
+    post(std::function<void()>([handle]() { handle.resume(); }));
+}
+
+void EventLoop::post(std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock(post_mutex_);
+        posted_.push_back(std::move(callback));
+    }
+    wake();
+}
+
+void EventLoop::watch(int fd, bool write, std::coroutine_handle<> handle) {
+    FdWaiters& waiters = waiters_[fd];
+    if (write) {
+        waiters.writer = handle;
+    } else {
+        waiters.reader = handle;
+    }
+    update_registration(fd, waiters);
+}
+
+void EventLoop::update_registration(int fd, FdWaiters& waiters) {
+    uint32_t wanted = 0;
+    if (waiters.reader) wanted |= EPOLLIN;
+    if (waiters.writer) wanted |= EPOLLOUT;
+
+    if (wanted == waiters.registered) {
+        return;
+    }
+
+    struct epoll_event ev {};
+    ev.events = wanted;
+    ev.data.fd = fd;
+
+    if (wanted == 0) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        waiters_.erase(fd);
+        return;
+    }
+
+    int op = waiters.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(epoll_fd_, op, fd, &ev) < 0) {
+        throw std::runtime_error("Failed to watch file descriptor " + std::to_string(fd));
+    }
+    waiters.registered = wanted;
+}
+
+void EventLoop::add_timer(std::chrono::steady_clock::time_point deadline,
+                          std::coroutine_handle<> handle) {
+    timers_.push({deadline, timer_sequence_++, handle});
+}
+
+int EventLoop::next_timeout_ms() const {
+    if (timers_.empty()) {
+        return -1;
+    }
+    auto remaining = timers_.top().deadline - std::chrono::steady_clock::now();
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+    return ms < 0 ? 0 : static_cast<int>(ms);
+}
+
+void EventLoop::run_posted() {
+    if (!deferred_.empty()) {
+        std::vector<std::coroutine_handle<>> handles;
+        handles.swap(deferred_);
+        for (auto handle : handles) {
+            handle.resume();
+        }
+    }
+
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(post_mutex_);
+        ready.swap(posted_);
+    }
+    for (auto& callback : ready) {
+        callback();
+    }
+}
+
+void EventLoop::run_expired_timers() {
+    auto now = std::chrono::steady_clock::now();
+    while (!timers_.empty() && timers_.top().deadline <= now) {
+        auto handle = timers_.top().handle;
+        timers_.pop();
+        handle.resume();
+    }
+}
+
+void EventLoop::run() {
+    struct epoll_event events[64];
+
+    while (!stopped_) {
+        run_posted();
+        run_expired_timers();
+
+        int timeout = deferred_.empty() ? next_timeout_ms() : 0;
+        int n = epoll_wait(epoll_fd_, events, 64, timeout);
+        for (int i = 0; i < n && !stopped_; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wake_fd_) {
+                uint64_t count;
+                while (read(wake_fd_, &count, sizeof(count)) > 0) {}
+                continue;
+            }
+
+            auto it = waiters_.find(fd);
+            if (it == waiters_.end()) {
+                continue;
+            }
+
+            // Detach the ready waiters before resuming: they may re-register
+            uint32_t revents = events[i].events;
+            bool error = revents & (EPOLLERR | EPOLLHUP);
+            std::coroutine_handle<> reader, writer;
+            if ((revents & EPOLLIN) || error) reader = std::exchange(it->second.reader, nullptr);
+            if ((revents & EPOLLOUT) || error) writer = std::exchange(it->second.writer, nullptr);
+            update_registration(fd, it->second);
+
+            if (reader) reader.resume();
+            if (writer) writer.resume();
+        }
+    }
+}
+
+EventLoop::OffloadAwaiter<std::function<std::optional<std::string>()>>
+EventLoop::read_file(const std::string& path) {
+    std::function<std::optional<std::string>()> reader = [path]() -> std::optional<std::string> {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return std::nullopt;
+        }
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    };
+    return OffloadAwaiter<std::function<std::optional<std::string>()>>(*this, *blocking_pool_,
+                                                                       std::move(reader));
+}
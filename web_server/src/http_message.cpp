@@ -0,0 +1,66 @@
+#include "http_message.h"
+
+std::string http_status_text(int status_code) {
+    switch (status_code) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 500: return "Internal Server Error";
+        default: return "Unknown";
+    }
+}
+
+std::string Request::header(const std::string& name) const {
+    std::string search = "\r\n" + name + ": ";
+    size_t pos = raw.find(search);
+    if (pos == std::string::npos) {
+        return "";
+    }
+
+    size_t start = pos + search.length();
+    size_t end = raw.find("\r\n", start);
+    if (end == std::string::npos) {
+        return raw.substr(start);
+    }
+    return raw.substr(start, end - start);
+}
+
+std::string Request::query_param(const std::string& name, const std::string& fallback) const {
+    size_t pos = 0;
+    while (pos <= query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos) end = query.size();
+
+        size_t eq = query.find('=', pos);
+        if (eq != std::string::npos && eq < end && query.compare(pos, eq - pos, name) == 0 &&
+            eq - pos == name.size()) {
+            return query.substr(eq + 1, end - eq - 1);
+        }
+        pos = end + 1;
+    }
+    return fallback;
+}
+
+Response Response::json(const std::string& json_content, int status) {
+    Response response;
+    response.status = status;
+    response.content_type = "application/json";
+    response.body = json_content;
+    return response;
+}
+
+std::string Response::serialize() const {
+    std::string response = "HTTP/1.1 " + std::to_string(status) + " " + http_status_text(status) + "\r\n";
+    response += "Content-Type: " + content_type + "\r\n";
+    response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    for (const auto& header : headers) {
+        response += header.first + ": " + header.second + "\r\n";
+    }
+    response += "Connection: close\r\n";
+    response += "\r\n";
+    response += body;
+    return response;
+}
@@ -1,23 +1,142 @@
 #include "server.h"
+#include "cache.h"
+#include "shared_cache.h"
+#include "trace.h"
+#include "websocket.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
 
-int main(int argc, char* argv[]) {
-    int port = 8080;
+namespace {
 
-    // Parse command line arguments
-    if (argc > 1) {
-        port = std::stoi(argv[1]);
-    }
+volatile sig_atomic_t shutdown_requested = 0;
 
-    std::cout << "Starting HTTP Server on port " << port << "...\n";
+void on_shutdown_signal(int) {
+    shutdown_requested = 1;
+}
+
+struct ServerOptions {
+    int port = 8080;
+    int workers = 1;
+    size_t shared_cache_slots = 2048;
+    WebSocketSession::Options ws_options;
+};
 
+int run_server(const ServerOptions& options, std::shared_ptr<SharedResponseCache> shared_cache) {
     try {
-        HTTPServer server(port);
+        HTTPServer server(options.port);
+        server.set_reuse_port(options.workers > 1);
+        server.get_websocket_hub().session_options() = options.ws_options;
+        if (shared_cache) {
+            server.get_request_handler().get_cache().attach_shared(shared_cache);
+        }
         server.start();
     } catch (const std::exception& e) {
         std::cerr << "Server error: " << e.what() << "\n";
         return 1;
     }
+    return 0;
+}
+
+pid_t spawn_worker(const ServerOptions& options, std::shared_ptr<SharedResponseCache> shared_cache) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        _exit(run_server(options, shared_cache));
+    }
+    if (pid < 0) {
+        std::cerr << "Failed to fork worker\n";
+    }
+    return pid;
+}
+
+// Parent process: fork the workers, replace any that die, stop them on SIGINT/SIGTERM
+int run_prefork(const ServerOptions& options) {
+    SharedResponseCache::Options cache_options;
+    cache_options.slot_count = options.shared_cache_slots;
+    auto shared_cache = SharedResponseCache::create(cache_options);
+
+    struct sigaction action {};
+    action.sa_handler = on_shutdown_signal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::vector<pid_t> workers;
+    for (int i = 0; i < options.workers; ++i) {
+        workers.push_back(spawn_worker(options, shared_cache));
+    }
+    std::cout << "Started " << options.workers << " workers sharing one response cache\n";
+
+    while (!shutdown_requested) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (auto& worker : workers) {
+            if (worker != pid || shutdown_requested) continue;
+            std::cerr << "Worker " << pid << " exited (status " << status << "), restarting\n";
+            // Avoid a fork storm if workers die on startup
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            worker = spawn_worker(options, shared_cache);
+        }
+    }
 
+    for (pid_t pid : workers) {
+        if (pid > 0) kill(pid, SIGTERM);
+    }
+    for (pid_t pid : workers) {
+        if (pid > 0) waitpid(pid, nullptr, 0);
+    }
     return 0;
 }
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    ServerOptions options;
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--trace-sample" && i + 1 < argc) {
+            // Fraction of requests traced continuously (see /debug/trace)
+            trace::set_sample_rate(std::stod(argv[++i]));
+        } else if (arg == "--ws-queue-bytes" && i + 1 < argc) {
+            options.ws_options.max_queued_bytes = std::stoul(argv[++i]);
+        } else if (arg == "--ws-slow-policy" && i + 1 < argc) {
+            std::string policy = argv[++i];
+            options.ws_options.policy = (policy == "disconnect")
+                                            ? WebSocketSession::SlowConsumerPolicy::DISCONNECT
+                                            : WebSocketSession::SlowConsumerPolicy::DROP;
+        } else if (arg == "--workers" && i + 1 < argc) {
+            options.workers = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--shared-cache-slots" && i + 1 < argc) {
+            options.shared_cache_slots = std::stoul(argv[++i]);
+        } else {
+            options.port = std::stoi(arg);
+        }
+    }
+
+    std::cout << "Starting HTTP Server on port " << options.port << "...\n";
+
+    if (options.workers > 1) {
+        try {
+            return run_prefork(options);
+        } catch (const std::exception& e) {
+            std::cerr << "Server error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    return run_server(options, nullptr);
+}
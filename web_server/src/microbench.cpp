@@ -0,0 +1,385 @@
+#include "request_handler.h"
+#include "cache.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Interposed allocator counter
+//
+// Every global operator new in this binary goes through these replacements, so
+// the benchmarks can report allocations/op for the code under test (including
+// allocations made on ThreadPool workers).
+// ---------------------------------------------------------------------------
+
+namespace {
+std::atomic<uint64_t> g_alloc_count{0};
+std::atomic<uint64_t> g_alloc_bytes{0};
+
+void* counted_alloc(std::size_t size) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* counted_aligned_alloc(std::size_t size, std::align_val_t align) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    std::size_t alignment = static_cast<std::size_t>(align);
+    std::size_t rounded = (size + alignment - 1) / alignment * alignment;
+    if (void* p = std::aligned_alloc(alignment, rounded ? rounded : alignment)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+}  // namespace
+
+void* operator new(std::size_t size) { return counted_alloc(size); }
+void* operator new[](std::size_t size) { return counted_alloc(size); }
+void* operator new(std::size_t size, std::align_val_t align) { return counted_aligned_alloc(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align) { return counted_aligned_alloc(size, align); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * BenchResult - One row of the report
+ */
+struct BenchResult {
+    std::string name;
+    int threads;
+    uint64_t ops;
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+    double ops_per_sec;
+};
+
+/**
+ * Measurement - Captures time and allocator counters around a benchmark body
+ */
+class Measurement {
+public:
+    Measurement()
+        : start_(Clock::now()),
+          allocs_(g_alloc_count.load(std::memory_order_relaxed)),
+          bytes_(g_alloc_bytes.load(std::memory_order_relaxed)) {}
+
+    // ns_per_op is wall time per operation per thread, i.e. the latency a
+    // single caller observes; ops_per_sec is aggregate throughput
+    BenchResult finish(const std::string& name, int threads, uint64_t ops) const {
+        auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start_).count();
+        uint64_t allocs = g_alloc_count.load(std::memory_order_relaxed) - allocs_;
+        uint64_t bytes = g_alloc_bytes.load(std::memory_order_relaxed) - bytes_;
+        double n = static_cast<double>(ops ? ops : 1);
+        return {name, threads, ops,
+                elapsed * threads / n,
+                allocs / n,
+                bytes / n,
+                n / (elapsed / 1e9)};
+    }
+
+private:
+    Clock::time_point start_;
+    uint64_t allocs_;
+    uint64_t bytes_;
+};
+
+// Cheap per-thread PRNG so key selection does not dominate the cache numbers
+struct XorShift {
+    uint64_t state;
+    explicit XorShift(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+// Silences std::cout for the lifetime of the object (handlers log to stdout)
+class QuietStdout {
+public:
+    QuietStdout() : old_(std::cout.rdbuf(sink_.rdbuf())) {}
+    ~QuietStdout() { std::cout.rdbuf(old_); }
+
+private:
+    std::ostringstream sink_;
+    std::streambuf* old_;
+};
+
+// 1, 2, 4, ... up to and including max_threads
+std::vector<int> thread_counts(int max_threads) {
+    std::vector<int> counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(max_threads);
+    return counts;
+}
+
+// ---------------------------------------------------------------------------
+// RequestHandler::handle_request
+// ---------------------------------------------------------------------------
+
+void bench_handler(std::vector<BenchResult>& results, uint64_t iterations) {
+    struct Case {
+        const char* name;
+        std::string raw;
+    };
+
+    const std::string headers =
+        "Host: localhost:8080\r\n"
+        "User-Agent: curl/8.5.0\r\n"
+        "Accept: */*\r\n";
+
+    std::vector<Case> cases = {
+        {"handler/GET / (cached)", "GET / HTTP/1.1\r\n" + headers + "\r\n"},
+        {"handler/GET /api/data (cached)", "GET /api/data HTTP/1.1\r\n" + headers + "\r\n"},
+        {"handler/GET 404", "GET /missing/page HTTP/1.1\r\n" + headers + "\r\n"},
+        {"handler/POST /api/submit", "POST /api/submit HTTP/1.1\r\n" + headers +
+             "Content-Type: application/x-www-form-urlencoded\r\n"
+             "Content-Length: 27\r\n\r\nname=alice&value=1234567890"},
+        {"handler/OPTIONS /", "OPTIONS / HTTP/1.1\r\n" + headers + "\r\n"},
+    };
+
+    RequestHandler handler;
+    QuietStdout quiet;
+
+    for (const auto& c : cases) {
+        // Warm-up also populates the response cache for cacheable GETs
+        for (int i = 0; i < 100; ++i) {
+            handler.handle_request(c.raw);
+        }
+
+        size_t sink = 0;
+        Measurement m;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            sink += handler.handle_request(c.raw).size();
+        }
+        results.push_back(m.finish(c.name, 1, iterations));
+        if (sink == 0) {
+            std::cerr << "unexpected empty response\n";
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ResponseCache::get / put
+// ---------------------------------------------------------------------------
+
+void bench_cache(std::vector<BenchResult>& results, uint64_t iterations, int max_threads) {
+    const int key_count = 1024;
+    const std::string payload(512, 'x');
+
+    std::vector<std::string> present;
+    std::vector<std::string> absent;
+    for (int i = 0; i < key_count; ++i) {
+        present.push_back("/api/resource/" + std::to_string(i));
+        absent.push_back("/api/missing/" + std::to_string(i));
+    }
+
+    for (int hit_percent : {0, 50, 90, 100}) {
+        for (int threads : thread_counts(max_threads)) {
+            ResponseCache cache(300);
+            for (const auto& key : present) {
+                cache.put(key, payload);
+            }
+
+            uint64_t per_thread = iterations / threads;
+            std::atomic<bool> go{false};
+            std::vector<std::thread> workers;
+
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t]() {
+                    XorShift rng(t + 1);
+                    while (!go.load(std::memory_order_acquire)) {
+                        std::this_thread::yield();
+                    }
+                    for (uint64_t i = 0; i < per_thread; ++i) {
+                        uint64_t r = rng.next();
+                        size_t k = r % key_count;
+                        // 1 in 10 operations is a put, the rest are lookups
+                        if ((r >> 32) % 10 == 0) {
+                            cache.put(present[k], payload);
+                        } else if (static_cast<int>((r >> 40) % 100) < hit_percent) {
+                            cache.get(present[k]);
+                        } else {
+                            cache.get(absent[k]);
+                        }
+                    }
+                });
+            }
+
+            Measurement m;
+            go.store(true, std::memory_order_release);
+            for (auto& w : workers) {
+                w.join();
+            }
+
+            results.push_back(m.finish("cache/get+put hit=" + std::to_string(hit_percent) + "%",
+                                       threads, per_thread * threads));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ThreadPool::enqueue
+// ---------------------------------------------------------------------------
+
+void bench_thread_pool(std::vector<BenchResult>& results, uint64_t iterations, int max_threads) {
+    for (int threads : thread_counts(max_threads)) {
+        ThreadPool pool(threads);
+
+        // Round trip: enqueue one task and block on its future
+        {
+            uint64_t rounds = iterations / 10;
+            Measurement m;
+            for (uint64_t i = 0; i < rounds; ++i) {
+                pool.enqueue([]() { return 1; }).get();
+            }
+            // One caller waits out each task before the next: serial latency
+            BenchResult r = m.finish("thread_pool/enqueue round-trip", 1, rounds);
+            r.threads = threads;
+            results.push_back(r);
+        }
+
+        // Throughput: flood the queue and wait for everything to drain
+        {
+            std::atomic<uint64_t> done{0};
+            std::vector<std::future<void>> futures;
+            futures.reserve(iterations);
+            Measurement m;
+            for (uint64_t i = 0; i < iterations; ++i) {
+                futures.push_back(pool.enqueue([&done]() {
+                    done.fetch_add(1, std::memory_order_relaxed);
+                }));
+            }
+            for (auto& f : futures) {
+                f.get();
+            }
+            // Report producer-side cost: one thread submits every task
+            BenchResult r = m.finish("thread_pool/enqueue throughput", 1, iterations);
+            r.threads = threads;
+            results.push_back(r);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Reporting
+// ---------------------------------------------------------------------------
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+void print_table(const std::vector<BenchResult>& results) {
+    std::cerr << std::left << std::setw(40) << "benchmark"
+              << std::right << std::setw(8) << "threads"
+              << std::setw(14) << "ns/op"
+              << std::setw(14) << "allocs/op"
+              << std::setw(14) << "bytes/op"
+              << std::setw(16) << "ops/s" << "\n";
+    std::cerr << std::fixed;
+    for (const auto& r : results) {
+        std::cerr << std::left << std::setw(40) << r.name
+                  << std::right << std::setw(8) << r.threads
+                  << std::setw(14) << std::setprecision(1) << r.ns_per_op
+                  << std::setw(14) << std::setprecision(2) << r.allocs_per_op
+                  << std::setw(14) << std::setprecision(1) << r.bytes_per_op
+                  << std::setw(16) << std::setprecision(0) << r.ops_per_sec << "\n";
+    }
+}
+
+void write_json(std::ostream& out, const std::vector<BenchResult>& results) {
+    out << "{\n  \"benchmarks\": [\n";
+    out << std::fixed;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << "    {\"name\": \"" << json_escape(r.name) << "\""
+            << ", \"threads\": " << r.threads
+            << ", \"ops\": " << r.ops
+            << std::setprecision(3)
+            << ", \"ns_per_op\": " << r.ns_per_op
+            << ", \"allocs_per_op\": " << r.allocs_per_op
+            << ", \"bytes_per_op\": " << r.bytes_per_op
+            << std::setprecision(1)
+            << ", \"ops_per_sec\": " << r.ops_per_sec << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string json_path;
+    uint64_t iterations = 200000;
+    int max_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::stoull(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            max_threads = std::max(1, std::stoi(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--json <file>] [--iterations N] [--threads N]\n";
+            return 1;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    bench_handler(results, iterations);
+    bench_cache(results, iterations, max_threads);
+    bench_thread_pool(results, iterations, max_threads);
+
+    print_table(results);
+
+    // JSON goes to stdout unless a file was requested, so runs can be diffed
+    if (json_path.empty()) {
+        write_json(std::cout, results);
+    } else {
+        std::ofstream file(json_path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file: " << json_path << "\n";
+            return 1;
+        }
+        write_json(file, results);
+    }
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include "request_handler.h"
 #include "cache.h"
+#include "trace.h"
 #include <sstream>
 #include <algorithm>
 #include <iostream>
@@ -55,16 +56,7 @@ std::string RequestHandler::parse_header(const std::string& raw_request,
 }
 
 std::string RequestHandler::get_status_text(int status_code) const {
-    switch (status_code) {
-        case 200: return "OK";
-        case 201: return "Created";
-        case 204: return "No Content";
-        case 400: return "Bad Request";
-        case 404: return "Not Found";
-        case 405: return "Method Not Allowed";
-        case 500: return "Internal Server Error";
-        default: return "Unknown";
-    }
+    return http_status_text(status_code);
 }
 
 std::string RequestHandler::generate_html_response(const std::string& html_content,
@@ -99,7 +91,11 @@ std::string RequestHandler::generate_error_response(int status_code,
 
 std::string RequestHandler::handle_get(const std::string& path) {
     // Check cache first
-    auto cached = cache_->get(path);
+    std::shared_ptr<std::string> cached;
+    {
+        trace::Span span("cache_lookup");
+        cached = cache_->get(path);
+    }
     if (cached) {
         std::cout << "Cache hit for: " << path << "\n";
         return *cached;
@@ -130,6 +126,8 @@ std::string RequestHandler::handle_get(const std::string& path) {
         <strong>POST /api/submit</strong> - Submit data<br>
         <strong>PUT /api/update</strong> - Update data<br>
         <strong>DELETE /api/remove</strong> - Delete data<br>
+        <strong>GET /api/delay?ms=N</strong> - Non-blocking delayed response<br>
+        <strong>POST /api/hash</strong> - SHA-256 of the body (offloaded)<br>
         <strong>OPTIONS /</strong> - Get allowed methods
     </div>
 </body>
@@ -242,10 +240,47 @@ std::string RequestHandler::generate_response(const std::string& method,
 }
 
 std::string RequestHandler::handle_request(const std::string& raw_request) {
-    std::string method = parse_method(raw_request);
-    std::string path = parse_path(raw_request);
-    std::string version = parse_version(raw_request);
-    std::string body = parse_body(raw_request);
+    std::string method, path, version, body;
+    {
+        trace::Span span("parse");
+        method = parse_method(raw_request);
+        path = parse_path(raw_request);
+        version = parse_version(raw_request);
+        body = parse_body(raw_request);
+    }
 
+    trace::Span span("route");
     return generate_response(method, path, version, body);
 }
+
+Request RequestHandler::parse_request(const std::string& raw_request) {
+    Request request;
+    request.method = parse_method(raw_request);
+    request.version = parse_version(raw_request);
+    request.body = parse_body(raw_request);
+    request.raw = raw_request;
+
+    std::string target = parse_path(raw_request);
+    size_t query_pos = target.find('?');
+    if (query_pos == std::string::npos) {
+        request.path = target;
+    } else {
+        request.path = target.substr(0, query_pos);
+        request.query = target.substr(query_pos + 1);
+    }
+    return request;
+}
+
+void RequestHandler::register_async_route(const std::string& method, const std::string& path,
+                                          AsyncHandler handler) {
+    async_routes_[method + " " + path] = std::move(handler);
+}
+
+const AsyncHandler* RequestHandler::find_async_route(const std::string& method,
+                                                     const std::string& path) const {
+    if (async_routes_.empty()) {
+        return nullptr;
+    }
+    auto it = async_routes_.find(method + " " + path);
+    return it == async_routes_.end() ? nullptr : &it->second;
+}
@@ -2,20 +2,32 @@
 #include "request_handler.h"
 #include "cache.h"
 #include "thread_pool.h"
+#include "event_loop.h"
+#include "connection.h"
+#include "trace.h"
+#include "websocket.h"
 #include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
 
 HTTPServer::HTTPServer(int port, Protocol protocol)
     : port_(port), protocol_(protocol), server_socket_(-1), running_(false),
+      event_loop_(std::make_unique<EventLoop>()),
       thread_pool_(std::make_unique<ThreadPool>(4)),
       request_handler_(std::make_unique<RequestHandler>()),
+      websocket_hub_(std::make_unique<WebSocketHub>(*event_loop_)),
       ssl_context_(nullptr) {
+    register_builtin_routes();
 }
 
 HTTPServer::~HTTPServer() {
@@ -58,6 +70,12 @@ void HTTPServer::setup_socket() {
         throw std::runtime_error("Failed to set socket options");
     }
 
+    // Prefork workers each bind the port; the kernel balances connections
+    if (reuse_port_ &&
+        setsockopt(server_socket_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        throw std::runtime_error("Failed to set SO_REUSEPORT");
+    }
+
     // Bind socket to port
     struct sockaddr_in server_addr;
     std::memset(&server_addr, 0, sizeof(server_addr));
@@ -70,24 +88,102 @@ void HTTPServer::setup_socket() {
     }
 
     // Listen for incoming connections
-    if (listen(server_socket_, 5) < 0) {
+    if (listen(server_socket_, SOMAXCONN) < 0) {
         throw std::runtime_error("Failed to listen on socket");
     }
 
+    // The event loop waits for readiness instead of blocking in accept()
+    fcntl(server_socket_, F_SETFL, fcntl(server_socket_, F_GETFL, 0) | O_NONBLOCK);
+
     std::string protocol_str = (protocol_ == Protocol::HTTPS) ? "HTTPS" : "HTTP";
     std::cout << "Server listening on " << protocol_str << " port " << port_ << "\n";
 }
 
-void HTTPServer::accept_connections() {
+void HTTPServer::register_async_route(const std::string& method, const std::string& path,
+                                      AsyncHandler handler) {
+    request_handler_->register_async_route(method, path, std::move(handler));
+}
+
+void HTTPServer::register_builtin_routes() {
+    // Holds the request open on a timer without tying up a worker thread
+    register_async_route("GET", "/api/delay", [this](Request& request) -> task<Response> {
+        int ms = std::clamp(std::atoi(request.query_param("ms", "100").c_str()), 0, 10000);
+        co_await event_loop_->sleep_for(std::chrono::milliseconds(ms));
+        co_return Response::json(R"({"status":"success","delayed_ms":)" + std::to_string(ms) + "}");
+    });
+
+    // Hashing runs on the compute pool; the loop keeps serving other requests
+    register_async_route("POST", "/api/hash", [this](Request& request) -> task<Response> {
+        std::string digest = co_await event_loop_->offload(*thread_pool_, [&request]() {
+            unsigned char md[EVP_MAX_MD_SIZE];
+            unsigned int md_len = 0;
+            EVP_Digest(request.body.data(), request.body.size(), md, &md_len, EVP_sha256(), nullptr);
+
+            std::string hex;
+            char byte[3];
+            for (unsigned int i = 0; i < md_len; ++i) {
+                std::snprintf(byte, sizeof(byte), "%02x", md[i]);
+                hex += byte;
+            }
+            return hex;
+        });
+        co_return Response::json(R"({"status":"success","sha256":")" + digest + "\"}");
+    });
+
+    // Broadcasts the body to every WebSocket subscribed to ?topic=
+    register_async_route("POST", "/api/publish", [this](Request& request) -> task<Response> {
+        std::string topic = request.query_param("topic");
+        if (topic.empty()) {
+            co_return Response::json(R"({"status":"error","message":"missing topic"})", 400);
+        }
+        size_t delivered = websocket_hub_->publish(topic, request.body);
+        co_return Response::json(R"({"status":"success","delivered":)" + std::to_string(delivered) + "}");
+    });
+
+    // Samples requests for N seconds (at least at ?rate=, else at the current
+    // rate, or all of them if tracing is off) and returns the spans as
+    // Chrome/Perfetto trace-event JSON. The steady-state rate is never
+    // touched, so overlapping captures cannot leave it changed.
+    register_async_route("GET", "/debug/trace", [this](Request& request) -> task<Response> {
+        double seconds = std::clamp(std::atof(request.query_param("seconds", "1").c_str()), 0.0, 60.0);
+        std::string rate = request.query_param("rate");
+        {
+            trace::Capture capture(!rate.empty() ? std::atof(rate.c_str())
+                                                 : (trace::sample_rate() > 0 ? 0.0 : 1.0));
+            co_await event_loop_->sleep_for(
+                std::chrono::milliseconds(static_cast<int>(seconds * 1000)));
+        }
+
+        Response response;
+        response.content_type = "application/json";
+        response.body = trace::export_chrome_json(seconds);
+        co_return response;
+    });
+
+    // Reads or changes the steady-state sampling rate (?rate=0.01)
+    register_async_route("GET", "/debug/trace/sampling", [](Request& request) -> task<Response> {
+        std::string rate = request.query_param("rate");
+        if (!rate.empty()) {
+            trace::set_sample_rate(std::atof(rate.c_str()));
+        }
+        co_return Response::json(R"({"status":"success","sample_rate":)" +
+                                 std::to_string(trace::sample_rate()) + "}");
+    });
+}
+
+task<void> HTTPServer::accept_connections() {
     while (running_) {
+        uint64_t accept_start = trace::now();
         struct sockaddr_in client_addr;
         socklen_t client_addr_len = sizeof(client_addr);
 
-        int client_socket = accept(server_socket_, 
-                                   (struct sockaddr*)&client_addr, 
-                                   &client_addr_len);
+        int client_socket = accept4(server_socket_,
+                                    (struct sockaddr*)&client_addr,
+                                    &client_addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (client_socket < 0) {
-            if (running_) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await event_loop_->readable(server_socket_);
+            } else if (running_ && errno != EINTR) {
                 std::cerr << "Error accepting connection\n";
             }
             continue;
@@ -97,20 +193,76 @@ void HTTPServer::accept_connections() {
         inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
         std::cout << "New connection from " << client_ip << ":" << ntohs(client_addr.sin_port) << "\n";
 
-        // Submit client handling task to thread pool
-        thread_pool_->enqueue([this, client_socket]() {
-            char buffer[8192] = {0};
-            int bytes_read = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
+        trace::Context ctx = trace::begin_request();
+        if (ctx.sampled) {
+            trace::record(ctx, "accept", accept_start, trace::now());
+        }
+        spawn(serve_connection(client_socket, ctx));
+    }
+}
 
-            if (bytes_read > 0) {
-                std::string request(buffer);
-                std::string response = request_handler_->handle_request(request);
-                send(client_socket, response.c_str(), response.size(), 0);
-            }
+task<void> HTTPServer::serve_connection(int client_socket, trace::Context ctx) {
+    trace::Span request_span(ctx, "request");
+    Connection connection(*event_loop_, client_socket);
+
+    const size_t buffer_size = 8192;
+    char* buffer = static_cast<char*>(connection.arena().allocate(buffer_size));
+    ssize_t bytes_read;
+    {
+        trace::Span span(ctx, "read");
+        bytes_read = co_await connection.read_some(buffer, buffer_size - 1);
+    }
+    if (bytes_read <= 0) {
+        co_return;
+    }
+
+    buffer[bytes_read] = '\0';
+    std::string raw(buffer);
+    std::string response;
 
-            close(client_socket);
+    Request request;
+    {
+        trace::Span span(ctx, "parse");
+        request = request_handler_->parse_request(raw);
+        request.arena = &connection.arena();
+    }
+
+    // /ws/<topic> upgrades to a WebSocket subscribed to <topic>
+    if (request.path.rfind("/ws/", 0) == 0 && is_websocket_upgrade(request)) {
+        WebSocketSession session(connection, *websocket_hub_, websocket_hub_->session_options());
+        co_await session.run(request, request.path.substr(4));
+        co_return;
+    }
+
+    const AsyncHandler* handler;
+    {
+        trace::Span span(ctx, "route");
+        handler = request_handler_->find_async_route(request.method, request.path);
+    }
+
+    if (handler) {
+        trace::Span span(ctx, "handler");
+        try {
+            Response result = co_await (*handler)(request);
+            response = result.serialize();
+        } catch (const std::exception& e) {
+            std::cerr << "Handler error: " << e.what() << "\n";
+            Response error;
+            error.status = 500;
+            error.body = "<html><body><h1>Error 500 - Internal Server Error</h1></body></html>";
+            response = error.serialize();
+        }
+    } else {
+        // Synchronous handlers may block, so they run on the thread pool
+        response = co_await event_loop_->offload(*thread_pool_, [this, &raw, ctx]() {
+            trace::ContextScope scope(ctx);
+            trace::Span span("handler");
+            return request_handler_->handle_request(raw);
         });
     }
+
+    trace::Span span(ctx, "send");
+    co_await connection.write_all(response);
 }
 
 void HTTPServer::start() {
@@ -119,12 +271,15 @@ void HTTPServer::start() {
         setup_ssl();
     }
     running_ = true;
-    accept_connections();
+    spawn(accept_connections());
+    event_loop_->run();
 }
 
 void HTTPServer::stop() {
     running_ = false;
+    event_loop_->stop();
     if (server_socket_ >= 0) {
         close(server_socket_);
+        server_socket_ = -1;
     }
 }
@@ -0,0 +1,331 @@
+#include "shared_cache.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t cache_magic = 0x5743414348453031ULL;  // "WCACHE01"
+constexpr uint32_t cache_version = 1;
+constexpr size_t cache_ways = 8;
+constexpr size_t lock_stripes = 64;
+
+uint64_t hash_key(const std::string& key) {
+    // FNV-1a: stable across processes, unlike a per-process seeded hash
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash ? hash : 1;  // 0 marks an empty slot
+}
+
+int64_t now_ns() {
+    // CLOCK_MONOTONIC is shared by every process on the machine
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+struct SharedResponseCache::Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t ways;
+    uint64_t slot_count;
+    uint64_t slot_size;
+    int32_t default_ttl;
+    std::atomic<uint64_t> recoveries;
+    std::atomic<uint64_t> clock;  // Logical time for LRU eviction
+    pthread_mutex_t locks[lock_stripes];
+};
+
+struct SharedResponseCache::Slot {
+    std::atomic<uint64_t> sequence;  // Odd while a writer is modifying the slot
+    std::atomic<uint64_t> last_used; // Updated by readers, outside the seqlock
+    uint64_t hash;                   // 0 = empty
+    int64_t expires_at;
+    uint32_t key_len;
+    uint32_t value_len;
+    char data[];                     // key bytes followed by value bytes
+};
+
+std::shared_ptr<SharedResponseCache> SharedResponseCache::create(const Options& options,
+                                                                 const std::string& name) {
+    size_t slot_count = (options.slot_count + cache_ways - 1) / cache_ways * cache_ways;
+    size_t slot_size = (options.slot_size + 63) & ~size_t(63);
+    if (slot_count == 0 || slot_size <= sizeof(Slot)) {
+        throw std::runtime_error("Invalid shared cache geometry");
+    }
+
+    size_t header_size = (sizeof(Header) + 63) & ~size_t(63);
+    size_t mapped_size = header_size + slot_count * slot_size;
+
+    bool created = true;
+    int fd;
+    if (name.empty()) {
+        fd = memfd_create("web_server_cache", MFD_CLOEXEC);
+    } else {
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno == EEXIST) {
+            fd = shm_open(name.c_str(), O_RDWR, 0600);
+            created = false;
+        }
+    }
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create shared cache segment");
+    }
+    if (created && ftruncate(fd, static_cast<off_t>(mapped_size)) < 0) {
+        close(fd);
+        throw std::runtime_error("Failed to size shared cache segment");
+    }
+
+    void* base = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("Failed to map shared cache segment");
+    }
+
+    auto* header = static_cast<Header*>(base);
+    if (created) {
+        // Fresh pages are zero-filled: empty slots with sequence 0
+        header->version = cache_version;
+        header->ways = cache_ways;
+        header->slot_count = slot_count;
+        header->slot_size = slot_size;
+        header->default_ttl = options.default_ttl;
+        new (&header->recoveries) std::atomic<uint64_t>(0);
+        new (&header->clock) std::atomic<uint64_t>(0);
+
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        for (auto& lock : header->locks) {
+            pthread_mutex_init(&lock, &attr);
+        }
+        pthread_mutexattr_destroy(&attr);
+
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = cache_magic;
+    } else if (header->magic != cache_magic || header->version != cache_version ||
+               header->slot_count != slot_count || header->slot_size != slot_size) {
+        munmap(base, mapped_size);
+        throw std::runtime_error("Shared cache segment " + name + " has an incompatible layout");
+    }
+
+    return std::shared_ptr<SharedResponseCache>(new SharedResponseCache(base, mapped_size));
+}
+
+SharedResponseCache::SharedResponseCache(void* base, size_t mapped_size)
+    : base_(base), mapped_size_(mapped_size), header_(static_cast<Header*>(base)) {
+}
+
+SharedResponseCache::~SharedResponseCache() {
+    munmap(base_, mapped_size_);
+}
+
+SharedResponseCache::Slot* SharedResponseCache::slot(size_t index) const {
+    size_t header_size = (sizeof(Header) + 63) & ~size_t(63);
+    return reinterpret_cast<Slot*>(static_cast<char*>(base_) + header_size +
+                                   index * header_->slot_size);
+}
+
+size_t SharedResponseCache::set_of(uint64_t hash) const {
+    return (hash >> 7) % (header_->slot_count / header_->ways);
+}
+
+size_t SharedResponseCache::max_entry_size() const {
+    return header_->slot_size - sizeof(Slot);
+}
+
+uint64_t SharedResponseCache::recoveries() const {
+    return header_->recoveries.load(std::memory_order_relaxed);
+}
+
+void SharedResponseCache::lock_stripe(size_t set) const {
+    size_t stripe = set % lock_stripes;
+    int rc = pthread_mutex_lock(&header_->locks[stripe]);
+    if (rc == EOWNERDEAD) {
+        // The previous owner died mid-update: repair, then mark the lock usable
+        repair_stripe(stripe);
+        pthread_mutex_consistent(&header_->locks[stripe]);
+        header_->recoveries.fetch_add(1, std::memory_order_relaxed);
+    } else if (rc != 0) {
+        throw std::runtime_error("Failed to lock shared cache");
+    }
+}
+
+void SharedResponseCache::unlock_stripe(size_t set) const {
+    pthread_mutex_unlock(&header_->locks[set % lock_stripes]);
+}
+
+void SharedResponseCache::repair_stripe(size_t stripe) const {
+    size_t sets = header_->slot_count / header_->ways;
+    for (size_t set = stripe; set < sets; set += lock_stripes) {
+        for (size_t way = 0; way < header_->ways; ++way) {
+            Slot* s = slot(set * header_->ways + way);
+            uint64_t sequence = s->sequence.load(std::memory_order_relaxed);
+            if (sequence & 1) {
+                // Torn write: drop the entry and publish the slot as empty
+                s->hash = 0;
+                s->key_len = 0;
+                s->value_len = 0;
+                s->sequence.store(sequence + 1, std::memory_order_release);
+            }
+        }
+    }
+}
+
+std::shared_ptr<std::string> SharedResponseCache::get(const std::string& key) const {
+    uint64_t hash = hash_key(key);
+    size_t set = set_of(hash);
+    size_t max_len = max_entry_size();
+
+    for (size_t way = 0; way < header_->ways; ++way) {
+        Slot* s = slot(set * header_->ways + way);
+
+        for (int attempt = 0; attempt < 16; ++attempt) {
+            uint64_t before = s->sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;  // Writer in progress
+            }
+
+            uint64_t slot_hash = s->hash;
+            int64_t expires_at = s->expires_at;
+            uint32_t key_len = s->key_len;
+            uint32_t value_len = s->value_len;
+
+            bool candidate = slot_hash == hash && key_len == key.size() &&
+                             static_cast<size_t>(key_len) + value_len <= max_len;
+            std::shared_ptr<std::string> value;
+            if (candidate) {
+                candidate = std::memcmp(s->data, key.data(), key_len) == 0;
+                if (candidate) {
+                    value = std::make_shared<std::string>(s->data + key_len, value_len);
+                }
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s->sequence.load(std::memory_order_relaxed) != before) {
+                continue;  // Torn read, try again
+            }
+
+            if (!candidate) {
+                break;  // Consistent snapshot of some other key
+            }
+            if (expires_at < now_ns()) {
+                return nullptr;
+            }
+            s->last_used.store(header_->clock.fetch_add(1, std::memory_order_relaxed),
+                               std::memory_order_relaxed);
+            return value;
+        }
+    }
+    return nullptr;
+}
+
+bool SharedResponseCache::put(const std::string& key, const std::string& response, int ttl_seconds) {
+    if (key.size() + response.size() > max_entry_size()) {
+        return false;
+    }
+
+    uint64_t hash = hash_key(key);
+    size_t set = set_of(hash);
+    int ttl = (ttl_seconds < 0) ? header_->default_ttl : ttl_seconds;
+    int64_t now = now_ns();
+
+    lock_stripe(set);
+
+    // Reuse the key's slot, else an empty or expired one, else the least recently used
+    Slot* victim = nullptr;
+    uint64_t oldest = UINT64_MAX;
+    for (size_t way = 0; way < header_->ways; ++way) {
+        Slot* s = slot(set * header_->ways + way);
+        if (s->hash == hash && s->key_len == key.size() &&
+            std::memcmp(s->data, key.data(), key.size()) == 0) {
+            victim = s;
+            break;
+        }
+        uint64_t age = (s->hash == 0 || s->expires_at < now)
+                           ? 0
+                           : s->last_used.load(std::memory_order_relaxed) + 1;
+        if (age < oldest) {
+            oldest = age;
+            victim = s;
+        }
+    }
+
+    uint64_t sequence = victim->sequence.load(std::memory_order_relaxed);
+    victim->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    victim->hash = hash;
+    victim->expires_at = now + static_cast<int64_t>(ttl) * 1000000000LL;
+    victim->key_len = static_cast<uint32_t>(key.size());
+    victim->value_len = static_cast<uint32_t>(response.size());
+    std::memcpy(victim->data, key.data(), key.size());
+    std::memcpy(victim->data + key.size(), response.data(), response.size());
+    victim->last_used.store(header_->clock.fetch_add(1, std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+
+    victim->sequence.store(sequence + 2, std::memory_order_release);
+    unlock_stripe(set);
+    return true;
+}
+
+void SharedResponseCache::remove(const std::string& key) {
+    uint64_t hash = hash_key(key);
+    size_t set = set_of(hash);
+
+    lock_stripe(set);
+    for (size_t way = 0; way < header_->ways; ++way) {
+        Slot* s = slot(set * header_->ways + way);
+        if (s->hash == hash && s->key_len == key.size() &&
+            std::memcmp(s->data, key.data(), key.size()) == 0) {
+            uint64_t sequence = s->sequence.load(std::memory_order_relaxed);
+            s->sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            s->hash = 0;
+            s->sequence.store(sequence + 2, std::memory_order_release);
+        }
+    }
+    unlock_stripe(set);
+}
+
+void SharedResponseCache::clear() {
+    size_t sets = header_->slot_count / header_->ways;
+    for (size_t set = 0; set < sets; ++set) {
+        lock_stripe(set);
+        for (size_t way = 0; way < header_->ways; ++way) {
+            Slot* s = slot(set * header_->ways + way);
+            if (s->hash != 0) {
+                uint64_t sequence = s->sequence.load(std::memory_order_relaxed);
+                s->sequence.store(sequence + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                s->hash = 0;
+                s->sequence.store(sequence + 2, std::memory_order_release);
+            }
+        }
+        unlock_stripe(set);
+    }
+}
+
+size_t SharedResponseCache::size() const {
+    int64_t now = now_ns();
+    size_t count = 0;
+    for (size_t i = 0; i < header_->slot_count; ++i) {
+        Slot* s = slot(i);
+        if (s->hash != 0 && s->expires_at >= now) {
+            ++count;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,234 @@
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace trace {
+
+namespace {
+
+constexpr size_t ring_capacity = 8192;  // Spans kept per thread (power of two)
+
+// Slot fields are atomics so the exporter can read while the owner writes;
+// the sequence number works as a per-slot seqlock to reject torn reads
+struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> request_id{0};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+};
+
+struct ThreadBuffer {
+    int tid = 0;
+    std::atomic<uint64_t> head{0};
+    Slot slots[ring_capacity];
+};
+
+struct Epoch {
+    uint64_t ticks;
+    std::chrono::steady_clock::time_point time;
+};
+
+std::mutex registry_mutex;
+std::vector<ThreadBuffer*> registry;  // Buffers outlive their threads
+std::atomic<int> next_tid{1};
+std::atomic<uint64_t> next_request_id{1};
+std::atomic<uint32_t> sample_threshold{0};  // rate scaled to [0, 2^32)
+std::atomic<uint32_t> capture_threshold{0};  // Highest of the active captures'
+
+std::mutex capture_mutex;
+std::multiset<uint32_t> capture_thresholds;
+
+uint32_t threshold_of(double rate) {
+    if (rate <= 0.0) {
+        return 0;
+    }
+    if (rate >= 1.0) {
+        return UINT32_MAX;
+    }
+    return static_cast<uint32_t>(rate * 4294967296.0);
+}
+
+thread_local ThreadBuffer* tls_buffer = nullptr;
+thread_local Context tls_context;
+thread_local uint64_t tls_task_enqueued = 0;
+thread_local uint64_t tls_rng = 0;
+
+const Epoch& epoch() {
+    static const Epoch e{now(), std::chrono::steady_clock::now()};
+    return e;
+}
+
+ThreadBuffer& local_buffer() {
+    if (!tls_buffer) {
+        auto* buffer = new ThreadBuffer();
+        buffer->tid = next_tid.fetch_add(1);
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(buffer);
+        tls_buffer = buffer;
+    }
+    return *tls_buffer;
+}
+
+uint32_t next_random() {
+    if (tls_rng == 0) {
+        tls_rng = reinterpret_cast<uintptr_t>(&tls_rng) ^ now() ^ 0x9E3779B97F4A7C15ULL;
+    }
+    tls_rng ^= tls_rng << 13;
+    tls_rng ^= tls_rng >> 7;
+    tls_rng ^= tls_rng << 17;
+    return static_cast<uint32_t>(tls_rng >> 32);
+}
+
+}  // namespace
+
+uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+Context begin_request() {
+    epoch();  // Pin the calibration point before the first span
+    uint32_t threshold = std::max(sample_threshold.load(std::memory_order_relaxed),
+                                  capture_threshold.load(std::memory_order_relaxed));
+    if (threshold == 0) {
+        return {};
+    }
+    bool sampled = threshold == UINT32_MAX || next_random() < threshold;
+    return {sampled ? next_request_id.fetch_add(1, std::memory_order_relaxed) : 0, sampled};
+}
+
+const Context& current() {
+    return tls_context;
+}
+
+void record(const Context& ctx, const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer& buffer = local_buffer();
+    uint64_t index = buffer.head.load(std::memory_order_relaxed);
+    Slot& slot = buffer.slots[index & (ring_capacity - 1)];
+
+    uint64_t sequence = 2 * index + 1;
+    slot.sequence.store(sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.request_id.store(ctx.request_id, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_release);
+    buffer.head.store(index + 1, std::memory_order_release);
+}
+
+void note_task_start(uint64_t enqueued_at) {
+    tls_task_enqueued = enqueued_at;
+}
+
+void set_sample_rate(double rate) {
+    sample_threshold = threshold_of(rate);
+}
+
+double sample_rate() {
+    uint32_t threshold = sample_threshold.load(std::memory_order_relaxed);
+    return threshold == UINT32_MAX ? 1.0 : threshold / 4294967296.0;
+}
+
+Capture::Capture(double rate) : threshold_(threshold_of(rate)) {
+    std::lock_guard<std::mutex> lock(capture_mutex);
+    capture_thresholds.insert(threshold_);
+    capture_threshold = *capture_thresholds.rbegin();
+}
+
+Capture::~Capture() {
+    std::lock_guard<std::mutex> lock(capture_mutex);
+    capture_thresholds.erase(capture_thresholds.find(threshold_));
+    capture_threshold = capture_thresholds.empty() ? 0 : *capture_thresholds.rbegin();
+}
+
+ContextScope::ContextScope(const Context& ctx) : previous_(tls_context) {
+    tls_context = ctx;
+    if (tls_task_enqueued) {
+        if (ctx.sampled) {
+            record(ctx, "queue_wait", tls_task_enqueued, now());
+        }
+        tls_task_enqueued = 0;
+    }
+}
+
+ContextScope::~ContextScope() {
+    tls_context = previous_;
+}
+
+std::string export_chrome_json(double seconds) {
+    const Epoch& e = epoch();
+    uint64_t ticks_now = now();
+    double elapsed_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - e.time).count();
+    double ticks_per_us = elapsed_us > 0 ? (ticks_now - e.ticks) / elapsed_us : 1.0;
+    if (ticks_per_us <= 0) ticks_per_us = 1.0;
+
+    double window = seconds * 1e6 * ticks_per_us;
+    uint64_t cutoff = (window >= static_cast<double>(ticks_now - e.ticks))
+                          ? e.ticks
+                          : ticks_now - static_cast<uint64_t>(window);
+
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        buffers = registry;
+    }
+
+    std::ostringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+
+    for (ThreadBuffer* buffer : buffers) {
+        out << (first ? "" : ",")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"thread-" << buffer->tid << "\"}}";
+        first = false;
+
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = head > ring_capacity ? head - ring_capacity : 0;
+        for (uint64_t index = begin; index < head; ++index) {
+            const Slot& slot = buffer->slots[index & (ring_capacity - 1)];
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence != 2 * index + 2) {
+                continue;  // Overwritten or still being written
+            }
+            const char* name = slot.name.load(std::memory_order_relaxed);
+            uint64_t request_id = slot.request_id.load(std::memory_order_relaxed);
+            uint64_t start = slot.start.load(std::memory_order_relaxed);
+            uint64_t end = slot.end.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+                continue;
+            }
+            if (end < cutoff || start < e.ticks) {
+                continue;
+            }
+
+            out << ",{\"name\":\"" << name << "\",\"cat\":\"http\",\"ph\":\"X\",\"pid\":1"
+                << ",\"tid\":" << buffer->tid
+                << ",\"ts\":" << (start - e.ticks) / ticks_per_us
+                << ",\"dur\":" << (end - start) / ticks_per_us
+                << ",\"args\":{\"request\":" << request_id << "}}";
+        }
+    }
+
+    out << "]}";
+    return out.str();
+}
+
+}  // namespace trace
@@ -0,0 +1,494 @@
+#include "websocket.h"
+#include "connection.h"
+#include "event_loop.h"
+#include "http_message.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <openssl/evp.h>
+
+namespace {
+
+const char* const websocket_guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+const size_t max_iovecs = 64;
+
+// XOR the payload with the 4-byte masking key, eight bytes at a time
+void unmask(char* data, size_t len, const uint8_t* mask) {
+    uint32_t mask32;
+    std::memcpy(&mask32, mask, 4);
+    uint64_t mask64 = (static_cast<uint64_t>(mask32) << 32) | mask32;
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        word ^= mask64;
+        std::memcpy(data + i, &word, 8);
+    }
+    for (; i < len; ++i) {
+        data[i] ^= mask[i & 3];
+    }
+}
+
+std::string lowercase(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return value;
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Framing
+// ---------------------------------------------------------------------------
+
+WebSocketParser::WebSocketParser(size_t max_message_size)
+    : max_message_size_(max_message_size) {
+}
+
+bool WebSocketParser::feed(const char* data, size_t len, std::vector<WebSocketFrame>& out) {
+    buffer_.append(data, len);
+
+    while (true) {
+        size_t available = buffer_.size() - consumed_;
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(buffer_.data()) + consumed_;
+        if (available < 2) break;
+
+        bool fin = p[0] & 0x80;
+        uint8_t opcode = p[0] & 0x0F;
+        bool masked = p[1] & 0x80;
+        uint64_t length = p[1] & 0x7F;
+        size_t header = 2;
+
+        // No extensions are negotiated, and clients must mask every frame
+        if ((p[0] & 0x70) || !masked) {
+            error_code_ = 1002;
+            return false;
+        }
+
+        if (length == 126) {
+            if (available < 4) break;
+            length = (static_cast<uint64_t>(p[2]) << 8) | p[3];
+            header = 4;
+        } else if (length == 127) {
+            if (available < 10) break;
+            length = 0;
+            for (int i = 0; i < 8; ++i) {
+                length = (length << 8) | p[2 + i];
+            }
+            header = 10;
+        }
+
+        bool control = opcode & 0x8;
+        if (control && (!fin || length > 125)) {
+            error_code_ = 1002;
+            return false;
+        }
+        if (length > max_message_size_ ||
+            (!control && in_message_ && message_.size() + length > max_message_size_)) {
+            error_code_ = 1009;
+            return false;
+        }
+
+        header += 4;
+        if (available < header + length) break;
+
+        const uint8_t* mask = p + header - 4;
+        std::string payload(reinterpret_cast<const char*>(p + header), static_cast<size_t>(length));
+        unmask(payload.data(), payload.size(), mask);
+        consumed_ += header + static_cast<size_t>(length);
+
+        switch (opcode) {
+            case WebSocketFrame::CLOSE:
+            case WebSocketFrame::PING:
+            case WebSocketFrame::PONG:
+                out.push_back({opcode, std::move(payload)});
+                break;
+
+            case WebSocketFrame::CONTINUATION:
+                if (!in_message_) {
+                    error_code_ = 1002;
+                    return false;
+                }
+                message_ += payload;
+                if (fin) {
+                    out.push_back({message_opcode_, std::move(message_)});
+                    message_.clear();
+                    in_message_ = false;
+                }
+                break;
+
+            case WebSocketFrame::TEXT:
+            case WebSocketFrame::BINARY:
+                if (in_message_) {
+                    error_code_ = 1002;
+                    return false;
+                }
+                if (fin) {
+                    out.push_back({opcode, std::move(payload)});
+                } else {
+                    in_message_ = true;
+                    message_opcode_ = opcode;
+                    message_ = std::move(payload);
+                }
+                break;
+
+            default:
+                error_code_ = 1002;
+                return false;
+        }
+    }
+
+    // Drop consumed bytes once they are worth moving
+    if (consumed_ == buffer_.size()) {
+        buffer_.clear();
+        consumed_ = 0;
+    } else if (consumed_ > 65536) {
+        buffer_.erase(0, consumed_);
+        consumed_ = 0;
+    }
+    return true;
+}
+
+std::string encode_websocket_frame(uint8_t opcode, const char* payload, size_t len) {
+    std::string frame;
+    frame.reserve(len + 10);
+    frame += static_cast<char>(0x80 | opcode);
+
+    if (len < 126) {
+        frame += static_cast<char>(len);
+    } else if (len <= 0xFFFF) {
+        frame += static_cast<char>(126);
+        frame += static_cast<char>((len >> 8) & 0xFF);
+        frame += static_cast<char>(len & 0xFF);
+    } else {
+        frame += static_cast<char>(127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame += static_cast<char>((static_cast<uint64_t>(len) >> shift) & 0xFF);
+        }
+    }
+
+    frame.append(payload, len);
+    return frame;
+}
+
+std::string websocket_accept_key(const std::string& client_key) {
+    std::string input = client_key + websocket_guid;
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+    EVP_Digest(input.data(), input.size(), digest, &digest_len, EVP_sha1(), nullptr);
+
+    unsigned char encoded[64];
+    int encoded_len = EVP_EncodeBlock(encoded, digest, digest_len);
+    return std::string(reinterpret_cast<char*>(encoded), encoded_len);
+}
+
+bool is_websocket_upgrade(const Request& request) {
+    return request.method == "GET" &&
+           lowercase(request.header("Upgrade")) == "websocket" &&
+           !request.header("Sec-WebSocket-Key").empty();
+}
+
+// ---------------------------------------------------------------------------
+// WebSocketSession
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct QueueAwaiter {
+    bool ready;
+    std::coroutine_handle<>& slot;
+    bool await_ready() const noexcept { return ready; }
+    void await_suspend(std::coroutine_handle<> h) noexcept { slot = h; }
+    void await_resume() const noexcept {}
+};
+
+}  // namespace
+
+WebSocketSession::WebSocketSession(Connection& connection, WebSocketHub& hub,
+                                   const Options& options)
+    : connection_(connection), hub_(hub), options_(options) {
+    ++hub_.sessions_;
+}
+
+WebSocketSession::~WebSocketSession() {
+    hub_.unsubscribe_all(this);
+    --hub_.sessions_;
+}
+
+Arena* WebSocketSession::frame_arena() {
+    return connection_.frame_arena();
+}
+
+task<void> WebSocketSession::run(const Request& request, const std::string& topic) {
+    if (request.header("Sec-WebSocket-Version") != "13") {
+        Response response;
+        response.status = 400;
+        response.headers.emplace_back("Sec-WebSocket-Version", "13");
+        co_await connection_.write_all(response.serialize());
+        co_return;
+    }
+
+    std::string handshake =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: " + websocket_accept_key(request.header("Sec-WebSocket-Key")) + "\r\n"
+        "\r\n";
+    if (!co_await connection_.write_all(handshake)) {
+        co_return;
+    }
+
+    if (!topic.empty()) {
+        hub_.subscribe(this, topic);
+    }
+    spawn(write_loop());
+
+    // Bytes go straight into the parser, with no suspension between recv and
+    // feed, so every session on this loop's thread can share one read buffer
+    static thread_local char buffer[16384];
+    int fd = connection_.fd();
+    WebSocketParser parser(options_.max_message_size);
+    std::vector<WebSocketFrame> frames;
+
+    while (!failed_ && !closing_) {
+        // recv inline rather than through read_some: each call of a connection
+        // coroutine takes a frame from the connection arena, which is only
+        // reclaimed when the socket closes
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await connection_.loop().readable(fd);
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        frames.clear();
+        if (!parser.feed(buffer, static_cast<size_t>(n), frames)) {
+            close(parser.error_code());
+            break;
+        }
+
+        for (auto& frame : frames) {
+            if (frame.opcode == WebSocketFrame::PING) {
+                enqueue(std::make_shared<const std::string>(encode_websocket_frame(
+                            WebSocketFrame::PONG, frame.payload.data(), frame.payload.size())),
+                        true);
+            } else if (frame.opcode == WebSocketFrame::CLOSE) {
+                uint16_t code = 1000;
+                if (frame.payload.size() >= 2) {
+                    code = (static_cast<uint8_t>(frame.payload[0]) << 8) |
+                           static_cast<uint8_t>(frame.payload[1]);
+                }
+                close(code);
+                break;
+            } else if (frame.opcode != WebSocketFrame::PONG && !topic.empty()) {
+                // Messages from a client are broadcast to its topic
+                hub_.publish(topic, frame.payload, frame.opcode);
+            }
+        }
+    }
+
+    // Stop receiving fan-out, then wait for the writer to drain and exit
+    hub_.unsubscribe_all(this);
+    if (!closing_) {
+        fail();
+    }
+    wake_writer();
+    co_await QueueAwaiter{writer_done_, reader_waiting_};
+}
+
+bool WebSocketSession::enqueue(const FrameBuffer& frame, bool control) {
+    if (closing_ || failed_) {
+        return false;
+    }
+
+    if (!control && queued_bytes_ + frame->size() > options_.max_queued_bytes) {
+        if (options_.policy == SlowConsumerPolicy::DROP) {
+            ++dropped_frames_;
+        } else {
+            fail();
+        }
+        return false;
+    }
+
+    queue_.push_back(frame);
+    queued_bytes_ += frame->size();
+    wake_writer();
+    return true;
+}
+
+void WebSocketSession::close(uint16_t code) {
+    if (closing_ || failed_) {
+        return;
+    }
+    char payload[2] = {static_cast<char>(code >> 8), static_cast<char>(code & 0xFF)};
+    enqueue(std::make_shared<const std::string>(
+                encode_websocket_frame(WebSocketFrame::CLOSE, payload, sizeof(payload))),
+            true);
+    closing_ = true;
+}
+
+void WebSocketSession::wake_writer() {
+    if (writer_waiting_) {
+        connection_.loop().defer(std::exchange(writer_waiting_, nullptr));
+    }
+}
+
+void WebSocketSession::fail() {
+    if (failed_) {
+        return;
+    }
+    failed_ = true;
+    queue_.clear();
+    queued_bytes_ = 0;
+    front_offset_ = 0;
+    // Wakes the reader (recv returns 0) and any writer waiting for space
+    shutdown(connection_.fd(), SHUT_RDWR);
+    wake_writer();
+}
+
+task<void> WebSocketSession::write_loop() {
+    int fd = connection_.fd();
+    struct iovec iov[max_iovecs];
+
+    while (!failed_) {
+        if (queue_.empty()) {
+            if (closing_) break;
+            co_await QueueAwaiter{false, writer_waiting_};
+            continue;
+        }
+
+        // Gather queued frames straight from their shared buffers
+        size_t count = 0;
+        for (auto it = queue_.begin(); it != queue_.end() && count < max_iovecs; ++it, ++count) {
+            size_t offset = (count == 0) ? front_offset_ : 0;
+            iov[count].iov_base = const_cast<char*>((*it)->data() + offset);
+            iov[count].iov_len = (*it)->size() - offset;
+        }
+
+        struct msghdr message {};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        ssize_t n = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await connection_.loop().writable(fd);
+            } else if (errno != EINTR) {
+                fail();
+            }
+            continue;
+        }
+
+        size_t written = static_cast<size_t>(n);
+        while (written > 0) {
+            size_t remaining = queue_.front()->size() - front_offset_;
+            if (written >= remaining) {
+                written -= remaining;
+                queued_bytes_ -= queue_.front()->size();
+                queue_.pop_front();
+                front_offset_ = 0;
+            } else {
+                front_offset_ += written;
+                written = 0;
+            }
+        }
+    }
+
+    // Our close frame is out; end the connection without waiting for the echo
+    if (closing_ && !failed_) {
+        shutdown(fd, SHUT_RDWR);
+    }
+
+    writer_done_ = true;
+    if (reader_waiting_) {
+        connection_.loop().defer(std::exchange(reader_waiting_, nullptr));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// WebSocketHub
+// ---------------------------------------------------------------------------
+
+WebSocketHub::WebSocketHub(EventLoop& loop) : loop_(loop) {
+}
+
+void WebSocketHub::subscribe(WebSocketSession* session, const std::string& topic) {
+    if (session->subscriptions_.count(topic)) {
+        return;
+    }
+    auto& subscribers = topics_[topic];
+    session->subscriptions_[topic] = subscribers.size();
+    subscribers.push_back(session);
+}
+
+void WebSocketHub::unsubscribe(WebSocketSession* session, const std::string& topic) {
+    auto it = session->subscriptions_.find(topic);
+    if (it == session->subscriptions_.end()) {
+        return;
+    }
+
+    // Swap-remove keeps unsubscription O(1) with tens of thousands of subscribers
+    auto topic_it = topics_.find(topic);
+    auto& subscribers = topic_it->second;
+    size_t index = it->second;
+    WebSocketSession* last = subscribers.back();
+    subscribers[index] = last;
+    last->subscriptions_[topic] = index;
+    subscribers.pop_back();
+    session->subscriptions_.erase(topic);
+
+    if (subscribers.empty()) {
+        topics_.erase(topic_it);
+    }
+}
+
+void WebSocketHub::unsubscribe_all(WebSocketSession* session) {
+    std::vector<std::string> topics;
+    for (const auto& subscription : session->subscriptions_) {
+        topics.push_back(subscription.first);
+    }
+    for (const auto& topic : topics) {
+        unsubscribe(session, topic);
+    }
+}
+
+size_t WebSocketHub::publish(const std::string& topic, const std::string& payload, uint8_t opcode) {
+    auto it = topics_.find(topic);
+    if (it == topics_.end()) {
+        return 0;
+    }
+
+    // Serialize once; every subscriber queues a reference to the same buffer
+    FrameBuffer frame = std::make_shared<const std::string>(
+        encode_websocket_frame(opcode, payload.data(), payload.size()));
+
+    size_t delivered = 0;
+    for (WebSocketSession* session : it->second) {
+        if (session->enqueue(frame)) {
+            ++delivered;
+        }
+    }
+    return delivered;
+}
+
+void WebSocketHub::publish_async(const std::string& topic, std::string payload, uint8_t opcode) {
+    loop_.post([this, topic, payload = std::move(payload), opcode]() {
+        publish(topic, payload, opcode);
+    });
+}
+
+size_t WebSocketHub::subscriber_count(const std::string& topic) const {
+    auto it = topics_.find(topic);
+    return it == topics_.end() ? 0 : it->second.size();
+}